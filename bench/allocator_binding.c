@@ -0,0 +1,63 @@
+#include "bench.h"
+#include <cutils/allocator/arena.h>
+#include <cutils/array.h>
+
+// Appends into many short arrays so the growth path is exercised often
+#define ARRAYS 20000
+#define APPENDS 200
+#define ROUNDS 10
+
+DEFINE_ARRAY_TYPE(int)
+DEFINE_ARRAY_TYPE_WITH_ALLOCATOR(arena_int, int, arena)
+DEFINE_ARRAY_TYPE_WITH_ALLOCATOR(dynamic_int, int, allocator)
+
+static int_array_t heap_arrays[ARRAYS];
+static arena_int_array_t arena_arrays[ARRAYS];
+static dynamic_int_array_t dynamic_arrays[ARRAYS];
+
+int main(void) {
+    const double operations = (double)ARRAYS * APPENDS * ROUNDS;
+
+    BENCH_RUN("malloc-backed append", operations,
+        for (unsigned r = 0; r < ROUNDS; r++) {
+            for (unsigned a = 0; a < ARRAYS; a++) {
+                heap_arrays[a] = EMPTY_ARRAY(int);
+                for (int i = 0; i < APPENDS; i++)
+                    *array_append_int(&heap_arrays[a], 1) = i;
+            }
+            bench_do_not_optimize(heap_arrays[ARRAYS - 1].data);
+            for (unsigned a = 0; a < ARRAYS; a++)
+                array_free_int(&heap_arrays[a]);
+        }
+    );
+
+    arena_allocator_t arena = ARENA_INIT;
+    BENCH_RUN("arena append (direct binding)", operations,
+        for (unsigned r = 0; r < ROUNDS; r++) {
+            for (unsigned a = 0; a < ARRAYS; a++) {
+                arena_arrays[a] = EMPTY_ARRAY_WITH_ALLOCATOR(arena_int, &arena);
+                for (int i = 0; i < APPENDS; i++)
+                    *array_append_arena_int(&arena_arrays[a], 1) = i;
+            }
+            bench_do_not_optimize(arena_arrays[ARRAYS - 1].data);
+            arena_reset(&arena);
+        }
+    );
+
+    const allocator_t allocator = arena_get_allocator(&arena);
+    BENCH_RUN("arena append (allocator_t dispatch)", operations,
+        for (unsigned r = 0; r < ROUNDS; r++) {
+            for (unsigned a = 0; a < ARRAYS; a++) {
+                dynamic_arrays[a] = EMPTY_ARRAY_WITH_ALLOCATOR(dynamic_int, &allocator);
+                for (int i = 0; i < APPENDS; i++)
+                    *array_append_dynamic_int(&dynamic_arrays[a], 1) = i;
+            }
+            bench_do_not_optimize(dynamic_arrays[ARRAYS - 1].data);
+            arena_reset(&arena);
+        }
+    );
+
+    arena_free(&arena);
+    arena_cache_release();
+    return 0;
+}
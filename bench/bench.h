@@ -0,0 +1,75 @@
+#ifndef CUTILS_BENCH_H
+#define CUTILS_BENCH_H
+
+// clock_gettime and CLOCK_MONOTONIC are hidden by glibc in the strict ISO
+// modes, this only helps when bench.h comes before the other includes
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE) && !defined(_DEFAULT_SOURCE) && !defined(_GNU_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <cutils/compatibility.h>
+#include <cutils/perf.h>
+
+// Time in seconds from a monotonic clock, which clock adjustments do not
+// skew, the wall clock only when the system has none
+UNUSED
+static double bench_now(void) {
+    struct timespec ts;
+#if !defined(_WIN32) && defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#elif defined(TIME_MONOTONIC)
+    timespec_get(&ts, TIME_MONOTONIC);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Keep the compiler from optimizing away a computed value
+#ifdef __GNUC__
+#define bench_do_not_optimize(value) __asm__ volatile("" : : "g"(value) : "memory")
+#else
+UNUSED static volatile uintptr_t bench_sink;
+#define bench_do_not_optimize(value) (bench_sink = (uintptr_t)(value))
+#endif
+
+// Print one result line: name, number of operations, time and throughput
+UNUSED
+static void bench_report(const char* name, const double operations, const double seconds) {
+    printf("%-40s %12.0f ops %10.3f ms %10.2f ns/op %10.2f Mops/s\n",
+           name, operations, seconds * 1e3, seconds * 1e9 / operations, operations / seconds * 1e-6);
+}
+
+// Print the hardware counters per operation under the result line, nothing
+// when the system does not expose them
+UNUSED
+static void bench_report_counters(
+    const uint64_t start[PERF_COUNTER_COUNT], const uint64_t end[PERF_COUNTER_COUNT], const double operations
+) {
+    bool printed = false;
+    for (unsigned c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (c == PERF_TASK_CLOCK || !perf_available(c))
+            continue;
+        printf("%s %s %.3f/op", printed ? "," : "   ", perf_counter_names[c], (double)(end[c] - start[c]) / operations);
+        printed = true;
+    }
+    if (printed)
+        putchar('\n');
+}
+
+#define BENCH_RUN(name, operations, ...)                                \
+    do {                                                                \
+        uint64_t bench_counters[2][PERF_COUNTER_COUNT];                 \
+        perf_read(bench_counters[0]);                                   \
+        const double bench_start = bench_now();                         \
+        __VA_ARGS__                                                     \
+        const double bench_end = bench_now();                           \
+        perf_read(bench_counters[1]);                                   \
+        bench_report(name, operations, bench_end - bench_start);        \
+        bench_report_counters(bench_counters[0], bench_counters[1], operations); \
+    } while (0)
+
+#endif //CUTILS_BENCH_H
@@ -0,0 +1,115 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/bits.h>
+#include <cutils/bloom.h>
+
+#define LOOKUPS 10000000
+#define BITS_PER_KEY 12
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+// Classic Bloom filter: k bits anywhere in the bitset with double hashing
+typedef struct {
+    uint8_t* bits;
+    uint64_t size;
+    unsigned k;
+} classic_bloom_t;
+
+static void classic_insert(classic_bloom_t* filter, const uint64_t hash) {
+    const uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32);
+    for (unsigned i = 0; i < filter->k; i++)
+        bits_set(filter->bits, (unsigned)((h1 + (uint64_t)i * h2) % filter->size));
+}
+
+static bool classic_contains(const classic_bloom_t* filter, const uint64_t hash) {
+    const uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32);
+    for (unsigned i = 0; i < filter->k; i++)
+        if (!bits_isset(filter->bits, (unsigned)((h1 + (uint64_t)i * h2) % filter->size)))
+            return false;
+    return true;
+}
+
+static void run(const unsigned count) {
+    char name[64];
+    uint64_t* keys = malloc((size_t)count * sizeof(uint64_t));
+    uint64_t* probes = malloc(LOOKUPS * sizeof(uint64_t));
+    bool* results = malloc(LOOKUPS * sizeof(bool));
+    if (keys == NULL || probes == NULL || results == NULL)
+        exit(1);
+    uint64_t state = count;
+    for (unsigned i = 0; i < count; i++)
+        keys[i] = splitmix64(&state);
+    // Half of the probes are absent keys
+    for (unsigned i = 0; i < LOOKUPS; i++)
+        probes[i] = i % 2 ? splitmix64(&state) : keys[splitmix64(&state) % count];
+
+    // Same memory for both filters, k = 8 is optimal with 12 bits per key
+    classic_bloom_t classic = { NULL, (uint64_t)count * BITS_PER_KEY, 8 };
+    classic.bits = calloc(classic.size / 8 + 1, 1);
+    bloom_filter_t blocked = BLOOM_INIT;
+    if (classic.bits == NULL || !bloom_init(&blocked, (uint32_t)(classic.size / (BLOOM_BLOCK_SIZE * 8)) + 1))
+        exit(1);
+
+    snprintf(name, sizeof(name), "classic insert (%u)", count);
+    BENCH_RUN(name, count,
+        for (unsigned i = 0; i < count; i++)
+            classic_insert(&classic, keys[i]);
+    );
+    snprintf(name, sizeof(name), "blocked insert (%u)", count);
+    BENCH_RUN(name, count,
+        for (unsigned i = 0; i < count; i++)
+            bloom_insert(&blocked, keys[i]);
+    );
+    bloom_clear(&blocked);
+    snprintf(name, sizeof(name), "blocked batch insert (%u)", count);
+    BENCH_RUN(name, count,
+        bloom_insert_batch(&blocked, keys, count);
+    );
+
+    size_t found = 0;
+    snprintf(name, sizeof(name), "classic lookup (%u)", count);
+    BENCH_RUN(name, LOOKUPS,
+        for (unsigned i = 0; i < LOOKUPS; i++)
+            found += classic_contains(&classic, probes[i]);
+    );
+    bench_do_not_optimize(found);
+    snprintf(name, sizeof(name), "blocked lookup (%u)", count);
+    BENCH_RUN(name, LOOKUPS,
+        for (unsigned i = 0; i < LOOKUPS; i++)
+            found += bloom_contains(&blocked, probes[i]);
+    );
+    bench_do_not_optimize(found);
+    snprintf(name, sizeof(name), "blocked batch lookup (%u)", count);
+    BENCH_RUN(name, LOOKUPS,
+        found = bloom_contains_batch(&blocked, probes, LOOKUPS, results);
+    );
+    bench_do_not_optimize(found);
+
+    // False positive rates measured on the absent keys
+    size_t classicPositives = 0, blockedPositives = 0;
+    for (unsigned i = 1; i < LOOKUPS; i += 2) {
+        classicPositives += classic_contains(&classic, probes[i]);
+        blockedPositives += bloom_contains(&blocked, probes[i]);
+    }
+    printf("%-40s classic %.4f%% blocked %.4f%% (expected %.4f%%)\n", "false positive rate",
+           200.0 * classicPositives / LOOKUPS, 200.0 * blockedPositives / LOOKUPS,
+           100 * bloom_false_positive_rate(blocked.block_count, count));
+
+    free(classic.bits);
+    bloom_free(&blocked);
+    free(keys);
+    free(probes);
+    free(results);
+}
+
+int main(void) {
+    run(1000000);
+    run(10000000);
+    return 0;
+}
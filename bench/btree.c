@@ -0,0 +1,132 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <cutils/allocator/arena.h>
+#include <cutils/array.h>
+#include <cutils/btree.h>
+
+#define u64_cmp(a, b) ((*(a) > *(b)) - (*(a) < *(b)))
+
+DEFINE_ARRAY_TYPE(uint64_t)
+DEFINE_BTREE_TYPE(u64, uint64_t, uint64_t, u64_cmp)
+DEFINE_BTREE_TYPE_WITH_ALLOCATOR(arena_u64, uint64_t, uint64_t, u64_cmp, arena)
+
+static int u64_cmp_fn(const uint64_t* a, const uint64_t* b) { return u64_cmp(a, b); }
+
+static int u64_qsort_cmp(const void* a, const void* b) { return u64_cmp_fn(a, b); }
+
+// Sorted array inserts are quadratic, they are only timed on a small set
+#define SORTED_INSERT_COUNT 100000
+#define LOOKUPS 1000000
+#define RANGES 10000
+#define RANGE_WIDTH 100
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+static void run(const unsigned count) {
+    char name[64];
+    uint64_t* keys = malloc((size_t)count * sizeof(uint64_t));
+    uint64_t* probes = malloc(LOOKUPS * sizeof(uint64_t));
+    if (keys == NULL || probes == NULL)
+        exit(1);
+    uint64_t state = count;
+    for (unsigned i = 0; i < count; i++)
+        keys[i] = splitmix64(&state);
+    for (unsigned i = 0; i < LOOKUPS; i++)
+        probes[i] = keys[splitmix64(&state) % count];
+
+    u64_btree_t tree = EMPTY_BTREE(u64);
+    snprintf(name, sizeof(name), "btree random insert (%u)", count);
+    BENCH_RUN(name, count,
+        for (unsigned i = 0; i < count; i++)
+            bench_do_not_optimize(btree_insert_u64(&tree, &keys[i], &keys[i]));
+    );
+    btree_free_u64(&tree);
+
+    arena_allocator_t arena = ARENA_INIT;
+    arena_u64_btree_t arenaTree = EMPTY_BTREE_WITH_ALLOCATOR(arena_u64, &arena);
+    snprintf(name, sizeof(name), "btree arena random insert (%u)", count);
+    BENCH_RUN(name, count,
+        for (unsigned i = 0; i < count; i++)
+            bench_do_not_optimize(btree_insert_arena_u64(&arenaTree, &keys[i], &keys[i]));
+    );
+
+    qsort(keys, count, sizeof(uint64_t), u64_qsort_cmp);
+    snprintf(name, sizeof(name), "btree bulk load (%u)", count);
+    BENCH_RUN(name, count,
+        if (!btree_bulk_load_u64(&tree, keys, keys, count))
+            exit(1);
+    );
+
+    snprintf(name, sizeof(name), "btree find (%u)", count);
+    BENCH_RUN(name, LOOKUPS,
+        for (unsigned i = 0; i < LOOKUPS; i++)
+            bench_do_not_optimize(btree_find_u64(&tree, &probes[i]));
+    );
+    snprintf(name, sizeof(name), "btree arena find (%u)", count);
+    BENCH_RUN(name, LOOKUPS,
+        for (unsigned i = 0; i < LOOKUPS; i++)
+            bench_do_not_optimize(btree_find_arena_u64(&arenaTree, &probes[i]));
+    );
+
+    uint64_t_array_t sorted = {
+        .data = keys, .length = count, .capacity = count
+    };
+    snprintf(name, sizeof(name), "sorted array find (%u)", count);
+    BENCH_RUN(name, LOOKUPS,
+        for (unsigned i = 0; i < LOOKUPS; i++)
+            bench_do_not_optimize(array_find_sorted_uint64_t(&sorted, u64_cmp_fn, &probes[i]));
+    );
+
+    uint64_t sum = 0;
+    snprintf(name, sizeof(name), "btree range scan x%d (%u)", RANGE_WIDTH, count);
+    BENCH_RUN(name, (double)RANGES * RANGE_WIDTH,
+        for (unsigned i = 0; i < RANGES; i++) {
+            u64_btree_iterator_t it = btree_lower_bound_u64(&tree, &probes[i]);
+            for (unsigned j = 0; j < RANGE_WIDTH && btree_iterator_valid(it); j++, btree_next_u64(&it))
+                sum += *btree_iterator_value(it);
+        }
+    );
+    bench_do_not_optimize(sum);
+
+    btree_free_u64(&tree);
+    btree_free_arena_u64(&arenaTree);
+    arena_free(&arena);
+    free(keys);
+    free(probes);
+}
+
+// Usage: btree [max key count], the sizes grow tenfold from 1M up to the
+// maximum (10M by default, 100M needs about 4 GiB)
+int main(const int argc, char** argv) {
+    const unsigned max = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 10) : 10000000;
+
+    uint64_t state = 0;
+    uint64_t* values = malloc(SORTED_INSERT_COUNT * sizeof(uint64_t));
+    if (values == NULL)
+        return 1;
+    for (unsigned i = 0; i < SORTED_INSERT_COUNT; i++)
+        values[i] = splitmix64(&state);
+    uint64_t_array_t sorted = EMPTY_ARRAY(uint64_t);
+    BENCH_RUN("sorted array random insert (100000)", SORTED_INSERT_COUNT,
+        for (unsigned i = 0; i < SORTED_INSERT_COUNT; i++)
+            bench_do_not_optimize(array_insert_sorted_uint64_t(&sorted, u64_cmp_fn, &values[i]));
+    );
+    u64_btree_t tree = EMPTY_BTREE(u64);
+    BENCH_RUN("btree random insert (100000)", SORTED_INSERT_COUNT,
+        for (unsigned i = 0; i < SORTED_INSERT_COUNT; i++)
+            bench_do_not_optimize(btree_insert_u64(&tree, &values[i], &values[i]));
+    );
+    btree_free_u64(&tree);
+    array_free_uint64_t(&sorted);
+    free(values);
+
+    for (unsigned count = 1000000; count <= max && count != 0; count *= 10)
+        run(count);
+    arena_cache_release();
+    return 0;
+}
@@ -0,0 +1,96 @@
+#define _DEFAULT_SOURCE
+#include "bench.h"
+#include <stdlib.h>
+#include <cutils/concurrent_map.h>
+
+DEFINE_CONCURRENT_MAP_TYPE(u64, uint64_t)
+
+#define KEYS (1 << 16)
+// Operations of a run, split between its threads
+#define OPERATIONS 2000000
+#define MAX_THREADS 32
+
+typedef struct {
+    u64_concurrent_map_t* map;
+    const string_view_t* keys;
+    unsigned operations;
+    // Out of 100 operations, the number of writes (half upserts, half erases)
+    unsigned writes;
+    uint64_t seed;
+    uint64_t found;
+} worker_t;
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+static void* worker(void* arg) {
+    worker_t* w = arg;
+    uint64_t state = w->seed, found = 0;
+    for (unsigned i = 0; i < w->operations; i++) {
+        const uint64_t r = splitmix64(&state);
+        const string_view_t key = w->keys[r % KEYS];
+        const unsigned kind = (unsigned)(r >> 32) % 100;
+        if (kind >= w->writes) {
+            uint64_t value;
+            found += concurrent_map_find_u64(w->map, key, &value);
+        } else if (kind % 2 == 0) {
+            found += concurrent_map_upsert_u64(w->map, key, &r) == -ERROR_NO_ERROR;
+        } else {
+            found += concurrent_map_erase_u64(w->map, key, NULL);
+        }
+    }
+    w->found = found;
+    return NULL;
+}
+
+static void run(const string_view_t* keys, const unsigned shards, const unsigned writes) {
+    char name[64];
+    for (unsigned threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        u64_concurrent_map_t map;
+        if (!concurrent_map_init_u64(&map, shards, 0))
+            exit(1);
+        for (unsigned i = 0; i < KEYS; i += 2) {
+            const uint64_t value = i;
+            if (concurrent_map_insert_u64(&map, keys[i], &value) != -ERROR_NO_ERROR)
+                exit(1);
+        }
+        pthread_t ids[MAX_THREADS];
+        worker_t workers[MAX_THREADS];
+        snprintf(name, sizeof(name), "%u shard%s %u%% writes %u threads",
+                 shards, shards > 1 ? "s" : "", writes, threads);
+        BENCH_RUN(name, OPERATIONS,
+            for (unsigned t = 0; t < threads; t++) {
+                workers[t] = (worker_t) { &map, keys, OPERATIONS / threads, writes, t + 1, 0 };
+                pthread_create(&ids[t], NULL, worker, &workers[t]);
+            }
+            for (unsigned t = 0; t < threads; t++)
+                pthread_join(ids[t], NULL);
+        );
+        for (unsigned t = 0; t < threads; t++)
+            bench_do_not_optimize(workers[t].found);
+        concurrent_map_free_u64(&map);
+    }
+}
+
+int main(void) {
+    // Keys of 8 to 23 characters, half of them in the map at the start
+    static char storage[KEYS * 24];
+    static string_view_t keys[KEYS];
+    uint64_t state = 1;
+    for (unsigned i = 0; i < KEYS; i++) {
+        const int len = snprintf(storage + i * 24, 24, "key-%llu",
+                                 (unsigned long long)(splitmix64(&state) >> (i % 40)));
+        keys[i] = (string_view_t) { storage + i * 24, (size_t)len };
+    }
+    // A single shard is one global reader-writer lock
+    const unsigned shards[] = { 1, CONCURRENT_MAP_DEFAULT_SHARDS };
+    for (unsigned s = 0; s < 2; s++) {
+        run(keys, shards[s], 5);
+        run(keys, shards[s], 50);
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <cutils/csv.h>
+
+#define SIZE (128 * 1024 * 1024)
+#define CHUNK (1024 * 1024)
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Records of numbers, words and a quoted comment with delimiters inside
+static void generate(string_t* text) {
+    static const char* const words[] = { "alpha", "beta", "gamma", "delta", "epsilon", "zeta" };
+    uint64_t state = 88172645463325252U;
+    char record[256];
+    while (text->length < SIZE - sizeof(record)) {
+        const uint64_t r = next_random(&state);
+        const int length = snprintf(record, sizeof(record), "%u,%s,%.3f,\"%s, %s \"\"%u\"\"\",%s\r\n",
+                                    (unsigned)(r & 0xFFFFF), words[r % 6], (double)(r >> 40) / 1000.0,
+                                    words[(r >> 8) % 6], words[(r >> 16) % 6], (unsigned)(r >> 24) % 100,
+                                    words[(r >> 32) % 6]);
+        char* out = array_append_char(text, (unsigned)length);
+        if (out == NULL)
+            exit(1);
+        memcpy(out, record, (size_t)length);
+    }
+}
+
+static uint64_t read_csv(const string_t* text, const size_t chunk) {
+    csv_reader_t reader = csv_reader_init(',');
+    csv_field_array_t* record;
+    uint64_t fields = 0;
+    for (size_t start = 0; start < text->length; start += chunk) {
+        const size_t size = MIN(chunk, text->length - start);
+        if (!csv_reader_feed(&reader, (string_view_t) { .str = text->data + start, .len = size }))
+            exit(1);
+        while (csv_reader_next(&reader, &record) == -ERROR_NO_ERROR)
+            fields += record->length;
+    }
+    csv_reader_finish(&reader);
+    while (csv_reader_next(&reader, &record) == -ERROR_NO_ERROR)
+        fields += record->length;
+    csv_reader_free(&reader);
+    return fields;
+}
+
+// Byte at a time state machine, only counting the fields
+static uint64_t read_bytes(const string_t* text) {
+    uint64_t fields = 0;
+    bool quoted = false;
+    for (unsigned i = 0; i < text->length; i++) {
+        const char c = text->data[i];
+        quoted ^= c == '"';
+        fields += !quoted && (c == ',' || c == '\n');
+    }
+    return fields;
+}
+
+int main(void) {
+    string_t text = EMPTY_STRING;
+    generate(&text);
+
+    uint64_t fields = 0;
+    double start = bench_now();
+    BENCH_RUN("byte loop, count fields (128 MiB)", text.length, fields += read_bytes(&text););
+    const double bytes = bench_now() - start;
+    start = bench_now();
+    BENCH_RUN("csv_reader 1 MiB chunks (128 MiB)", text.length, fields += read_csv(&text, CHUNK););
+    const double chunked = bench_now() - start;
+    start = bench_now();
+    BENCH_RUN("csv_reader single chunk (128 MiB)", text.length, fields += read_csv(&text, text.length););
+    const double single = bench_now() - start;
+    printf("GB/s: byte loop %.2f, csv_reader chunked %.2f, single chunk %.2f\n",
+           text.length / bytes * 1e-9, text.length / chunked * 1e-9, text.length / single * 1e-9);
+    bench_do_not_optimize(fields);
+    string_free(&text);
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <cutils/file_reader.h>
+
+#define PATH "file_reader_bench.tmp"
+#define SIZE (256 * 1024 * 1024)
+#define BUFFER (256 * 1024)
+#define DEPTH 8
+
+// Light processing of a chunk, so the I/O dominates
+static uint64_t checksum(const char* data, const size_t size) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < size; i++)
+        sum += (unsigned char)data[i];
+    return sum;
+}
+
+static uint64_t sequential_read(void) {
+    const int fd = file_reader_open_fd(PATH);
+    char* buffer = malloc(BUFFER);
+    if (fd < 0 || buffer == NULL)
+        exit(1);
+    uint64_t sum = 0;
+    long ret;
+    while ((ret = (long)file_reader_read_fd(fd, buffer, BUFFER)) > 0)
+        sum += checksum(buffer, (size_t)ret);
+    file_reader_close_fd(fd);
+    free(buffer);
+    return sum;
+}
+
+static uint64_t reader_read(const unsigned flags) {
+    file_reader_t reader;
+    if (file_reader_open(&reader, PATH, DEPTH, BUFFER, flags) != -ERROR_NO_ERROR)
+        exit(1);
+    uint64_t sum = 0;
+    file_chunk_t chunk;
+    while (file_reader_next(&reader, &chunk) == -ERROR_NO_ERROR) {
+        sum += checksum(chunk.data, chunk.size);
+        file_reader_release(&reader, &chunk);
+    }
+    file_reader_close(&reader);
+    return sum;
+}
+
+int main(void) {
+    FILE* f = fopen(PATH, "wb");
+    char* block = malloc(BUFFER);
+    if (f == NULL || block == NULL)
+        return 1;
+    for (unsigned i = 0; i < BUFFER; i++)
+        block[i] = (char)(i * 13);
+    for (unsigned i = 0; i < SIZE / BUFFER; i++)
+        fwrite(block, 1, BUFFER, f);
+    fclose(f);
+    free(block);
+
+    // The file is in the page cache, so this measures the overlap of the
+    // system calls and copies with the processing rather than the device
+    uint64_t sum = 0;
+    BENCH_RUN("read() + checksum (256 MiB)", SIZE, sum += sequential_read(););
+    BENCH_RUN("file_reader sync + checksum (256 MiB)", SIZE, sum += reader_read(FILE_READER_SYNC););
+    BENCH_RUN("file_reader + checksum (256 MiB)", SIZE, sum += reader_read(0););
+    BENCH_RUN("file_reader registered + checksum", SIZE, sum += reader_read(FILE_READER_REGISTER_BUFFERS););
+    bench_do_not_optimize(sum);
+    remove(PATH);
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "bench.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <cutils/format.h>
+
+#define COUNT 1000000
+
+static uint64_t* integers;
+static double* doubles;
+static double* decimals;
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// The previous way: snprintf into a buffer, then copy into the string
+static void append_printf(string_t* str, const char* format, ...) {
+    char buffer[64];
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    char* out = array_append_char(str, (unsigned)length);
+    if (out == NULL)
+        exit(1);
+    memcpy(out, buffer, (size_t)length);
+}
+
+#define CHECK(call)     \
+    do {                \
+        if (!(call))    \
+            exit(1);    \
+    } while (0)
+
+int main(void) {
+    integers = malloc(COUNT * sizeof(uint64_t));
+    doubles = malloc(COUNT * sizeof(double));
+    decimals = malloc(COUNT * sizeof(double));
+    if (integers == NULL || doubles == NULL || decimals == NULL)
+        return 1;
+    uint64_t state = 88172645463325252U;
+    for (unsigned i = 0; i < COUNT; i++) {
+        // All the magnitudes, and prices with three decimals as in a CSV file
+        integers[i] = next_random(&state) >> (next_random(&state) % 64);
+        uint64_t bits;
+        do
+            bits = next_random(&state);
+        while ((bits >> 52 & 0x7FF) == 0x7FF);
+        memcpy(&doubles[i], &bits, sizeof(double));
+        decimals[i] = (double)(next_random(&state) % 100000000) / 1000.0;
+    }
+
+    string_t str = EMPTY_STRING;
+    BENCH_RUN("snprintf %llu", COUNT,
+        str.length = 0;
+        for (unsigned i = 0; i < COUNT; i++)
+            append_printf(&str, "%llu", (unsigned long long)integers[i]);
+    );
+    BENCH_RUN("string_append_u64", COUNT,
+        str.length = 0;
+        for (unsigned i = 0; i < COUNT; i++)
+            CHECK(string_append_u64(&str, integers[i]));
+    );
+    BENCH_RUN("snprintf %016llx", COUNT,
+        str.length = 0;
+        for (unsigned i = 0; i < COUNT; i++)
+            append_printf(&str, "%016llx", (unsigned long long)integers[i]);
+    );
+    BENCH_RUN("string_append_hex width 16", COUNT,
+        str.length = 0;
+        for (unsigned i = 0; i < COUNT; i++)
+            CHECK(string_append_hex(&str, integers[i], 16));
+    );
+    BENCH_RUN("snprintf %.17g random doubles", COUNT,
+        str.length = 0;
+        for (unsigned i = 0; i < COUNT; i++)
+            append_printf(&str, "%.17g", doubles[i]);
+    );
+    BENCH_RUN("string_append_f64 random doubles", COUNT,
+        str.length = 0;
+        for (unsigned i = 0; i < COUNT; i++)
+            CHECK(string_append_f64(&str, doubles[i]));
+    );
+    BENCH_RUN("snprintf %.17g decimals", COUNT,
+        str.length = 0;
+        for (unsigned i = 0; i < COUNT; i++)
+            append_printf(&str, "%.17g", decimals[i]);
+    );
+    BENCH_RUN("string_append_f64 decimals", COUNT,
+        str.length = 0;
+        for (unsigned i = 0; i < COUNT; i++)
+            CHECK(string_append_f64(&str, decimals[i]));
+    );
+    BENCH_RUN("snprintf %.3f decimals", COUNT,
+        str.length = 0;
+        for (unsigned i = 0; i < COUNT; i++)
+            append_printf(&str, "%.3f", decimals[i]);
+    );
+    BENCH_RUN("string_append_f64_fixed 3 decimals", COUNT,
+        str.length = 0;
+        for (unsigned i = 0; i < COUNT; i++)
+            CHECK(string_append_f64_fixed(&str, decimals[i], 3));
+    );
+    bench_do_not_optimize(str.data);
+    string_free(&str);
+    free(integers);
+    free(doubles);
+    free(decimals);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <cutils/hash.h>
+
+// Bytes hashed for every key length
+#define BYTES (64 * 1024 * 1024)
+#define MAX_LENGTH (64 * 1024)
+#define VIEWS 4096
+
+static uint64_t fnv1a(const void* data, const size_t size) {
+    const uint8_t* p = data;
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < size; i++)
+        h = (h ^ p[i]) * UINT64_C(0x100000001b3);
+    return h;
+}
+
+int main(void) {
+    char name[64];
+    // Keys are taken at every offset of a buffer larger than the longest key
+    char* buffer = malloc(2 * MAX_LENGTH);
+    if (buffer == NULL)
+        return 1;
+    for (unsigned i = 0; i < 2 * MAX_LENGTH; i++)
+        buffer[i] = (char)(i * 2654435761U >> 13);
+
+    for (size_t length = 1; length <= MAX_LENGTH; length *= 2) {
+        const size_t count = BYTES / length < 1000000 ? BYTES / length : 1000000;
+        uint64_t h = 0;
+        snprintf(name, sizeof(name), "hash_bytes %zu B", length);
+        BENCH_RUN(name, count,
+            for (size_t i = 0; i < count; i++)
+                h += hash_bytes(buffer + (i & (MAX_LENGTH - 1)), length, 0);
+        );
+        snprintf(name, sizeof(name), "fnv1a %zu B", length);
+        BENCH_RUN(name, count,
+            for (size_t i = 0; i < count; i++)
+                h += fnv1a(buffer + (i & (MAX_LENGTH - 1)), length);
+        );
+        bench_do_not_optimize(h);
+    }
+
+    // Short keys of various lengths, one by one and in bulk
+    static string_view_t views[VIEWS];
+    static uint64_t hashes[VIEWS];
+    uint64_t state = 1;
+    for (unsigned i = 0; i < VIEWS; i++) {
+        state = state * 6364136223846793005U + 1442695040888963407U;
+        views[i] = (string_view_t) { buffer + (state >> 48), 1 + (state >> 40) % 32 };
+    }
+    uint64_t h = 0;
+    BENCH_RUN("hash_string_view 1-32 B", 1000.0 * VIEWS,
+        for (unsigned r = 0; r < 1000; r++)
+            for (unsigned i = 0; i < VIEWS; i++)
+                h += hash_string_view(views[i], r);
+    );
+    BENCH_RUN("hash_string_views 1-32 B", 1000.0 * VIEWS,
+        for (unsigned r = 0; r < 1000; r++) {
+            hash_string_views(views, VIEWS, r, hashes);
+            h += hashes[r];
+        }
+    );
+    BENCH_RUN("fnv1a 1-32 B", 1000.0 * VIEWS,
+        for (unsigned r = 0; r < 1000; r++)
+            for (unsigned i = 0; i < VIEWS; i++)
+                h += fnv1a(views[i].str, views[i].len) ^ r;
+    );
+    bench_do_not_optimize(h);
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <cutils/array.h>
+#include <cutils/heap.h>
+
+#define int_cmp(a, b) ((*(a) > *(b)) - (*(a) < *(b)))
+
+DEFINE_ARRAY_TYPE(int)
+DEFINE_HEAP_TYPE(int, int_cmp)
+DEFINE_ARRAY_TYPE_WITH_ALLOCATOR(binary_int, int, heap)
+DEFINE_HEAP_TYPE_WITH_ARITY(binary_int, int, int_cmp, 2)
+
+static int int_cmp_fn(const int* a, const int* b) { return int_cmp(a, b); }
+
+#define SORTED_COUNT 100000
+#define HEAP_COUNT 1000000
+#define STREAM 10000000
+#define TOP_K 100
+
+static int* values;
+
+int main(void) {
+    values = malloc(STREAM * sizeof(int));
+    if (values == NULL)
+        return 1;
+    srand(1);
+    for (unsigned i = 0; i < STREAM; i++)
+        values[i] = rand();
+
+    int value;
+    int_array_t sorted = EMPTY_ARRAY(int);
+    BENCH_RUN("sorted array insert + pop (100K)", 2.0 * SORTED_COUNT,
+        for (unsigned i = 0; i < SORTED_COUNT; i++)
+            array_insert_sorted_int(&sorted, int_cmp_fn, &values[i]);
+        while (array_pop_int(&sorted, &value))
+            bench_do_not_optimize(value);
+    );
+
+    int_heap_t heap = EMPTY_HEAP(int);
+    BENCH_RUN("4-ary heap push + pop (100K)", 2.0 * SORTED_COUNT,
+        for (unsigned i = 0; i < SORTED_COUNT; i++)
+            (void)heap_push_int(&heap, &values[i]);
+        while (heap_pop_int(&heap, &value))
+            bench_do_not_optimize(value);
+    );
+    BENCH_RUN("4-ary heap push + pop (1M)", 2.0 * HEAP_COUNT,
+        for (unsigned i = 0; i < HEAP_COUNT; i++)
+            (void)heap_push_int(&heap, &values[i]);
+        while (heap_pop_int(&heap, &value))
+            bench_do_not_optimize(value);
+    );
+
+    binary_int_heap_t binary = EMPTY_HEAP(binary_int);
+    BENCH_RUN("binary heap push + pop (1M)", 2.0 * HEAP_COUNT,
+        for (unsigned i = 0; i < HEAP_COUNT; i++)
+            (void)heap_push_binary_int(&binary, &values[i]);
+        while (heap_pop_binary_int(&binary, &value))
+            bench_do_not_optimize(value);
+    );
+
+    BENCH_RUN("4-ary heapify (1M)", HEAP_COUNT,
+        memcpy(array_append_int(&heap.array, HEAP_COUNT), values, HEAP_COUNT * sizeof(int));
+        heap_heapify_int(&heap);
+        bench_do_not_optimize(heap.array.data[0]);
+    );
+    heap.array.length = 0;
+
+    BENCH_RUN("sorted array top-100 (10M stream)", STREAM,
+        for (unsigned i = 0; i < STREAM; i++) {
+            if (sorted.length == TOP_K) {
+                if (values[i] <= sorted.data[0])
+                    continue;
+                array_remove_int(&sorted, NULL, 0);
+            }
+            array_insert_sorted_int(&sorted, int_cmp_fn, &values[i]);
+        }
+        bench_do_not_optimize(sorted.data[0]);
+    );
+    BENCH_RUN("bounded heap top-100 (10M stream)", STREAM,
+        for (unsigned i = 0; i < STREAM; i++)
+            heap_push_bounded_int(&heap, &values[i], TOP_K);
+        bench_do_not_optimize(heap.array.data[0]);
+    );
+    printf("top-100 minimum: %d %d\n", sorted.data[0], *heap_top_int(&heap));
+
+    array_free_int(&sorted);
+    heap_free_int(&heap);
+    heap_free_binary_int(&binary);
+    free(values);
+    return 0;
+}
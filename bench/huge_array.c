@@ -0,0 +1,56 @@
+#define _GNU_SOURCE
+#define CUTILS_INSTRUMENT
+#include "bench.h"
+#include <cutils/array.h>
+#include <cutils/huge_array.h>
+
+#define COUNT ((size_t)96 << 20)
+
+DEFINE_ARRAY_TYPE(uint64_t)
+DEFINE_HUGE_ARRAY_TYPE(uint64_t)
+
+// Bytes at a new address after a reallocation, copied unless realloc remapped
+static void report_moved(const instrument_stats_t* stats) {
+    printf("   %llu reallocations, %.1f MiB moved\n", (unsigned long long)stats->reallocations,
+           (double)stats->bytes_moved / (1024.0 * 1024.0));
+    instrument_reset();
+}
+
+static uint64_t grow_array(void) {
+    uint64_t_array_t array = EMPTY_ARRAY(uint64_t);
+    for (size_t i = 0; i < COUNT; i++) {
+        uint64_t* p = array_append_uint64_t(&array, 1);
+        if (p == NULL)
+            exit(1);
+        *p = i;
+    }
+    const uint64_t last = array.data[array.length - 1];
+    array_free_uint64_t(&array);
+    return last;
+}
+
+static uint64_t grow_huge_array(const unsigned flags) {
+    uint64_t_huge_array_t array = HUGE_ARRAY_INIT(uint64_t, flags);
+    for (size_t i = 0; i < COUNT; i++) {
+        uint64_t* p = huge_array_append_uint64_t(&array, 1);
+        if (p == NULL)
+            exit(1);
+        *p = i;
+    }
+    const uint64_t last = array.data[array.length - 1];
+    huge_array_free_uint64_t(&array);
+    return last;
+}
+
+int main(void) {
+    uint64_t sum = 0;
+    // 768 MiB of elements appended one at a time, the growth dominates
+    BENCH_RUN("array_append (realloc) 96M x 8 B", COUNT, sum += grow_array(););
+    report_moved(INSTRUMENT_STATS(array, uint64_t));
+    BENCH_RUN("huge_array_append (mremap) 96M x 8 B", COUNT, sum += grow_huge_array(0););
+    report_moved(INSTRUMENT_STATS(huge_array, uint64_t));
+    BENCH_RUN("huge_array_append + huge pages", COUNT, sum += grow_huge_array(HUGE_ARRAY_HUGE_PAGES););
+    report_moved(INSTRUMENT_STATS(huge_array, uint64_t));
+    bench_do_not_optimize(sum);
+    return 0;
+}
@@ -0,0 +1,63 @@
+#define _DEFAULT_SOURCE
+#include "bench.h"
+#include <stdlib.h>
+#include <cutils/mapped_file.h>
+
+#define PATH "mapped_file_bench.tmp"
+#define SIZE (128 * 1024 * 1024)
+#define BLOCK 4096
+
+// Lines counted after reading the file in a string_t grown block by block
+static size_t count_read(void) {
+    FILE* f = fopen(PATH, "rb");
+    if (f == NULL)
+        exit(1);
+    string_t content = EMPTY_STRING;
+    size_t read;
+    do {
+        char* block = array_append_char(&content, BLOCK);
+        read = fread(block, 1, BLOCK, f);
+        content.length -= BLOCK - read;
+    } while (read == BLOCK);
+    fclose(f);
+    size_t lines = 0;
+    string_view_t line;
+    string_split_t split = string_lines((string_view_t) { content.data, content.length });
+    while (string_lines_next(&split, &line))
+        lines++;
+    string_free(&content);
+    return lines;
+}
+
+static size_t count_mapped(void) {
+    mapped_file_t file;
+    if (mapped_file_open(&file, PATH) != -ERROR_NO_ERROR)
+        exit(1);
+    size_t lines = 0;
+    string_view_t line;
+    string_split_t split = string_lines(file.content);
+    while (string_lines_next(&split, &line))
+        lines++;
+    mapped_file_close(&file);
+    return lines;
+}
+
+int main(void) {
+    FILE* f = fopen(PATH, "wb");
+    if (f == NULL)
+        return 1;
+    char line[128];
+    for (size_t written = 0, i = 0; written < SIZE; i++) {
+        const int length = snprintf(line, sizeof(line), "%zu some log line of moderate length %zu\n", i, i * 7919);
+        fwrite(line, 1, (size_t)length, f);
+        written += (size_t)length;
+    }
+    fclose(f);
+
+    size_t lines = 0;
+    BENCH_RUN("read into string_t + lines (128 MiB)", SIZE, lines += count_read(););
+    BENCH_RUN("mapped file + lines (128 MiB)", SIZE, lines += count_mapped(););
+    bench_do_not_optimize(lines);
+    remove(PATH);
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <cutils/array.h>
+#include <cutils/packed_array.h>
+
+#define COUNT (16u << 20)
+#define LOOKUPS (16u << 20)
+#define BLOCK 4096
+
+DEFINE_ARRAY_TYPE(uint32_t)
+DEFINE_PACKED_ARRAY_CONVERSIONS(uint32_t)
+
+static uint32_t* indices;
+static uint32_t block[BLOCK];
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void run(const unsigned width) {
+    uint32_t_array_t array = EMPTY_ARRAY(uint32_t);
+    uint32_t* data = array_append_uint32_t(&array, COUNT);
+    if (data == NULL)
+        exit(1);
+    uint64_t state = width;
+    for (unsigned i = 0; i < COUNT; i++)
+        data[i] = (uint32_t)next_random(&state) & ((1u << width) - 1);
+    packed_array_t packed = EMPTY_PACKED_ARRAY(width);
+    if (!packed_array_pack_uint32_t(&packed, &array))
+        exit(1);
+    printf("%u bits: %.1f MiB packed, %.1f MiB as uint32_t\n", width,
+           (double)packed_array_size(packed.length, width) / (1 << 20),
+           (double)COUNT * sizeof(uint32_t) / (1 << 20));
+
+    uint64_t sum = 0;
+    char name[64];
+    snprintf(name, sizeof(name), "uint32_t random access (%u bits)", width);
+    BENCH_RUN(name, LOOKUPS,
+        for (unsigned i = 0; i < LOOKUPS; i++)
+            sum += array.data[indices[i]];
+    );
+    snprintf(name, sizeof(name), "packed_array_get random (%u bits)", width);
+    BENCH_RUN(name, LOOKUPS,
+        for (unsigned i = 0; i < LOOKUPS; i++)
+            sum += packed_array_get(&packed, indices[i]);
+    );
+    // Sequential scans decode blocks which stay in the cache
+    snprintf(name, sizeof(name), "uint32_t sequential copy (%u bits)", width);
+    BENCH_RUN(name, COUNT,
+        for (unsigned i = 0; i < COUNT; i += BLOCK) {
+            memcpy(block, array.data + i, sizeof(block));
+            sum += block[i % BLOCK];
+        }
+    );
+    snprintf(name, sizeof(name), "packed_array_unpack (%u bits)", width);
+    BENCH_RUN(name, COUNT,
+        for (unsigned i = 0; i < COUNT; i += BLOCK) {
+            packed_array_unpack(&packed, i, BLOCK, block);
+            sum += block[i % BLOCK];
+        }
+    );
+    packed_array_t repacked = EMPTY_PACKED_ARRAY(width);
+    snprintf(name, sizeof(name), "packed_array_pack (%u bits)", width);
+    BENCH_RUN(name, COUNT, sum += packed_array_pack_uint32_t(&repacked, &array););
+    bench_do_not_optimize(sum);
+
+    packed_array_free(&repacked);
+    packed_array_free(&packed);
+    array_free_uint32_t(&array);
+}
+
+int main(void) {
+    indices = malloc(LOOKUPS * sizeof(uint32_t));
+    if (indices == NULL)
+        return 1;
+    uint64_t state = 1;
+    for (unsigned i = 0; i < LOOKUPS; i++)
+        indices[i] = (uint32_t)(next_random(&state) % COUNT);
+#if defined(CUTILS_PACKED_ARRAY_AVX2)
+    puts("vector decode: AVX2");
+#elif defined(CUTILS_PACKED_ARRAY_NEON)
+    puts("vector decode: NEON");
+#else
+    puts("vector decode: none (scalar)");
+#endif
+    run(3);
+    run(12);
+    run(20);
+    free(indices);
+    return 0;
+}
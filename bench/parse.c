@@ -0,0 +1,125 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <cutils/format.h>
+#include <cutils/parse.h>
+
+#define COUNT 1000000
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Fields separated by '\n', as they come out of a CSV reader
+static string_t text;
+static string_view_t* fields;
+
+static void build_fields(void) {
+    unsigned start = 0;
+    for (unsigned i = 0; start < text.length; i++) {
+        const char* end = memchr(text.data + start, '\n', text.length - start);
+        const unsigned length = (unsigned)(end - text.data) - start;
+        fields[i] = (string_view_t) { .str = text.data + start, .len = length };
+        start += length + 1;
+    }
+}
+
+static void end_field(void) {
+    char* newline = array_append_char(&text, 1);
+    if (newline == NULL)
+        exit(1);
+    *newline = '\n';
+}
+
+#define CHECK(call)     \
+    do {                \
+        if (!(call))    \
+            exit(1);    \
+    } while (0)
+
+static void run(const char* kind, const bool integers) {
+    char name[64];
+    uint64_t sum = 0;
+    double total = 0;
+    snprintf(name, sizeof(name), "string_from + %s %s", integers ? "strtoull" : "strtod", kind);
+    BENCH_RUN(name, COUNT,
+        for (unsigned i = 0; i < COUNT; i++) {
+            string_t copy = string_from(fields[i]);
+            if (integers)
+                sum += strtoull(copy.data, NULL, 10);
+            else
+                total += strtod(copy.data, NULL);
+            string_free(&copy);
+        }
+    );
+    // The fields are followed by '\n', which stops strtod like the NUL would
+    snprintf(name, sizeof(name), "in place %s %s", integers ? "strtoull" : "strtod", kind);
+    BENCH_RUN(name, COUNT,
+        for (unsigned i = 0; i < COUNT; i++) {
+            if (integers)
+                sum += strtoull(fields[i].str, NULL, 10);
+            else
+                total += strtod(fields[i].str, NULL);
+        }
+    );
+    snprintf(name, sizeof(name), "%s %s", integers ? "parse_u64" : "parse_f64", kind);
+    size_t consumed;
+    BENCH_RUN(name, COUNT,
+        for (unsigned i = 0; i < COUNT; i++) {
+            if (integers) {
+                uint64_t value;
+                CHECK(parse_u64(fields[i], &value, &consumed) == -ERROR_NO_ERROR);
+                sum += value;
+            } else {
+                double value;
+                CHECK(parse_f64(fields[i], &value, &consumed) == -ERROR_NO_ERROR);
+                total += value;
+            }
+        }
+    );
+    printf("    %.1f MB of text\n", text.length / 1e6);
+    bench_do_not_optimize(sum);
+    bench_do_not_optimize((uint64_t)total);
+}
+
+int main(void) {
+    fields = malloc(COUNT * sizeof(string_view_t));
+    if (fields == NULL)
+        return 1;
+    uint64_t state = 88172645463325252U;
+
+    for (unsigned i = 0; i < COUNT; i++) {
+        CHECK(string_append_u64(&text, next_random(&state) >> (next_random(&state) % 64)));
+        end_field();
+    }
+    build_fields();
+    run("random integers", true);
+
+    text.length = 0;
+    for (unsigned i = 0; i < COUNT; i++) {
+        uint64_t bits;
+        do
+            bits = next_random(&state) >> 1;
+        while ((bits >> 52) >= 0x7FF);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        CHECK(string_append_f64(&text, value));
+        end_field();
+    }
+    build_fields();
+    run("shortest random doubles", false);
+
+    text.length = 0;
+    for (unsigned i = 0; i < COUNT; i++) {
+        CHECK(string_append_f64_fixed(&text, (double)(next_random(&state) % 100000000) / 1000.0, 3));
+        end_field();
+    }
+    build_fields();
+    run("prices with 3 decimals", false);
+
+    string_free(&text);
+    free(fields);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <cutils/piece_table.h>
+
+#define EDITS 20000
+#define LOOKUPS 1000000
+
+static uint64_t next_random(uint64_t* state) {
+    *state = *state * 6364136223846793005U + 1442695040888963407U;
+    return *state >> 33;
+}
+
+static void run(const size_t size) {
+    char name[64];
+    char* original = malloc(size);
+    if (original == NULL)
+        exit(1);
+    for (size_t i = 0; i < size; i++)
+        original[i] = (char)('a' + i % 26);
+    const string_view_t text = { "0123456789abcdef", 16 };
+
+    // Splices on a flat string move its tail
+    string_t flat = EMPTY_STRING;
+    memcpy(array_append_char(&flat, (unsigned)size), original, size);
+    uint64_t state = 1;
+    snprintf(name, sizeof(name), "string_t splice %zu KiB", size >> 10);
+    BENCH_RUN(name, EDITS,
+        for (unsigned i = 0; i < EDITS; i++) {
+            const size_t position = next_random(&state) % flat.length;
+            if (i % 2 == 0) {
+                if (array_append_char(&flat, (unsigned)text.len) == NULL)
+                    exit(1);
+                memmove(flat.data + position + text.len, flat.data + position, flat.length - text.len - position);
+                memcpy(flat.data + position, text.str, text.len);
+            } else {
+                const size_t count = position + text.len <= flat.length ? text.len : flat.length - position;
+                memmove(flat.data + position, flat.data + position + count, flat.length - position - count);
+                flat.length -= (unsigned)count;
+            }
+        }
+    );
+    string_free(&flat);
+
+    arena_allocator_t arena = ARENA_INIT;
+    piece_table_t table;
+    if (!piece_table_init(&table, &arena, (string_view_t) { original, size }))
+        exit(1);
+    state = 1;
+    snprintf(name, sizeof(name), "piece_table splice %zu KiB", size >> 10);
+    BENCH_RUN(name, EDITS,
+        for (unsigned i = 0; i < EDITS; i++) {
+            const size_t position = next_random(&state) % piece_table_length(&table);
+            if (!(i % 2 == 0 ? piece_table_insert(&table, position, text)
+                             : piece_table_erase(&table, position, text.len)))
+                exit(1);
+        }
+    );
+    size_t sum = 0;
+    snprintf(name, sizeof(name), "piece_table index %zu KiB", size >> 10);
+    BENCH_RUN(name, LOOKUPS,
+        for (unsigned i = 0; i < LOOKUPS; i++)
+            sum += (unsigned char)piece_table_at(&table, next_random(&state) % piece_table_length(&table));
+    );
+    snprintf(name, sizeof(name), "piece_table iterate %zu KiB", size >> 10);
+    string_view_t chunk;
+    BENCH_RUN(name, piece_table_length(&table),
+        for (size_t position = 0; piece_table_next(&table, &position, &chunk);)
+            sum += chunk.len;
+    );
+    bench_do_not_optimize(sum);
+    arena_free(&arena);
+    free(original);
+}
+
+int main(void) {
+    for (size_t size = 64 << 10; size <= (16 << 20); size <<= 4)
+        run(size);
+    return 0;
+}
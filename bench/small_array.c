@@ -0,0 +1,124 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+
+// Count the allocations of the containers
+static unsigned long allocations = 0;
+
+static void* counting_alloc(size_t size) {
+    allocations++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void* buffer, size_t size) {
+    allocations += buffer == NULL;
+    return realloc(buffer, size);
+}
+
+#define CUTILS_alloc counting_alloc
+#define CUTILS_realloc counting_realloc
+#define CUTILS_dealloc free
+
+#include "bench.h"
+#include <cutils/small_array.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#define COUNT 2000000
+
+DEFINE_ARRAY_TYPE(int)
+DEFINE_SMALL_ARRAY_TYPE_WITH_ALLOCATOR(int_small, int, 8, heap)
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Resident set size in MiB, 0 where it is not available
+static double resident_mib(void) {
+#ifdef __linux__
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f == NULL)
+        return 0;
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+        resident = 0;
+    fclose(f);
+    return (double)resident * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+#else
+    return 0;
+#endif
+}
+
+// Millions of arrays of 0 to 11 elements, most of them under 8
+static unsigned length_of(uint64_t* state) {
+    const uint64_t r = next_random(state);
+    return (unsigned)(r % 16 < 14 ? r % 8 : 8 + (r >> 8) % 4);
+}
+
+int main(void) {
+    int_array_t* arrays = calloc(COUNT, sizeof(int_array_t));
+    int_small_array_t* small = calloc(COUNT, sizeof(int_small_array_t));
+    if (arrays == NULL || small == NULL)
+        return 1;
+    uint64_t state = 88172645463325252U;
+    long sum = 0;
+
+    // The structures are touched for the first time by the appends, so the
+    // resident memory counts them as well as the allocations
+    double before = resident_mib();
+    allocations = 0;
+    BENCH_RUN("int_array_t, 2M arrays of 0-11 ints", COUNT,
+        for (unsigned i = 0; i < COUNT; i++) {
+            const unsigned length = length_of(&state);
+            for (unsigned k = 0; k < length; k++) {
+                int* p = array_append_int(&arrays[i], 1);
+                if (p == NULL)
+                    return 1;
+                *p = (int)k;
+            }
+        }
+    );
+    printf("   %lu allocations, %.1f MiB resident (%zu B per array struct)\n", allocations,
+           resident_mib() - before, sizeof(int_array_t));
+    BENCH_RUN("int_array_t sum", COUNT,
+        for (unsigned i = 0; i < COUNT; i++)
+            for (unsigned k = 0; k < arrays[i].length; k++)
+                sum += arrays[i].data[k];
+    );
+    for (unsigned i = 0; i < COUNT; i++)
+        array_free_int(&arrays[i]);
+    free(arrays);
+
+    state = 88172645463325252U;
+    before = resident_mib();
+    allocations = 0;
+    BENCH_RUN("int_small_array_t (8 inline), same arrays", COUNT,
+        for (unsigned i = 0; i < COUNT; i++) {
+            const unsigned length = length_of(&state);
+            for (unsigned k = 0; k < length; k++) {
+                int* p = array_append_int_small(&small[i], 1);
+                if (p == NULL)
+                    return 1;
+                *p = (int)k;
+            }
+        }
+    );
+    printf("   %lu allocations, %.1f MiB resident (%zu B per array struct)\n", allocations,
+           resident_mib() - before, sizeof(int_small_array_t));
+    BENCH_RUN("int_small_array_t sum", COUNT,
+        for (unsigned i = 0; i < COUNT; i++) {
+            const int* data = array_data_int_small(&small[i]);
+            for (unsigned k = 0; k < small[i].length; k++)
+                sum += data[k];
+        }
+    );
+    for (unsigned i = 0; i < COUNT; i++)
+        array_free_int_small(&small[i]);
+    free(small);
+    bench_do_not_optimize(sum);
+    return 0;
+}
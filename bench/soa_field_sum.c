@@ -0,0 +1,57 @@
+#include "bench.h"
+#include <cutils/array.h>
+#include <cutils/soa.h>
+
+#define RECORDS 10000000
+#define ROUNDS 10
+
+typedef struct {
+    float x, y, z;
+    float vx, vy, vz;
+    float mass;
+    int id;
+} particle;
+
+DEFINE_ARRAY_TYPE(particle)
+DEFINE_SOA_TYPE(particle, (float, x), (float, y), (float, z),
+                (float, vx), (float, vy), (float, vz), (float, mass), (int, id))
+
+int main(void) {
+    particle_array_t aos = EMPTY_ARRAY(particle);
+    particle* records = array_append_particle(&aos, RECORDS);
+    if (records == NULL)
+        return 1;
+    for (unsigned i = 0; i < RECORDS; i++)
+        records[i] = (particle) { .x = (float)i, .mass = (float)(i & 7), .id = (int)i };
+
+    particle_soa_t soa = EMPTY_SOA(particle);
+    if (!soa_from_array(particle, &soa, &aos))
+        return 1;
+
+    double aos_sum = 0, soa_sum = 0;
+    BENCH_RUN("AoS field sum (10M records)", (double)RECORDS * ROUNDS,
+        for (unsigned r = 0; r < ROUNDS; r++) {
+            float sum = 0;
+            foreach(aos, p, particle) {
+                sum += p->mass;
+            }
+            bench_do_not_optimize(sum);
+            aos_sum += sum;
+        }
+    );
+    BENCH_RUN("SoA field sum (10M records)", (double)RECORDS * ROUNDS,
+        for (unsigned r = 0; r < ROUNDS; r++) {
+            const float* mass = soa_column(soa, mass);
+            float sum = 0;
+            for (unsigned i = 0; i < soa.length; i++)
+                sum += mass[i];
+            bench_do_not_optimize(sum);
+            soa_sum += sum;
+        }
+    );
+    printf("checksums: %.0f %.0f\n", aos_sum, soa_sum);
+
+    soa_free_particle(&soa);
+    array_free_particle(&aos);
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <cutils/array.h>
+#include <cutils/heap.h>
+#include <cutils/timer_wheel.h>
+
+// Times in microseconds, 1 ms ticks and timeouts of up to a minute
+#define TICK 1000
+#define TIMEOUT 60000000
+#define TIMERS 1000000
+#define CHURN 10000000
+// Operations between two advances of the clock in the churn workload
+#define CHURN_BATCH 1000
+// Idle timeout of a connection, pushed back on each activity
+#define IDLE_TIMEOUT 30000000
+
+typedef struct {
+    uint64_t expires;
+    unsigned id;
+    unsigned version;
+} timeout_t;
+
+#define timeout_cmp(a, b) (((a)->expires > (b)->expires) - ((a)->expires < (b)->expires))
+
+DEFINE_ARRAY_TYPE(timeout_t)
+DEFINE_HEAP_TYPE(timeout_t, timeout_cmp)
+
+static uint64_t* delays;
+static unsigned* targets;
+static size_t fired;
+
+static void count_fired(timer_wheel_t* wheel, void* data) {
+    (void)wheel;
+    (void)data;
+    fired += 1;
+}
+
+static uint64_t random_delay(void) {
+    return (((uint64_t)rand() << 31) ^ (uint64_t)rand()) % TIMEOUT;
+}
+
+// Schedule every timer, then advance one tick at a time until all fired
+static void wheel_fire_all(void) {
+    timer_wheel_t wheel;
+    if (!timer_wheel_init(&wheel, TICK, 4, 0))
+        exit(1);
+    for (unsigned i = 0; i < TIMERS; i++)
+        if (timer_wheel_schedule(&wheel, delays[i], count_fired, NULL) == SLOT_HANDLE_NULL)
+            exit(1);
+    for (uint64_t time = 0; wheel.count != 0; time += TICK)
+        timer_wheel_advance(&wheel, time);
+    timer_wheel_free(&wheel);
+}
+
+static void heap_fire_all(void) {
+    timeout_t_heap_t heap = EMPTY_HEAP(timeout_t);
+    for (unsigned i = 0; i < TIMERS; i++)
+        if (!heap_push_timeout_t(&heap, &(timeout_t){ .expires = delays[i], .id = i }))
+            exit(1);
+    timeout_t top;
+    for (uint64_t time = 0; !heap_empty(heap); time += TICK)
+        while (!heap_empty(heap) && heap.array.data[0].expires <= time && heap_pop_timeout_t(&heap, &top))
+            fired += 1;
+    heap_free_timeout_t(&heap);
+}
+
+// Connections pushing back their idle timeout on activity, some of them
+// closing and reopening, with the clock advancing every CHURN_BATCH operations
+static void wheel_churn(void) {
+    timer_wheel_t wheel;
+    static slot_handle_t handles[TIMERS];
+    if (!timer_wheel_init(&wheel, TICK, 4, 0) || !timer_wheel_reserve(&wheel, TIMERS))
+        exit(1);
+    for (unsigned i = 0; i < TIMERS; i++)
+        handles[i] = timer_wheel_schedule(&wheel, delays[i], count_fired, NULL);
+    uint64_t time = 0;
+    for (unsigned op = 0; op < CHURN; op++) {
+        const unsigned target = targets[op];
+        if (op % 8 == 0) {
+            timer_wheel_cancel(&wheel, handles[target]);
+            handles[target] = timer_wheel_schedule(&wheel, time + delays[op % TIMERS], count_fired, NULL);
+        } else if (!timer_wheel_reschedule(&wheel, handles[target], time + IDLE_TIMEOUT)) {
+            handles[target] = timer_wheel_schedule(&wheel, time + IDLE_TIMEOUT, count_fired, NULL);
+        }
+        if (op % CHURN_BATCH == 0)
+            timer_wheel_advance(&wheel, time += TICK);
+    }
+    timer_wheel_free(&wheel);
+}
+
+// Same workload on a heap, stale entries are skipped when they reach the top
+static void heap_churn(void) {
+    timeout_t_heap_t heap = EMPTY_HEAP(timeout_t);
+    static unsigned versions[TIMERS];
+    for (unsigned i = 0; i < TIMERS; i++)
+        if (!heap_push_timeout_t(&heap, &(timeout_t){ .expires = delays[i], .id = i }))
+            exit(1);
+    uint64_t time = 0;
+    timeout_t top;
+    for (unsigned op = 0; op < CHURN; op++) {
+        const unsigned target = targets[op];
+        versions[target] += 1;
+        const uint64_t delay = op % 8 == 0 ? delays[op % TIMERS] : IDLE_TIMEOUT;
+        const timeout_t timeout = { time + delay, target, versions[target] };
+        if (!heap_push_timeout_t(&heap, &timeout))
+            exit(1);
+        if (op % CHURN_BATCH == 0) {
+            time += TICK;
+            while (!heap_empty(heap) && heap.array.data[0].expires <= time && heap_pop_timeout_t(&heap, &top))
+                fired += top.version == versions[top.id];
+        }
+    }
+    heap_free_timeout_t(&heap);
+}
+
+int main(void) {
+    delays = malloc(TIMERS * sizeof(uint64_t));
+    targets = malloc(CHURN * sizeof(unsigned));
+    if (delays == NULL || targets == NULL)
+        return 1;
+    srand(1);
+    for (unsigned i = 0; i < TIMERS; i++)
+        delays[i] = random_delay();
+    for (unsigned i = 0; i < CHURN; i++)
+        targets[i] = (unsigned)rand() % TIMERS;
+
+    BENCH_RUN("timer wheel schedule + fire (1M)", TIMERS, wheel_fire_all(););
+    BENCH_RUN("4-ary heap push + pop (1M)", TIMERS, heap_fire_all(););
+    BENCH_RUN("timer wheel churn (1M live, 10M ops)", CHURN, wheel_churn(););
+    BENCH_RUN("4-ary heap lazy churn (1M live, 10M ops)", CHURN, heap_churn(););
+    bench_do_not_optimize(fired);
+
+    free(targets);
+    free(delays);
+    return 0;
+}
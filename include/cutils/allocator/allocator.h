@@ -4,6 +4,10 @@
 #include <stddef.h>
 #include <cutils/compatibility.h>
 
+#ifndef CUTILS_NO_STD
+#include <string.h>
+#endif
+
 #define CUTILS_NEXT_ALLOC_ALIGNED(nextAlloc, align) (((nextAlloc) + ((align) - 1)) & -align)
 
 typedef void *(*alloc_fn_t)(size_t size);
@@ -65,4 +69,59 @@ static void allocator_dealloc(const allocator_t* allocator, void* buffer) {
     else allocator->no_md.dealloc(buffer);
 }
 
+// Reallocate through alloc/dealloc when the allocator has no realloc function
+UNUSED
+static void* allocator_realloc_sized(const allocator_t* allocator, void* buffer, const size_t old_size, const size_t size) {
+    const bool has_realloc = allocator->metadata ? allocator->md.realloc != NULL : allocator->no_md.realloc != NULL;
+    if (has_realloc)
+        return allocator_realloc(allocator, buffer, size);
+    void* memory = allocator_alloc(allocator, size);
+    if (memory == NULL)
+        return NULL;
+    if (buffer != NULL) {
+        memcpy(memory, buffer, old_size < size ? old_size : size);
+        if (allocator->metadata ? allocator->md.dealloc != NULL : allocator->no_md.dealloc != NULL)
+            allocator_dealloc(allocator, buffer);
+    }
+    return memory;
+}
+
+/*
+ * Compile-time allocator bindings
+ *
+ * Containers defined with DEFINE_*_TYPE_WITH_ALLOCATOR(name, type, binding)
+ * call the functions of the binding directly instead of dispatching through
+ * allocator_t, so their growth paths can be inlined. A binding is a set of
+ * macros sharing a prefix:
+ *  - binding_binding_t: type of the allocator state
+ *  - binding_binding_member: state pointer stored in the containers (may be empty)
+ *  - binding_binding_init(state): designated initializer of this member
+ *  - binding_binding_state(container): state of a container
+ *  - binding_binding_alloc(state, size)
+ *  - binding_binding_realloc(state, buffer, old_size, size)
+ *  - binding_binding_dealloc(state, buffer, size)
+ *
+ * The heap binding uses CUTILS_alloc, CUTILS_realloc and CUTILS_dealloc and
+ * stores nothing in the containers, the allocator binding dispatches through
+ * an allocator_t. arena.h and bump.h provide the arena and bump bindings.
+ */
+
+typedef void heap_binding_t;
+#define heap_binding_member
+#define heap_binding_init(state)
+#define heap_binding_state(container) NULL
+#define heap_binding_alloc(state, size) ((void)(state), CUTILS_alloc(size))
+#define heap_binding_realloc(state, buffer, old_size, size) ((void)(state), (void)(old_size), CUTILS_realloc(buffer, size))
+#define heap_binding_dealloc(state, buffer, size) ((void)(state), (void)(size), CUTILS_dealloc(buffer))
+
+typedef allocator_t allocator_binding_t;
+#define allocator_binding_member const allocator_t* allocator;
+#define allocator_binding_init(state) .allocator = (state),
+#define allocator_binding_state(container) ((container)->allocator)
+#define allocator_binding_alloc(state, size) allocator_alloc(state, size)
+#define allocator_binding_realloc(state, buffer, old_size, size) allocator_realloc_sized(state, buffer, old_size, size)
+#define allocator_binding_dealloc(state, buffer, size) \
+    ((void)(size), (state)->metadata ? ((state)->md.dealloc ? (state)->md.dealloc((state)->metadata, buffer) : (void)0) \
+                                     : ((state)->no_md.dealloc ? (state)->no_md.dealloc(buffer) : (void)0))
+
 #endif //CUTILS_ALLOCATOR_H
@@ -5,15 +5,57 @@
 #include <cutils/allocator/allocator.h>
 #include <cutils/bits.h>
 #include <cutils/minmax.h>
+#include <stdint.h>
 
 #ifndef CUTILS_ARENA_SIZE_TYPE
 #define CUTILS_ARENA_SIZE_TYPE size_t
 #endif
 
+// Capacity of the first region, the next ones grow geometrically
 #ifndef CUTILS_ARENA_DEFAULT_REGION_SIZE
 #define CUTILS_ARENA_DEFAULT_REGION_SIZE 4096
 #endif
 
+// Regions stop growing once they reach this capacity
+#ifndef CUTILS_ARENA_MAX_REGION_SIZE
+#define CUTILS_ARENA_MAX_REGION_SIZE (64 * 1024 * 1024)
+#endif
+
+// Upper bound of the alignment arena_allocate derives from the size
+#ifndef CUTILS_ARENA_MAX_ALIGN
+#define CUTILS_ARENA_MAX_ALIGN ALIGNOF(max_align_t)
+#endif
+
+// The region cache is per thread by default, define it as `static` to share
+// a single cache in a single-threaded program. A per-thread cache is freed
+// at the exit of its thread by a pthread key destructor. The main thread,
+// which does not run the destructors, can call arena_cache_release.
+#ifndef CUTILS_ARENA_CACHE_STORAGE
+#define CUTILS_ARENA_CACHE_STORAGE static THREAD_LOCAL
+#if defined(__has_include)
+#if __has_include(<pthread.h>)
+#define CUTILS_ARENA_CACHE_THREAD_EXIT
+#endif
+#endif
+// Without the destructor a thread would leak its cache, so it is opt-in
+#ifndef CUTILS_ARENA_CACHE_THREAD_EXIT
+#define CUTILS_ARENA_CACHE_DISABLED
+#endif
+#endif
+
+// Bytes of freed regions kept for reuse by the next arenas (0 disables the cache)
+#ifndef CUTILS_ARENA_CACHE_SIZE
+#ifdef CUTILS_ARENA_CACHE_DISABLED
+#define CUTILS_ARENA_CACHE_SIZE 0
+#else
+#define CUTILS_ARENA_CACHE_SIZE (16 * 1024 * 1024)
+#endif
+#endif
+
+#ifdef CUTILS_ARENA_CACHE_THREAD_EXIT
+#include <pthread.h>
+#endif
+
 typedef CUTILS_ARENA_SIZE_TYPE arena_size_t;
 
 typedef struct arena_region arena_region_t;
@@ -25,63 +67,192 @@ struct arena_region {
   char data[];
 };
 
+typedef struct {
+  arena_region_t* head;
+  arena_size_t size;
+} arena_region_cache_t;
+
+UNUSED CUTILS_ARENA_CACHE_STORAGE arena_region_cache_t arena_region_cache = { NULL, 0 };
+
+#ifdef CUTILS_ARENA_CACHE_THREAD_EXIT
+UNUSED static pthread_key_t arena_cache_key;
+UNUSED static pthread_once_t arena_cache_once = PTHREAD_ONCE_INIT;
+UNUSED static bool arena_cache_key_created;
+// Whether the destructor of the calling thread is armed
+UNUSED static THREAD_LOCAL bool arena_cache_registered;
+#endif
+
 UNUSED NODISCARD
 static arena_region_t* arena_region_allocate(const arena_size_t capacity) {
-  const arena_size_t size = CUTILS_NEXT_ALLOC_ALIGNED(sizeof(arena_region_t) + capacity, 64);
-  arena_region_t* region = CUTILS_alloc(size);
-  when_null_ret(region, NULL);
+  // Best fit among the cached regions
+  arena_region_t** best = NULL;
+  for (arena_region_t** link = &arena_region_cache.head; *link != NULL; link = &(*link)->next) {
+    if ((*link)->capacity >= capacity && (best == NULL || (*link)->capacity < (*best)->capacity))
+      best = link;
+  }
+  arena_region_t* region;
+  if (best != NULL) {
+    region = *best;
+    *best = region->next;
+    arena_region_cache.size -= region->capacity;
+  } else {
+    const arena_size_t size = CUTILS_NEXT_ALLOC_ALIGNED(sizeof(arena_region_t) + capacity, 64);
+    region = CUTILS_alloc(size);
+    when_null_ret(region, NULL);
+    region->capacity = size - sizeof(arena_region_t);
+  }
   region->next = NULL;
-  region->capacity = capacity;
   region->used = 0;
   return region;
 }
 
+// Give the cached regions of the calling thread back to the system allocator
+UNUSED
+static void arena_cache_release(void) {
+  arena_region_t* r = arena_region_cache.head;
+  while (r != NULL) {
+    arena_region_t* remove = r;
+    r = r->next;
+    CUTILS_dealloc(remove);
+  }
+  arena_region_cache.head = NULL;
+  arena_region_cache.size = 0;
+#ifdef CUTILS_ARENA_CACHE_THREAD_EXIT
+  // Arenas freed by later destructors arm it again
+  arena_cache_registered = false;
+#endif
+}
+
+#ifdef CUTILS_ARENA_CACHE_THREAD_EXIT
+UNUSED
+static void arena_cache_exit(void* cache) {
+  (void)cache;
+  arena_cache_release();
+}
+
+UNUSED
+static void arena_cache_create_key(void) {
+  arena_cache_key_created = pthread_key_create(&arena_cache_key, arena_cache_exit) == 0;
+}
+
+// Arm the destructor of the calling thread, false when it cannot be
+UNUSED NODISCARD
+static bool arena_cache_register(void) {
+  pthread_once(&arena_cache_once, arena_cache_create_key);
+  when_false_ret(arena_cache_key_created, false);
+  when_false_ret(pthread_setspecific(arena_cache_key, &arena_region_cache) == 0, false);
+  arena_cache_registered = true;
+  return true;
+}
+#endif
+
+UNUSED
+static void arena_region_release(arena_region_t* region) {
+  if (arena_region_cache.size + region->capacity > CUTILS_ARENA_CACHE_SIZE
+#ifdef CUTILS_ARENA_CACHE_THREAD_EXIT
+      || (!arena_cache_registered && !arena_cache_register())
+#endif
+  ) {
+    CUTILS_dealloc(region);
+    return;
+  }
+  region->next = arena_region_cache.head;
+  arena_region_cache.head = region;
+  arena_region_cache.size += region->capacity;
+}
+
+// Bump the region used size, returns NULL if the allocation does not fit
+UNUSED NODISCARD
+static void* arena_region_bump(arena_region_t* region, const arena_size_t size, const arena_size_t align) {
+  const uintptr_t base = (uintptr_t)region->data;
+  const uintptr_t offset = CUTILS_NEXT_ALLOC_ALIGNED(base + region->used, (uintptr_t)align) - base;
+  if (offset > region->capacity || region->capacity - offset < size)
+    return NULL;
+  region->used = offset + size;
+  return &region->data[offset];
+}
+
 typedef struct arena_allocator arena_allocator_t;
 
 struct arena_allocator {
   arena_region_t* head;
   arena_region_t *current;
+  // Dedicated regions of the large allocations
+  arena_region_t* large;
+  // Capacity of the last region allocated
+  arena_size_t region_size;
 };
 
 #if __STDC_VERSION__ >= 202311L
 #define ARENA_INIT {}
 #else
-#define ARENA_INIT { NULL, NULL }
+#define ARENA_INIT { NULL, NULL, NULL, 0 }
 #endif
 
 NODISCARD
-static void *arena_allocate(arena_allocator_t *arena, const arena_size_t size) {
-  // Compute the alignment
-  const arena_size_t align = MIN(bits_next_pow2(size), 64);
-  // Minimum region size to allocate if needed
-  const arena_size_t regionSize = MAX(size, CUTILS_ARENA_DEFAULT_REGION_SIZE);
-  // Minimum region size needed
-  arena_size_t needed;
-  if (arena->current == NULL) {
-    needed = size;
-    arena->head = arena->current = arena_region_allocate(regionSize);
-  } else {
-    while ((needed = CUTILS_NEXT_ALLOC_ALIGNED(arena->current->used, align) + size) > arena->current->capacity
-      && arena->current->next != NULL)
-      arena->current = arena->current->next;
+static void *arena_allocate_aligned(arena_allocator_t *arena, const arena_size_t size, const arena_size_t align) {
+  when_false_ret(align != 0 && (align & (align - 1)) == 0, NULL);
+  void* ret;
+  if (arena->current != NULL && (ret = arena_region_bump(arena->current, size, align)) != NULL)
+    return ret;
+  // Worst case capacity needed whatever the region address
+  const arena_size_t needed = size + align - 1;
+  when_true_ret(needed < size, NULL);
+  const arena_size_t regionSize = MIN(MAX(arena->region_size * 2, CUTILS_ARENA_DEFAULT_REGION_SIZE),
+                                      CUTILS_ARENA_MAX_REGION_SIZE);
+  // Large allocations get their own region so the current one is not abandoned
+  if (needed > regionSize / 2) {
+    arena_region_t* region = arena_region_allocate(needed);
+    when_null_ret(region, NULL);
+    region->next = arena->large;
+    arena->large = region;
+    return arena_region_bump(region, size, align);
   }
-  // If the current block is not large enough allocate another
-  if (needed > arena->current->capacity) {
-    arena->current->next = arena_region_allocate(regionSize);
-    arena->current = arena->current->next;
+  // Look for a spare region left by arena_reset or arena_pop_frame
+  arena_region_t* spare = arena->current != NULL ? arena->current->next : arena->head;
+  for (; spare != NULL; spare = spare->next) {
+    spare->used = 0;
+    arena->current = spare;
+    if ((ret = arena_region_bump(spare, size, align)) != NULL)
+      return ret;
   }
-  void* ret = &arena->current->data[arena->current->used];
-  arena->current->used += needed;
-  return ret;
+  arena_region_t* region = arena_region_allocate(regionSize);
+  when_null_ret(region, NULL);
+  arena->region_size = regionSize;
+  if (arena->current == NULL)
+    arena->head = region;
+  else
+    arena->current->next = region;
+  arena->current = region;
+  return arena_region_bump(region, size, align);
+}
+
+NODISCARD
+static void *arena_allocate(arena_allocator_t *arena, const arena_size_t size) {
+  // Natural alignment of the size, capped to CUTILS_ARENA_MAX_ALIGN
+  const arena_size_t align = MIN(bits_next_pow2(size), CUTILS_ARENA_MAX_ALIGN);
+  return arena_allocate_aligned(arena, size, align);
 }
 
 UNUSED NODISCARD
 static void *arena_allocate_array(arena_allocator_t *arena, const arena_size_t count, const arena_size_t size) {
-  return arena_allocate(arena, count * size);
+  when_true_ret(size != 0 && count > (arena_size_t)-1 / size, NULL);
+  const arena_size_t align = MIN(bits_next_pow2(size), CUTILS_ARENA_MAX_ALIGN);
+  return arena_allocate_aligned(arena, count * size, align);
+}
+
+UNUSED
+static void arena_release_large(arena_allocator_t* arena, const arena_region_t* until) {
+  while (arena->large != until) {
+    arena_region_t* remove = arena->large;
+    arena->large = remove->next;
+    arena_region_release(remove);
+  }
 }
 
 UNUSED
 static void arena_reset(arena_allocator_t* arena) {
+  arena_release_large(arena, NULL);
   for (arena_region_t* r = arena->head; r != NULL; r = r->next)
     r->used = 0;
   arena->current = arena->head;
@@ -89,38 +260,73 @@ static void arena_reset(arena_allocator_t* arena) {
 
 UNUSED
 static void arena_free(arena_allocator_t* arena) {
+  arena_release_large(arena, NULL);
   arena_region_t* r = arena->head;
   while (r != NULL) {
     arena_region_t* remove = r;
     r = r->next;
-    CUTILS_dealloc(remove);
+    arena_region_release(remove);
   }
 
   arena->head = NULL;
   arena->current = NULL;
+  arena->region_size = 0;
 }
 
-static void arena_free_noop(arena_allocator_t*, void*) {}
+// Grow buffer in place when it is the last allocation of the current region
+UNUSED NODISCARD
+static void *arena_reallocate(arena_allocator_t *arena, void* buffer, const arena_size_t old_size, const arena_size_t size) {
+  arena_region_t* region = arena->current;
+  if (buffer != NULL && region != NULL && (char*)buffer + old_size == region->data + region->used
+      && size - old_size <= region->capacity - region->used) {
+    region->used += size - old_size;
+    return buffer;
+  }
+  if (size <= old_size)
+    return buffer;
+  void* memory = arena_allocate(arena, size);
+  when_null_ret(memory, NULL);
+  if (buffer != NULL)
+    memcpy(memory, buffer, old_size);
+  return memory;
+}
+
+static void arena_free_noop(arena_allocator_t* arena, void* buffer) {
+  (void)arena;
+  (void)buffer;
+}
 
 UNUSED
 static allocator_t arena_get_allocator(arena_allocator_t* arena) {
   return ALLOCATOR_INIT_METADATA(arena, (alloc_md_fn_t)arena_allocate, NULL, (dealloc_md_fn_t)arena_free_noop);
 }
 
+// Compile-time allocator binding (see allocator.h)
+typedef arena_allocator_t arena_binding_t;
+#define arena_binding_member arena_allocator_t* allocator;
+#define arena_binding_init(state) .allocator = (state),
+#define arena_binding_state(container) ((container)->allocator)
+#define arena_binding_alloc(state, size) arena_allocate(state, size)
+#define arena_binding_realloc(state, buffer, old_size, size) arena_reallocate(state, buffer, old_size, size)
+#define arena_binding_dealloc(state, buffer, size) ((void)(state), (void)(buffer), (void)(size))
+
 typedef struct {
   arena_region_t* region;
-  unsigned used;
+  arena_size_t used;
+  arena_region_t* large;
 } arena_frame_t;
 
 UNUSED
 static arena_frame_t arena_push_frame(const arena_allocator_t* arena) {
-  return (arena_frame_t) { arena->current, arena->current->used };
+  return (arena_frame_t) { arena->current, arena->current != NULL ? arena->current->used : 0, arena->large };
 }
 
 UNUSED
 static void arena_pop_frame(arena_allocator_t* arena, const arena_frame_t frame) {
+  arena_release_large(arena, frame.large);
   arena->current = frame.region;
-  arena->current->used = frame.used;
+  if (arena->current != NULL)
+    arena->current->used = frame.used;
 }
 
 #endif // !CUTILS_ARENA_H
@@ -1,21 +1,36 @@
 #ifndef CUTILS_BUMP_H
 #define CUTILS_BUMP_H
 
+#include <cutils/allocator/allocator.h>
+#include <cutils/when_macros.h>
+#include <cutils/bits.h>
+#include <cutils/minmax.h>
+#include <stdint.h>
+
 #ifndef CUTILS_BUMP_SIZE_TYPE
 #define CUTILS_BUMP_SIZE_TYPE unsigned
-#include "allocator.h"
+#endif
+
+// Upper bound of the alignment bump_allocate derives from the size
+#ifndef CUTILS_BUMP_MAX_ALIGN
+#define CUTILS_BUMP_MAX_ALIGN ALIGNOF(max_align_t)
 #endif
 
 typedef CUTILS_BUMP_SIZE_TYPE bump_size_t;
+
+// The buffer is double-ended: long-lived data is allocated from the front
+// (size bytes used) and temporaries from the back (back bytes used)
 typedef struct {
     char *memory;
     bump_size_t capacity;
     bump_size_t size;
+    bump_size_t back;
 } bump_allocator_t;
 
 UNUSED
 static void bump_reset(bump_allocator_t* bump) {
     bump->size = 0;
+    bump->back = 0;
 }
 
 UNUSED
@@ -28,11 +43,21 @@ static void bump_pop_frame(bump_allocator_t* bump, const bump_size_t frame) {
     bump->size = frame;
 }
 
-#define BUMP_NEXT_ALLOC_ALIGNED(nextAlloc, align) ((nextAlloc) + ((align) - ((nextAlloc) % (align))))
+UNUSED
+static bump_size_t bump_push_back_frame(const bump_allocator_t* bump) {
+    return bump->back;
+}
+
+UNUSED
+static void bump_pop_back_frame(bump_allocator_t* bump, const bump_size_t frame) {
+    bump->back = frame;
+}
+
+#define BUMP_NEXT_ALLOC_ALIGNED(nextAlloc, align) (((nextAlloc) + ((align) - 1)) / (align) * (align))
 
 UNUSED
 static bump_allocator_t bump_init(void *memory, bump_size_t capacity) {
-    return (bump_allocator_t){.memory = (char *)memory, .capacity = capacity, .size = 0};
+    return (bump_allocator_t){.memory = (char *)memory, .capacity = capacity, .size = 0, .back = 0};
 }
 
 UNUSED
@@ -40,23 +65,95 @@ static void bump_free(bump_allocator_t* bump) {
     *bump = (bump_allocator_t) {
         .memory = NULL,
         .capacity = 0,
-        .size = 0
+        .size = 0,
+        .back = 0
     };
 }
 
 UNUSED NODISCARD
-static void *bump_allocate(bump_allocator_t *bump, const size_t size) {
-    const bump_size_t nextAllocOffset = BUMP_NEXT_ALLOC_ALIGNED(bump->size, 64);
-    const size_t minCapacity = nextAllocOffset + size;
-    if(bump->capacity < minCapacity)
+static void *bump_allocate_aligned(bump_allocator_t *bump, const size_t size, const size_t align) {
+    when_false_ret(align != 0 && (align & (align - 1)) == 0, NULL);
+    const uintptr_t base = (uintptr_t)bump->memory;
+    const uintptr_t nextAllocOffset = CUTILS_NEXT_ALLOC_ALIGNED(base + bump->size, (uintptr_t)align) - base;
+    const size_t available = bump->capacity - bump->back;
+    if(nextAllocOffset > available || available - nextAllocOffset < size)
         return NULL;
     bump->size = nextAllocOffset + size;
     return bump->memory + nextAllocOffset;
 }
 
+UNUSED NODISCARD
+static void *bump_allocate_back_aligned(bump_allocator_t *bump, const size_t size, const size_t align) {
+    when_false_ret(align != 0 && (align & (align - 1)) == 0, NULL);
+    const size_t top = bump->capacity - bump->back;
+    if(size > top - bump->size)
+        return NULL;
+    const uintptr_t base = (uintptr_t)bump->memory;
+    const uintptr_t address = (base + top - size) & -(uintptr_t)align;
+    if(address < base + bump->size)
+        return NULL;
+    bump->back = bump->capacity - (address - base);
+    return (void*)address;
+}
+
+UNUSED NODISCARD
+static void *bump_allocate(bump_allocator_t *bump, const size_t size) {
+    // Natural alignment of the size, capped to CUTILS_BUMP_MAX_ALIGN
+    return bump_allocate_aligned(bump, size, MIN(bits_next_pow2(size), CUTILS_BUMP_MAX_ALIGN));
+}
+
+UNUSED NODISCARD
+static void *bump_allocate_back(bump_allocator_t *bump, const size_t size) {
+    return bump_allocate_back_aligned(bump, size, MIN(bits_next_pow2(size), CUTILS_BUMP_MAX_ALIGN));
+}
+
+// Grow buffer in place when it is the last allocation of the front
+UNUSED NODISCARD
+static void *bump_reallocate(bump_allocator_t *bump, void* buffer, const size_t old_size, const size_t size) {
+    if(buffer != NULL && (char*)buffer + old_size == bump->memory + bump->size
+       && size - old_size <= (size_t)(bump->capacity - bump->back - bump->size)) {
+        bump->size += size - old_size;
+        return buffer;
+    }
+    if(size <= old_size)
+        return buffer;
+    void* memory = bump_allocate(bump, size);
+    when_null_ret(memory, NULL);
+    if(buffer != NULL)
+        memcpy(memory, buffer, old_size);
+    return memory;
+}
+
+// Give the memory back when buffer is the last allocation of the front
+UNUSED
+static void bump_deallocate(bump_allocator_t *bump, void* buffer, const size_t size) {
+    if(buffer != NULL && (char*)buffer + size == bump->memory + bump->size)
+        bump->size = (char*)buffer - bump->memory;
+}
+
+// Compile-time allocator binding (see allocator.h)
+typedef bump_allocator_t bump_binding_t;
+#define bump_binding_member bump_allocator_t* allocator;
+#define bump_binding_init(state) .allocator = (state),
+#define bump_binding_state(container) ((container)->allocator)
+#define bump_binding_alloc(state, size) bump_allocate(state, size)
+#define bump_binding_realloc(state, buffer, old_size, size) bump_reallocate(state, buffer, old_size, size)
+#define bump_binding_dealloc(state, buffer, size) bump_deallocate(state, buffer, size)
+
+// Allocate count elements of type with its natural alignment
+#define bump_new(bump, type, count) \
+    ((type*)bump_allocate_aligned(bump, sizeof(type) * (count), ALIGNOF(type)))
+#define bump_new_back(bump, type, count) \
+    ((type*)bump_allocate_back_aligned(bump, sizeof(type) * (count), ALIGNOF(type)))
+
 UNUSED
 static allocator_t bump_allocator(bump_allocator_t* bump) {
     return ALLOCATOR_INIT_METADATA(bump, (alloc_md_fn_t)bump_allocate, NULL, NULL);
 }
 
-#endif //CUTILS_BUMP_H
\ No newline at end of file
+UNUSED
+static allocator_t bump_back_allocator(bump_allocator_t* bump) {
+    return ALLOCATOR_INIT_METADATA(bump, (alloc_md_fn_t)bump_allocate_back, NULL, NULL);
+}
+
+#endif //CUTILS_BUMP_H
@@ -0,0 +1,393 @@
+#ifndef CUTILS_THREAD_ARENA_H
+#define CUTILS_THREAD_ARENA_H
+
+#include <cutils/allocator/arena.h>
+#include <cutils/bits.h>
+#include <cutils/compatibility.h>
+#include <cutils/when_macros.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/*
+ * Per-thread arenas: each thread allocates from its own regions, created on
+ * its first thread_arena_alloc and placed on the NUMA node of the CPU it ran
+ * on at that time. The blocks fall in power of two size classes whose freed
+ * blocks are reused by the owner. A block freed by another thread is handed
+ * back through a lock-free list the owner drains when a class runs dry.
+ * Blocks above CUTILS_THREAD_ARENA_MAX_SMALL bytes get their own memory and
+ * are given back to the system by whichever thread frees them.
+ *
+ * The arena of a thread is released at its exit (pthread key destructor),
+ * or by thread_arena_thread_exit, and freed once the other threads have
+ * freed its last block.
+ *
+ * On Linux the regions are mapped and bound to the node with the mbind
+ * system call (preferred policy, the kernel falls back to other nodes when
+ * the node is full). When the binding is refused (no NUMA support, seccomp)
+ * or elsewhere, the owner touches the pages of every new region so that the
+ * first-touch policy places them. The arenas are per translation unit, like
+ * the other static state of these headers.
+ */
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+// Declared here as glibc hides it in the strict ISO modes
+long syscall(long number, ...);
+#define CUTILS_THREAD_ARENA_NUMA
+#endif
+
+// Size of the regions the small blocks are cut from
+#ifndef CUTILS_THREAD_ARENA_REGION_SIZE
+#define CUTILS_THREAD_ARENA_REGION_SIZE (1024 * 1024)
+#endif
+
+// Largest block taken from the regions, a power of two
+#ifndef CUTILS_THREAD_ARENA_MAX_SMALL
+#define CUTILS_THREAD_ARENA_MAX_SMALL (64 * 1024)
+#endif
+
+#if CUTILS_THREAD_ARENA_MAX_SMALL + 64 > CUTILS_THREAD_ARENA_REGION_SIZE
+#error "CUTILS_THREAD_ARENA_MAX_SMALL blocks must fit in a region"
+#endif
+
+// Size classes of 16 B to 128 MiB
+#define THREAD_ARENA_CLASSES 24
+#define THREAD_ARENA_MIN_SIZE 16
+
+// Nodes of the masks given to the kernel
+#define THREAD_ARENA_MAX_NODES 1024
+#define THREAD_ARENA_MPOL_DEFAULT 0
+#define THREAD_ARENA_MPOL_PREFERRED 1
+
+typedef struct thread_arena thread_arena_t;
+
+typedef struct {
+    _Alignas(max_align_t) thread_arena_t* owner;
+    // Size class of a small block, size of the memory of a large one (whose
+    // owner is NULL)
+    size_t size;
+} thread_arena_header_t;
+
+typedef struct thread_arena_free {
+    thread_arena_header_t header;
+    struct thread_arena_free* next;
+} thread_arena_free_t;
+
+struct thread_arena {
+    // Blocks freed by other threads
+    _Atomic(thread_arena_free_t*) remote;
+    // Live blocks, plus one until the owner exits
+    atomic_size_t references;
+    thread_arena_free_t* free[THREAD_ARENA_CLASSES];
+    // The first region is the one being cut
+    arena_region_t* regions;
+    // Node the memory is placed on, -1 if unknown
+    int node;
+    // Whether the last region was bound by mbind rather than first touched
+    bool bound;
+};
+
+UNUSED static atomic_size_t thread_arena_instances;
+UNUSED static THREAD_LOCAL thread_arena_t* thread_arena_self;
+UNUSED static pthread_key_t thread_arena_key;
+UNUSED static pthread_once_t thread_arena_once = PTHREAD_ONCE_INIT;
+UNUSED static bool thread_arena_key_created;
+
+// NUMA node of the CPU running the calling thread, -1 if unknown
+UNUSED
+static int thread_arena_current_node(void) {
+#if defined(CUTILS_THREAD_ARENA_NUMA) && defined(SYS_getcpu)
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+        return (int)node;
+#endif
+    return -1;
+}
+
+#ifdef CUTILS_THREAD_ARENA_NUMA
+#define THREAD_ARENA_MASK_BITS (8 * sizeof(unsigned long))
+
+UNUSED
+static void thread_arena_node_mask(unsigned long mask[THREAD_ARENA_MAX_NODES / THREAD_ARENA_MASK_BITS], const int node) {
+    for (unsigned i = 0; i < THREAD_ARENA_MAX_NODES / THREAD_ARENA_MASK_BITS; i++)
+        mask[i] = 0;
+    mask[(unsigned)node / THREAD_ARENA_MASK_BITS] = 1UL << ((unsigned)node % THREAD_ARENA_MASK_BITS);
+}
+#endif
+
+// Prefer node for the pages of [memory, memory + size) (the whole pages it
+// contains), false if the system refuses
+UNUSED
+static bool thread_arena_bind_memory(void* memory, const size_t size, const int node) {
+#if defined(CUTILS_THREAD_ARENA_NUMA) && defined(SYS_mbind)
+    when_false_ret(node >= 0 && node < THREAD_ARENA_MAX_NODES, false);
+    unsigned long mask[THREAD_ARENA_MAX_NODES / THREAD_ARENA_MASK_BITS];
+    thread_arena_node_mask(mask, node);
+    const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = ((uintptr_t)memory + page - 1) & ~(page - 1);
+    const uintptr_t end = ((uintptr_t)memory + size) & ~(page - 1);
+    if (end <= begin)
+        return true;
+    // The kernel reads maxnode - 1 bits of the mask
+    return syscall(SYS_mbind, (long)begin, (long)(end - begin), (long)THREAD_ARENA_MPOL_PREFERRED, (long)mask,
+                   (long)THREAD_ARENA_MAX_NODES + 1, 0L) == 0;
+#else
+    (void)memory, (void)size, (void)node;
+    return false;
+#endif
+}
+
+// Prefer node for every future allocation of the calling thread, or go back
+// to the default policy if node is negative (set_mempolicy system call)
+UNUSED
+static bool thread_arena_prefer_node(const int node) {
+#if defined(CUTILS_THREAD_ARENA_NUMA) && defined(SYS_set_mempolicy)
+    if (node < 0)
+        return syscall(SYS_set_mempolicy, (long)THREAD_ARENA_MPOL_DEFAULT, 0L, 0L) == 0;
+    when_false_ret(node < THREAD_ARENA_MAX_NODES, false);
+    unsigned long mask[THREAD_ARENA_MAX_NODES / THREAD_ARENA_MASK_BITS];
+    thread_arena_node_mask(mask, node);
+    return syscall(SYS_set_mempolicy, (long)THREAD_ARENA_MPOL_PREFERRED, (long)mask,
+                   (long)THREAD_ARENA_MAX_NODES + 1) == 0;
+#else
+    (void)node;
+    return false;
+#endif
+}
+
+UNUSED NODISCARD
+static void* thread_arena_map(const size_t size) {
+#if defined(CUTILS_THREAD_ARENA_NUMA) && defined(MAP_ANONYMOUS)
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+#else
+    return CUTILS_alloc(size);
+#endif
+}
+
+UNUSED
+static void thread_arena_unmap(void* memory, const size_t size) {
+#if defined(CUTILS_THREAD_ARENA_NUMA) && defined(MAP_ANONYMOUS)
+    munmap(memory, size);
+#else
+    (void)size;
+    CUTILS_dealloc(memory);
+#endif
+}
+
+// Place new memory on the node of the arena
+UNUSED
+static void thread_arena_place(thread_arena_t* arena, void* memory, const size_t size) {
+    arena->bound = arena->node >= 0 && thread_arena_bind_memory(memory, size, arena->node);
+    if (arena->bound)
+        return;
+    // First touch by the owner, at least once per page
+    for (size_t offset = 0; offset < size; offset += 4096)
+        ((volatile char*)memory)[offset] = 0;
+}
+
+UNUSED
+static void thread_arena_destroy(thread_arena_t* arena) {
+    arena_region_t* r = arena->regions;
+    while (r != NULL) {
+        arena_region_t* remove = r;
+        r = r->next;
+        thread_arena_unmap(remove, CUTILS_THREAD_ARENA_REGION_SIZE);
+    }
+    CUTILS_dealloc(arena);
+    atomic_fetch_sub(&thread_arena_instances, 1);
+}
+
+UNUSED
+static void thread_arena_release(thread_arena_t* arena) {
+    if (atomic_fetch_sub_explicit(&arena->references, 1, memory_order_acq_rel) == 1)
+        thread_arena_destroy(arena);
+}
+
+UNUSED
+static void thread_arena_exit(void* arena) {
+    if (thread_arena_self == arena)
+        thread_arena_self = NULL;
+    thread_arena_release(arena);
+}
+
+UNUSED
+static void thread_arena_create_key(void) {
+    thread_arena_key_created = pthread_key_create(&thread_arena_key, thread_arena_exit) == 0;
+}
+
+// Arena of the calling thread, created on the first call
+UNUSED NODISCARD
+static thread_arena_t* thread_arena_get(void) {
+    if (thread_arena_self != NULL)
+        return thread_arena_self;
+    pthread_once(&thread_arena_once, thread_arena_create_key);
+    when_false_ret(thread_arena_key_created, NULL);
+    thread_arena_t* arena = CUTILS_alloc(sizeof(thread_arena_t));
+    when_null_ret(arena, NULL);
+    atomic_init(&arena->remote, NULL);
+    atomic_init(&arena->references, 1);
+    for (unsigned c = 0; c < THREAD_ARENA_CLASSES; c++)
+        arena->free[c] = NULL;
+    arena->regions = NULL;
+    arena->node = thread_arena_current_node();
+    arena->bound = false;
+    if (pthread_setspecific(thread_arena_key, arena) != 0) {
+        CUTILS_dealloc(arena);
+        return NULL;
+    }
+    atomic_fetch_add(&thread_arena_instances, 1);
+    thread_arena_self = arena;
+    return arena;
+}
+
+// Release the arena of the calling thread before its exit, typically in the
+// main thread which does not run the key destructors. The next allocation of
+// the thread creates a new arena.
+UNUSED
+static void thread_arena_thread_exit(void) {
+    thread_arena_t* arena = thread_arena_self;
+    if (arena == NULL)
+        return;
+    pthread_setspecific(thread_arena_key, NULL);
+    thread_arena_exit(arena);
+}
+
+// Arenas alive in the process: of running threads or with live blocks
+UNUSED
+static size_t thread_arena_count(void) {
+    return atomic_load(&thread_arena_instances);
+}
+
+UNUSED
+static unsigned thread_arena_class(const size_t size) {
+    return size <= THREAD_ARENA_MIN_SIZE ? 0 : 64 - bits_leading_zeros((uint64_t)size - 1) - 4;
+}
+
+// Move the blocks freed by other threads to the free lists
+UNUSED
+static void thread_arena_collect(thread_arena_t* arena) {
+    thread_arena_free_t* block = atomic_exchange_explicit(&arena->remote, NULL, memory_order_acquire);
+    while (block != NULL) {
+        thread_arena_free_t* next = block->next;
+        block->next = arena->free[block->header.size];
+        arena->free[block->header.size] = block;
+        block = next;
+    }
+}
+
+UNUSED NODISCARD
+static void* thread_arena_bump(thread_arena_t* arena, const size_t size) {
+    void* memory;
+    const arena_size_t align = ALIGNOF(thread_arena_header_t);
+    if (arena->regions != NULL && (memory = arena_region_bump(arena->regions, size, align)) != NULL)
+        return memory;
+    arena_region_t* region = thread_arena_map(CUTILS_THREAD_ARENA_REGION_SIZE);
+    when_null_ret(region, NULL);
+    thread_arena_place(arena, region, CUTILS_THREAD_ARENA_REGION_SIZE);
+    region->next = arena->regions;
+    region->capacity = CUTILS_THREAD_ARENA_REGION_SIZE - sizeof(arena_region_t);
+    region->used = 0;
+    arena->regions = region;
+    return arena_region_bump(region, size, align);
+}
+
+UNUSED NODISCARD
+static void* thread_arena_alloc(const size_t size) {
+    thread_arena_t* arena = thread_arena_get();
+    when_null_ret(arena, NULL);
+    thread_arena_header_t* header;
+    if (size > CUTILS_THREAD_ARENA_MAX_SMALL) {
+        when_true_ret(size > SIZE_MAX - sizeof(thread_arena_header_t), NULL);
+        const size_t total = sizeof(thread_arena_header_t) + size;
+        header = thread_arena_map(total);
+        when_null_ret(header, NULL);
+        thread_arena_place(arena, header, total);
+        header->owner = NULL;
+        header->size = total;
+        return header + 1;
+    }
+    const unsigned c = thread_arena_class(size);
+    if (arena->free[c] == NULL)
+        thread_arena_collect(arena);
+    thread_arena_free_t* block = arena->free[c];
+    if (block != NULL) {
+        arena->free[c] = block->next;
+        header = &block->header;
+    } else {
+        header = thread_arena_bump(arena, sizeof(thread_arena_header_t) + ((size_t)THREAD_ARENA_MIN_SIZE << c));
+        when_null_ret(header, NULL);
+        header->owner = arena;
+        header->size = c;
+    }
+    atomic_fetch_add_explicit(&arena->references, 1, memory_order_relaxed);
+    return header + 1;
+}
+
+// Free a block allocated by any thread
+UNUSED
+static void thread_arena_free(void* memory) {
+    if (memory == NULL)
+        return;
+    thread_arena_header_t* header = (thread_arena_header_t*)memory - 1;
+    thread_arena_t* owner = header->owner;
+    if (owner == NULL) {
+        thread_arena_unmap(header, header->size);
+        return;
+    }
+    thread_arena_free_t* block = (thread_arena_free_t*)header;
+    if (owner == thread_arena_self) {
+        block->next = owner->free[header->size];
+        owner->free[header->size] = block;
+        atomic_fetch_sub_explicit(&owner->references, 1, memory_order_relaxed);
+        return;
+    }
+    // Hand the block back, the last block of an exited thread frees its arena
+    block->next = atomic_load_explicit(&owner->remote, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&owner->remote, &block->next, block,
+                                                  memory_order_release, memory_order_relaxed)) {}
+    thread_arena_release(owner);
+}
+
+// Usable size of a block
+UNUSED
+static size_t thread_arena_block_size(const void* memory) {
+    const thread_arena_header_t* header = (const thread_arena_header_t*)memory - 1;
+    return header->owner != NULL ? (size_t)THREAD_ARENA_MIN_SIZE << header->size
+                                 : header->size - sizeof(thread_arena_header_t);
+}
+
+UNUSED NODISCARD
+static void* thread_arena_realloc(void* memory, const size_t size) {
+    if (memory == NULL)
+        return thread_arena_alloc(size);
+    const size_t capacity = thread_arena_block_size(memory);
+    if (size <= capacity)
+        return memory;
+    void* moved = thread_arena_alloc(size);
+    when_null_ret(moved, NULL);
+    memcpy(moved, memory, capacity);
+    thread_arena_free(memory);
+    return moved;
+}
+
+UNUSED
+static allocator_t thread_arena_get_allocator(void) {
+    return ALLOCATOR_INIT_NO_METADATA(thread_arena_alloc, thread_arena_realloc, thread_arena_free);
+}
+
+// Compile-time allocator binding (see allocator.h), the memory comes from the
+// arena of the calling thread
+typedef void thread_arena_binding_t;
+#define thread_arena_binding_member
+#define thread_arena_binding_init(state)
+#define thread_arena_binding_state(container) NULL
+#define thread_arena_binding_alloc(state, size) ((void)(state), thread_arena_alloc(size))
+#define thread_arena_binding_realloc(state, buffer, old_size, size) \
+    ((void)(state), (void)(old_size), thread_arena_realloc(buffer, size))
+#define thread_arena_binding_dealloc(state, buffer, size) ((void)(state), (void)(size), thread_arena_free(buffer))
+
+#endif //CUTILS_THREAD_ARENA_H
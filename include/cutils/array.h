@@ -1,9 +1,11 @@
 #ifndef CUTILS_ARRAY_H
 #define CUTILS_ARRAY_H
 
-#include <cutils/allocator/alloc.h>
+#include <cutils/allocator/allocator.h>
 #include <cutils/compatibility.h>
+#include <cutils/instrument.h>
 #include <cutils/minmax.h>
+#include <cutils/when_macros.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <assert.h>
@@ -31,6 +33,11 @@
 #define EMPTY_ARRAY(type) (type ## _array_t) { .length = 0, .capacity = 0, .data = NULL }
 #endif
 
+#ifndef EMPTY_ARRAY_WITH_ALLOCATOR
+#define EMPTY_ARRAY_WITH_ALLOCATOR(name, state) \
+    (name ## _array_t) { .length = 0, .capacity = 0, .data = NULL, .allocator = (state) }
+#endif
+
 #define DEFINE_SERIALIZED_ARRAY_ALIGNER(type)   \
     struct aligner {                            \
         unsigned length;                        \
@@ -38,41 +45,64 @@
     };
 
 #define DEFINE_ARRAY_TYPE(type)                                                \
-    DEFINE_INTERFACE_ARRAY_TYPE(type)                                          \
-    DEFINE_IMPLEMENTATION_ARRAY_TYPE(type)                                     \
+    DEFINE_ARRAY_TYPE_WITH_ALLOCATOR(type, type, heap)
 
 #define DEFINE_INTERFACE_ARRAY_TYPE(type)                                      \
-    typedef struct {                                                           \
-        unsigned length;                                                       \
-        unsigned capacity;                                                     \
-        type *data;                                                            \
-    } type ## _array_t;
+    DEFINE_INTERFACE_ARRAY_TYPE_WITH_ALLOCATOR(type, type, heap)
 
 #define DEFINE_IMPLEMENTATION_ARRAY_TYPE(type)                                  \
-    UNUSED NODISCARD static type *array_append_ ## type(                        \
-        type ## _array_t *array, unsigned count                                 \
+    DEFINE_IMPLEMENTATION_ARRAY_TYPE_WITH_ALLOCATOR(type, type, heap)
+
+// Define name ## _array_t, an array of type whose growth calls the functions
+// of the allocator binding directly (see allocator.h)
+#define DEFINE_ARRAY_TYPE_WITH_ALLOCATOR(name, type, binding)                   \
+    DEFINE_INTERFACE_ARRAY_TYPE_WITH_ALLOCATOR(name, type, binding)             \
+    DEFINE_IMPLEMENTATION_ARRAY_TYPE_WITH_ALLOCATOR(name, type, binding)        \
+
+#define DEFINE_INTERFACE_ARRAY_TYPE_WITH_ALLOCATOR(name, type, binding)         \
+    typedef struct {                                                            \
+        unsigned length;                                                        \
+        unsigned capacity;                                                      \
+        type *data;                                                             \
+        binding ## _binding_member                                              \
+    } name ## _array_t;
+
+#define DEFINE_IMPLEMENTATION_ARRAY_TYPE_WITH_ALLOCATOR(name, type, binding)    \
+    INSTRUMENT_DEFINE(array, name)                                              \
+                                                                                \
+    UNUSED NODISCARD static type *array_append_ ## name(                        \
+        name ## _array_t *array, unsigned count                                 \
     ) {                                                                         \
         if(count == 0)                                                          \
             return NULL;                                                        \
-        if (array->capacity == 0) {                                             \
-            unsigned capacity = MAX(count, ARRAY_MIN_CAPACITY);                 \
-            array->data = CUTILS_alloc(capacity * sizeof(type));                \
-            array->capacity = capacity;                                         \
-        }                                                                       \
         if (array->capacity < array->length + count) {                          \
-            unsigned capacity = (array->capacity + count) * 2;                  \
-            void *memory = CUTILS_realloc(array->data, capacity * sizeof(type));\
-            assert(memory != NULL);                                             \
+            unsigned capacity = MAX(array->capacity * 2, array->length + count); \
+            capacity = MAX(capacity, ARRAY_MIN_CAPACITY);                       \
+            void *memory = array->capacity == 0                                 \
+                ? binding ## _binding_alloc(binding ## _binding_state(array),   \
+                    capacity * sizeof(type))                                    \
+                : binding ## _binding_realloc(binding ## _binding_state(array), \
+                    array->data, array->capacity * sizeof(type),                \
+                    capacity * sizeof(type));                                   \
+            when_null_ret(memory, NULL);                                        \
+            if (array->capacity != 0) {                                         \
+                INSTRUMENT(array, name, INSTRUMENT_REALLOCATION, 1);            \
+                /* The allocator copied the elements if it moved them */        \
+                if (memory != array->data)                                      \
+                    INSTRUMENT(array, name, INSTRUMENT_BYTES_MOVED,             \
+                        array->length * sizeof(type));                          \
+            }                                                                   \
+            INSTRUMENT(array, name, INSTRUMENT_CAPACITY, capacity);             \
             array->data = memory;                                               \
-            array->capacity *= 2;                                               \
+            array->capacity = capacity;                                         \
         }                                                                       \
         type* ret = &array->data[array->length];                                \
         array->length += count;                                                 \
         return ret;                                                             \
     }                                                                           \
                                                                                 \
-    UNUSED static bool array_pop_ ## type(                                      \
-        type ## _array_t *array, type* value                                    \
+    UNUSED static bool array_pop_ ## name(                                      \
+        name ## _array_t *array, type* value                                    \
     ) {                                                                         \
         if(array->length == 0)                                                  \
             return false;                                                       \
@@ -82,35 +112,39 @@
         return true;                                                            \
     }                                                                           \
                                                                                 \
-    UNUSED static type* array_insert_ ## type(                                  \
-        type##_array_t *array, const type *item, unsigned index                 \
+    UNUSED static type* array_insert_ ## name(                                  \
+        name##_array_t *array, const type *item, unsigned index                 \
     ) {                                                                         \
         assert(index <= array->length);                                         \
-        if(NULL == array_append_ ## type(array, 1))                             \
+        if(NULL == array_append_ ## name(array, 1))                             \
             return NULL;                                                        \
-        size_t tailSize = (array->length - index) * sizeof(type);               \
-        if(tailSize != 0)                                                       \
+        size_t tailSize = (array->length - 1 - index) * sizeof(type);           \
+        if(tailSize != 0) {                                                     \
             memmove(&array->data[index + 1], &array->data[index], tailSize);    \
+            INSTRUMENT(array, name, INSTRUMENT_BYTES_MOVED, tailSize);          \
+        }                                                                       \
         if(item != NULL)                                                        \
             memcpy(&array->data[index], item, sizeof(type));                    \
         return &array->data[index];                                             \
     }                                                                           \
                                                                                 \
-    UNUSED static bool array_remove_ ## type(                                   \
-        type##_array_t *array, const type *item, unsigned index                 \
+    UNUSED static bool array_remove_ ## name(                                   \
+        name##_array_t *array, const type *item, unsigned index                 \
     ) {                                                                         \
         assert(index < array->length);                                          \
         size_t tailSize = (array->length - 1 - index) * sizeof(type);           \
         if(item != NULL)                                                        \
             memcpy(&array->data[index], item, sizeof(type));                    \
-        if(tailSize != 0)                                                       \
+        if(tailSize != 0) {                                                     \
             memmove(&array->data[index], &array->data[index + 1], tailSize);    \
+            INSTRUMENT(array, name, INSTRUMENT_BYTES_MOVED, tailSize);          \
+        }                                                                       \
         array->length -= 1;                                                     \
         return true;                                                            \
     }                                                                           \
                                                                                 \
-    UNUSED static void array_filter_ ## type(                                   \
-        type##_array_t *array, const bool* remove                               \
+    UNUSED static void array_filter_ ## name(                                   \
+        name##_array_t *array, const bool* remove                               \
     ) {                                                                         \
         unsigned start = 0, blockSize = 0;                                      \
         for(unsigned i = 0; i < array->length; i++) {                           \
@@ -118,6 +152,8 @@
                 if (blockSize > 0) {                                            \
                     memmove(&array->data[start], &array->data[i - blockSize],   \
                         blockSize * sizeof(type));                              \
+                    INSTRUMENT(array, name, INSTRUMENT_BYTES_MOVED,             \
+                        blockSize * sizeof(type));                              \
                     start += blockSize;                                         \
                     blockSize = 0;                                              \
                 }                                                               \
@@ -127,8 +163,8 @@
         }                                                                       \
     }                                                                           \
                                                                                 \
-    UNUSED static void array_swap_and_pop_back_ ## type(                        \
-        type ## _array_t *array, unsigned index                                 \
+    UNUSED static void array_swap_and_pop_back_ ## name(                        \
+        name ## _array_t *array, unsigned index                                 \
     ) {                                                                         \
         assert(index < array->length);                                          \
         if (index == array->length - 1) {                                       \
@@ -140,37 +176,42 @@
                sizeof(type));                                                   \
     }                                                                           \
                                                                                 \
-    UNUSED static void array_free_##type(type##_array_t *array) {               \
-        free(array->data);                                                      \
+    UNUSED static void array_free_##name(name##_array_t *array) {               \
+        binding ## _binding_dealloc(binding ## _binding_state(array),           \
+            array->data, array->capacity * sizeof(type));                       \
         array->length = 0;                                                      \
         array->capacity = 0;                                                    \
         array->data = NULL;                                                     \
     }                                                                           \
                                                                                 \
-    UNUSED static type ## _array_t array_shallow_clone_ ## type(                \
-        const type##_array_t *array                                             \
+    UNUSED static name ## _array_t array_shallow_clone_ ## name(                \
+        const name##_array_t *array                                             \
     ) {                                                                         \
-        type* copy = malloc(array->capacity * sizeof(type));                    \
+        type* copy = binding ## _binding_alloc(binding ## _binding_state(array), \
+            array->capacity * sizeof(type));                                    \
         memcpy(copy, array->data, array->length * sizeof(type));                \
-        return (type ## _array_t) {                                             \
+        INSTRUMENT(array, name, INSTRUMENT_BYTES_MOVED,                         \
+            array->length * sizeof(type));                                      \
+        return (name ## _array_t) {                                             \
             .length = array->length,                                            \
             .capacity = array->capacity,                                        \
-            .data = copy                                                        \
+            .data = copy,                                                       \
+            binding ## _binding_init(binding ## _binding_state(array))          \
         };                                                                      \
     }                                                                           \
                                                                                 \
     typedef int (*compare_ ## type ##_fn)(const type *a, const type *b);        \
                                                                                 \
-    UNUSED static type* array_insert_sorted_ ## type(                           \
-        type ## _array_t* array, compare_ ## type ## _fn fn, type* x            \
+    UNUSED static type* array_insert_sorted_ ## name(                           \
+        name ## _array_t* array, compare_ ## type ## _fn fn, type* x            \
     ) {                                                                         \
         if (array->length == 0 ||                                               \
             fn(x, &array->data[array->length - 1]) > 0) {                       \
-            type *p = array_append_##type(array, 1);                            \
+            type *p = array_append_##name(array, 1);                            \
             memcpy(p, x, sizeof(type));                                         \
             return p;                                                           \
         } else if (fn(x, &array->data[0]) < 0) {                                \
-            return array_insert_##type(array, x, 0);                            \
+            return array_insert_##name(array, x, 0);                            \
         }                                                                       \
         unsigned a = 0, b = array->length, mid;                                 \
         while (a <= b) {                                                        \
@@ -181,14 +222,14 @@
             } else if (cmp > 0) {                                               \
                 a = mid + 1;                                                    \
             } else {                                                            \
-                return array_insert_##type(array, x, mid);                      \
+                return array_insert_##name(array, x, mid);                      \
             }                                                                   \
         }                                                                       \
-        return array_insert_##type(array, x, mid);                              \
+        return array_insert_##name(array, x, a);                                \
     }                                                                           \
                                                                                 \
-    UNUSED static type* array_find_sorted_ ## type(                             \
-        const type ## _array_t* array, compare_ ## type ## _fn fn, type* x      \
+    UNUSED static type* array_find_sorted_ ## name(                             \
+        const name ## _array_t* array, compare_ ## type ## _fn fn, type* x      \
     ) {                                                                         \
         if (array->length == 0                                                  \
             || fn(x, &array->data[0]) < 0 ||                                    \
@@ -210,15 +251,15 @@
         return NULL;                                                            \
     }                                                                           \
                                                                                 \
-    UNUSED static size_t array_serialized_size_ ## type(                        \
-        const type ## _array_t* array                                           \
+    UNUSED static size_t array_serialized_size_ ## name(                        \
+        const name ## _array_t* array                                           \
     ) {                                                                         \
         DEFINE_SERIALIZED_ARRAY_ALIGNER(type)                                   \
         return sizeof(struct aligner) + array->length * sizeof(type);           \
     }                                                                           \
                                                                                 \
-    UNUSED static bool array_serialize_ ## type(                                \
-        char* buffer, const type ## _array_t* array                             \
+    UNUSED static bool array_serialize_ ## name(                                \
+        char* buffer, const name ## _array_t* array                             \
     ) {                                                                         \
         DEFINE_SERIALIZED_ARRAY_ALIGNER(type)                                   \
         if((intptr_t)buffer & (ALIGNOF(unsigned) - 1)) return false;            \
@@ -228,15 +269,15 @@
         return true;                                                            \
     }                                                                           \
                                                                                 \
-    NODISCARD UNUSED static bool array_deserialize_ ## type(                    \
-        type ## _array_t* array, const char* buffer                             \
+    NODISCARD UNUSED static bool array_deserialize_ ## name(                    \
+        name ## _array_t* array, const char* buffer                             \
     ) {                                                                         \
         DEFINE_SERIALIZED_ARRAY_ALIGNER(type)                                   \
         if((intptr_t)buffer & (ALIGNOF(unsigned) - 1)) return false;            \
         unsigned length = *(unsigned*)buffer;                                   \
-        array_free_ ## type(array);                                             \
-        type* data = array_append_ ## type(array, length);                      \
-        if (data != NULL) return false;                                         \
+        array_free_ ## name(array);                                             \
+        type* data = array_append_ ## name(array, length);                      \
+        if (data == NULL) return false;                                         \
         memcpy(data, buffer + sizeof(struct aligner), length * sizeof(type));   \
         return true;                                                            \
     }
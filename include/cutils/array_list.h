@@ -8,13 +8,18 @@
  * @ingroup array_list
  */
 
+#include "cutils/compatibility.h"
 #include "cutils/errors.h"
+#include "cutils/instrument.h"
 #include "cutils/when_macros.h"
 
+/* Must be a power of two, the capacity of the buffer always is */
 #define ARRAY_LIST_MIN_CAPACITY 8
 
 #define get_array_list_ref(array, index, type)                                 \
-  (type *)((array).data + (index) * (array).size_bytes)
+  (type *)((array).data +                                                      \
+           (((array).begin + (index)) & ((array).capacity - 1)) *              \
+               (array).size_bytes)
 
 /**
  * @defgroup array_list Dynamic arrays
@@ -29,21 +34,24 @@
 typedef struct array_list array_list_t;
 
 /**
- * @struct circular_buffer
- * @brief A circular buffer
+ * @struct array_list
+ * @brief A growable double-ended queue
  *
  * A dynamic array olds a pointer to its data, the size (in bytes) of an
  * element of the array, the current capacity of the buffer, the actual
- * number of elements in the array
+ * number of elements in the array and the index of its first element.<br>
+ * The elements are stored in a circular buffer whose capacity is a power of
+ * two so that both ends can grow and shrink in O(1).
  */
 struct array_list {
   char *data; /**< Pointer to the allocated memory for the dynamic array */
   unsigned size_bytes; /**< Size (in bytes) of an element of the array */
   unsigned capacity;   /**< The current capacity of the array */
   unsigned size;       /**< The number of elements in the array */
+  unsigned begin;      /**< Index in the buffer of the first element */
 };
 
-#define ARRAY_LIST_INIT(type) (array_list_t){NULL, sizeof(type), 0, 0};
+#define ARRAY_LIST_INIT(type) (array_list_t){NULL, sizeof(type), 0, 0, 0}
 
 /**
  * @brief Create an empty dynamic array
@@ -98,13 +106,23 @@ void array_list_deinit(array_list_t *array);
  */
 bool array_list_empty(array_list_t *array);
 
+/**
+ * @brief Get a pointer to an element of the array
+ *
+ * _Complexity: O(1)_
+ * @param[in] array pointer to the array
+ * @param[in] index index of the element
+ * @return Pointer to the element (NULL if index is out of bounds)
+ */
+void *array_list_get(array_list_t *array, unsigned index);
+
 /**
  * @brief Copy an element at the beginning of the array
  *
  * The array **won't** take ownership of the element but extend the array buffer
  * and copy the element into it.
  *
- * _Complexity: O(n)_
+ * _Complexity: O(1) amortized_
  * @param array Pointer to the array to extend
  * @param p Pointer to the data to copy at the beginning of the array
  * @return Pointer to the newly created element (NULL in case of failure)
@@ -117,7 +135,7 @@ void *array_list_push_front(array_list_t *array, void *value);
  * The array **won't** take ownership of the element but extend the array buffer
  * and copy the element into it.
  *
- * _Complexity: O(1)_
+ * _Complexity: O(1) amortized_
  * @param array Pointer to the array to extend
  * @param p Pointer to the data to copy at the end of the array
  * @return Pointer to the newly created element (NULL in case of failure)
@@ -131,7 +149,7 @@ void *array_list_push_back(array_list_t *array, void *value);
  * to the memory region pointed by value which should have been allocated with
  * array_list::size_bytes bytes.<br>
  *
- * _Complexity: O(n)_
+ * _Complexity: O(1)_
  * @param[in] array pointer to the array
  * @param[out] value pointer to the remove data (if NULL the data will be lost)
  * @return FALSE iif the array was empty
@@ -173,65 +191,95 @@ bool array_list_swap_and_pop_back(array_list_t *array, unsigned int i,
 #include <stdlib.h>
 #include <string.h>
 
-#define array_list_init(type)                                                  \
-  (array_list_t) {                                                             \
-    .data = NULL, .capacity = 0, .size = 0, .size_bytes = sizeof(type)         \
-  }
+INSTRUMENT_DEFINE(array_list, untyped)
+
+array_list_t *array_list_create(unsigned size_bytes) {
+  array_list_t *array = malloc(sizeof(array_list_t));
+  when_null_ret(array, NULL);
+  array_list_init(array, size_bytes);
+  return array;
+}
+
+void array_list_free(array_list_t *array) {
+  array_list_deinit(array);
+  free(array);
+}
+
+void array_list_init(array_list_t *array, unsigned size_bytes) {
+  *array = (array_list_t){
+      .data = NULL, .size_bytes = size_bytes, .capacity = 0, .size = 0,
+      .begin = 0};
+}
 
 void array_list_deinit(array_list_t *array) {
   array->capacity = 0;
   array->size = 0;
+  array->begin = 0;
   free(array->data);
   array->data = NULL;
 }
 
 bool array_list_empty(array_list_t *array) { return array->size == 0; }
 
-static void ensure_sufficient_capacity(array_list_t *array) {
-  if (array->size >= array->capacity) {
-    if (array->capacity < ARRAY_LIST_MIN_CAPACITY)
-      array->capacity = ARRAY_LIST_MIN_CAPACITY * array->size_bytes;
-    else
-      array->capacity *= 2;
-    array->data = realloc(array->data, array->capacity * array->size_bytes);
-  }
+void *array_list_get(array_list_t *array, unsigned index) {
+  when_false_ret(index < array->size, NULL);
+  return get_array_list_ref(*array, index, void);
 }
 
-static void shift_right(array_list_t *array) {
-  memmove(array->data + array->size_bytes, array->data,
-          array->size * array->size_bytes);
+static bool ensure_sufficient_capacity(array_list_t *array) {
+  if (array->size < array->capacity)
+    return true;
+  const unsigned capacity = array->capacity < ARRAY_LIST_MIN_CAPACITY
+                                ? ARRAY_LIST_MIN_CAPACITY
+                                : array->capacity * 2;
+  char *data = realloc(array->data, (size_t)capacity * array->size_bytes);
+  when_null_ret(data, false);
+  if (array->capacity != 0) {
+    INSTRUMENT(array_list, untyped, INSTRUMENT_REALLOCATION, 1);
+    // realloc copied the elements if it moved them
+    if (data != array->data)
+      INSTRUMENT(array_list, untyped, INSTRUMENT_BYTES_MOVED,
+                 (size_t)array->size * array->size_bytes);
+  }
+  INSTRUMENT(array_list, untyped, INSTRUMENT_CAPACITY, capacity);
+  // Move the elements which wrapped around after the old end of the buffer
+  if (array->begin + array->size > array->capacity) {
+    const unsigned wrapped = array->begin + array->size - array->capacity;
+    memcpy(data + (size_t)array->capacity * array->size_bytes, data,
+           (size_t)wrapped * array->size_bytes);
+    INSTRUMENT(array_list, untyped, INSTRUMENT_BYTES_MOVED,
+               (size_t)wrapped * array->size_bytes);
+  }
+  array->data = data;
+  array->capacity = capacity;
+  return true;
 }
 
 void *array_list_push_front(array_list_t *array, void *value) {
-  ensure_sufficient_capacity(array);
+  when_false_ret(ensure_sufficient_capacity(array), NULL);
+  array->begin = (array->begin - 1) & (array->capacity - 1);
   array->size++;
-  shift_right(array);
-  void *ptr = array->data;
+  void *ptr = get_array_list_ref(*array, 0, void);
   memcpy(ptr, value, array->size_bytes);
   return ptr;
 }
 
 void *array_list_push_back(array_list_t *array, void *value) {
-  ensure_sufficient_capacity(array);
-  void *ptr = array->data + array->size_bytes * array->size;
+  when_false_ret(ensure_sufficient_capacity(array), NULL);
+  void *ptr = get_array_list_ref(*array, array->size, void);
   memcpy(ptr, value, array->size_bytes);
   array->size++;
   return ptr;
 }
 
-static void shift_left(array_list_t *array) {
-  memmove(array->data, array->data + array->size_bytes,
-          array->size * array->size_bytes);
-}
-
 bool array_list_pop_front(array_list_t *array, void *value) {
   if (array_list_empty(array))
     return false;
 
   if (value != NULL) {
-    memcpy(value, array->data, array->size_bytes);
+    memcpy(value, get_array_list_ref(*array, 0, void), array->size_bytes);
   }
-  shift_left(array);
+  array->begin = (array->begin + 1) & (array->capacity - 1);
   array->size--;
   return true;
 }
@@ -241,7 +289,7 @@ bool array_list_pop_back(array_list_t *array, void *value) {
     return false;
 
   if (value != NULL) {
-    char *ptr = array->data + array->size_bytes * (array->size - 1);
+    char *ptr = get_array_list_ref(*array, array->size - 1, char);
     memcpy(value, ptr, array->size_bytes);
   }
   array->size--;
@@ -256,10 +304,14 @@ int array_list_swap(array_list_t *array, unsigned a, unsigned b) {
     return -ERROR_NO_ERROR;
   unsigned char *a_ref = get_array_list_ref(*array, a, unsigned char);
   unsigned char *b_ref = get_array_list_ref(*array, b, unsigned char);
-  for (unsigned i = 0; i < array->size_bytes; i++) {
-    unsigned char byte = a_ref[i];
-    a_ref[i] = b_ref[i];
-    b_ref[i] = byte;
+  unsigned char tmp[64];
+  for (unsigned i = 0; i < array->size_bytes; i += sizeof(tmp)) {
+    const size_t n = array->size_bytes - i < sizeof(tmp)
+                         ? array->size_bytes - i
+                         : sizeof(tmp);
+    memcpy(tmp, a_ref + i, n);
+    memcpy(a_ref + i, b_ref + i, n);
+    memcpy(b_ref + i, tmp, n);
   }
   return -ERROR_NO_ERROR;
 }
@@ -269,7 +321,7 @@ bool array_list_swap_and_pop_back(array_list_t *array, unsigned i,
   if (array_list_empty(array) == true)
     return false;
   int ret = array_list_swap(array, i, array->size - 1);
-  when_false_ret(-ERROR_NO_ERROR == ret, FALSE);
+  when_false_ret(-ERROR_NO_ERROR == ret, false);
   return array_list_pop_back(array, value);
 }
 
@@ -7,11 +7,13 @@
 #ifdef __GNUC__
 UNUSED
 static uint64_t bits_next_pow2(const uint64_t n) {
-    return n == 1 ? 1 : 1 << (64 - __builtin_clzl(n - 1));
+    return n <= 1 ? 1 : UINT64_C(1) << (64 - __builtin_clzll(n - 1));
 }
 #else
 UNUSED
 static uint64_t bits_next_pow2(uint64_t n) {
+    if (n <= 1) return 1;
+    n -= 1;
     n |= (n >> 1);
     n |= (n >> 2);
     n |= (n >> 4);
@@ -22,6 +24,78 @@ static uint64_t bits_next_pow2(uint64_t n) {
 }
 #endif
 
+#ifdef __GNUC__
+UNUSED
+static unsigned bits_popcount(const uint64_t n) {
+    return (unsigned)__builtin_popcountll(n);
+}
+#else
+UNUSED
+static unsigned bits_popcount(uint64_t n) {
+    n = n - ((n >> 1) & UINT64_C(0x5555555555555555));
+    n = (n & UINT64_C(0x3333333333333333)) + ((n >> 2) & UINT64_C(0x3333333333333333));
+    n = (n + (n >> 4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+    return (unsigned)((n * UINT64_C(0x0101010101010101)) >> 56);
+}
+#endif
+
+// Number of leading zero bits of n, which must not be 0
+#ifdef __GNUC__
+UNUSED
+static unsigned bits_leading_zeros(const uint64_t n) {
+    return (unsigned)__builtin_clzll(n);
+}
+#else
+UNUSED
+static unsigned bits_leading_zeros(uint64_t n) {
+    unsigned zeros = 0;
+    for (unsigned shift = 32; shift != 0; shift >>= 1) {
+        if (n >> (64 - shift) == 0) {
+            zeros += shift;
+            n <<= shift;
+        }
+    }
+    return zeros;
+}
+#endif
+
+// Number of trailing zero bits of n, which must not be 0
+#ifdef __GNUC__
+UNUSED
+static unsigned bits_trailing_zeros(const uint64_t n) {
+    return (unsigned)__builtin_ctzll(n);
+}
+#else
+UNUSED
+static unsigned bits_trailing_zeros(const uint64_t n) {
+    return bits_popcount((n & (0 - n)) - 1);
+}
+#endif
+
+// Full 128-bit product of a and b: returns the low 64 bits and stores the
+// high ones in *high
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 bits_uint128_t;
+
+UNUSED
+static uint64_t bits_mul128(const uint64_t a, const uint64_t b, uint64_t* high) {
+    const bits_uint128_t product = (bits_uint128_t)a * b;
+    *high = (uint64_t)(product >> 64);
+    return (uint64_t)product;
+}
+#else
+UNUSED
+static uint64_t bits_mul128(const uint64_t a, const uint64_t b, uint64_t* high) {
+    const uint64_t a_low = (uint32_t)a, a_high = a >> 32;
+    const uint64_t b_low = (uint32_t)b, b_high = b >> 32;
+    const uint64_t low = a_low * b_low;
+    const uint64_t middle = a_high * b_low + (low >> 32);
+    const uint64_t cross = a_low * b_high + (uint32_t)middle;
+    *high = a_high * b_high + (middle >> 32) + (cross >> 32);
+    return (cross << 32) | (uint32_t)low;
+}
+#endif
+
 UNUSED
 static bool bits_isset(const uint8_t* bits, const unsigned index) {
     const uint8_t byte = bits[index / 8];
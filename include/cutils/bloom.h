@@ -0,0 +1,289 @@
+#ifndef CUTILS_BLOOM_H
+#define CUTILS_BLOOM_H
+
+#include <cutils/allocator/allocator.h>
+#include <cutils/bits.h>
+#include <cutils/compatibility.h>
+#include <cutils/when_macros.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef CUTILS_NO_STD
+#include <string.h>
+#endif
+
+/*
+ * Split block Bloom filter: a key selects one 64-byte block (a cache line)
+ * with the high half of its hash, then sets one bit in each of the 32-bit
+ * lanes of this block. One probe per lane is the best trade-off from 8 to 40
+ * bits per key (false positive rates from 10% to 1e-6). The lanes are
+ * computed together with GNU vector extensions when they are available. The
+ * keys are 64-bit hashes computed by the caller.
+ */
+
+#define BLOOM_BLOCK_SIZE 64
+#define BLOOM_BLOCK_LANES 16
+
+// Number of keys probed ahead by the batch functions
+#ifndef CUTILS_BLOOM_PREFETCH_DISTANCE
+#define CUTILS_BLOOM_PREFETCH_DISTANCE 8
+#endif
+
+typedef struct {
+    // block_count blocks of BLOOM_BLOCK_LANES lanes, aligned on BLOOM_BLOCK_SIZE
+    uint32_t* blocks;
+    void* memory;
+    uint32_t block_count;
+} bloom_filter_t;
+
+#define BLOOM_INIT { NULL, NULL, 0 }
+
+// Header of the serialized filters, followed by the blocks
+typedef struct {
+    uint32_t block_count;
+    uint32_t lanes;
+} bloom_header_t;
+
+UNUSED static const uint32_t bloom_salts[BLOOM_BLOCK_LANES] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+    0x9e3779b1U, 0x85ebca77U, 0xc2b2ae3dU, 0x27d4eb2fU,
+    0x165667b1U, 0xd3a2646dU, 0xfd7046c5U, 0xb55a4f09U,
+};
+
+UNUSED
+static uint32_t* bloom_block(const bloom_filter_t* filter, const uint64_t hash) {
+    // Map the high half of the hash on [0, block_count) without a division
+    const uint64_t index = ((hash >> 32) * filter->block_count) >> 32;
+    return &filter->blocks[index * BLOOM_BLOCK_LANES];
+}
+
+#ifdef __GNUC__
+
+typedef uint32_t bloom_vector_t __attribute__((vector_size(BLOOM_BLOCK_SIZE)));
+
+UNUSED
+static void bloom_mask(const uint64_t hash, bloom_vector_t* mask) {
+    bloom_vector_t salts;
+    memcpy(&salts, bloom_salts, sizeof(salts));
+    const bloom_vector_t bit = (((bloom_vector_t){ 0 } + (uint32_t)hash) * salts) >> 27;
+    *mask = ((bloom_vector_t){ 0 } + 1U) << bit;
+}
+
+UNUSED
+static void bloom_insert_block(uint32_t* block, const bloom_vector_t* mask) {
+    bloom_vector_t lanes;
+    memcpy(&lanes, block, sizeof(lanes));
+    lanes |= *mask;
+    memcpy(block, &lanes, sizeof(lanes));
+}
+
+UNUSED
+static bool bloom_contains_block(const uint32_t* block, const bloom_vector_t* mask) {
+    bloom_vector_t lanes;
+    memcpy(&lanes, block, sizeof(lanes));
+    const bloom_vector_t missing = *mask & ~lanes;
+    uint32_t any = 0;
+    for (unsigned i = 0; i < BLOOM_BLOCK_LANES; i++)
+        any |= missing[i];
+    return any == 0;
+}
+
+#else
+
+typedef struct {
+    uint32_t lanes[BLOOM_BLOCK_LANES];
+} bloom_vector_t;
+
+UNUSED
+static void bloom_mask(const uint64_t hash, bloom_vector_t* mask) {
+    for (unsigned i = 0; i < BLOOM_BLOCK_LANES; i++)
+        mask->lanes[i] = 1U << (((uint32_t)hash * bloom_salts[i]) >> 27);
+}
+
+UNUSED
+static void bloom_insert_block(uint32_t* block, const bloom_vector_t* mask) {
+    for (unsigned i = 0; i < BLOOM_BLOCK_LANES; i++)
+        block[i] |= mask->lanes[i];
+}
+
+UNUSED
+static bool bloom_contains_block(const uint32_t* block, const bloom_vector_t* mask) {
+    uint32_t any = 0;
+    for (unsigned i = 0; i < BLOOM_BLOCK_LANES; i++)
+        any |= mask->lanes[i] & ~block[i];
+    return any == 0;
+}
+
+#endif
+
+#ifdef __GNUC__
+#define bloom_prefetch(address, write) __builtin_prefetch(address, write)
+#else
+#define bloom_prefetch(address, write) ((void)(address))
+#endif
+
+UNUSED NODISCARD
+static bool bloom_init(bloom_filter_t* filter, const uint32_t block_count) {
+    when_false_ret(block_count != 0, false);
+    const size_t size = (size_t)block_count * BLOOM_BLOCK_SIZE;
+    void* memory = CUTILS_alloc(size + BLOOM_BLOCK_SIZE - 1);
+    when_null_ret(memory, false);
+    filter->memory = memory;
+    filter->blocks = (uint32_t*)CUTILS_NEXT_ALLOC_ALIGNED((uintptr_t)memory, (uintptr_t)BLOOM_BLOCK_SIZE);
+    filter->block_count = block_count;
+    memset(filter->blocks, 0, size);
+    return true;
+}
+
+UNUSED
+static void bloom_free(bloom_filter_t* filter) {
+    CUTILS_dealloc(filter->memory);
+    *filter = (bloom_filter_t) BLOOM_INIT;
+}
+
+UNUSED
+static void bloom_clear(bloom_filter_t* filter) {
+    memset(filter->blocks, 0, (size_t)filter->block_count * BLOOM_BLOCK_SIZE);
+}
+
+// e^-x for x >= 0, the header does not depend on libm
+UNUSED
+static double bloom_exp_neg(double x) {
+    unsigned squarings = 0;
+    for (; x > 0.5; x /= 2)
+        squarings++;
+    double term = 1, sum = 1;
+    for (unsigned i = 1; i < 16; i++) {
+        term *= -x / i;
+        sum += term;
+    }
+    while (squarings-- > 0)
+        sum *= sum;
+    return sum;
+}
+
+// Expected false positive rate once count keys are inserted
+UNUSED
+static double bloom_false_positive_rate(const uint32_t block_count, const double count) {
+    // The number of keys of a block follows a Poisson law of mean load
+    const double load = count / block_count;
+    double probability = bloom_exp_neg(load), unset = 1, rate = 0;
+    for (unsigned keys = 0; keys < 2 * load + 64 || probability > 1e-18; keys++) {
+        // Probability that the probed bits of all the lanes are set
+        double hit = 1;
+        for (unsigned i = 0; i < BLOOM_BLOCK_LANES; i++)
+            hit *= 1 - unset;
+        rate += probability * hit;
+        probability *= load / (keys + 1);
+        unset *= 31.0 / 32.0;
+    }
+    return rate;
+}
+
+// Smallest filter whose false positive rate stays below rate with count keys
+UNUSED NODISCARD
+static bool bloom_init_for(bloom_filter_t* filter, const size_t count, const double rate) {
+    when_false_ret(rate > 0 && rate < 1, false);
+    const double bitsPerBlock = BLOOM_BLOCK_SIZE * 8;
+    // Up to 128 bits per key, grow by steps of 1/16
+    for (double bitsPerKey = 1; bitsPerKey <= 128; bitsPerKey *= 1.0625) {
+        const double blocks = (count != 0 ? (double)count : 1) * bitsPerKey / bitsPerBlock;
+        if (blocks >= UINT32_MAX)
+            return false;
+        const uint32_t block_count = (uint32_t)blocks + 1;
+        if (bloom_false_positive_rate(block_count, (double)count) <= rate)
+            return bloom_init(filter, block_count);
+    }
+    return false;
+}
+
+UNUSED
+static void bloom_insert(bloom_filter_t* filter, const uint64_t hash) {
+    bloom_vector_t mask;
+    bloom_mask(hash, &mask);
+    bloom_insert_block(bloom_block(filter, hash), &mask);
+}
+
+UNUSED
+static bool bloom_contains(const bloom_filter_t* filter, const uint64_t hash) {
+    bloom_vector_t mask;
+    bloom_mask(hash, &mask);
+    return bloom_contains_block(bloom_block(filter, hash), &mask);
+}
+
+// Insert count hashes, prefetching the blocks of the next ones
+UNUSED
+static void bloom_insert_batch(bloom_filter_t* filter, const uint64_t* hashes, const size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (i + CUTILS_BLOOM_PREFETCH_DISTANCE < count)
+            bloom_prefetch(bloom_block(filter, hashes[i + CUTILS_BLOOM_PREFETCH_DISTANCE]), 1);
+        bloom_insert(filter, hashes[i]);
+    }
+}
+
+// Probe count hashes, results[i] tells if hashes[i] may be in the filter.
+// Returns the number of positive results.
+UNUSED
+static size_t bloom_contains_batch(
+    const bloom_filter_t* filter, const uint64_t* hashes, const size_t count, bool* results
+) {
+    size_t found = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i + CUTILS_BLOOM_PREFETCH_DISTANCE < count)
+            bloom_prefetch(bloom_block(filter, hashes[i + CUTILS_BLOOM_PREFETCH_DISTANCE]), 0);
+        results[i] = bloom_contains(filter, hashes[i]);
+        found += results[i];
+    }
+    return found;
+}
+
+// Add the keys of source to filter, both must have the same number of blocks
+UNUSED NODISCARD
+static bool bloom_union(bloom_filter_t* filter, const bloom_filter_t* source) {
+    when_false_ret(filter->block_count == source->block_count, false);
+    for (uint32_t b = 0; b < filter->block_count; b++) {
+        bloom_vector_t lanes;
+        memcpy(&lanes, &source->blocks[b * BLOOM_BLOCK_LANES], sizeof(lanes));
+        bloom_insert_block(&filter->blocks[b * BLOOM_BLOCK_LANES], &lanes);
+    }
+    return true;
+}
+
+// Proportion of the bits set, the false positive rate is about this ratio
+// raised to the number of lanes
+UNUSED
+static double bloom_fill_ratio(const bloom_filter_t* filter) {
+    const uint64_t* words = (const uint64_t*)filter->blocks;
+    const size_t count = (size_t)filter->block_count * (BLOOM_BLOCK_SIZE / sizeof(uint64_t));
+    size_t set = 0;
+    for (size_t i = 0; i < count; i++)
+        set += bits_popcount(words[i]);
+    return (double)set / ((double)count * 64);
+}
+
+UNUSED
+static size_t bloom_serialized_size(const bloom_filter_t* filter) {
+    return sizeof(bloom_header_t) + (size_t)filter->block_count * BLOOM_BLOCK_SIZE;
+}
+
+UNUSED
+static bool bloom_serialize(char* buffer, const bloom_filter_t* filter) {
+    if ((intptr_t)buffer & (ALIGNOF(bloom_header_t) - 1)) return false;
+    *(bloom_header_t*)buffer = (bloom_header_t) { filter->block_count, BLOOM_BLOCK_LANES };
+    memcpy(buffer + sizeof(bloom_header_t), filter->blocks, (size_t)filter->block_count * BLOOM_BLOCK_SIZE);
+    return true;
+}
+
+NODISCARD UNUSED
+static bool bloom_deserialize(bloom_filter_t* filter, const char* buffer) {
+    if ((intptr_t)buffer & (ALIGNOF(bloom_header_t) - 1)) return false;
+    const bloom_header_t header = *(const bloom_header_t*)buffer;
+    if (header.lanes != BLOOM_BLOCK_LANES) return false;
+    bloom_free(filter);
+    if (!bloom_init(filter, header.block_count)) return false;
+    memcpy(filter->blocks, buffer + sizeof(bloom_header_t), (size_t)header.block_count * BLOOM_BLOCK_SIZE);
+    return true;
+}
+
+#endif //CUTILS_BLOOM_H
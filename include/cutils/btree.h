@@ -0,0 +1,519 @@
+#ifndef CUTILS_BTREE_H
+#define CUTILS_BTREE_H
+
+#include <cutils/allocator/allocator.h>
+#include <cutils/compatibility.h>
+#include <cutils/instrument.h>
+#include <cutils/minmax.h>
+#include <cutils/when_macros.h>
+#include <stddef.h>
+
+#ifndef CUTILS_NO_STD
+#include <string.h>
+#endif
+
+// Size in bytes targeted by a node, a multiple of the cache line size
+#ifndef CUTILS_BTREE_NODE_SIZE
+#define CUTILS_BTREE_NODE_SIZE 512
+#endif
+
+// Enough for 2^32 keys with the minimal fan-out of 4
+#define BTREE_MAX_HEIGHT 24
+
+#define EMPTY_BTREE(name) (name ## _btree_t) { .root = NULL, .first = NULL, .length = 0, .height = 0 }
+#define EMPTY_BTREE_WITH_ALLOCATOR(name, state) \
+    (name ## _btree_t) { .root = NULL, .first = NULL, .length = 0, .height = 0, .allocator = (state) }
+
+#define btree_iterator_valid(it) ((it).leaf != NULL)
+#define btree_iterator_key(it) (&(it).leaf->keys[(it).index])
+#define btree_iterator_value(it) (&(it).leaf->values[(it).index])
+
+typedef struct {
+    unsigned short count;
+    unsigned short leaf;
+} btree_node_t;
+
+typedef struct {
+    btree_node_t* node;
+    unsigned child;
+} btree_path_t;
+
+/*
+ * B+tree map from key_type to value_type ordered by
+ * cmp(const key_type* a, const key_type* b) (negative, zero or positive like
+ * strcmp). Leaves are linked for range scans. Nodes are sized after
+ * CUTILS_BTREE_NODE_SIZE and come from the allocator binding (see
+ * allocator.h). Erasing frees the nodes once they are empty rather than
+ * merging siblings.
+ */
+#define DEFINE_BTREE_TYPE(name, key_type, value_type, cmp)                      \
+    DEFINE_BTREE_TYPE_WITH_ALLOCATOR(name, key_type, value_type, cmp, heap)
+
+#define DEFINE_BTREE_TYPE_WITH_ALLOCATOR(name, key_type, value_type, cmp, binding) \
+    DEFINE_INTERFACE_BTREE_TYPE_WITH_ALLOCATOR(name, key_type, value_type, binding) \
+    DEFINE_IMPLEMENTATION_BTREE_TYPE_WITH_ALLOCATOR(name, key_type, value_type, cmp, binding)
+
+#define DEFINE_INTERFACE_BTREE_TYPE_WITH_ALLOCATOR(name, key_type, value_type, binding) \
+    enum {                                                                      \
+        name ## _btree_leaf_capacity = MAX(4, (CUTILS_BTREE_NODE_SIZE - sizeof(btree_node_t) \
+            - 2 * sizeof(void*)) / (sizeof(key_type) + sizeof(value_type))),    \
+        name ## _btree_inner_capacity = MAX(4, (CUTILS_BTREE_NODE_SIZE - sizeof(btree_node_t) \
+            - sizeof(void*)) / (sizeof(key_type) + sizeof(void*))),             \
+    };                                                                          \
+                                                                                \
+    typedef struct name ## _btree_leaf name ## _btree_leaf_t;                   \
+    struct name ## _btree_leaf {                                                \
+        btree_node_t header;                                                    \
+        key_type keys[name ## _btree_leaf_capacity];                            \
+        name ## _btree_leaf_t* prev;                                            \
+        name ## _btree_leaf_t* next;                                            \
+        value_type values[name ## _btree_leaf_capacity];                        \
+    };                                                                          \
+                                                                                \
+    typedef struct {                                                            \
+        btree_node_t header;                                                    \
+        key_type keys[name ## _btree_inner_capacity];                           \
+        btree_node_t* children[name ## _btree_inner_capacity + 1];              \
+    } name ## _btree_inner_t;                                                   \
+                                                                                \
+    typedef struct {                                                            \
+        btree_node_t* root;                                                     \
+        name ## _btree_leaf_t* first;                                           \
+        unsigned length;                                                        \
+        unsigned height;                                                        \
+        binding ## _binding_member                                              \
+    } name ## _btree_t;                                                         \
+                                                                                \
+    typedef struct {                                                            \
+        name ## _btree_leaf_t* leaf;                                            \
+        unsigned index;                                                         \
+    } name ## _btree_iterator_t;
+
+#define DEFINE_IMPLEMENTATION_BTREE_TYPE_WITH_ALLOCATOR(name, key_type, value_type, cmp, binding) \
+    INSTRUMENT_DEFINE(btree, name)                                              \
+                                                                                \
+    /* Branchless binary searches, the comparisons of a node are unpredictable */ \
+    UNUSED static unsigned btree_leaf_lower_bound_ ## name(                     \
+        const name ## _btree_leaf_t* leaf, const key_type* key                  \
+    ) {                                                                         \
+        const key_type* base = leaf->keys;                                      \
+        unsigned n = leaf->header.count;                                        \
+        if (n == 0)                                                             \
+            return 0;                                                           \
+        while (n > 1) {                                                         \
+            const unsigned half = n / 2;                                        \
+            base = cmp(&base[half - 1], key) < 0 ? base + half : base;          \
+            n -= half;                                                          \
+        }                                                                       \
+        return (unsigned)(base - leaf->keys) + (cmp(base, key) < 0);            \
+    }                                                                           \
+                                                                                \
+    /* Index of the child which may hold key */                                 \
+    UNUSED static unsigned btree_inner_child_ ## name(                          \
+        const name ## _btree_inner_t* inner, const key_type* key                \
+    ) {                                                                         \
+        const key_type* base = inner->keys;                                     \
+        unsigned n = inner->header.count;                                       \
+        if (n == 0)                                                             \
+            return 0;                                                           \
+        while (n > 1) {                                                         \
+            const unsigned half = n / 2;                                        \
+            base = cmp(key, &base[half - 1]) < 0 ? base : base + half;          \
+            n -= half;                                                          \
+        }                                                                       \
+        return (unsigned)(base - inner->keys) + (cmp(key, base) >= 0);          \
+    }                                                                           \
+                                                                                \
+    UNUSED static name ## _btree_leaf_t* btree_find_leaf_ ## name(              \
+        const name ## _btree_t* tree, const key_type* key,                      \
+        btree_path_t* path                                                      \
+    ) {                                                                         \
+        btree_node_t* node = tree->root;                                        \
+        unsigned depth = 0;                                                     \
+        while (!node->leaf) {                                                   \
+            const name ## _btree_inner_t* inner = (name ## _btree_inner_t*)node; \
+            const unsigned child = btree_inner_child_ ## name(inner, key);      \
+            if (path != NULL)                                                   \
+                path[depth++] = (btree_path_t) { node, child };                 \
+            node = inner->children[child];                                      \
+        }                                                                       \
+        return (name ## _btree_leaf_t*)node;                                    \
+    }                                                                           \
+                                                                                \
+    UNUSED static value_type* btree_find_ ## name(                              \
+        const name ## _btree_t* tree, const key_type* key                       \
+    ) {                                                                         \
+        if (tree->root == NULL)                                                 \
+            return NULL;                                                        \
+        name ## _btree_leaf_t* leaf = btree_find_leaf_ ## name(tree, key, NULL); \
+        const unsigned pos = btree_leaf_lower_bound_ ## name(leaf, key);        \
+        if (pos == leaf->header.count || cmp(&leaf->keys[pos], key) != 0)       \
+            return NULL;                                                        \
+        return &leaf->values[pos];                                              \
+    }                                                                           \
+                                                                                \
+    /* First element whose key is not lower than key */                         \
+    UNUSED static name ## _btree_iterator_t btree_lower_bound_ ## name(         \
+        const name ## _btree_t* tree, const key_type* key                       \
+    ) {                                                                         \
+        if (tree->root == NULL)                                                 \
+            return (name ## _btree_iterator_t) { NULL, 0 };                     \
+        name ## _btree_leaf_t* leaf = btree_find_leaf_ ## name(tree, key, NULL); \
+        const unsigned pos = btree_leaf_lower_bound_ ## name(leaf, key);        \
+        if (pos == leaf->header.count)                                          \
+            return (name ## _btree_iterator_t) { leaf->next, 0 };               \
+        return (name ## _btree_iterator_t) { leaf, pos };                       \
+    }                                                                           \
+                                                                                \
+    UNUSED static name ## _btree_iterator_t btree_begin_ ## name(               \
+        const name ## _btree_t* tree                                            \
+    ) {                                                                         \
+        return (name ## _btree_iterator_t) { tree->first, 0 };                  \
+    }                                                                           \
+                                                                                \
+    UNUSED static void btree_next_ ## name(name ## _btree_iterator_t* it) {     \
+        if (++it->index == it->leaf->header.count) {                            \
+            it->leaf = it->leaf->next;                                          \
+            it->index = 0;                                                      \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    UNUSED static name ## _btree_leaf_t* btree_leaf_allocate_ ## name(          \
+        name ## _btree_t* tree                                                  \
+    ) {                                                                         \
+        (void)tree;                                                             \
+        name ## _btree_leaf_t* leaf = binding ## _binding_alloc(                \
+            binding ## _binding_state(tree), sizeof(name ## _btree_leaf_t));    \
+        when_null_ret(leaf, NULL);                                              \
+        leaf->header = (btree_node_t) { .count = 0, .leaf = 1 };                \
+        leaf->prev = NULL;                                                      \
+        leaf->next = NULL;                                                      \
+        return leaf;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static name ## _btree_inner_t* btree_inner_allocate_ ## name(        \
+        name ## _btree_t* tree                                                  \
+    ) {                                                                         \
+        (void)tree;                                                             \
+        name ## _btree_inner_t* inner = binding ## _binding_alloc(              \
+            binding ## _binding_state(tree), sizeof(name ## _btree_inner_t));   \
+        when_null_ret(inner, NULL);                                             \
+        inner->header = (btree_node_t) { .count = 0, .leaf = 0 };               \
+        return inner;                                                           \
+    }                                                                           \
+                                                                                \
+    UNUSED static void btree_node_free_ ## name(                                \
+        name ## _btree_t* tree, btree_node_t* node                              \
+    ) {                                                                         \
+        (void)tree;                                                             \
+        binding ## _binding_dealloc(binding ## _binding_state(tree), node,      \
+            node->leaf ? sizeof(name ## _btree_leaf_t) : sizeof(name ## _btree_inner_t)); \
+    }                                                                           \
+                                                                                \
+    UNUSED static void btree_subtree_free_ ## name(                             \
+        name ## _btree_t* tree, btree_node_t* node                              \
+    ) {                                                                         \
+        if (!node->leaf) {                                                      \
+            name ## _btree_inner_t* inner = (name ## _btree_inner_t*)node;      \
+            for (unsigned i = 0; i <= inner->header.count; i++)                 \
+                btree_subtree_free_ ## name(tree, inner->children[i]);          \
+        }                                                                       \
+        btree_node_free_ ## name(tree, node);                                   \
+    }                                                                           \
+                                                                                \
+    UNUSED static void btree_free_ ## name(name ## _btree_t* tree) {            \
+        if (tree->root != NULL)                                                 \
+            btree_subtree_free_ ## name(tree, tree->root);                      \
+        tree->root = NULL;                                                      \
+        tree->first = NULL;                                                     \
+        tree->length = 0;                                                       \
+        tree->height = 0;                                                       \
+    }                                                                           \
+                                                                                \
+    /* Insert or assign, returns the stored value (NULL if allocation failed) */ \
+    UNUSED NODISCARD static value_type* btree_insert_ ## name(                  \
+        name ## _btree_t* tree, const key_type* key, const value_type* value    \
+    ) {                                                                         \
+        enum {                                                                  \
+            L = name ## _btree_leaf_capacity,                                   \
+            I = name ## _btree_inner_capacity                                   \
+        };                                                                      \
+        if (tree->root == NULL) {                                               \
+            name ## _btree_leaf_t* leaf = btree_leaf_allocate_ ## name(tree);   \
+            when_null_ret(leaf, NULL);                                          \
+            tree->root = &leaf->header;                                         \
+            tree->first = leaf;                                                 \
+            tree->height = 1;                                                   \
+        }                                                                       \
+        btree_path_t path[BTREE_MAX_HEIGHT];                                    \
+        name ## _btree_leaf_t* leaf = btree_find_leaf_ ## name(tree, key, path); \
+        unsigned pos = btree_leaf_lower_bound_ ## name(leaf, key);              \
+        if (pos < leaf->header.count && cmp(&leaf->keys[pos], key) == 0) {      \
+            leaf->values[pos] = *value;                                         \
+            return &leaf->values[pos];                                          \
+        }                                                                       \
+        if (leaf->header.count < L) {                                           \
+            memmove(&leaf->keys[pos + 1], &leaf->keys[pos],                     \
+                (leaf->header.count - pos) * sizeof(key_type));                 \
+            memmove(&leaf->values[pos + 1], &leaf->values[pos],                 \
+                (leaf->header.count - pos) * sizeof(value_type));               \
+            INSTRUMENT(btree, name, INSTRUMENT_BYTES_MOVED, (leaf->header.count - pos) \
+                * (sizeof(key_type) + sizeof(value_type)));                     \
+            leaf->keys[pos] = *key;                                             \
+            leaf->values[pos] = *value;                                         \
+            leaf->header.count += 1;                                            \
+            tree->length += 1;                                                  \
+            return &leaf->values[pos];                                          \
+        }                                                                       \
+        /* Allocate every node the splits need before modifying the tree */     \
+        unsigned depth = tree->height - 1, splits = 0;                          \
+        while (splits < depth && path[depth - 1 - splits].node->count == I)     \
+            splits++;                                                           \
+        const unsigned needed = 1 + splits + (splits == depth);                 \
+        btree_node_t* nodes[BTREE_MAX_HEIGHT + 1];                              \
+        for (unsigned i = 0; i < needed; i++) {                                 \
+            nodes[i] = i == 0                                                   \
+                ? (btree_node_t*)btree_leaf_allocate_ ## name(tree)             \
+                : (btree_node_t*)btree_inner_allocate_ ## name(tree);           \
+            if (nodes[i] == NULL) {                                             \
+                while (i-- > 0)                                                 \
+                    btree_node_free_ ## name(tree, nodes[i]);                   \
+                return NULL;                                                    \
+            }                                                                   \
+        }                                                                       \
+        /* Split the leaf */                                                    \
+        name ## _btree_leaf_t* right = (name ## _btree_leaf_t*)nodes[0];        \
+        const unsigned half = (L + 1) / 2;                                      \
+        right->header.count = L - half;                                         \
+        memcpy(right->keys, &leaf->keys[half], (L - half) * sizeof(key_type));  \
+        memcpy(right->values, &leaf->values[half], (L - half) * sizeof(value_type)); \
+        INSTRUMENT(btree, name, INSTRUMENT_BYTES_MOVED,                         \
+            (L - half) * (sizeof(key_type) + sizeof(value_type)));              \
+        leaf->header.count = half;                                              \
+        right->next = leaf->next;                                               \
+        right->prev = leaf;                                                     \
+        if (leaf->next != NULL)                                                 \
+            leaf->next->prev = right;                                           \
+        leaf->next = right;                                                     \
+        name ## _btree_leaf_t* target = leaf;                                   \
+        if (pos > half || (pos == half && cmp(key, &right->keys[0]) > 0)) {     \
+            target = right;                                                     \
+            pos -= half;                                                        \
+        }                                                                       \
+        memmove(&target->keys[pos + 1], &target->keys[pos],                     \
+            (target->header.count - pos) * sizeof(key_type));                   \
+        memmove(&target->values[pos + 1], &target->values[pos],                 \
+            (target->header.count - pos) * sizeof(value_type));                 \
+        INSTRUMENT(btree, name, INSTRUMENT_BYTES_MOVED, (target->header.count - pos) \
+            * (sizeof(key_type) + sizeof(value_type)));                         \
+        target->keys[pos] = *key;                                               \
+        target->values[pos] = *value;                                           \
+        target->header.count += 1;                                              \
+        tree->length += 1;                                                      \
+        value_type* ret = &target->values[pos];                                 \
+        /* Insert the separators in the ancestors */                            \
+        key_type separator = right->keys[0];                                    \
+        btree_node_t* child = &right->header;                                   \
+        unsigned used = 1;                                                      \
+        for (;;) {                                                              \
+            if (depth == 0) {                                                   \
+                name ## _btree_inner_t* root = (name ## _btree_inner_t*)nodes[used++]; \
+                root->header.count = 1;                                         \
+                root->keys[0] = separator;                                      \
+                root->children[0] = tree->root;                                 \
+                root->children[1] = child;                                      \
+                tree->root = &root->header;                                     \
+                tree->height += 1;                                              \
+                break;                                                          \
+            }                                                                   \
+            depth--;                                                            \
+            name ## _btree_inner_t* parent = (name ## _btree_inner_t*)path[depth].node; \
+            const unsigned c = path[depth].child;                               \
+            const unsigned count = parent->header.count;                        \
+            if (count < I) {                                                    \
+                memmove(&parent->keys[c + 1], &parent->keys[c],                 \
+                    (count - c) * sizeof(key_type));                            \
+                memmove(&parent->children[c + 2], &parent->children[c + 1],     \
+                    (count - c) * sizeof(btree_node_t*));                       \
+                parent->keys[c] = separator;                                    \
+                parent->children[c + 1] = child;                                \
+                parent->header.count += 1;                                      \
+                break;                                                          \
+            }                                                                   \
+            key_type keys[I + 1];                                               \
+            btree_node_t* children[I + 2];                                      \
+            memcpy(keys, parent->keys, c * sizeof(key_type));                   \
+            keys[c] = separator;                                                \
+            memcpy(&keys[c + 1], &parent->keys[c], (I - c) * sizeof(key_type)); \
+            memcpy(children, parent->children, (c + 1) * sizeof(btree_node_t*)); \
+            children[c + 1] = child;                                            \
+            memcpy(&children[c + 2], &parent->children[c + 1],                  \
+                (I - c) * sizeof(btree_node_t*));                               \
+            const unsigned mid = (I + 1) / 2;                                   \
+            name ## _btree_inner_t* sibling = (name ## _btree_inner_t*)nodes[used++]; \
+            parent->header.count = mid;                                         \
+            memcpy(parent->keys, keys, mid * sizeof(key_type));                 \
+            memcpy(parent->children, children, (mid + 1) * sizeof(btree_node_t*)); \
+            sibling->header.count = I - mid;                                    \
+            memcpy(sibling->keys, &keys[mid + 1], (I - mid) * sizeof(key_type)); \
+            memcpy(sibling->children, &children[mid + 1],                       \
+                (I - mid + 1) * sizeof(btree_node_t*));                         \
+            separator = keys[mid];                                              \
+            child = &sibling->header;                                           \
+        }                                                                       \
+        return ret;                                                             \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool btree_erase_ ## name(                                    \
+        name ## _btree_t* tree, const key_type* key, value_type* value          \
+    ) {                                                                         \
+        if (tree->root == NULL)                                                 \
+            return false;                                                       \
+        btree_path_t path[BTREE_MAX_HEIGHT];                                    \
+        name ## _btree_leaf_t* leaf = btree_find_leaf_ ## name(tree, key, path); \
+        const unsigned pos = btree_leaf_lower_bound_ ## name(leaf, key);        \
+        if (pos == leaf->header.count || cmp(&leaf->keys[pos], key) != 0)       \
+            return false;                                                       \
+        if (value != NULL)                                                      \
+            *value = leaf->values[pos];                                         \
+        leaf->header.count -= 1;                                                \
+        memmove(&leaf->keys[pos], &leaf->keys[pos + 1],                         \
+            (leaf->header.count - pos) * sizeof(key_type));                     \
+        memmove(&leaf->values[pos], &leaf->values[pos + 1],                     \
+            (leaf->header.count - pos) * sizeof(value_type));                   \
+        INSTRUMENT(btree, name, INSTRUMENT_BYTES_MOVED, (leaf->header.count - pos) \
+            * (sizeof(key_type) + sizeof(value_type)));                         \
+        tree->length -= 1;                                                      \
+        if (leaf->header.count != 0)                                            \
+            return true;                                                        \
+        /* Unlink the empty leaf then remove the empty ancestors */             \
+        if (leaf->prev != NULL)                                                 \
+            leaf->prev->next = leaf->next;                                      \
+        else                                                                    \
+            tree->first = leaf->next;                                           \
+        if (leaf->next != NULL)                                                 \
+            leaf->next->prev = leaf->prev;                                      \
+        btree_node_t* empty = &leaf->header;                                    \
+        unsigned depth = tree->height - 1;                                      \
+        while (depth > 0) {                                                     \
+            depth--;                                                            \
+            btree_node_free_ ## name(tree, empty);                              \
+            name ## _btree_inner_t* parent = (name ## _btree_inner_t*)path[depth].node; \
+            const unsigned c = path[depth].child;                               \
+            const unsigned count = parent->header.count;                        \
+            if (count == 0) {                                                   \
+                empty = &parent->header;                                        \
+                continue;                                                       \
+            }                                                                   \
+            const unsigned k = c == 0 ? 0 : c - 1;                              \
+            memmove(&parent->keys[k], &parent->keys[k + 1],                     \
+                (count - 1 - k) * sizeof(key_type));                            \
+            memmove(&parent->children[c], &parent->children[c + 1],             \
+                (count - c) * sizeof(btree_node_t*));                           \
+            parent->header.count -= 1;                                          \
+            empty = NULL;                                                       \
+            break;                                                              \
+        }                                                                       \
+        if (empty != NULL) {                                                    \
+            /* The whole tree is empty */                                       \
+            btree_node_free_ ## name(tree, empty);                              \
+            tree->root = NULL;                                                  \
+            tree->first = NULL;                                                 \
+            tree->height = 0;                                                   \
+            return true;                                                        \
+        }                                                                       \
+        /* Collapse the roots with a single child */                            \
+        while (!tree->root->leaf && tree->root->count == 0) {                   \
+            btree_node_t* root = tree->root;                                    \
+            tree->root = ((name ## _btree_inner_t*)root)->children[0];          \
+            tree->height -= 1;                                                  \
+            btree_node_free_ ## name(tree, root);                               \
+        }                                                                       \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    /* Build the tree from count keys sorted in strictly increasing order */    \
+    UNUSED NODISCARD static bool btree_bulk_load_ ## name(                      \
+        name ## _btree_t* tree, const key_type* keys, const value_type* values, \
+        unsigned count                                                          \
+    ) {                                                                         \
+        enum {                                                                  \
+            L = name ## _btree_leaf_capacity,                                   \
+            I = name ## _btree_inner_capacity                                   \
+        };                                                                      \
+        btree_free_ ## name(tree);                                              \
+        if (count == 0)                                                         \
+            return true;                                                        \
+        unsigned width = (count + L - 1) / L;                                   \
+        btree_node_t** level = CUTILS_alloc(width * sizeof(btree_node_t*));     \
+        key_type* lows = CUTILS_alloc(width * sizeof(key_type));                \
+        if (level == NULL || lows == NULL) {                                    \
+            CUTILS_dealloc(level);                                              \
+            CUTILS_dealloc(lows);                                               \
+            return false;                                                       \
+        }                                                                       \
+        name ## _btree_leaf_t* previous = NULL;                                 \
+        for (unsigned i = 0; i < width; i++) {                                  \
+            name ## _btree_leaf_t* leaf = btree_leaf_allocate_ ## name(tree);   \
+            if (leaf == NULL) {                                                 \
+                btree_free_ ## name(tree);                                      \
+                for (name ## _btree_leaf_t* l = previous; l != NULL;) {         \
+                    name ## _btree_leaf_t* prev = l->prev;                      \
+                    btree_node_free_ ## name(tree, &l->header);                 \
+                    l = prev;                                                   \
+                }                                                               \
+                CUTILS_dealloc(level);                                          \
+                CUTILS_dealloc(lows);                                           \
+                return false;                                                   \
+            }                                                                   \
+            const unsigned first = i * L;                                       \
+            const unsigned n = MIN((unsigned)L, count - first);                 \
+            memcpy(leaf->keys, &keys[first], n * sizeof(key_type));             \
+            memcpy(leaf->values, &values[first], n * sizeof(value_type));       \
+            leaf->header.count = n;                                             \
+            leaf->prev = previous;                                              \
+            if (previous != NULL)                                               \
+                previous->next = leaf;                                          \
+            else                                                                \
+                tree->first = leaf;                                             \
+            previous = leaf;                                                    \
+            level[i] = &leaf->header;                                           \
+            lows[i] = keys[first];                                              \
+        }                                                                       \
+        tree->height = 1;                                                       \
+        while (width > 1) {                                                     \
+            const unsigned parents = (width + I) / (I + 1);                     \
+            for (unsigned i = 0; i < parents; i++) {                            \
+                name ## _btree_inner_t* inner = btree_inner_allocate_ ## name(tree); \
+                if (inner == NULL) {                                            \
+                    for (unsigned j = 0; j < i; j++)                            \
+                        btree_subtree_free_ ## name(tree, level[j]);            \
+                    for (unsigned j = i * (I + 1); j < width; j++)              \
+                        btree_subtree_free_ ## name(tree, level[j]);            \
+                    CUTILS_dealloc(level);                                      \
+                    CUTILS_dealloc(lows);                                       \
+                    tree->root = NULL;                                          \
+                    tree->first = NULL;                                         \
+                    tree->height = 0;                                           \
+                    return false;                                               \
+                }                                                               \
+                const unsigned first = i * (I + 1);                             \
+                const unsigned n = MIN((unsigned)I + 1, width - first);         \
+                inner->header.count = n - 1;                                    \
+                memcpy(inner->children, &level[first], n * sizeof(btree_node_t*)); \
+                memcpy(inner->keys, &lows[first + 1], (n - 1) * sizeof(key_type)); \
+                /* Slots below i were consumed, reuse them for the next level */ \
+                level[i] = &inner->header;                                      \
+                lows[i] = lows[first];                                          \
+            }                                                                   \
+            width = parents;                                                    \
+            tree->height += 1;                                                  \
+        }                                                                       \
+        tree->root = level[0];                                                  \
+        tree->length = count;                                                   \
+        CUTILS_dealloc(level);                                                  \
+        CUTILS_dealloc(lows);                                                   \
+        return true;                                                            \
+    }
+
+#endif //CUTILS_BTREE_H
@@ -6,6 +6,7 @@
 #include <stddef.h>
 #define CONSTEXPR const
 #define ALIGNOF _Alignof
+#define THREAD_LOCAL _Thread_local
 #ifdef __GNUC__
 #define UNUSED __attribute__((unused))
 #else
@@ -19,8 +20,18 @@
 #endif
 #define CONSTEXPR constexpr
 #define ALIGNOF alignof
+#define THREAD_LOCAL thread_local
 #define UNUSED [[maybe_unused]]
 #define NODISCARD [[nodiscard]]
 #endif
 
+// Keeps a cold path out of its callers
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE
+#endif
+
 #endif //CUTILS_COMPATIBILITY_H
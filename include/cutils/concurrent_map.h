@@ -0,0 +1,330 @@
+#ifndef CUTILS_CONCURRENT_MAP_H
+#define CUTILS_CONCURRENT_MAP_H
+
+#include <cutils/allocator/alloc.h>
+#include <cutils/allocator/allocator.h>
+#include <cutils/compatibility.h>
+#include <cutils/errors.h>
+#include <cutils/hash.h>
+#include <cutils/instrument.h>
+#include <cutils/string.h>
+#include <cutils/when_macros.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Hash map from string_view_t keys to value_type shared by several threads.
+ * The keys are split over a power of two number of shards by the high bits
+ * of their hash, each shard being an open addressing table (linear probing,
+ * backward shift erase) behind its own reader-writer lock and on its own
+ * cache lines. Lookups of different shards never contend, lookups of the
+ * same shard share its lock, and a shard grows under its write lock without
+ * blocking the other shards. The map copies the keys it stores, the values
+ * are copied in and out under the lock.
+ *
+ * The reader-writer locks come from POSIX threads, in the strict ISO modes
+ * (-std=c11) glibc only declares them when _POSIX_C_SOURCE >= 200112L or
+ * _DEFAULT_SOURCE is defined before the first include.
+ */
+
+#ifndef CONCURRENT_MAP_DEFAULT_SHARDS
+#define CONCURRENT_MAP_DEFAULT_SHARDS 64
+#endif
+
+#ifndef CONCURRENT_MAP_MIN_CAPACITY
+#define CONCURRENT_MAP_MIN_CAPACITY 16
+#endif
+
+// Shards are aligned on this size so two of them never share a cache line
+#define CONCURRENT_MAP_SHARD_ALIGN 128
+
+#define concurrent_map_shard(map, index) \
+    ((void*)((map)->shards + (size_t)(index) * (map)->shard_stride))
+
+#define DEFINE_CONCURRENT_MAP_TYPE(name, value_type)                            \
+    DEFINE_INTERFACE_CONCURRENT_MAP_TYPE(name, value_type)                      \
+    DEFINE_IMPLEMENTATION_CONCURRENT_MAP_TYPE(name, value_type)
+
+#define DEFINE_INTERFACE_CONCURRENT_MAP_TYPE(name, value_type)                  \
+    typedef struct {                                                            \
+        uint64_t hash;                                                          \
+        /* Owned copy of the key, NULL str for an empty slot */                 \
+        string_view_t key;                                                      \
+        value_type value;                                                       \
+    } name ## _concurrent_map_entry_t;                                          \
+                                                                                \
+    typedef struct {                                                            \
+        pthread_rwlock_t lock;                                                  \
+        name ## _concurrent_map_entry_t* entries;                               \
+        size_t capacity;                                                        \
+        size_t count;                                                           \
+    } name ## _concurrent_map_shard_t;                                          \
+                                                                                \
+    typedef struct {                                                            \
+        char* shards;                                                           \
+        void* memory;                                                           \
+        size_t shard_stride;                                                    \
+        unsigned shard_count;                                                   \
+        unsigned shard_shift;                                                   \
+        uint64_t seed;                                                          \
+    } name ## _concurrent_map_t;
+
+#define DEFINE_IMPLEMENTATION_CONCURRENT_MAP_TYPE(name, value_type)             \
+    INSTRUMENT_DEFINE(concurrent_map, name)                                     \
+                                                                                \
+    /* shard_count is rounded up to a power of two, 0 selects                   \
+       CONCURRENT_MAP_DEFAULT_SHARDS */                                         \
+    UNUSED NODISCARD static bool concurrent_map_init_ ## name(                  \
+        name ## _concurrent_map_t* map, unsigned shard_count, uint64_t seed     \
+    ) {                                                                         \
+        if (shard_count == 0)                                                   \
+            shard_count = CONCURRENT_MAP_DEFAULT_SHARDS;                        \
+        when_false_ret(shard_count <= (1u << 16), false);                       \
+        unsigned bits = 0;                                                      \
+        while ((1u << bits) < shard_count)                                      \
+            bits++;                                                             \
+        map->shard_count = 1u << bits;                                          \
+        map->shard_shift = 64 - bits;                                           \
+        map->seed = seed;                                                       \
+        map->shard_stride = CUTILS_NEXT_ALLOC_ALIGNED(sizeof(name ## _concurrent_map_shard_t), \
+            (size_t)CONCURRENT_MAP_SHARD_ALIGN);                                \
+        map->memory = CUTILS_alloc(map->shard_count * map->shard_stride         \
+            + CONCURRENT_MAP_SHARD_ALIGN - 1);                                  \
+        when_null_ret(map->memory, false);                                      \
+        map->shards = (char*)CUTILS_NEXT_ALLOC_ALIGNED((uintptr_t)map->memory,  \
+            (uintptr_t)CONCURRENT_MAP_SHARD_ALIGN);                             \
+        for (unsigned i = 0; i < map->shard_count; i++) {                       \
+            name ## _concurrent_map_shard_t* shard = concurrent_map_shard(map, i); \
+            shard->entries = NULL;                                              \
+            shard->capacity = 0;                                                \
+            shard->count = 0;                                                   \
+            if (pthread_rwlock_init(&shard->lock, NULL) != 0) {                 \
+                while (i-- > 0)                                                 \
+                    pthread_rwlock_destroy(                                     \
+                        &((name ## _concurrent_map_shard_t*)concurrent_map_shard(map, i))->lock); \
+                CUTILS_dealloc(map->memory);                                    \
+                map->memory = NULL;                                             \
+                return false;                                                   \
+            }                                                                   \
+        }                                                                       \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    /* The map must not be used by other threads anymore */                     \
+    UNUSED static void concurrent_map_free_ ## name(name ## _concurrent_map_t* map) { \
+        for (unsigned i = 0; i < map->shard_count && map->memory != NULL; i++) { \
+            name ## _concurrent_map_shard_t* shard = concurrent_map_shard(map, i); \
+            for (size_t e = 0; e < shard->capacity; e++)                        \
+                CUTILS_dealloc(shard->entries[e].key.str);                      \
+            CUTILS_dealloc(shard->entries);                                     \
+            pthread_rwlock_destroy(&shard->lock);                               \
+        }                                                                       \
+        CUTILS_dealloc(map->memory);                                            \
+        map->memory = NULL;                                                     \
+        map->shards = NULL;                                                     \
+        map->shard_count = 0;                                                   \
+    }                                                                           \
+                                                                                \
+    UNUSED static name ## _concurrent_map_shard_t* concurrent_map_find_shard_ ## name( \
+        const name ## _concurrent_map_t* map, uint64_t hash                     \
+    ) {                                                                         \
+        /* A shift by 64 is undefined, a single shard takes index 0 */          \
+        const unsigned index = map->shard_count == 1 ? 0 : (unsigned)(hash >> map->shard_shift); \
+        return concurrent_map_shard(map, index);                                \
+    }                                                                           \
+                                                                                \
+    /* Slot of key in the shard, or of the empty slot ending its probe          \
+       sequence. The shard must have a capacity. */                             \
+    UNUSED static size_t concurrent_map_probe_ ## name(                         \
+        const name ## _concurrent_map_shard_t* shard, uint64_t hash, string_view_t key \
+    ) {                                                                         \
+        const size_t mask = shard->capacity - 1;                                \
+        size_t i = hash & mask;                                                 \
+        for (;; i = (i + 1) & mask) {                                           \
+            const name ## _concurrent_map_entry_t* entry = &shard->entries[i];  \
+            if (entry->key.str == NULL)                                         \
+                break;                                                          \
+            if (entry->hash == hash && entry->key.len == key.len                \
+                && memcmp(entry->key.str, key.str, key.len) == 0)               \
+                break;                                                          \
+        }                                                                       \
+        if (i != (hash & mask))                                                 \
+            INSTRUMENT(concurrent_map, name, INSTRUMENT_PROBE, (i - hash) & mask); \
+        return i;                                                               \
+    }                                                                           \
+                                                                                \
+    /* Make room for one more key, load factor at most 3/4 */                   \
+    UNUSED NODISCARD static bool concurrent_map_reserve_ ## name(               \
+        name ## _concurrent_map_shard_t* shard                                  \
+    ) {                                                                         \
+        if ((shard->count + 1) * 4 <= shard->capacity * 3)                      \
+            return true;                                                        \
+        const size_t capacity = shard->capacity == 0                            \
+            ? CONCURRENT_MAP_MIN_CAPACITY : shard->capacity * 2;                \
+        name ## _concurrent_map_entry_t* entries = CUTILS_alloc(                \
+            capacity * sizeof(name ## _concurrent_map_entry_t));                \
+        when_null_ret(entries, false);                                          \
+        if (shard->capacity != 0) {                                             \
+            INSTRUMENT(concurrent_map, name, INSTRUMENT_REALLOCATION, 1);       \
+            INSTRUMENT(concurrent_map, name, INSTRUMENT_BYTES_MOVED,            \
+                shard->count * sizeof(name ## _concurrent_map_entry_t));        \
+        }                                                                       \
+        INSTRUMENT(concurrent_map, name, INSTRUMENT_CAPACITY, capacity);        \
+        for (size_t i = 0; i < capacity; i++)                                   \
+            entries[i].key.str = NULL;                                          \
+        /* The hashes are stored, the keys are not read again */                \
+        for (size_t i = 0; i < shard->capacity; i++) {                          \
+            const name ## _concurrent_map_entry_t* entry = &shard->entries[i];  \
+            if (entry->key.str == NULL)                                         \
+                continue;                                                       \
+            size_t slot = entry->hash & (capacity - 1);                         \
+            while (entries[slot].key.str != NULL)                               \
+                slot = (slot + 1) & (capacity - 1);                             \
+            entries[slot] = *entry;                                             \
+        }                                                                       \
+        CUTILS_dealloc(shard->entries);                                         \
+        shard->entries = entries;                                               \
+        shard->capacity = capacity;                                             \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    /* Slot of key in the write-locked shard, inserted if absent (the value     \
+       is then uninitialized). Returns -ERROR_NO_ERROR for a new key,           \
+       -ERROR_KEY_ALREADY_EXISTS or -ERROR_ALLOCATION_FAILED. */                \
+    UNUSED static int concurrent_map_emplace_ ## name(                          \
+        name ## _concurrent_map_shard_t* shard, uint64_t hash, string_view_t key, size_t* slot \
+    ) {                                                                         \
+        if (shard->capacity != 0) {                                             \
+            *slot = concurrent_map_probe_ ## name(shard, hash, key);            \
+            if (shard->entries[*slot].key.str != NULL)                          \
+                return -ERROR_KEY_ALREADY_EXISTS;                               \
+        }                                                                       \
+        char* copy = CUTILS_alloc(key.len + 1);                                 \
+        if (copy == NULL || !concurrent_map_reserve_ ## name(shard)) {          \
+            CUTILS_dealloc(copy);                                               \
+            return -ERROR_ALLOCATION_FAILED;                                    \
+        }                                                                       \
+        memcpy(copy, key.str, key.len);                                         \
+        copy[key.len] = '\0';                                                   \
+        *slot = concurrent_map_probe_ ## name(shard, hash, key);                \
+        shard->entries[*slot].hash = hash;                                      \
+        shard->entries[*slot].key = (string_view_t) { .str = copy, .len = key.len }; \
+        shard->count += 1;                                                      \
+        return -ERROR_NO_ERROR;                                                 \
+    }                                                                           \
+                                                                                \
+    /* Copy the value of key in value (if not NULL), false if it is absent */   \
+    UNUSED static bool concurrent_map_find_ ## name(                            \
+        name ## _concurrent_map_t* map, string_view_t key, value_type* value    \
+    ) {                                                                         \
+        const uint64_t hash = hash_string_view(key, map->seed);                 \
+        name ## _concurrent_map_shard_t* shard = concurrent_map_find_shard_ ## name(map, hash); \
+        pthread_rwlock_rdlock(&shard->lock);                                    \
+        bool found = false;                                                     \
+        if (shard->capacity != 0) {                                             \
+            const size_t slot = concurrent_map_probe_ ## name(shard, hash, key); \
+            found = shard->entries[slot].key.str != NULL;                       \
+            if (found && value != NULL)                                         \
+                *value = shard->entries[slot].value;                            \
+        }                                                                       \
+        pthread_rwlock_unlock(&shard->lock);                                    \
+        return found;                                                           \
+    }                                                                           \
+                                                                                \
+    /* Insert key if it is absent, -ERROR_KEY_ALREADY_EXISTS otherwise */       \
+    UNUSED NODISCARD static int concurrent_map_insert_ ## name(                 \
+        name ## _concurrent_map_t* map, string_view_t key, const value_type* value \
+    ) {                                                                         \
+        const uint64_t hash = hash_string_view(key, map->seed);                 \
+        name ## _concurrent_map_shard_t* shard = concurrent_map_find_shard_ ## name(map, hash); \
+        pthread_rwlock_wrlock(&shard->lock);                                    \
+        size_t slot;                                                            \
+        const int ret = concurrent_map_emplace_ ## name(shard, hash, key, &slot); \
+        if (ret == -ERROR_NO_ERROR)                                             \
+            shard->entries[slot].value = *value;                                \
+        pthread_rwlock_unlock(&shard->lock);                                    \
+        return ret;                                                             \
+    }                                                                           \
+                                                                                \
+    /* Insert key or replace its value */                                       \
+    UNUSED NODISCARD static int concurrent_map_upsert_ ## name(                 \
+        name ## _concurrent_map_t* map, string_view_t key, const value_type* value \
+    ) {                                                                         \
+        const uint64_t hash = hash_string_view(key, map->seed);                 \
+        name ## _concurrent_map_shard_t* shard = concurrent_map_find_shard_ ## name(map, hash); \
+        pthread_rwlock_wrlock(&shard->lock);                                    \
+        size_t slot;                                                            \
+        int ret = concurrent_map_emplace_ ## name(shard, hash, key, &slot);     \
+        if (ret != -ERROR_ALLOCATION_FAILED) {                                  \
+            shard->entries[slot].value = *value;                                \
+            ret = -ERROR_NO_ERROR;                                              \
+        }                                                                       \
+        pthread_rwlock_unlock(&shard->lock);                                    \
+        return ret;                                                             \
+    }                                                                           \
+                                                                                \
+    /* Read-modify-write of the value of key under the lock of its shard:       \
+       update(value, inserted, data) gets an uninitialized value when the       \
+       key was absent and has just been inserted */                             \
+    UNUSED NODISCARD static int concurrent_map_update_ ## name(                 \
+        name ## _concurrent_map_t* map, string_view_t key,                      \
+        void (*update)(value_type* value, bool inserted, void* data), void* data \
+    ) {                                                                         \
+        const uint64_t hash = hash_string_view(key, map->seed);                 \
+        name ## _concurrent_map_shard_t* shard = concurrent_map_find_shard_ ## name(map, hash); \
+        pthread_rwlock_wrlock(&shard->lock);                                    \
+        size_t slot;                                                            \
+        int ret = concurrent_map_emplace_ ## name(shard, hash, key, &slot);     \
+        if (ret != -ERROR_ALLOCATION_FAILED) {                                  \
+            update(&shard->entries[slot].value, ret == -ERROR_NO_ERROR, data);  \
+            ret = -ERROR_NO_ERROR;                                              \
+        }                                                                       \
+        pthread_rwlock_unlock(&shard->lock);                                    \
+        return ret;                                                             \
+    }                                                                           \
+                                                                                \
+    /* Remove key, its value is copied in value (if not NULL) */                \
+    UNUSED static bool concurrent_map_erase_ ## name(                           \
+        name ## _concurrent_map_t* map, string_view_t key, value_type* value    \
+    ) {                                                                         \
+        const uint64_t hash = hash_string_view(key, map->seed);                 \
+        name ## _concurrent_map_shard_t* shard = concurrent_map_find_shard_ ## name(map, hash); \
+        pthread_rwlock_wrlock(&shard->lock);                                    \
+        size_t hole = shard->capacity != 0                                      \
+            ? concurrent_map_probe_ ## name(shard, hash, key) : 0;              \
+        if (shard->capacity == 0 || shard->entries[hole].key.str == NULL) {     \
+            pthread_rwlock_unlock(&shard->lock);                                \
+            return false;                                                       \
+        }                                                                       \
+        if (value != NULL)                                                      \
+            *value = shard->entries[hole].value;                                \
+        CUTILS_dealloc(shard->entries[hole].key.str);                           \
+        /* Move back the entries whose probe sequence crosses the hole */       \
+        const size_t mask = shard->capacity - 1;                                \
+        for (size_t i = (hole + 1) & mask; shard->entries[i].key.str != NULL; i = (i + 1) & mask) { \
+            const size_t home = shard->entries[i].hash & mask;                  \
+            if (((i - home) & mask) >= ((i - hole) & mask)) {                   \
+                shard->entries[hole] = shard->entries[i];                       \
+                hole = i;                                                       \
+            }                                                                   \
+        }                                                                       \
+        shard->entries[hole].key.str = NULL;                                    \
+        shard->count -= 1;                                                      \
+        pthread_rwlock_unlock(&shard->lock);                                    \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    /* Number of keys, only exact while no other thread modifies the map */     \
+    UNUSED static size_t concurrent_map_length_ ## name(name ## _concurrent_map_t* map) { \
+        size_t length = 0;                                                      \
+        for (unsigned i = 0; i < map->shard_count; i++) {                       \
+            name ## _concurrent_map_shard_t* shard = concurrent_map_shard(map, i); \
+            pthread_rwlock_rdlock(&shard->lock);                                \
+            length += shard->count;                                             \
+            pthread_rwlock_unlock(&shard->lock);                                \
+        }                                                                       \
+        return length;                                                          \
+    }
+
+#endif //CUTILS_CONCURRENT_MAP_H
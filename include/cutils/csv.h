@@ -0,0 +1,343 @@
+#ifndef CUTILS_CSV_H
+#define CUTILS_CSV_H
+
+#include <cutils/array.h>
+#include <cutils/bits.h>
+#include <cutils/compatibility.h>
+#include <cutils/errors.h>
+#include <cutils/string.h>
+#include <cutils/when_macros.h>
+#include <stdint.h>
+
+/*
+ * Streaming reader of delimited records (CSV, TSV...) in two passes over
+ * each chunk of input:
+ *
+ * - the chunk is classified 64 bytes at a time with vector comparisons into
+ *   bitmasks of quotes, delimiters and newlines, the quoted areas being the
+ *   prefix XOR of the quotes (a carry-less multiplication when available),
+ *   which leaves the positions of the delimiters and newlines outside quotes
+ * - the records are then cut at these positions into string_view_t fields,
+ *   which point into the chunk.
+ *
+ *     csv_reader_t reader = csv_reader_init(',');
+ *     while (read a chunk) {
+ *         csv_reader_feed(&reader, chunk);
+ *         while (csv_reader_next(&reader, &record) == -ERROR_NO_ERROR)
+ *             ... record->data[0 .. record->length - 1] ...
+ *     }
+ *     csv_reader_finish(&reader);
+ *     while (csv_reader_next(&reader, &record) == -ERROR_NO_ERROR) ...
+ *     csv_reader_free(&reader);
+ *
+ * Fields are separated by the delimiter and records by '\n', a '\r' before
+ * it is dropped. A field starting with a quote ends at its closing quote,
+ * it may contain delimiters, newlines and doubled quotes, which are the only
+ * fields copied (to a buffer of the reader). A record cut by the end of a
+ * chunk is copied until the chunk completing it is fed. The fields of a
+ * record are valid until the next call to csv_reader_next, the chunk must
+ * stay valid until csv_reader_next stops returning records, and is at most
+ * 4 GiB.
+ *
+ * Defining CUTILS_CSV_SCALAR disables the vector instructions. AVX2 and the
+ * carry-less multiplication are used only when the compiler targets them
+ * (-mavx2 -mpclmul, -march=native...).
+ */
+
+#if !defined(CUTILS_CSV_SCALAR) && defined(__AVX2__)
+#include <immintrin.h>
+#define CUTILS_CSV_AVX2
+#elif !defined(CUTILS_CSV_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define CUTILS_CSV_SSE2
+#elif !defined(CUTILS_CSV_SCALAR) && defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CUTILS_CSV_NEON
+#endif
+
+#if !defined(CUTILS_CSV_SCALAR) && defined(__PCLMUL__) && defined(__x86_64__)
+#include <wmmintrin.h>
+#define CUTILS_CSV_PCLMUL
+#endif
+
+DEFINE_ARRAY_TYPE_WITH_ALLOCATOR(csv_position, uint32_t, heap)
+DEFINE_ARRAY_TYPE_WITH_ALLOCATOR(csv_field, string_view_t, heap)
+
+typedef struct {
+    string_view_t chunk;
+    // Start of the next record in the chunk
+    size_t position;
+    // Delimiters and newlines of the chunk outside quotes, and the next one
+    csv_position_array_t positions;
+    unsigned cursor;
+    // Start of a record cut by the end of the previous chunks
+    string_t pending;
+    csv_position_array_t pending_positions;
+    bool pending_returned;
+    csv_field_array_t fields;
+    // Quoted fields containing doubled quotes
+    string_t unescaped;
+    char delimiter;
+    // Whether the end of the input fed so far is inside quotes
+    bool quoted;
+    bool finished;
+} csv_reader_t;
+
+// Bitmasks of the quotes and of the delimiters or newlines of 64 bytes
+typedef struct {
+    uint64_t quotes;
+    uint64_t separators;
+} csv_block_t;
+
+#ifdef CUTILS_CSV_NEON
+// Bit i set if byte i of the four vectors is set, given bytes weighted by
+// their bit in their group of eight
+UNUSED
+static uint64_t csv_neon_mask(const uint8x16_t v[4]) {
+    uint8x16_t sum = vpaddq_u8(vpaddq_u8(v[0], v[1]), vpaddq_u8(v[2], v[3]));
+    sum = vpaddq_u8(sum, sum);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+}
+#endif
+
+UNUSED
+static csv_block_t csv_classify(const char* p, const char delimiter) {
+    csv_block_t block = { 0, 0 };
+#if defined(CUTILS_CSV_AVX2)
+    for (unsigned i = 0; i < 2; i++) {
+        const __m256i chars = _mm256_loadu_si256((const __m256i*)(p + 32 * i));
+        const __m256i quotes = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('"'));
+        const __m256i separators = _mm256_or_si256(
+            _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(delimiter)), _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n')));
+        block.quotes |= (uint64_t)(uint32_t)_mm256_movemask_epi8(quotes) << (32 * i);
+        block.separators |= (uint64_t)(uint32_t)_mm256_movemask_epi8(separators) << (32 * i);
+    }
+#elif defined(CUTILS_CSV_SSE2)
+    for (unsigned i = 0; i < 4; i++) {
+        const __m128i chars = _mm_loadu_si128((const __m128i*)(p + 16 * i));
+        const __m128i quotes = _mm_cmpeq_epi8(chars, _mm_set1_epi8('"'));
+        const __m128i separators = _mm_or_si128(
+            _mm_cmpeq_epi8(chars, _mm_set1_epi8(delimiter)), _mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')));
+        block.quotes |= (uint64_t)(uint16_t)_mm_movemask_epi8(quotes) << (16 * i);
+        block.separators |= (uint64_t)(uint16_t)_mm_movemask_epi8(separators) << (16 * i);
+    }
+#elif defined(CUTILS_CSV_NEON)
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t weight = vld1q_u8(weights);
+    uint8x16_t quotes[4], separators[4];
+    for (unsigned i = 0; i < 4; i++) {
+        const uint8x16_t chars = vld1q_u8((const uint8_t*)p + 16 * i);
+        quotes[i] = vandq_u8(vceqq_u8(chars, vdupq_n_u8('"')), weight);
+        separators[i] = vandq_u8(
+            vorrq_u8(vceqq_u8(chars, vdupq_n_u8((uint8_t)delimiter)), vceqq_u8(chars, vdupq_n_u8('\n'))), weight);
+    }
+    block.quotes = csv_neon_mask(quotes);
+    block.separators = csv_neon_mask(separators);
+#else
+    for (unsigned i = 0; i < 64; i++) {
+        block.quotes |= (uint64_t)(p[i] == '"') << i;
+        block.separators |= (uint64_t)(p[i] == delimiter || p[i] == '\n') << i;
+    }
+#endif
+    return block;
+}
+
+// Bit i set if an odd number of bits are set up to bit i included
+UNUSED
+static uint64_t csv_prefix_xor(uint64_t bits) {
+#ifdef CUTILS_CSV_PCLMUL
+    return (uint64_t)_mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_set_epi64x(0, (int64_t)bits), _mm_set1_epi8(-1), 0));
+#else
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+#endif
+}
+
+// Append to positions the delimiters and newlines of data outside quotes,
+// *quoted is the quote state before data and after it on return
+UNUSED NODISCARD
+static bool csv_index(
+    const char* data, const size_t length, const char delimiter, bool* quoted, csv_position_array_t* positions
+) {
+    uint64_t carry = *quoted ? UINT64_MAX : 0;
+    for (size_t base = 0; base < length; base += 64) {
+        csv_block_t block;
+        if (length - base >= 64) {
+            block = csv_classify(data + base, delimiter);
+        } else {
+            char tail[64];
+            const size_t rest = length - base;
+            memcpy(tail, data + base, rest);
+            block = csv_classify(tail, delimiter);
+            const uint64_t mask = (UINT64_C(1) << rest) - 1;
+            block.quotes &= mask;
+            block.separators &= mask;
+        }
+        const uint64_t inside = csv_prefix_xor(block.quotes) ^ carry;
+        carry = 0 - (inside >> 63);
+        uint64_t separators = block.separators & ~inside;
+        if (separators == 0)
+            continue;
+        uint32_t* out = array_append_csv_position(positions, bits_popcount(separators));
+        when_null_ret(out, false);
+        for (; separators != 0; separators &= separators - 1)
+            *out++ = (uint32_t)(base + bits_trailing_zeros(separators));
+    }
+    *quoted = carry != 0;
+    return true;
+}
+
+UNUSED NODISCARD
+static csv_reader_t csv_reader_init(const char delimiter) {
+    return (csv_reader_t) {
+        .chunk = EMPTY_STRING_VIEW,
+        .position = 0,
+        .positions = EMPTY_ARRAY(csv_position),
+        .cursor = 0,
+        .pending = EMPTY_STRING,
+        .pending_positions = EMPTY_ARRAY(csv_position),
+        .pending_returned = false,
+        .fields = EMPTY_ARRAY(csv_field),
+        .unescaped = EMPTY_STRING,
+        .delimiter = delimiter,
+        .quoted = false,
+        .finished = false,
+    };
+}
+
+UNUSED
+static void csv_reader_free(csv_reader_t* reader) {
+    array_free_csv_position(&reader->positions);
+    array_free_csv_position(&reader->pending_positions);
+    array_free_csv_field(&reader->fields);
+    string_free(&reader->pending);
+    string_free(&reader->unescaped);
+}
+
+// Content of a field, unquoted
+UNUSED
+static string_view_t csv_field(csv_reader_t* reader, const char* field, size_t length) {
+    if (length == 0 || field[0] != '"')
+        return (string_view_t) { .str = (char*)field, .len = length };
+    field += 1;
+    length -= length >= 2 && field[length - 2] == '"' ? 2 : 1;
+    const char* end = field + length;
+    const char* quote = memchr(field, '"', length);
+    if (quote == NULL)
+        return (string_view_t) { .str = (char*)field, .len = length };
+    // The buffer has room for the whole record, the views into it stay valid
+    char* begin = reader->unescaped.data + reader->unescaped.length;
+    char* out = begin;
+    for (; quote != NULL; quote = memchr(field, '"', (size_t)(end - field))) {
+        memcpy(out, field, (size_t)(quote + 1 - field));
+        out += quote + 1 - field;
+        field = quote + 1 + (quote + 1 < end && quote[1] == '"');
+    }
+    memcpy(out, field, (size_t)(end - field));
+    out += end - field;
+    reader->unescaped.length += (unsigned)(out - begin);
+    return (string_view_t) { .str = begin, .len = (size_t)(out - begin) };
+}
+
+// Cut the record [start, end) of base at the count delimiters
+UNUSED NODISCARD
+static int csv_split(
+    csv_reader_t* reader, const char* base, size_t start, const uint32_t* delimiters, const size_t count, size_t end
+) {
+    if (end > start && base[end - 1] == '\r')
+        end -= 1;
+    reader->fields.length = 0;
+    string_view_t* fields = array_append_csv_field(&reader->fields, (unsigned)count + 1);
+    when_null_ret(fields, -ERROR_ALLOCATION_FAILED);
+    if (reader->unescaped.capacity < end - start) {
+        when_null_ret(array_append_char(&reader->unescaped, (unsigned)(end - start)), -ERROR_ALLOCATION_FAILED);
+    }
+    reader->unescaped.length = 0;
+    for (size_t i = 0; i <= count; i++) {
+        const size_t field_end = i < count ? delimiters[i] : end;
+        fields[i] = csv_field(reader, base + start, field_end - start);
+        start = field_end + 1;
+    }
+    return -ERROR_NO_ERROR;
+}
+
+// Complete the pending record with length bytes and cut it
+UNUSED NODISCARD
+static int csv_split_pending(csv_reader_t* reader, const char* rest, const size_t length) {
+    if (length != 0) {
+        char* out = array_append_char(&reader->pending, (unsigned)length);
+        when_null_ret(out, -ERROR_ALLOCATION_FAILED);
+        memcpy(out, rest, length);
+    }
+    reader->pending_returned = true;
+    reader->pending_positions.length = 0;
+    bool quoted = false;
+    when_false_ret(
+        csv_index(reader->pending.data, reader->pending.length, reader->delimiter, &quoted, &reader->pending_positions),
+        -ERROR_ALLOCATION_FAILED
+    );
+    // Only the delimiters are left, the record contains no newline
+    return csv_split(reader, reader->pending.data, 0, reader->pending_positions.data,
+                     reader->pending_positions.length, reader->pending.length);
+}
+
+// Index the next chunk, the records of the previous one must have been read
+UNUSED NODISCARD
+static bool csv_reader_feed(csv_reader_t* reader, const string_view_t chunk) {
+    reader->chunk = chunk;
+    reader->position = 0;
+    reader->cursor = 0;
+    reader->positions.length = 0;
+    return csv_index(chunk.str, chunk.len, reader->delimiter, &reader->quoted, &reader->positions);
+}
+
+// No chunk will follow, the last record may not end with a newline
+UNUSED
+static void csv_reader_finish(csv_reader_t* reader) {
+    reader->finished = true;
+}
+
+// Next complete record: -ERROR_NO_ERROR, -ERROR_IS_EMPTY when the next
+// record is not complete yet (or the input is over) or
+// -ERROR_ALLOCATION_FAILED, after which the reader must be freed
+UNUSED NODISCARD
+static int csv_reader_next(csv_reader_t* reader, csv_field_array_t** record) {
+    *record = &reader->fields;
+    if (reader->pending_returned) {
+        reader->pending.length = 0;
+        reader->pending_returned = false;
+    }
+    const uint32_t* positions = reader->positions.data;
+    unsigned last = reader->cursor;
+    while (last < reader->positions.length && reader->chunk.str[positions[last]] != '\n')
+        last++;
+    if (last < reader->positions.length) {
+        const size_t end = positions[last];
+        const int ret = reader->pending.length == 0
+            ? csv_split(reader, reader->chunk.str, reader->position, positions + reader->cursor,
+                        last - reader->cursor, end)
+            : csv_split_pending(reader, reader->chunk.str + reader->position, end - reader->position);
+        reader->position = end + 1;
+        reader->cursor = last + 1;
+        return ret;
+    }
+    // The rest of the chunk starts a record completed by the next chunks
+    if (reader->position < reader->chunk.len) {
+        const size_t length = reader->chunk.len - reader->position;
+        char* out = array_append_char(&reader->pending, (unsigned)length);
+        when_null_ret(out, -ERROR_ALLOCATION_FAILED);
+        memcpy(out, reader->chunk.str + reader->position, length);
+        reader->position = reader->chunk.len;
+        reader->cursor = reader->positions.length;
+    }
+    if (reader->finished && reader->pending.length != 0)
+        return csv_split_pending(reader, NULL, 0);
+    return -ERROR_IS_EMPTY;
+}
+
+#endif //CUTILS_CSV_H
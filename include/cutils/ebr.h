@@ -0,0 +1,192 @@
+#ifndef CUTILS_EBR_H
+#define CUTILS_EBR_H
+
+#include <cutils/allocator/allocator.h>
+#include <cutils/compatibility.h>
+#include <cutils/when_macros.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Epoch-based reclamation: memory unlinked from a lock-free structure is
+ * retired instead of freed, and handed back to the allocator once every
+ * thread which could still read it has left its critical section.
+ *
+ * Each thread registers once per domain and brackets its accesses to the
+ * shared structures with ebr_pin/ebr_unpin. A global epoch advances when all
+ * the pinned threads have observed it, memory retired during epoch e is
+ * freed once the epoch reaches e + 2. A thread pinned for a long time delays
+ * the frees of every thread but never makes them unsafe.
+ *
+ * The allocator of the domain is called from every registered thread, it
+ * must be thread-safe (the default one is). A domain and its threads are
+ * freed once no thread uses them anymore.
+ */
+
+// Retired pointers a thread keeps before trying to advance the epoch
+#ifndef CUTILS_EBR_COLLECT_THRESHOLD
+#define CUTILS_EBR_COLLECT_THRESHOLD 64
+#endif
+
+typedef struct ebr_thread ebr_thread_t;
+
+typedef struct {
+    atomic_uint_fast64_t epoch;
+    // Registered threads, records are never unlinked before ebr_free
+    _Atomic(ebr_thread_t*) threads;
+    allocator_t allocator;
+} ebr_domain_t;
+
+typedef struct {
+    void* pointer;
+    uint64_t epoch;
+} ebr_retired_t;
+
+struct ebr_thread {
+    // (epoch << 1) | 1 while pinned, 0 otherwise
+    atomic_uint_fast64_t local_epoch;
+    atomic_bool in_use;
+    ebr_thread_t* next;
+    ebr_domain_t* domain;
+    unsigned pin_depth;
+    ebr_retired_t* retired;
+    size_t retired_count;
+    size_t retired_capacity;
+};
+
+UNUSED
+static void ebr_init_allocator(ebr_domain_t* domain, const allocator_t allocator) {
+    atomic_init(&domain->epoch, 0);
+    atomic_init(&domain->threads, NULL);
+    domain->allocator = allocator;
+}
+
+#ifndef CUTILS_NO_STD
+UNUSED
+static void ebr_init(ebr_domain_t* domain) {
+    ebr_init_allocator(domain, ALLOCATOR_DEFAULT);
+}
+#endif
+
+// Thread record of the calling thread, a record released by ebr_unregister
+// is reused with the memory it still has to free
+NODISCARD UNUSED
+static ebr_thread_t* ebr_register(ebr_domain_t* domain) {
+    for (ebr_thread_t* t = atomic_load(&domain->threads); t != NULL; t = t->next) {
+        bool expected = false;
+        if (!atomic_load_explicit(&t->in_use, memory_order_relaxed)
+            && atomic_compare_exchange_strong(&t->in_use, &expected, true))
+            return t;
+    }
+    ebr_thread_t* t = allocator_alloc(&domain->allocator, sizeof(ebr_thread_t));
+    when_null_ret(t, NULL);
+    atomic_init(&t->local_epoch, 0);
+    atomic_init(&t->in_use, true);
+    t->domain = domain;
+    t->pin_depth = 0;
+    t->retired = NULL;
+    t->retired_count = 0;
+    t->retired_capacity = 0;
+    t->next = atomic_load(&domain->threads);
+    while (!atomic_compare_exchange_weak(&domain->threads, &t->next, t)) {}
+    return t;
+}
+
+// Enter a critical section, pins nest
+UNUSED
+static void ebr_pin(ebr_thread_t* thread) {
+    if (thread->pin_depth++ != 0)
+        return;
+    const uint64_t epoch = atomic_load_explicit(&thread->domain->epoch, memory_order_relaxed);
+    atomic_store_explicit(&thread->local_epoch, (epoch << 1) | 1, memory_order_relaxed);
+    // The announcement must be visible before the shared pointers are read
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+UNUSED
+static void ebr_unpin(ebr_thread_t* thread) {
+    if (--thread->pin_depth == 0)
+        atomic_store_explicit(&thread->local_epoch, 0, memory_order_release);
+}
+
+// Advance the global epoch if every pinned thread has observed it
+UNUSED
+static bool ebr_try_advance(ebr_domain_t* domain) {
+    atomic_thread_fence(memory_order_seq_cst);
+    uint64_t epoch = atomic_load(&domain->epoch);
+    for (ebr_thread_t* t = atomic_load(&domain->threads); t != NULL; t = t->next) {
+        const uint64_t local = atomic_load(&t->local_epoch);
+        if ((local & 1) && (local >> 1) != epoch)
+            return false;
+    }
+    return atomic_compare_exchange_strong(&domain->epoch, &epoch, epoch + 1);
+}
+
+// Free the pointers retired by thread which no thread can read anymore
+UNUSED
+static void ebr_collect(ebr_thread_t* thread) {
+    ebr_domain_t* domain = thread->domain;
+    ebr_try_advance(domain);
+    const uint64_t epoch = atomic_load(&domain->epoch);
+    size_t kept = 0;
+    for (size_t i = 0; i < thread->retired_count; i++) {
+        if (thread->retired[i].epoch + 2 <= epoch)
+            allocator_binding_dealloc(&domain->allocator, thread->retired[i].pointer, 0);
+        else
+            thread->retired[kept++] = thread->retired[i];
+    }
+    thread->retired_count = kept;
+}
+
+// Release the record of the calling thread, the pointers which cannot be
+// freed yet are left to the next thread reusing it (or to ebr_free)
+UNUSED
+static void ebr_unregister(ebr_thread_t* thread) {
+    atomic_store_explicit(&thread->local_epoch, 0, memory_order_release);
+    thread->pin_depth = 0;
+    ebr_collect(thread);
+    atomic_store_explicit(&thread->in_use, false, memory_order_release);
+}
+
+// Free pointer once no pinned thread can read it, pointer must already be
+// unreachable for the threads which pin after this call. Returns false if
+// the retired list cannot grow, the pointer is then leaked.
+UNUSED
+static bool ebr_retire(ebr_thread_t* thread, void* pointer) {
+    ebr_domain_t* domain = thread->domain;
+    if (thread->retired_count == thread->retired_capacity) {
+        const size_t capacity = thread->retired_capacity == 0
+            ? CUTILS_EBR_COLLECT_THRESHOLD : thread->retired_capacity * 2;
+        ebr_retired_t* retired = allocator_realloc_sized(&domain->allocator, thread->retired,
+            thread->retired_capacity * sizeof(ebr_retired_t), capacity * sizeof(ebr_retired_t));
+        when_null_ret(retired, false);
+        thread->retired = retired;
+        thread->retired_capacity = capacity;
+    }
+    thread->retired[thread->retired_count++] = (ebr_retired_t) {
+        .pointer = pointer,
+        .epoch = atomic_load(&domain->epoch),
+    };
+    if (thread->retired_count % CUTILS_EBR_COLLECT_THRESHOLD == 0)
+        ebr_collect(thread);
+    return true;
+}
+
+// Free every retired pointer and thread record, no thread may use the
+// domain anymore
+UNUSED
+static void ebr_free(ebr_domain_t* domain) {
+    ebr_thread_t* t = atomic_load(&domain->threads);
+    while (t != NULL) {
+        ebr_thread_t* next = t->next;
+        for (size_t i = 0; i < t->retired_count; i++)
+            allocator_binding_dealloc(&domain->allocator, t->retired[i].pointer, 0);
+        allocator_binding_dealloc(&domain->allocator, t->retired, 0);
+        allocator_binding_dealloc(&domain->allocator, t, 0);
+        t = next;
+    }
+    atomic_store(&domain->threads, NULL);
+}
+
+#endif //CUTILS_EBR_H
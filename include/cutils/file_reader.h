@@ -0,0 +1,492 @@
+#ifndef CUTILS_FILE_READER_H
+#define CUTILS_FILE_READER_H
+
+#include <cutils/allocator/allocator.h>
+#include <cutils/compatibility.h>
+#include <cutils/errors.h>
+#include <cutils/ring.h>
+#include <cutils/when_macros.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Sequential file reader which keeps up to depth reads of buffer_size bytes
+ * in flight, so the I/O of the next chunks overlaps the processing of the
+ * current one. On Linux the reads are submitted to an io_uring through the
+ * raw system calls (no liburing needed), elsewhere or when io_uring is not
+ * available the free buffers are filled synchronously with read.
+ *
+ * The chunks are delivered in file order through a ring of file_chunk_t.
+ * A chunk stays valid until it is given back with file_reader_release, which
+ * immediately reuses its buffer for the next read.
+ */
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define CUTILS_FILE_READER_URING
+#endif
+#endif
+
+#ifdef CUTILS_FILE_READER_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+// Declared here as glibc hides it in the strict ISO modes
+long syscall(long number, ...);
+#endif
+
+// Use read even if io_uring is available
+#define FILE_READER_SYNC 1
+// Register the buffers with the io_uring (falls back silently if refused)
+#define FILE_READER_REGISTER_BUFFERS 2
+
+#define FILE_READER_ALIGN 4096
+
+typedef struct {
+    char* data;
+    size_t size;
+    uint64_t offset;
+    unsigned slot;
+} file_chunk_t;
+
+// Private name, a ring of file_chunk_t defined by the user cannot collide
+DEFINE_RING_TYPE_WITH_ALLOCATOR(file_reader_chunk, file_chunk_t, heap)
+
+enum {
+    FILE_READER_FREE,
+    FILE_READER_IN_FLIGHT,
+    FILE_READER_DONE,
+    FILE_READER_DELIVERED
+};
+
+typedef struct {
+    uint64_t offset;
+    size_t length;
+    size_t filled;
+    // errno of the failed read of this chunk
+    int error;
+    unsigned state;
+} file_reader_slot_t;
+
+#ifdef CUTILS_FILE_READER_URING
+typedef struct {
+    int fd;
+    bool registered;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+    // Entries written in the submission queue but not published yet
+    unsigned queued;
+    // Entries published but not consumed by the kernel yet
+    unsigned to_submit;
+    struct iovec* iovecs;
+} file_reader_uring_t;
+#endif
+
+typedef struct {
+    int fd;
+    // errno of the first failed read, the reader stops at this point
+    int error;
+    uint64_t size;
+    // Offset of the next read submitted, and of the next chunk delivered
+    uint64_t submitted;
+    uint64_t delivered;
+    size_t buffer_size;
+    unsigned depth;
+    unsigned in_flight;
+    char* memory;
+    char* buffers;
+    file_reader_slot_t* slots;
+    file_reader_chunk_ring_t completed;
+#ifdef CUTILS_FILE_READER_URING
+    file_reader_uring_t uring;
+#endif
+} file_reader_t;
+
+#ifdef CUTILS_FILE_READER_URING
+#define file_reader_async(reader) ((reader)->uring.fd >= 0)
+#else
+#define file_reader_async(reader) ((void)(reader), false)
+#endif
+
+#ifdef _WIN32
+#define file_reader_open_fd(path) _open(path, _O_RDONLY | _O_BINARY)
+#define file_reader_seek(fd, offset, whence) _lseeki64(fd, offset, whence)
+#define file_reader_read_fd(fd, buffer, size) _read(fd, buffer, (unsigned)(size))
+#define file_reader_close_fd(fd) _close(fd)
+#else
+#define file_reader_open_fd(path) open(path, O_RDONLY)
+#define file_reader_seek(fd, offset, whence) lseek(fd, offset, whence)
+#define file_reader_read_fd(fd, buffer, size) read(fd, buffer, size)
+#define file_reader_close_fd(fd) close(fd)
+#endif
+
+#ifdef CUTILS_FILE_READER_URING
+
+UNUSED
+static void file_reader_uring_close(file_reader_uring_t* uring) {
+    if (uring->sqes != NULL)
+        munmap(uring->sqes, uring->sqes_size);
+    if (uring->cq_ring != NULL && uring->cq_ring != uring->sq_ring)
+        munmap(uring->cq_ring, uring->cq_ring_size);
+    if (uring->sq_ring != NULL)
+        munmap(uring->sq_ring, uring->sq_ring_size);
+    if (uring->fd >= 0)
+        close(uring->fd);
+    CUTILS_dealloc(uring->iovecs);
+    *uring = (file_reader_uring_t) { .fd = -1 };
+}
+
+UNUSED NODISCARD
+static bool file_reader_uring_setup(file_reader_t* reader, const unsigned flags) {
+    file_reader_uring_t* uring = &reader->uring;
+    *uring = (file_reader_uring_t) { .fd = -1 };
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const long fd = syscall(__NR_io_uring_setup, reader->depth, &params);
+    if (fd < 0)
+        return false;
+    uring->fd = (int)fd;
+    uring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    uring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    // Recent kernels map both rings at once
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (uring->cq_ring_size > uring->sq_ring_size)
+            uring->sq_ring_size = uring->cq_ring_size;
+        uring->cq_ring_size = uring->sq_ring_size;
+    }
+    void* sq = mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, uring->fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        file_reader_uring_close(uring);
+        return false;
+    }
+    uring->sq_ring = sq;
+    void* cq = sq;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(NULL, uring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, uring->fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            file_reader_uring_close(uring);
+            return false;
+        }
+    }
+    uring->cq_ring = cq;
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, uring->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        file_reader_uring_close(uring);
+        return false;
+    }
+    uring->sqes = sqes;
+    uring->sq_tail = (unsigned*)((char*)sq + params.sq_off.tail);
+    uring->sq_mask = *(unsigned*)((char*)sq + params.sq_off.ring_mask);
+    uring->sq_array = (unsigned*)((char*)sq + params.sq_off.array);
+    uring->cq_head = (unsigned*)((char*)cq + params.cq_off.head);
+    uring->cq_tail = (unsigned*)((char*)cq + params.cq_off.tail);
+    uring->cq_mask = *(unsigned*)((char*)cq + params.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe*)((char*)cq + params.cq_off.cqes);
+
+    uring->iovecs = CUTILS_alloc(reader->depth * sizeof(struct iovec));
+    if (uring->iovecs == NULL) {
+        file_reader_uring_close(uring);
+        return false;
+    }
+    for (unsigned i = 0; i < reader->depth; i++)
+        uring->iovecs[i] = (struct iovec) { reader->buffers + i * reader->buffer_size, reader->buffer_size };
+    if (flags & FILE_READER_REGISTER_BUFFERS) {
+        // Pinning the buffers may exceed RLIMIT_MEMLOCK, reads work without it
+        uring->registered = syscall(__NR_io_uring_register, uring->fd, IORING_REGISTER_BUFFERS,
+                                    uring->iovecs, reader->depth) == 0;
+    }
+    return true;
+}
+
+// Queue the read of the missing part of a slot, submitted by file_reader_uring_enter
+UNUSED
+static void file_reader_uring_queue(file_reader_t* reader, const unsigned slot) {
+    file_reader_uring_t* uring = &reader->uring;
+    const file_reader_slot_t* s = &reader->slots[slot];
+    // Only this thread produces submissions, the kernel reads the tail
+    const unsigned tail = *uring->sq_tail + uring->queued;
+    const unsigned index = tail & uring->sq_mask;
+    struct io_uring_sqe* sqe = &uring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = reader->fd;
+    sqe->off = s->offset + s->filled;
+    sqe->user_data = slot;
+    char* buffer = reader->buffers + slot * reader->buffer_size + s->filled;
+    if (uring->registered) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->addr = (uintptr_t)buffer;
+        sqe->len = (unsigned)(s->length - s->filled);
+        sqe->buf_index = (uint16_t)slot;
+    } else {
+        // READV is supported since the first io_uring kernels, READ is not
+        uring->iovecs[slot] = (struct iovec) { buffer, s->length - s->filled };
+        sqe->opcode = IORING_OP_READV;
+        sqe->addr = (uintptr_t)&uring->iovecs[slot];
+        sqe->len = 1;
+    }
+    uring->sq_array[index] = index;
+    uring->queued += 1;
+}
+
+// Submit the queued reads and wait for min_complete completions
+UNUSED NODISCARD
+static bool file_reader_uring_enter(file_reader_t* reader, const unsigned min_complete) {
+    file_reader_uring_t* uring = &reader->uring;
+    __atomic_store_n(uring->sq_tail, *uring->sq_tail + uring->queued, __ATOMIC_RELEASE);
+    uring->to_submit += uring->queued;
+    uring->queued = 0;
+    const unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (uring->to_submit > 0 || min_complete > 0) {
+        const long ret = syscall(__NR_io_uring_enter, uring->fd, uring->to_submit, min_complete, flags, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            reader->error = errno;
+            return false;
+        }
+        uring->to_submit -= (unsigned)ret;
+        if (min_complete > 0 || uring->to_submit == 0)
+            break;
+    }
+    return true;
+}
+
+UNUSED
+static void file_reader_uring_reap(file_reader_t* reader) {
+    file_reader_uring_t* uring = &reader->uring;
+    unsigned head = *uring->cq_head;
+    bool resubmit = false;
+    while (head != __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE)) {
+        const struct io_uring_cqe* cqe = &uring->cqes[head & uring->cq_mask];
+        file_reader_slot_t* slot = &reader->slots[cqe->user_data];
+        if (cqe->res < 0) {
+            slot->error = -cqe->res;
+            if (reader->error == 0)
+                reader->error = -cqe->res;
+            slot->state = FILE_READER_DONE;
+            reader->in_flight -= 1;
+        } else if (cqe->res > 0 && slot->filled + (size_t)cqe->res < slot->length) {
+            // Short read, queue the rest of the chunk
+            slot->filled += (size_t)cqe->res;
+            file_reader_uring_queue(reader, (unsigned)cqe->user_data);
+            resubmit = true;
+        } else {
+            slot->filled += (size_t)cqe->res;
+            slot->state = FILE_READER_DONE;
+            reader->in_flight -= 1;
+        }
+        head++;
+    }
+    __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+    if (resubmit)
+        (void)file_reader_uring_enter(reader, 0);
+}
+
+#endif
+
+// Fill a slot with blocking reads
+UNUSED
+static void file_reader_fill_sync(file_reader_t* reader, file_reader_slot_t* slot, const unsigned index) {
+    char* buffer = reader->buffers + index * reader->buffer_size;
+    if (file_reader_seek(reader->fd, slot->offset, SEEK_SET) < 0) {
+        slot->error = reader->error = errno;
+    } else {
+        while (slot->filled < slot->length) {
+            const long ret = (long)file_reader_read_fd(reader->fd, buffer + slot->filled, slot->length - slot->filled);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret < 0)
+                slot->error = reader->error = errno;
+            if (ret <= 0)
+                break;
+            slot->filled += (size_t)ret;
+        }
+    }
+    slot->state = FILE_READER_DONE;
+}
+
+// Start the reads of the next chunks in the free slots
+UNUSED
+static void file_reader_refill(file_reader_t* reader) {
+    for (unsigned i = 0; i < reader->depth && reader->submitted < reader->size && reader->error == 0; i++) {
+        file_reader_slot_t* slot = &reader->slots[i];
+        if (slot->state != FILE_READER_FREE)
+            continue;
+        const uint64_t remaining = reader->size - reader->submitted;
+        *slot = (file_reader_slot_t) {
+            .offset = reader->submitted,
+            .length = remaining < reader->buffer_size ? (size_t)remaining : reader->buffer_size,
+            .filled = 0,
+            .error = 0,
+            .state = FILE_READER_IN_FLIGHT
+        };
+        reader->submitted += slot->length;
+#ifdef CUTILS_FILE_READER_URING
+        if (file_reader_async(reader)) {
+            reader->in_flight += 1;
+            file_reader_uring_queue(reader, i);
+            continue;
+        }
+#endif
+        file_reader_fill_sync(reader, slot, i);
+    }
+#ifdef CUTILS_FILE_READER_URING
+    if (file_reader_async(reader) && reader->uring.queued > 0)
+        (void)file_reader_uring_enter(reader, 0);
+#endif
+}
+
+// Move the completed chunks to the ring in file order
+UNUSED
+static void file_reader_deliver(file_reader_t* reader) {
+    bool found = true;
+    while (found) {
+        found = false;
+        for (unsigned i = 0; i < reader->depth; i++) {
+            file_reader_slot_t* slot = &reader->slots[i];
+            if (slot->state != FILE_READER_DONE || slot->offset != reader->delivered)
+                continue;
+            slot->state = FILE_READER_DELIVERED;
+            reader->delivered += slot->length;
+            *ring_push_back_file_reader_chunk(&reader->completed, false) = (file_chunk_t) {
+                .data = reader->buffers + i * reader->buffer_size,
+                .size = slot->filled,
+                .offset = slot->offset,
+                .slot = i
+            };
+            found = true;
+        }
+    }
+}
+
+UNUSED
+static void file_reader_close(file_reader_t* reader) {
+#ifdef CUTILS_FILE_READER_URING
+    // The kernel may still write in the buffers of the pending reads
+    while (file_reader_async(reader) && reader->in_flight > 0) {
+        if (!file_reader_uring_enter(reader, 1))
+            break;
+        file_reader_uring_reap(reader);
+    }
+    if (reader->uring.fd >= 0)
+        file_reader_uring_close(&reader->uring);
+#endif
+    if (reader->fd >= 0)
+        file_reader_close_fd(reader->fd);
+    ring_free_file_reader_chunk(&reader->completed);
+    CUTILS_dealloc(reader->slots);
+    CUTILS_dealloc(reader->memory);
+    reader->fd = -1;
+    reader->slots = NULL;
+    reader->memory = NULL;
+    reader->buffers = NULL;
+}
+
+// Open path and start reading depth chunks of buffer_size bytes
+NODISCARD UNUSED
+static int file_reader_open(
+    file_reader_t* reader, const char* path, const unsigned depth, const size_t buffer_size, const unsigned flags
+) {
+    when_false_ret(depth > 0, -ERROR_INVALID_PARAM3);
+    when_false_ret(buffer_size > 0 && buffer_size <= UINT32_MAX, -ERROR_INVALID_PARAM4);
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = -1;
+#ifdef CUTILS_FILE_READER_URING
+    reader->uring.fd = -1;
+#endif
+    reader->depth = depth;
+    reader->buffer_size = buffer_size;
+    reader->fd = file_reader_open_fd(path);
+    if (reader->fd < 0)
+        return -ERROR_IO;
+    const long long size = (long long)file_reader_seek(reader->fd, 0, SEEK_END);
+    if (size < 0) {
+        file_reader_close(reader);
+        return -ERROR_IO;
+    }
+    reader->size = (uint64_t)size;
+    reader->memory = CUTILS_alloc(depth * buffer_size + FILE_READER_ALIGN - 1);
+    reader->slots = CUTILS_alloc(depth * sizeof(file_reader_slot_t));
+    reader->completed = ring_create_allocator_file_reader_chunk(NULL, depth, NULL);
+    if (reader->memory == NULL || reader->slots == NULL || reader->completed.data == NULL) {
+        file_reader_close(reader);
+        return -ERROR_ALLOCATION_FAILED;
+    }
+    reader->buffers = (char*)CUTILS_NEXT_ALLOC_ALIGNED((uintptr_t)reader->memory, (uintptr_t)FILE_READER_ALIGN);
+    for (unsigned i = 0; i < depth; i++)
+        reader->slots[i].state = FILE_READER_FREE;
+#ifdef CUTILS_FILE_READER_URING
+    if (!(flags & FILE_READER_SYNC) && !file_reader_uring_setup(reader, flags))
+        reader->uring.fd = -1;
+#else
+    // Reads are always synchronous without io_uring
+    (void)flags;
+#endif
+    file_reader_refill(reader);
+    return -ERROR_NO_ERROR;
+}
+
+// Next chunk in file order. Returns -ERROR_IS_EMPTY at the end of the file,
+// -ERROR_CAPACITY_EXCEEDED when every buffer is held by the caller (release
+// one to go on) and -ERROR_IO when a read failed, reader->error then holds
+// its errno. A chunk cut short by a failed read is not delivered.
+NODISCARD UNUSED
+static int file_reader_next(file_reader_t* reader, file_chunk_t* chunk) {
+    for (;;) {
+        file_reader_deliver(reader);
+        file_chunk_t* front = ring_front_file_reader_chunk(&reader->completed);
+        if (front != NULL) {
+            *chunk = *front;
+            ring_pop_front_file_reader_chunk(&reader->completed);
+            file_reader_slot_t* slot = &reader->slots[chunk->slot];
+            if (slot->error == 0 && chunk->size != 0)
+                return -ERROR_NO_ERROR;
+            // The buffer is not handed out, empty chunks come from a file
+            // truncated since it was opened
+            slot->state = FILE_READER_FREE;
+            return slot->error != 0 ? -ERROR_IO : -ERROR_IS_EMPTY;
+        }
+        if (reader->error != 0)
+            return -ERROR_IO;
+#ifdef CUTILS_FILE_READER_URING
+        if (file_reader_async(reader) && reader->in_flight > 0) {
+            if (!file_reader_uring_enter(reader, 1))
+                return -ERROR_IO;
+            file_reader_uring_reap(reader);
+            continue;
+        }
+#endif
+        return reader->delivered < reader->size ? -ERROR_CAPACITY_EXCEEDED : -ERROR_IS_EMPTY;
+    }
+}
+
+// Give the buffer of chunk back, it is reused for the next read at once
+UNUSED
+static void file_reader_release(file_reader_t* reader, const file_chunk_t* chunk) {
+    reader->slots[chunk->slot].state = FILE_READER_FREE;
+    file_reader_refill(reader);
+}
+
+#endif //CUTILS_FILE_READER_H
@@ -0,0 +1,348 @@
+#ifndef CUTILS_FORMAT_H
+#define CUTILS_FORMAT_H
+
+#include <cutils/bits.h>
+#include <cutils/compatibility.h>
+#include <cutils/pow5.h>
+#include <cutils/string.h>
+#include <cutils/when_macros.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Numbers appended to a string_t without going through snprintf: the
+ * characters are written straight into the array, which grows at most once
+ * per call, and no NUL terminator is added. Each function returns false and
+ * leaves the string unchanged if it cannot grow.
+ *
+ * The integers are written two digits at a time from a table. The doubles
+ * are written with the shortest decimal representation which reads back as
+ * the same double (Schubfach algorithm), the closest one to the exact value
+ * when several have that length. The fixed notation with a precision rounds
+ * the exact binary value like printf "%.*f".
+ */
+
+UNUSED static const char format_digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Number of decimal digits of value, 1 for 0
+UNUSED
+static unsigned format_count_digits(const uint64_t value) {
+    // 0 in the first slot so that 0 counts one digit
+    static const uint64_t powers[20] = {
+        0, UINT64_C(10), UINT64_C(100), UINT64_C(1000), UINT64_C(10000), UINT64_C(100000),
+        UINT64_C(1000000), UINT64_C(10000000), UINT64_C(100000000), UINT64_C(1000000000),
+        UINT64_C(10000000000), UINT64_C(100000000000), UINT64_C(1000000000000),
+        UINT64_C(10000000000000), UINT64_C(100000000000000), UINT64_C(1000000000000000),
+        UINT64_C(10000000000000000), UINT64_C(100000000000000000), UINT64_C(1000000000000000000),
+        UINT64_C(10000000000000000000),
+    };
+    // floor(log10(2) * bits) is the number of digits or one less
+    const unsigned guess = (64 - bits_leading_zeros(value | 1)) * 1233 >> 12;
+    return guess + 1 - (value < powers[guess]);
+}
+
+// Write the digits of value so that they end right before end
+UNUSED
+static void format_write_digits(char* end, uint64_t value) {
+    while (value >= 100) {
+        const unsigned pair = (unsigned)(value % 100) * 2;
+        value /= 100;
+        end -= 2;
+        memcpy(end, format_digit_pairs + pair, 2);
+    }
+    if (value >= 10)
+        memcpy(end - 2, format_digit_pairs + value * 2, 2);
+    else
+        end[-1] = (char)('0' + value);
+}
+
+// Room for count characters at the end of str, the unused ones are given
+// back by setting the length of str
+UNUSED NODISCARD
+static char* format_reserve(string_t* str, const unsigned count) {
+    return array_append_char(str, count);
+}
+
+UNUSED NODISCARD
+static bool string_append_u64(string_t* str, const uint64_t value) {
+    const unsigned digits = format_count_digits(value);
+    char* out = format_reserve(str, digits);
+    when_null_ret(out, false);
+    format_write_digits(out + digits, value);
+    return true;
+}
+
+UNUSED NODISCARD
+static bool string_append_i64(string_t* str, const int64_t value) {
+    // Negated as unsigned so that INT64_MIN does not overflow
+    const uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    const unsigned digits = format_count_digits(magnitude) + (value < 0);
+    char* out = format_reserve(str, digits);
+    when_null_ret(out, false);
+    out[0] = '-';
+    format_write_digits(out + digits, magnitude);
+    return true;
+}
+
+// Decimal value padded with leading zeros to at least width digits
+UNUSED NODISCARD
+static bool string_append_u64_padded(string_t* str, const uint64_t value, const unsigned width) {
+    const unsigned digits = format_count_digits(value);
+    const unsigned length = MAX(digits, width);
+    char* out = format_reserve(str, length);
+    when_null_ret(out, false);
+    memset(out, '0', length - digits);
+    format_write_digits(out + length, value);
+    return true;
+}
+
+// Lowercase hexadecimal value without prefix, padded with leading zeros to
+// at least width digits
+UNUSED NODISCARD
+static bool string_append_hex(string_t* str, uint64_t value, const unsigned width) {
+    const unsigned digits = (64 - bits_leading_zeros(value | 1) + 3) / 4;
+    const unsigned length = MAX(digits, width);
+    char* out = format_reserve(str, length);
+    when_null_ret(out, false);
+    memset(out, '0', length - digits);
+    for (char* end = out + length; value != 0; value >>= 4)
+        *--end = "0123456789abcdef"[value & 0xF];
+    return true;
+}
+
+// Decoded double, value = significand * 2^exponent
+typedef struct {
+    uint64_t significand;
+    int exponent;
+    bool negative;
+    // Infinity or NaN, the significand being 0 for the infinities
+    bool special;
+} format_binary_t;
+
+UNUSED
+static format_binary_t format_decode(const double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const unsigned biased = (unsigned)(bits >> 52) & 0x7FF;
+    const uint64_t fraction = bits & ((UINT64_C(1) << 52) - 1);
+    return (format_binary_t) {
+        .significand = biased == 0 || biased == 0x7FF ? fraction : fraction | UINT64_C(1) << 52,
+        .exponent = biased == 0 ? -1074 : (int)biased - 1075,
+        .negative = bits >> 63,
+        .special = biased == 0x7FF,
+    };
+}
+
+// "nan", "inf" or "-inf" like printf
+UNUSED NODISCARD
+static bool format_append_special(string_t* str, const format_binary_t binary) {
+    const bool sign = binary.negative && binary.significand == 0;
+    char* out = format_reserve(str, 3 + sign);
+    when_null_ret(out, false);
+    memcpy(out, sign ? "-inf" : binary.significand != 0 ? "nan" : "inf", 3 + sign);
+    return true;
+}
+
+// Top 64 bits of g * cp, the lowest one set if the next 64 bits are not all
+// zero. The lowest 64 bits only hold the error of g and are ignored.
+UNUSED
+static uint64_t format_round_to_odd(const uint64_t g_high, const uint64_t g_low, const uint64_t cp) {
+    uint64_t low_high, high_high;
+    (void)bits_mul128(g_low, cp, &low_high);
+    const uint64_t high_low = bits_mul128(g_high, cp, &high_high);
+    const uint64_t middle = high_low + low_high;
+    return (high_high + (middle < high_low)) | (middle != 0);
+}
+
+// Shortest decimal in the rounding interval of c * 2^q, closest to it on a
+// tie, as significand * 10^*exponent (Giulietti, "The Schubfach way to
+// render doubles")
+UNUSED
+static uint64_t format_shortest(const uint64_t c, const int q, int* exponent) {
+    // The bounds of the interval belong to it when c is even
+    const uint64_t out = c & 1;
+    const uint64_t cb = c << 2;
+    const uint64_t cbr = cb + 2;
+    uint64_t cbl;
+    int k;
+    // floor(q * log10(2)), or of log10(3/4 * 2^q) on the lower boundary of a
+    // binade where the interval below the value is half as wide
+    if (c != UINT64_C(1) << 52 || q == -1074) {
+        cbl = cb - 2;
+        k = (int)(((int64_t)q * INT64_C(661971961083)) >> 41);
+    } else {
+        cbl = cb - 1;
+        k = (int)(((int64_t)q * INT64_C(661971961083) - INT64_C(274743187321)) >> 41);
+    }
+    // g approximates 10^-k from above on 128 bits, h in [1, 4] aligns it
+    const int h = q + (int)(((int64_t)-k * INT64_C(913124641741)) >> 38) + 1;
+    const uint64_t* pow5 = pow5_128[-k - POW5_MIN_EXPONENT];
+    const uint64_t g_low = pow5[1] + 1;
+    const uint64_t g_high = pow5[0] + (g_low == 0);
+    const uint64_t vb = format_round_to_odd(g_high, g_low, cb << h);
+    const uint64_t vbl = format_round_to_odd(g_high, g_low, cbl << h);
+    const uint64_t vbr = format_round_to_odd(g_high, g_low, cbr << h);
+    const uint64_t s = vb >> 2;
+    *exponent = k;
+    // One digit less if a single multiple of ten is in the interval
+    const uint64_t sp10 = s / 10 * 10;
+    const uint64_t tp10 = sp10 + 10;
+    const bool upin = sp10 != 0 && vbl + out <= sp10 << 2;
+    const bool wpin = (tp10 << 2) + out <= vbr;
+    if (upin != wpin)
+        return upin ? sp10 : tp10;
+    const uint64_t t = s + 1;
+    const bool uin = vbl + out <= s << 2;
+    const bool win = (t << 2) + out <= vbr;
+    if (uin != win)
+        return uin ? s : t;
+    // Both are in the interval, the closest one wins, the even one on a tie
+    const uint64_t middle = (s + t) << 1;
+    return vb < middle || (vb == middle && (s & 1) == 0) ? s : t;
+}
+
+// Shortest representation which reads back as value: plain notation when
+// the decimal point is at most 21 digits after and 6 digits before the
+// first significant digit (123.25, 0.000001), scientific one otherwise
+// (1e+21, 2.5e-7), like the JavaScript conversion of numbers to strings
+UNUSED NODISCARD
+static bool string_append_f64(string_t* str, const double value) {
+    const format_binary_t binary = format_decode(value);
+    if (binary.special)
+        return format_append_special(str, binary);
+    if (binary.significand == 0) {
+        char* out = format_reserve(str, 1 + binary.negative);
+        when_null_ret(out, false);
+        memcpy(out, "-0" + !binary.negative, 1 + binary.negative);
+        return true;
+    }
+    uint64_t significand;
+    int exponent;
+    const int shift = -binary.exponent;
+    if (0 < shift && shift < 53 && (binary.significand & ((UINT64_C(1) << shift) - 1)) == 0) {
+        // Integers below 2^53 are exact
+        significand = binary.significand >> shift;
+        exponent = 0;
+    } else {
+        significand = format_shortest(binary.significand, binary.exponent, &exponent);
+    }
+    while (significand % 10 == 0) {
+        significand /= 10;
+        exponent += 1;
+    }
+    const int digits = (int)format_count_digits(significand);
+    // Position of the decimal point relative to the first digit
+    const int point = digits + exponent;
+    char* out = format_reserve(str, 32);
+    when_null_ret(out, false);
+    char* p = out;
+    if (binary.negative)
+        *p++ = '-';
+    if (digits <= point && point <= 21) {
+        format_write_digits(p + digits, significand);
+        memset(p + digits, '0', (size_t)(point - digits));
+        p += point;
+    } else if (0 < point && point <= 21) {
+        format_write_digits(p + digits + 1, significand);
+        memmove(p, p + 1, (size_t)point);
+        p[point] = '.';
+        p += digits + 1;
+    } else if (-6 < point && point <= 0) {
+        memcpy(p, "0.000000", (size_t)(2 - point));
+        p += 2 - point;
+        format_write_digits(p + digits, significand);
+        p += digits;
+    } else {
+        format_write_digits(p + digits + 1, significand);
+        p[0] = p[1];
+        p[1] = '.';
+        p += digits == 1 ? 1 : digits + 1;
+        *p++ = 'e';
+        *p++ = point > 0 ? '+' : '-';
+        const unsigned magnitude = (unsigned)(point > 0 ? point - 1 : 1 - point);
+        const unsigned length = format_count_digits(magnitude);
+        format_write_digits(p + length, magnitude);
+        p += length;
+    }
+    str->length = (unsigned)(p - str->data);
+    return true;
+}
+
+// Fixed notation with precision digits after the decimal point, rounded to
+// nearest, ties to even, from the exact binary value like printf "%.*f"
+UNUSED NODISCARD
+static bool string_append_f64_fixed(string_t* str, const double value, const unsigned precision) {
+    const format_binary_t binary = format_decode(value);
+    if (binary.special)
+        return format_append_special(str, binary);
+    uint64_t integer = 0;
+    // Fractional part as a 128-bit fixed point number with 124 bits after
+    // the point, so that ten times it still fits
+    uint64_t fraction[2] = { 0, 0 };
+    if (binary.significand == 0) {
+        integer = 0;
+    } else if (binary.exponent >= 0 && binary.exponent <= (int)bits_leading_zeros(binary.significand)) {
+        integer = binary.significand << binary.exponent;
+    } else if (binary.exponent < 0 && binary.exponent >= -124) {
+        const unsigned k = (unsigned)-binary.exponent;
+        const unsigned shift = 124 - k;
+        const uint64_t bits = k < 64 ? binary.significand & ((UINT64_C(1) << k) - 1) : binary.significand;
+        integer = k < 64 ? binary.significand >> k : 0;
+        fraction[0] = shift >= 64 ? bits << (shift - 64) : shift == 0 ? 0 : bits >> (64 - shift);
+        fraction[1] = shift >= 64 ? 0 : bits << shift;
+    } else {
+        // Huge and tiny values print many digits anyway
+        const int length = snprintf(NULL, 0, "%.*f", (int)precision, value);
+        when_false_ret(length > 0, false);
+        char* out = format_reserve(str, (unsigned)length + 1);
+        when_null_ret(out, false);
+        snprintf(out, (size_t)length + 1, "%.*f", (int)precision, value);
+        str->length -= 1;
+        return true;
+    }
+    const unsigned digits = format_count_digits(integer);
+    // One more character for a carry out of the integer part
+    char* out = format_reserve(str, 1 + binary.negative + digits + (precision != 0) + precision);
+    when_null_ret(out, false);
+    char* p = out;
+    if (binary.negative)
+        *p++ = '-';
+    char* first = p;
+    format_write_digits(p + digits, integer);
+    p += digits;
+    if (precision != 0)
+        *p++ = '.';
+    for (unsigned i = 0; i < precision; i++) {
+        uint64_t carry;
+        fraction[1] = bits_mul128(fraction[1], 10, &carry);
+        fraction[0] = fraction[0] * 10 + carry;
+        *p++ = (char)('0' + (fraction[0] >> 60));
+        fraction[0] &= (UINT64_C(1) << 60) - 1;
+    }
+    const uint64_t half = UINT64_C(1) << 59;
+    const bool odd = (p[-1] - '0') & 1;
+    if (fraction[0] > half || (fraction[0] == half && (fraction[1] != 0 || odd))) {
+        char* digit = p - 1;
+        for (; digit >= first; digit--) {
+            if (*digit == '.')
+                continue;
+            if (*digit != '9')
+                break;
+            *digit = '0';
+        }
+        if (digit >= first) {
+            *digit += 1;
+        } else {
+            memmove(first + 1, first, (size_t)(p - first));
+            *first = '1';
+            p += 1;
+        }
+    }
+    str->length = (unsigned)(p - str->data);
+    return true;
+}
+
+#endif //CUTILS_FORMAT_H
@@ -0,0 +1,162 @@
+#ifndef CUTILS_HASH_H
+#define CUTILS_HASH_H
+
+#include <cutils/compatibility.h>
+#include <cutils/string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 64-bit non-cryptographic hash following the construction of wyhash: the
+ * input is read in 8-byte words which are folded with 64x64->128 bit
+ * multiplications, keys of up to 16 bytes take a branch-light path without
+ * loop. The values depend on the seed, and are the same on every platform.
+ */
+
+#define HASH_DEFAULT_SEED 0
+
+UNUSED static const uint64_t hash_secret[4] = {
+    UINT64_C(0x2d358dccaa6c78a5), UINT64_C(0x8bb84b93962eacc9),
+    UINT64_C(0x4b33a62ed433d4a3), UINT64_C(0x4d5a2da51de1aa47),
+};
+
+// Full 128-bit product of a and b, low half in a and high half in b
+UNUSED
+static void hash_multiply(uint64_t* a, uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 hash_u128_t;
+    const hash_u128_t r = (hash_u128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    const uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    const uint64_t t = rl + (rm0 << 32);
+    uint64_t carry = t < rl;
+    const uint64_t lo = t + (rm1 << 32);
+    carry += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+UNUSED
+static uint64_t hash_mix(uint64_t a, uint64_t b) {
+    hash_multiply(&a, &b);
+    return a ^ b;
+}
+
+// Little-endian loads, unaligned accesses go through memcpy
+UNUSED
+static uint64_t hash_read64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+UNUSED
+static uint64_t hash_read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+UNUSED
+static uint64_t hash_finish(uint64_t a, uint64_t b, const uint64_t seed, const size_t size) {
+    a ^= hash_secret[1];
+    b ^= seed;
+    hash_multiply(&a, &b);
+    return hash_mix(a ^ hash_secret[0] ^ size, b ^ hash_secret[1]);
+}
+
+// Seed mixed with the secret, computed once for the keys hashed in bulk
+UNUSED
+static uint64_t hash_seed(const uint64_t seed) {
+    return seed ^ hash_mix(seed ^ hash_secret[0], hash_secret[1]);
+}
+
+// Keys longer than 16 bytes, kept out of line so the short path inlines
+UNUSED NOINLINE
+static uint64_t hash_bytes_long(const uint8_t* p, const size_t size, uint64_t seed) {
+    size_t i = size;
+    if (i > 48) {
+        // Three independent lanes hide the latency of the multiplications
+        uint64_t see1 = seed, see2 = seed;
+        do {
+            seed = hash_mix(hash_read64(p) ^ hash_secret[1], hash_read64(p + 8) ^ seed);
+            see1 = hash_mix(hash_read64(p + 16) ^ hash_secret[2], hash_read64(p + 24) ^ see1);
+            see2 = hash_mix(hash_read64(p + 32) ^ hash_secret[3], hash_read64(p + 40) ^ see2);
+            p += 48;
+            i -= 48;
+        } while (i > 48);
+        seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+        seed = hash_mix(hash_read64(p) ^ hash_secret[1], hash_read64(p + 8) ^ seed);
+        p += 16;
+        i -= 16;
+    }
+    return hash_finish(hash_read64(p + i - 16), hash_read64(p + i - 8), seed, size);
+}
+
+UNUSED
+static uint64_t hash_bytes_seeded(const void* data, const size_t size, const uint64_t seed) {
+    const uint8_t* p = data;
+    if (size > 16)
+        return hash_bytes_long(p, size, seed);
+    uint64_t a = 0, b = 0;
+    if (size >= 4) {
+        // Two overlapping pairs of 4-byte words cover 4 to 16 bytes
+        const size_t middle = (size >> 3) << 2;
+        a = (hash_read32(p) << 32) | hash_read32(p + middle);
+        b = (hash_read32(p + size - 4) << 32) | hash_read32(p + size - 4 - middle);
+    } else if (size > 0) {
+        a = ((uint64_t)p[0] << 16) | ((uint64_t)p[size >> 1] << 8) | p[size - 1];
+    }
+    return hash_finish(a, b, seed, size);
+}
+
+UNUSED
+static uint64_t hash_bytes(const void* data, const size_t size, const uint64_t seed) {
+    return hash_bytes_seeded(data, size, hash_seed(seed));
+}
+
+// Same value as hash_bytes(&key, sizeof(key), seed) without the loads
+UNUSED
+static uint64_t hash_u64(const uint64_t key, const uint64_t seed) {
+    const uint64_t low = (uint32_t)key, high = key >> 32;
+    return hash_finish((low << 32) | high, (high << 32) | low, hash_seed(seed), sizeof(key));
+}
+
+// Hash of the bytes of a value of plain old data type, *pointer must not
+// contain padding bytes
+#define hash_value(pointer, seed) hash_bytes(pointer, sizeof(*(pointer)), seed)
+
+UNUSED
+static uint64_t hash_string_view(const string_view_t view, const uint64_t seed) {
+    return hash_bytes(view.str, view.len, seed);
+}
+
+// Hash count views into hashes, the seed is mixed once and the data of the
+// next views is prefetched
+UNUSED
+static void hash_string_views(
+    const string_view_t* views, const size_t count, const uint64_t seed, uint64_t* hashes
+) {
+    const uint64_t mixed = hash_seed(seed);
+    for (size_t i = 0; i < count; i++) {
+#ifdef __GNUC__
+        if (i + 4 < count)
+            __builtin_prefetch(views[i + 4].str);
+#endif
+        hashes[i] = hash_bytes_seeded(views[i].str, views[i].len, mixed);
+    }
+}
+
+#endif //CUTILS_HASH_H
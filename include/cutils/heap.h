@@ -0,0 +1,262 @@
+#ifndef CUTILS_HEAP_H
+#define CUTILS_HEAP_H
+
+#include <cutils/allocator/alloc.h>
+#include <cutils/compatibility.h>
+#include <cutils/minmax.h>
+#include <cutils/when_macros.h>
+#include <stddef.h>
+#include <assert.h>
+
+// Number of children of a node, 4 keeps the siblings in one cache line for
+// small elements and halves the depth of a binary heap
+#ifndef HEAP_DEFAULT_ARITY
+#define HEAP_DEFAULT_ARITY 4
+#endif
+
+// Position of an index which is not in an indexed heap
+#define HEAP_NO_POSITION ((unsigned)-1)
+
+#define EMPTY_HEAP(name) (name ## _heap_t) { .array = { .length = 0, .capacity = 0, .data = NULL } }
+
+#define heap_empty(heap) ((heap).array.length == 0)
+#define heap_length(heap) ((heap).array.length)
+
+// Called each time an element is written in a slot of the heap
+#define HEAP_NO_HOOK(name, heap, slot) ((void)0)
+#define HEAP_POSITION_HOOK(name, heap, slot) heap_update_position_ ## name(heap, slot)
+// Called when the element of a slot leaves the heap
+#define HEAP_POSITION_UNHOOK(name, heap, slot) heap_clear_position_ ## name(heap, slot)
+
+/*
+ * Priority queues stored in a name ## _array_t (defined beforehand with
+ * DEFINE_ARRAY_TYPE or DEFINE_ARRAY_TYPE_WITH_ALLOCATOR).
+ * cmp(const type* a, const type* b) < 0 when a should be popped before b, it
+ * can be a function or a macro and is called directly.
+ */
+#define DEFINE_HEAP_TYPE(type, cmp)                                             \
+    DEFINE_HEAP_TYPE_WITH_ARITY(type, type, cmp, HEAP_DEFAULT_ARITY)
+
+#define DEFINE_HEAP_TYPE_WITH_ARITY(name, type, cmp, arity)                     \
+    typedef struct {                                                            \
+        name ## _array_t array;                                                 \
+    } name ## _heap_t;                                                          \
+                                                                                \
+    DEFINE_HEAP_OPERATIONS(name, type, cmp, arity, HEAP_NO_HOOK, HEAP_NO_HOOK)  \
+                                                                                \
+    UNUSED NODISCARD static bool heap_push_ ## name(                            \
+        name ## _heap_t* heap, const type* item                                 \
+    ) {                                                                         \
+        return heap_insert_ ## name(heap, item);                                \
+    }                                                                           \
+                                                                                \
+    UNUSED static void heap_free_ ## name(name ## _heap_t* heap) {              \
+        array_free_ ## name(&heap->array);                                      \
+    }                                                                           \
+                                                                                \
+    /* Floyd's bottom-up construction of the heap from the array content */     \
+    UNUSED static void heap_heapify_ ## name(name ## _heap_t* heap) {           \
+        if (heap->array.length < 2)                                             \
+            return;                                                             \
+        for (unsigned slot = (heap->array.length - 2) / (arity) + 1; slot-- > 0;) \
+            heap_sift_down_ ## name(heap, slot);                                \
+    }                                                                           \
+                                                                                \
+    /* Take ownership of the array and turn it into a heap in O(n) */           \
+    UNUSED static name ## _heap_t heap_from_array_ ## name(name ## _array_t array) { \
+        name ## _heap_t heap = { .array = array };                              \
+        heap_heapify_ ## name(&heap);                                           \
+        return heap;                                                            \
+    }                                                                           \
+                                                                                \
+    /* Top-K mode: keep the count elements popped last, the top of the heap */  \
+    /* being the worst of them. Returns true if the item was kept. */           \
+    UNUSED static bool heap_push_bounded_ ## name(                              \
+        name ## _heap_t* heap, const type* item, unsigned count                 \
+    ) {                                                                         \
+        if (heap->array.length < count)                                         \
+            return heap_push_ ## name(heap, item);                              \
+        if (count == 0 || !(cmp(&heap->array.data[0], item) < 0))               \
+            return false;                                                       \
+        heap->array.data[0] = *item;                                            \
+        heap_sift_down_ ## name(heap, 0);                                       \
+        return true;                                                            \
+    }
+
+/*
+ * Indexed priority queue: index_of(const type*) gives a unique unsigned
+ * index per element, used to find its position for heap_update and
+ * heap_remove (decrease-key).
+ */
+#define DEFINE_INDEXED_HEAP_TYPE(name, type, cmp, index_of, arity)              \
+    typedef struct {                                                            \
+        name ## _array_t array;                                                 \
+        unsigned* position;                                                     \
+        unsigned position_capacity;                                             \
+    } name ## _heap_t;                                                          \
+                                                                                \
+    UNUSED static void heap_update_position_ ## name(                           \
+        name ## _heap_t* heap, unsigned slot                                    \
+    ) {                                                                         \
+        heap->position[index_of(&heap->array.data[slot])] = slot;               \
+    }                                                                           \
+                                                                                \
+    UNUSED static void heap_clear_position_ ## name(                            \
+        name ## _heap_t* heap, unsigned slot                                    \
+    ) {                                                                         \
+        heap->position[index_of(&heap->array.data[slot])] = HEAP_NO_POSITION;   \
+    }                                                                           \
+                                                                                \
+    DEFINE_HEAP_OPERATIONS(name, type, cmp, arity, HEAP_POSITION_HOOK, HEAP_POSITION_UNHOOK) \
+                                                                                \
+    UNUSED static void heap_free_ ## name(name ## _heap_t* heap) {              \
+        array_free_ ## name(&heap->array);                                      \
+        CUTILS_dealloc(heap->position);                                         \
+        heap->position = NULL;                                                  \
+        heap->position_capacity = 0;                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool heap_contains_ ## name(                                  \
+        const name ## _heap_t* heap, unsigned index                             \
+    ) {                                                                         \
+        return index < heap->position_capacity                                  \
+            && heap->position[index] != HEAP_NO_POSITION;                       \
+    }                                                                           \
+                                                                                \
+    UNUSED static type* heap_find_ ## name(name ## _heap_t* heap, unsigned index) { \
+        if (!heap_contains_ ## name(heap, index))                               \
+            return NULL;                                                        \
+        return &heap->array.data[heap->position[index]];                        \
+    }                                                                           \
+                                                                                \
+    /* Push the item, or replace the element with the same index */             \
+    UNUSED NODISCARD static bool heap_update_ ## name(                          \
+        name ## _heap_t* heap, const type* item                                 \
+    ) {                                                                         \
+        const unsigned index = index_of(item);                                  \
+        if (index >= heap->position_capacity) {                                 \
+            unsigned capacity = MAX(heap->position_capacity * 2, index + 1);    \
+            unsigned* position = CUTILS_realloc(heap->position,                 \
+                capacity * sizeof(unsigned));                                   \
+            when_null_ret(position, false);                                     \
+            for (unsigned i = heap->position_capacity; i < capacity; i++)       \
+                position[i] = HEAP_NO_POSITION;                                 \
+            heap->position = position;                                          \
+            heap->position_capacity = capacity;                                 \
+        }                                                                       \
+        const unsigned slot = heap->position[index];                            \
+        if (slot == HEAP_NO_POSITION)                                           \
+            return heap_insert_ ## name(heap, item);                            \
+        const bool up = cmp(item, &heap->array.data[slot]) < 0;                 \
+        heap->array.data[slot] = *item;                                         \
+        if (up)                                                                 \
+            heap_sift_up_ ## name(heap, slot);                                  \
+        else                                                                    \
+            heap_sift_down_ ## name(heap, slot);                                \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    /* Same as heap_update, an element with the index of item is replaced */    \
+    UNUSED NODISCARD static bool heap_push_ ## name(                            \
+        name ## _heap_t* heap, const type* item                                 \
+    ) {                                                                         \
+        return heap_update_ ## name(heap, item);                                \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool heap_remove_ ## name(                                    \
+        name ## _heap_t* heap, unsigned index, type* value                      \
+    ) {                                                                         \
+        if (!heap_contains_ ## name(heap, index))                               \
+            return false;                                                       \
+        const unsigned slot = heap->position[index];                            \
+        if (value != NULL)                                                      \
+            *value = heap->array.data[slot];                                    \
+        heap->position[index] = HEAP_NO_POSITION;                               \
+        heap->array.length -= 1;                                                \
+        if (slot == heap->array.length)                                         \
+            return true;                                                        \
+        const bool up = cmp(&heap->array.data[heap->array.length],              \
+            &heap->array.data[slot]) < 0;                                       \
+        heap->array.data[slot] = heap->array.data[heap->array.length];          \
+        if (up)                                                                 \
+            heap_sift_up_ ## name(heap, slot);                                  \
+        else                                                                    \
+            heap_sift_down_ ## name(heap, slot);                                \
+        return true;                                                            \
+    }
+
+#define DEFINE_HEAP_OPERATIONS(name, type, cmp, arity, hook, unhook)            \
+    UNUSED static void heap_sift_up_ ## name(                                   \
+        name ## _heap_t* heap, unsigned slot                                    \
+    ) {                                                                         \
+        type* data = heap->array.data;                                          \
+        const type item = data[slot];                                           \
+        while (slot > 0) {                                                      \
+            const unsigned parent = (slot - 1) / (arity);                       \
+            if (!(cmp(&item, &data[parent]) < 0))                               \
+                break;                                                          \
+            data[slot] = data[parent];                                          \
+            hook(name, heap, slot);                                             \
+            slot = parent;                                                      \
+        }                                                                       \
+        data[slot] = item;                                                      \
+        hook(name, heap, slot);                                                 \
+    }                                                                           \
+                                                                                \
+    UNUSED static void heap_sift_down_ ## name(                                 \
+        name ## _heap_t* heap, unsigned slot                                    \
+    ) {                                                                         \
+        type* data = heap->array.data;                                          \
+        const unsigned length = heap->array.length;                             \
+        const type item = data[slot];                                           \
+        for (;;) {                                                              \
+            const unsigned first = slot * (arity) + 1;                          \
+            if (first >= length)                                                \
+                break;                                                          \
+            const unsigned last = MIN(first + (arity), length);                 \
+            unsigned best = first;                                              \
+            for (unsigned child = first + 1; child < last; child++)             \
+                if (cmp(&data[child], &data[best]) < 0)                         \
+                    best = child;                                               \
+            if (!(cmp(&data[best], &item) < 0))                                 \
+                break;                                                          \
+            data[slot] = data[best];                                            \
+            hook(name, heap, slot);                                             \
+            slot = best;                                                        \
+        }                                                                       \
+        data[slot] = item;                                                      \
+        hook(name, heap, slot);                                                 \
+    }                                                                           \
+                                                                                \
+    /* Append and sift up, the indexed heaps grow their positions first */      \
+    UNUSED NODISCARD static bool heap_insert_ ## name(                          \
+        name ## _heap_t* heap, const type* item                                 \
+    ) {                                                                         \
+        type* slot = array_append_ ## name(&heap->array, 1);                    \
+        when_null_ret(slot, false);                                             \
+        *slot = *item;                                                          \
+        heap_sift_up_ ## name(heap, heap->array.length - 1);                    \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static type* heap_top_ ## name(name ## _heap_t* heap) {              \
+        if (heap->array.length == 0)                                            \
+            return NULL;                                                        \
+        return &heap->array.data[0];                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool heap_pop_ ## name(name ## _heap_t* heap, type* value) {  \
+        if (heap->array.length == 0)                                            \
+            return false;                                                       \
+        if (value != NULL)                                                      \
+            *value = heap->array.data[0];                                       \
+        unhook(name, heap, 0);                                                  \
+        heap->array.length -= 1;                                                \
+        if (heap->array.length != 0) {                                          \
+            heap->array.data[0] = heap->array.data[heap->array.length];         \
+            heap_sift_down_ ## name(heap, 0);                                   \
+        }                                                                       \
+        return true;                                                            \
+    }
+
+#endif //CUTILS_HEAP_H
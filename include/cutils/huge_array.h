@@ -0,0 +1,268 @@
+#ifndef CUTILS_HUGE_ARRAY_H
+#define CUTILS_HUGE_ARRAY_H
+
+#include <cutils/allocator/allocator.h>
+#include <cutils/compatibility.h>
+#include <cutils/instrument.h>
+#include <cutils/minmax.h>
+#include <cutils/when_macros.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef CUTILS_NO_STD
+#include <string.h>
+#endif
+
+/*
+ * Arrays of more than 4G elements or bytes: the length and capacity are
+ * size_t and the growth fails instead of wrapping around when the size in
+ * bytes would not fit in a size_t.
+ *
+ * Below CUTILS_HUGE_ARRAY_MAP_THRESHOLD bytes the elements come from the
+ * allocator binding, above they live in an anonymous private mapping whose
+ * growth is an mremap(MREMAP_MAYMOVE): the kernel moves the page tables and
+ * the elements are never copied. Created with HUGE_ARRAY_HUGE_PAGES, the
+ * mappings are advised to be backed by transparent huge pages.
+ *
+ * mremap and MADV_HUGEPAGE are Linux extensions, glibc only declares them
+ * when _GNU_SOURCE is defined before the first include. Without them a
+ * mapping grows by mapping a new one and copying, without MAP_ANONYMOUS
+ * (Windows, strict ISO modes without _DEFAULT_SOURCE) the binding is used
+ * at every size.
+ */
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(MAP_ANONYMOUS)
+#define CUTILS_HUGE_ARRAY_MAP
+#endif
+#endif
+
+#ifndef CUTILS_HUGE_ARRAY_MAP_THRESHOLD
+#define CUTILS_HUGE_ARRAY_MAP_THRESHOLD ((size_t)2 << 20)
+#endif
+
+#ifndef HUGE_ARRAY_MIN_CAPACITY
+#define HUGE_ARRAY_MIN_CAPACITY 64
+#endif
+
+// Advise the mappings to use transparent huge pages
+#define HUGE_ARRAY_HUGE_PAGES 1
+
+#define EMPTY_HUGE_ARRAY(name) (name ## _huge_array_t) { .length = 0, .capacity = 0, .data = NULL, .flags = 0 }
+#define HUGE_ARRAY_INIT(name, huge_flags) \
+    (name ## _huge_array_t) { .length = 0, .capacity = 0, .data = NULL, .flags = (huge_flags) }
+#define EMPTY_HUGE_ARRAY_WITH_ALLOCATOR(name, state, huge_flags) \
+    (name ## _huge_array_t) { .length = 0, .capacity = 0, .data = NULL, .flags = (huge_flags), .allocator = (state) }
+
+// Whether a buffer of size bytes is a mapping
+UNUSED
+static bool huge_array_is_mapped(const size_t size) {
+#ifdef CUTILS_HUGE_ARRAY_MAP
+    return size >= CUTILS_HUGE_ARRAY_MAP_THRESHOLD;
+#else
+    (void)size;
+    return false;
+#endif
+}
+
+#ifdef CUTILS_HUGE_ARRAY_MAP
+
+// Size of the mapping holding size bytes
+UNUSED
+static size_t huge_array_mapping_size(const size_t size) {
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return size > SIZE_MAX - (page - 1) ? 0 : (size + page - 1) & ~(page - 1);
+}
+
+UNUSED
+static void huge_array_advise(void* memory, const size_t size, const unsigned flags) {
+#ifdef MADV_HUGEPAGE
+    if (flags & HUGE_ARRAY_HUGE_PAGES)
+        madvise(memory, size, MADV_HUGEPAGE);
+#else
+    (void)memory, (void)size, (void)flags;
+#endif
+}
+
+UNUSED NODISCARD
+static void* huge_array_map(const size_t size, const unsigned flags) {
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    when_true_ret(memory == MAP_FAILED, NULL);
+    huge_array_advise(memory, size, flags);
+    return memory;
+}
+
+// Grow a mapping of old_size bytes, used bytes of which are copied if it
+// cannot be extended in place
+UNUSED NODISCARD
+static void* huge_array_remap(
+    void* memory, const size_t old_size, const size_t used, const size_t size, const unsigned flags
+) {
+#ifdef MREMAP_MAYMOVE
+    (void)used;
+    void* moved = mremap(memory, old_size, size, MREMAP_MAYMOVE);
+    when_true_ret(moved == MAP_FAILED, NULL);
+    huge_array_advise(moved, size, flags);
+#else
+    void* moved = huge_array_map(size, flags);
+    when_null_ret(moved, NULL);
+    memcpy(moved, memory, used);
+    munmap(memory, old_size);
+#endif
+    return moved;
+}
+
+#endif
+
+#define DEFINE_HUGE_ARRAY_TYPE(type)                                            \
+    DEFINE_HUGE_ARRAY_TYPE_WITH_ALLOCATOR(type, type, heap)
+
+#define DEFINE_INTERFACE_HUGE_ARRAY_TYPE(type)                                  \
+    DEFINE_INTERFACE_HUGE_ARRAY_TYPE_WITH_ALLOCATOR(type, type, heap)
+
+#define DEFINE_IMPLEMENTATION_HUGE_ARRAY_TYPE(type)                             \
+    DEFINE_IMPLEMENTATION_HUGE_ARRAY_TYPE_WITH_ALLOCATOR(type, type, heap)
+
+// Define name ## _huge_array_t, an array of type taking its memory from the
+// allocator binding (see allocator.h) below CUTILS_HUGE_ARRAY_MAP_THRESHOLD
+// bytes and from anonymous mappings above
+#define DEFINE_HUGE_ARRAY_TYPE_WITH_ALLOCATOR(name, type, binding)              \
+    DEFINE_INTERFACE_HUGE_ARRAY_TYPE_WITH_ALLOCATOR(name, type, binding)        \
+    DEFINE_IMPLEMENTATION_HUGE_ARRAY_TYPE_WITH_ALLOCATOR(name, type, binding)
+
+#define DEFINE_INTERFACE_HUGE_ARRAY_TYPE_WITH_ALLOCATOR(name, type, binding)    \
+    typedef struct {                                                            \
+        size_t length;                                                          \
+        size_t capacity;                                                        \
+        type *data;                                                             \
+        unsigned flags;                                                         \
+        binding ## _binding_member                                              \
+    } name ## _huge_array_t;
+
+#ifdef CUTILS_HUGE_ARRAY_MAP
+#define CUTILS_HUGE_ARRAY_GROW_MAPPED(name, type, binding)                      \
+    if (huge_array_is_mapped(size)) {                                           \
+        /* The whole pages of the mapping are usable */                         \
+        when_true_ret(huge_array_mapping_size(size) == 0, false);               \
+        capacity = huge_array_mapping_size(size) / sizeof(type);                \
+        size = huge_array_mapping_size(capacity * sizeof(type));                \
+        if (old_mapped) {                                                       \
+            memory = huge_array_remap(array->data,                              \
+                huge_array_mapping_size(old_size),                              \
+                array->length * sizeof(type), size, array->flags);              \
+            when_null_ret(memory, false);                                       \
+            INSTRUMENT(huge_array, name, INSTRUMENT_REALLOCATION, 1);           \
+        } else {                                                                \
+            memory = huge_array_map(size, array->flags);                        \
+            when_null_ret(memory, false);                                       \
+            if (array->capacity != 0) {                                         \
+                memcpy(memory, array->data, array->length * sizeof(type));      \
+                INSTRUMENT(huge_array, name, INSTRUMENT_REALLOCATION, 1);       \
+                INSTRUMENT(huge_array, name, INSTRUMENT_BYTES_MOVED,            \
+                    array->length * sizeof(type));                              \
+                binding ## _binding_dealloc(binding ## _binding_state(array),   \
+                    array->data, old_size);                                     \
+            }                                                                   \
+        }                                                                       \
+    } else
+#define CUTILS_HUGE_ARRAY_FREE_MAPPED(array, type)                              \
+    if (huge_array_is_mapped((array)->capacity * sizeof(type)))                 \
+        munmap((array)->data,                                                   \
+               huge_array_mapping_size((array)->capacity * sizeof(type)));      \
+    else
+#else
+#define CUTILS_HUGE_ARRAY_GROW_MAPPED(name, type, binding)
+#define CUTILS_HUGE_ARRAY_FREE_MAPPED(array, type)
+#endif
+
+#define DEFINE_IMPLEMENTATION_HUGE_ARRAY_TYPE_WITH_ALLOCATOR(name, type, binding) \
+    INSTRUMENT_DEFINE(huge_array, name)                                         \
+                                                                                \
+    /* Make room for capacity elements, false if their size overflows or the    \
+       allocation fails */                                                      \
+    UNUSED NODISCARD static bool huge_array_reserve_ ## name(                   \
+        name ## _huge_array_t *array, size_t capacity                           \
+    ) {                                                                         \
+        if (capacity <= array->capacity)                                        \
+            return true;                                                        \
+        when_true_ret(capacity > SIZE_MAX / sizeof(type), false);               \
+        const size_t old_size = array->capacity * sizeof(type);                 \
+        const bool old_mapped = huge_array_is_mapped(old_size);                 \
+        size_t size = capacity * sizeof(type);                                  \
+        void* memory;                                                           \
+        (void)old_mapped;                                                       \
+        CUTILS_HUGE_ARRAY_GROW_MAPPED(name, type, binding)                      \
+        if (array->capacity == 0) {                                             \
+            memory = binding ## _binding_alloc(                                 \
+                binding ## _binding_state(array), size);                        \
+            when_null_ret(memory, false);                                       \
+        } else {                                                                \
+            memory = binding ## _binding_realloc(binding ## _binding_state(array), \
+                array->data, old_size, size);                                   \
+            when_null_ret(memory, false);                                       \
+            INSTRUMENT(huge_array, name, INSTRUMENT_REALLOCATION, 1);           \
+            /* The allocator copied the elements if it moved them */            \
+            if (memory != array->data)                                          \
+                INSTRUMENT(huge_array, name, INSTRUMENT_BYTES_MOVED,            \
+                    array->length * sizeof(type));                              \
+        }                                                                       \
+        INSTRUMENT(huge_array, name, INSTRUMENT_CAPACITY, capacity);            \
+        array->data = memory;                                                   \
+        array->capacity = capacity;                                             \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED NODISCARD static type *huge_array_append_ ## name(                   \
+        name ## _huge_array_t *array, size_t count                              \
+    ) {                                                                         \
+        if (count == 0)                                                         \
+            return NULL;                                                        \
+        when_true_ret(count > SIZE_MAX / sizeof(type) - array->length, NULL);   \
+        const size_t length = array->length + count;                            \
+        if (array->capacity < length) {                                         \
+            const size_t max = SIZE_MAX / sizeof(type);                         \
+            size_t capacity = array->capacity > max / 2                         \
+                ? max : array->capacity * 2;                                    \
+            capacity = MAX(capacity, length);                                   \
+            capacity = MAX(capacity, HUGE_ARRAY_MIN_CAPACITY);                  \
+            when_false_ret(huge_array_reserve_ ## name(array, capacity), NULL); \
+        }                                                                       \
+        type* ret = &array->data[array->length];                                \
+        array->length = length;                                                 \
+        return ret;                                                             \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool huge_array_pop_ ## name(                                 \
+        name ## _huge_array_t *array, type* value                               \
+    ) {                                                                         \
+        if (array->length == 0)                                                 \
+            return false;                                                       \
+        array->length -= 1;                                                     \
+        if (value != NULL)                                                      \
+            memcpy(value, &array->data[array->length], sizeof(type));           \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static void huge_array_swap_and_pop_back_ ## name(                   \
+        name ## _huge_array_t *array, size_t index                              \
+    ) {                                                                         \
+        array->length--;                                                        \
+        if (index != array->length)                                             \
+            memcpy(array->data + index, array->data + array->length,            \
+                   sizeof(type));                                               \
+    }                                                                           \
+                                                                                \
+    UNUSED static void huge_array_free_ ## name(name ## _huge_array_t *array) { \
+        if (array->capacity != 0) {                                             \
+            CUTILS_HUGE_ARRAY_FREE_MAPPED(array, type)                          \
+            binding ## _binding_dealloc(binding ## _binding_state(array),       \
+                array->data, array->capacity * sizeof(type));                   \
+        }                                                                       \
+        array->length = 0;                                                      \
+        array->capacity = 0;                                                    \
+        array->data = NULL;                                                     \
+    }
+
+#endif //CUTILS_HUGE_ARRAY_H
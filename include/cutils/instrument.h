@@ -0,0 +1,186 @@
+#ifndef CUTILS_INSTRUMENT_H
+#define CUTILS_INSTRUMENT_H
+
+#include <cutils/compatibility.h>
+
+/*
+ * Opt-in counters of the containers, enabled by defining CUTILS_INSTRUMENT
+ * before including them. Each container kind and type name (array of int,
+ * ring of event_t...) gets its own instrument_stats_t holding the number of
+ * reallocations, the bytes copied or moved inside the container, the peak
+ * capacity and, depending on the container:
+ * - the elements overwritten by a forced push or dropped by a push on a full
+ *   ring,
+ * - the nodes allocated by the lock-free stacks and queues,
+ * - the slots probed past the home slot of a key by the concurrent maps.
+ *
+ * The containers which are not generated per type get fixed names:
+ * "array_list untyped" for the array lists, "timer_wheel pool" for the
+ * nodes of the timer wheels and "timer_wheel bucket" for their slots.
+ *
+ * Without CUTILS_INSTRUMENT the INSTRUMENT macros expand to nothing. The
+ * statistics are per translation unit, like the generated functions, and are
+ * updated with relaxed atomics when the compiler has the GNU builtins.
+ */
+
+typedef enum {
+    INSTRUMENT_REALLOCATION,
+    INSTRUMENT_BYTES_MOVED,
+    INSTRUMENT_CAPACITY,
+    INSTRUMENT_OVERWRITE,
+    INSTRUMENT_DROP,
+    INSTRUMENT_ALLOCATION,
+    INSTRUMENT_PROBE,
+} instrument_event_t;
+
+#ifdef CUTILS_INSTRUMENT
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct instrument_stats {
+    const char* container;
+    const char* name;
+    uint64_t reallocations;
+    uint64_t bytes_moved;
+    uint64_t peak_capacity;
+    uint64_t overwrites;
+    uint64_t drops;
+    uint64_t allocations;
+    uint64_t probes;
+    // Statistics are listed once they record their first event
+    struct instrument_stats* next;
+    bool registered;
+} instrument_stats_t;
+
+// Called after every recorded event with the updated statistics
+typedef void (*instrument_hook_t)(
+    const instrument_stats_t* stats, instrument_event_t event, uint64_t value, void* data);
+
+UNUSED static instrument_stats_t* instrument_list;
+UNUSED static instrument_hook_t instrument_hook;
+UNUSED static void* instrument_hook_data;
+
+UNUSED
+static void instrument_set_hook(const instrument_hook_t hook, void* data) {
+    instrument_hook_data = data;
+    instrument_hook = hook;
+}
+
+#ifdef __GNUC__
+#define INSTRUMENT_ADD(counter, value) __atomic_fetch_add(&(counter), value, __ATOMIC_RELAXED)
+#else
+#define INSTRUMENT_ADD(counter, value) ((counter) += (value))
+#endif
+
+UNUSED
+static void instrument_register(instrument_stats_t* stats) {
+#ifdef __GNUC__
+    if (__atomic_exchange_n(&stats->registered, true, __ATOMIC_ACQ_REL))
+        return;
+    stats->next = __atomic_load_n(&instrument_list, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&instrument_list, &stats->next, stats, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+#else
+    if (stats->registered)
+        return;
+    stats->registered = true;
+    stats->next = instrument_list;
+    instrument_list = stats;
+#endif
+}
+
+UNUSED
+static void instrument_record(instrument_stats_t* stats, const instrument_event_t event, const uint64_t value) {
+    instrument_register(stats);
+    switch (event) {
+    case INSTRUMENT_REALLOCATION:
+        INSTRUMENT_ADD(stats->reallocations, value);
+        break;
+    case INSTRUMENT_BYTES_MOVED:
+        INSTRUMENT_ADD(stats->bytes_moved, value);
+        break;
+    case INSTRUMENT_CAPACITY: {
+#ifdef __GNUC__
+        uint64_t peak = __atomic_load_n(&stats->peak_capacity, __ATOMIC_RELAXED);
+        while (peak < value && !__atomic_compare_exchange_n(&stats->peak_capacity, &peak, value, true,
+                                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+#else
+        if (stats->peak_capacity < value)
+            stats->peak_capacity = value;
+#endif
+        break;
+    }
+    case INSTRUMENT_OVERWRITE:
+        INSTRUMENT_ADD(stats->overwrites, value);
+        break;
+    case INSTRUMENT_DROP:
+        INSTRUMENT_ADD(stats->drops, value);
+        break;
+    case INSTRUMENT_ALLOCATION:
+        INSTRUMENT_ADD(stats->allocations, value);
+        break;
+    case INSTRUMENT_PROBE:
+        INSTRUMENT_ADD(stats->probes, value);
+        break;
+    }
+    const instrument_hook_t hook = instrument_hook;
+    if (hook != NULL)
+        hook(stats, event, value, instrument_hook_data);
+}
+
+// Statistics of the containers which recorded an event, most recent first
+UNUSED
+static const instrument_stats_t* instrument_first(void) {
+#ifdef __GNUC__
+    return __atomic_load_n(&instrument_list, __ATOMIC_ACQUIRE);
+#else
+    return instrument_list;
+#endif
+}
+
+UNUSED
+static void instrument_dump(FILE* out) {
+    for (const instrument_stats_t* s = instrument_first(); s != NULL; s = s->next) {
+        fprintf(out, "%s %s: %llu reallocations, %llu bytes moved, peak capacity %llu",
+                s->container, s->name, (unsigned long long)s->reallocations,
+                (unsigned long long)s->bytes_moved, (unsigned long long)s->peak_capacity);
+        if (s->overwrites != 0 || s->drops != 0)
+            fprintf(out, ", %llu overwrites, %llu drops",
+                    (unsigned long long)s->overwrites, (unsigned long long)s->drops);
+        if (s->allocations != 0)
+            fprintf(out, ", %llu allocations", (unsigned long long)s->allocations);
+        if (s->probes != 0)
+            fprintf(out, ", %llu probes", (unsigned long long)s->probes);
+        fputc('\n', out);
+    }
+}
+
+// Zero the counters, the statistics stay listed
+UNUSED
+static void instrument_reset(void) {
+    for (instrument_stats_t* s = instrument_list; s != NULL; s = s->next) {
+        s->reallocations = 0;
+        s->bytes_moved = 0;
+        s->peak_capacity = 0;
+        s->overwrites = 0;
+        s->drops = 0;
+        s->allocations = 0;
+        s->probes = 0;
+    }
+}
+
+#define INSTRUMENT_STATS(container, name) (&instrument_ ## container ## _ ## name)
+#define INSTRUMENT_DEFINE(container, name) \
+    UNUSED static instrument_stats_t instrument_ ## container ## _ ## name = { #container, #name, 0, 0, 0, 0, 0, 0, 0, NULL, false };
+#define INSTRUMENT(container, name, event, value) \
+    instrument_record(INSTRUMENT_STATS(container, name), event, (uint64_t)(value))
+
+#else
+
+#define INSTRUMENT_DEFINE(container, name)
+#define INSTRUMENT(container, name, event, value) ((void)0)
+
+#endif
+
+#endif //CUTILS_INSTRUMENT_H
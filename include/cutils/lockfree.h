@@ -0,0 +1,229 @@
+#ifndef CUTILS_LOCKFREE_H
+#define CUTILS_LOCKFREE_H
+
+#include <cutils/compatibility.h>
+#include <cutils/ebr.h>
+#include <cutils/instrument.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/*
+ * Lock-free stack (Treiber) and FIFO queue (Michael-Scott) of type values.
+ * Their nodes come from the allocator of an EBR domain and are retired
+ * through it, every operation takes the ebr_thread_t of the calling thread
+ * and pins it. The links are tagged pointers: a pointer and a counter
+ * incremented by every successful compare-and-swap share one 64-bit atomic,
+ * so a node address coming back (ABA) never validates a stale swap.
+ *
+ * The pointer takes the low 48 bits on 64-bit targets (the user space
+ * addresses of x86-64 and AArch64) and the low 32 bits on 32-bit targets.
+ */
+
+typedef uint64_t tagged_ptr_t;
+
+#if UINTPTR_MAX > UINT32_MAX
+#define TAGGED_PTR_BITS 48
+#else
+#define TAGGED_PTR_BITS 32
+#endif
+
+#define TAGGED_PTR_MASK ((UINT64_C(1) << TAGGED_PTR_BITS) - 1)
+#define tagged_ptr_get(tagged) ((void*)(uintptr_t)((tagged) & TAGGED_PTR_MASK))
+#define tagged_ptr_tag(tagged) ((tagged) >> TAGGED_PTR_BITS)
+
+// Tagged pointer following previous with pointer, the tag wraps around
+UNUSED
+static tagged_ptr_t tagged_ptr_next(const tagged_ptr_t previous, void* pointer) {
+    return ((uint64_t)(uintptr_t)pointer & TAGGED_PTR_MASK)
+        | ((tagged_ptr_tag(previous) + 1) << TAGGED_PTR_BITS);
+}
+
+#define EMPTY_LOCKFREE_STACK(name) (name ## _lockfree_stack_t) { 0 }
+
+#define DEFINE_LOCKFREE_STACK_TYPE(type)                                        \
+    DEFINE_LOCKFREE_STACK_TYPE_WITH_NAME(type, type)
+
+#define DEFINE_LOCKFREE_STACK_TYPE_WITH_NAME(name, type)                        \
+    typedef struct name ## _lockfree_stack_node {                               \
+        /* Written before the node is published, never modified after */        \
+        struct name ## _lockfree_stack_node* next;                              \
+        type value;                                                             \
+    } name ## _lockfree_stack_node_t;                                           \
+                                                                                \
+    typedef struct {                                                            \
+        _Atomic(tagged_ptr_t) top;                                              \
+    } name ## _lockfree_stack_t;                                                \
+                                                                                \
+    INSTRUMENT_DEFINE(lockfree_stack, name)                                     \
+                                                                                \
+    UNUSED NODISCARD static bool lockfree_stack_push_ ## name(                  \
+        name ## _lockfree_stack_t* stack, ebr_thread_t* thread, const type* value \
+    ) {                                                                         \
+        name ## _lockfree_stack_node_t* node = allocator_alloc(                 \
+            &thread->domain->allocator, sizeof(name ## _lockfree_stack_node_t)); \
+        when_null_ret(node, false);                                             \
+        INSTRUMENT(lockfree_stack, name, INSTRUMENT_ALLOCATION, 1);             \
+        node->value = *value;                                                   \
+        tagged_ptr_t top = atomic_load_explicit(&stack->top, memory_order_relaxed); \
+        do {                                                                    \
+            node->next = tagged_ptr_get(top);                                   \
+        } while (!atomic_compare_exchange_weak_explicit(&stack->top, &top,      \
+            tagged_ptr_next(top, node), memory_order_release, memory_order_relaxed)); \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool lockfree_stack_pop_ ## name(                             \
+        name ## _lockfree_stack_t* stack, ebr_thread_t* thread, type* value     \
+    ) {                                                                         \
+        ebr_pin(thread);                                                        \
+        tagged_ptr_t top = atomic_load_explicit(&stack->top, memory_order_acquire); \
+        name ## _lockfree_stack_node_t* node;                                   \
+        do {                                                                    \
+            node = tagged_ptr_get(top);                                         \
+            if (node == NULL) {                                                 \
+                ebr_unpin(thread);                                              \
+                return false;                                                   \
+            }                                                                   \
+            /* The pin keeps node readable even if another thread pops it */    \
+        } while (!atomic_compare_exchange_weak_explicit(&stack->top, &top,      \
+            tagged_ptr_next(top, node->next), memory_order_acquire, memory_order_acquire)); \
+        if (value != NULL)                                                      \
+            *value = node->value;                                               \
+        ebr_retire(thread, node);                                               \
+        ebr_unpin(thread);                                                      \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    /* Free the remaining nodes, no thread may use the stack anymore */         \
+    UNUSED static void lockfree_stack_free_ ## name(                            \
+        name ## _lockfree_stack_t* stack, ebr_domain_t* domain                  \
+    ) {                                                                         \
+        name ## _lockfree_stack_node_t* node = tagged_ptr_get(atomic_load(&stack->top)); \
+        while (node != NULL) {                                                  \
+            name ## _lockfree_stack_node_t* next = node->next;                  \
+            allocator_binding_dealloc(&domain->allocator, node, 0);             \
+            node = next;                                                        \
+        }                                                                       \
+        atomic_store(&stack->top, 0);                                           \
+    }
+
+// Size of the padding between the head and the tail of the queues
+#define LOCKFREE_CACHE_LINE 64
+
+#define DEFINE_LOCKFREE_QUEUE_TYPE(type)                                        \
+    DEFINE_LOCKFREE_QUEUE_TYPE_WITH_NAME(type, type)
+
+#define DEFINE_LOCKFREE_QUEUE_TYPE_WITH_NAME(name, type)                        \
+    typedef struct {                                                            \
+        _Atomic(tagged_ptr_t) next;                                             \
+        type value;                                                             \
+    } name ## _lockfree_queue_node_t;                                           \
+                                                                                \
+    /* head points to a dummy node, the values are in the nodes after it */     \
+    typedef struct {                                                            \
+        _Atomic(tagged_ptr_t) head;                                             \
+        char padding[LOCKFREE_CACHE_LINE - sizeof(tagged_ptr_t)];               \
+        _Atomic(tagged_ptr_t) tail;                                             \
+    } name ## _lockfree_queue_t;                                                \
+                                                                                \
+    INSTRUMENT_DEFINE(lockfree_queue, name)                                     \
+                                                                                \
+    UNUSED NODISCARD static bool lockfree_queue_init_ ## name(                  \
+        name ## _lockfree_queue_t* queue, ebr_domain_t* domain                  \
+    ) {                                                                         \
+        name ## _lockfree_queue_node_t* dummy = allocator_alloc(                \
+            &domain->allocator, sizeof(name ## _lockfree_queue_node_t));        \
+        when_null_ret(dummy, false);                                            \
+        INSTRUMENT(lockfree_queue, name, INSTRUMENT_ALLOCATION, 1);             \
+        atomic_init(&dummy->next, 0);                                           \
+        atomic_init(&queue->head, tagged_ptr_next(0, dummy));                   \
+        atomic_init(&queue->tail, tagged_ptr_next(0, dummy));                   \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED NODISCARD static bool lockfree_queue_push_ ## name(                  \
+        name ## _lockfree_queue_t* queue, ebr_thread_t* thread, const type* value \
+    ) {                                                                         \
+        name ## _lockfree_queue_node_t* node = allocator_alloc(                 \
+            &thread->domain->allocator, sizeof(name ## _lockfree_queue_node_t)); \
+        when_null_ret(node, false);                                             \
+        INSTRUMENT(lockfree_queue, name, INSTRUMENT_ALLOCATION, 1);             \
+        node->value = *value;                                                   \
+        atomic_init(&node->next, 0);                                            \
+        ebr_pin(thread);                                                        \
+        tagged_ptr_t tail;                                                      \
+        for (;;) {                                                              \
+            tail = atomic_load_explicit(&queue->tail, memory_order_acquire);    \
+            name ## _lockfree_queue_node_t* last = tagged_ptr_get(tail);        \
+            tagged_ptr_t next = atomic_load_explicit(&last->next, memory_order_acquire); \
+            if (tail != atomic_load_explicit(&queue->tail, memory_order_acquire)) \
+                continue;                                                       \
+            if (tagged_ptr_get(next) == NULL) {                                 \
+                if (atomic_compare_exchange_weak_explicit(&last->next, &next,   \
+                    tagged_ptr_next(next, node), memory_order_release, memory_order_relaxed)) \
+                    break;                                                      \
+            } else {                                                            \
+                /* Help the thread which linked next to swing the tail */       \
+                atomic_compare_exchange_weak_explicit(&queue->tail, &tail,      \
+                    tagged_ptr_next(tail, tagged_ptr_get(next)),                \
+                    memory_order_release, memory_order_relaxed);                \
+            }                                                                   \
+        }                                                                       \
+        atomic_compare_exchange_strong_explicit(&queue->tail, &tail, tagged_ptr_next(tail, node), \
+            memory_order_release, memory_order_relaxed);                        \
+        ebr_unpin(thread);                                                      \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool lockfree_queue_pop_ ## name(                             \
+        name ## _lockfree_queue_t* queue, ebr_thread_t* thread, type* value     \
+    ) {                                                                         \
+        ebr_pin(thread);                                                        \
+        tagged_ptr_t head;                                                      \
+        for (;;) {                                                              \
+            head = atomic_load_explicit(&queue->head, memory_order_acquire);    \
+            tagged_ptr_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire); \
+            name ## _lockfree_queue_node_t* first = tagged_ptr_get(head);       \
+            const tagged_ptr_t next = atomic_load_explicit(&first->next, memory_order_acquire); \
+            name ## _lockfree_queue_node_t* second = tagged_ptr_get(next);      \
+            if (head != atomic_load_explicit(&queue->head, memory_order_acquire)) \
+                continue;                                                       \
+            if (first == tagged_ptr_get(tail)) {                                \
+                if (second == NULL) {                                           \
+                    ebr_unpin(thread);                                          \
+                    return false;                                               \
+                }                                                               \
+                atomic_compare_exchange_weak_explicit(&queue->tail, &tail,      \
+                    tagged_ptr_next(tail, second), memory_order_release, memory_order_relaxed); \
+                continue;                                                       \
+            }                                                                   \
+            /* Read before the swap, second may be popped and retired after */  \
+            const type read = second->value;                                    \
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &head,      \
+                tagged_ptr_next(head, second), memory_order_acquire, memory_order_relaxed)) { \
+                if (value != NULL)                                              \
+                    *value = read;                                              \
+                break;                                                          \
+            }                                                                   \
+        }                                                                       \
+        /* The old dummy is unreachable, second is the new one */               \
+        ebr_retire(thread, tagged_ptr_get(head));                               \
+        ebr_unpin(thread);                                                      \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    /* Free the remaining nodes, no thread may use the queue anymore */         \
+    UNUSED static void lockfree_queue_free_ ## name(                            \
+        name ## _lockfree_queue_t* queue, ebr_domain_t* domain                  \
+    ) {                                                                         \
+        name ## _lockfree_queue_node_t* node = tagged_ptr_get(atomic_load(&queue->head)); \
+        while (node != NULL) {                                                  \
+            name ## _lockfree_queue_node_t* next = tagged_ptr_get(atomic_load(&node->next)); \
+            allocator_binding_dealloc(&domain->allocator, node, 0);             \
+            node = next;                                                        \
+        }                                                                       \
+        atomic_store(&queue->head, 0);                                          \
+        atomic_store(&queue->tail, 0);                                          \
+    }
+
+#endif //CUTILS_LOCKFREE_H
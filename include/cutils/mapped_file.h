@@ -0,0 +1,116 @@
+#ifndef CUTILS_MAPPED_FILE_H
+#define CUTILS_MAPPED_FILE_H
+
+#include <cutils/compatibility.h>
+#include <cutils/errors.h>
+#include <cutils/string.h>
+#include <stddef.h>
+
+/*
+ * Read-only memory mapping of a whole file, exposed as a string_view_t so it
+ * can be iterated with string_split/string_lines or cut with string_chunks
+ * without copying. The pages are loaded on demand by the system.
+ *
+ * On POSIX systems the mapping is advised sequential. In the strict ISO
+ * modes (-std=c11) glibc hides posix_madvise and its constants unless
+ * _POSIX_C_SOURCE or _DEFAULT_SOURCE is defined before the first include,
+ * so they are declared here in that case.
+ */
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef POSIX_MADV_SEQUENTIAL
+// Declared here as glibc hides it in the strict ISO modes, the value is the
+// same on Linux, the BSDs and macOS
+int posix_madvise(void* addr, size_t len, int advice);
+#define POSIX_MADV_SEQUENTIAL 2
+#endif
+#endif
+
+typedef struct {
+    string_view_t content;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} mapped_file_t;
+
+#ifdef _WIN32
+#define MAPPED_FILE_INIT { { "", 0 }, INVALID_HANDLE_VALUE, NULL }
+#else
+#define MAPPED_FILE_INIT { { "", 0 } }
+#endif
+
+UNUSED
+static void mapped_file_close(mapped_file_t* file) {
+#ifdef _WIN32
+    if (file->content.len != 0)
+        UnmapViewOfFile(file->content.str);
+    if (file->mapping != NULL)
+        CloseHandle(file->mapping);
+    if (file->file != INVALID_HANDLE_VALUE)
+        CloseHandle(file->file);
+#else
+    if (file->content.len != 0)
+        munmap(file->content.str, file->content.len);
+#endif
+    *file = (mapped_file_t) MAPPED_FILE_INIT;
+}
+
+// Map the file at path, returns -ERROR_IO if it cannot be opened or mapped
+// (errno or GetLastError tell why). An empty file gives an empty view.
+NODISCARD UNUSED
+static int mapped_file_open(mapped_file_t* file, const char* path) {
+    *file = (mapped_file_t) MAPPED_FILE_INIT;
+#ifdef _WIN32
+    file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file->file == INVALID_HANDLE_VALUE)
+        return -ERROR_IO;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->file, &size) || (unsigned long long)size.QuadPart > (size_t)-1) {
+        mapped_file_close(file);
+        return -ERROR_IO;
+    }
+    if (size.QuadPart == 0)
+        return -ERROR_NO_ERROR;
+    file->mapping = CreateFileMappingA(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    char* data = file->mapping != NULL ? MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (data == NULL) {
+        mapped_file_close(file);
+        return -ERROR_IO;
+    }
+    file->content = (string_view_t) { .str = data, .len = (size_t)size.QuadPart };
+#else
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -ERROR_IO;
+    struct stat status;
+    if (fstat(fd, &status) != 0 || (unsigned long long)status.st_size > (size_t)-1) {
+        close(fd);
+        return -ERROR_IO;
+    }
+    if (status.st_size == 0) {
+        close(fd);
+        return -ERROR_NO_ERROR;
+    }
+    // The mapping stays valid once the descriptor is closed
+    void* data = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return -ERROR_IO;
+    posix_madvise(data, (size_t)status.st_size, POSIX_MADV_SEQUENTIAL);
+    file->content = (string_view_t) { .str = data, .len = (size_t)status.st_size };
+#endif
+    return -ERROR_NO_ERROR;
+}
+
+#endif //CUTILS_MAPPED_FILE_H
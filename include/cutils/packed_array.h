@@ -0,0 +1,375 @@
+#ifndef CUTILS_PACKED_ARRAY_H
+#define CUTILS_PACKED_ARRAY_H
+
+#include <cutils/allocator/alloc.h>
+#include <cutils/bits.h>
+#include <cutils/compatibility.h>
+#include <cutils/when_macros.h>
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Array of unsigned integers of width bits each (1 to 32), stored back to
+ * back in a little-endian bit stream: value i takes bits [i * width,
+ * (i + 1) * width). A value is read or written with a single unaligned 64-bit
+ * access at byte i * width / 8, the stream ends with 8 bytes of padding so
+ * the access of the last value stays in the buffer.
+ *
+ *     packed_array_t packed = EMPTY_PACKED_ARRAY(packed_array_width(max));
+ *     packed_array_pack(&packed, values, count);
+ *     ... packed_array_get(&packed, i) ...
+ *     packed_array_unpack(&packed, from, count, out);
+ *
+ * The serialized form is a header of two little-endian 64-bit words (length
+ * and width) followed by the stream, so a file written on a machine can be
+ * mapped and read in place by packed_array_view on any other.
+ *
+ * packed_array_unpack decodes 8 values per iteration with AVX2 or NEON table
+ * lookups and variable shifts for widths up to 25 bits when the compiler
+ * targets them (-mavx2, -march=native...), defining CUTILS_PACKED_ARRAY_SCALAR
+ * disables them.
+ */
+
+#if !defined(CUTILS_PACKED_ARRAY_SCALAR) && defined(__AVX2__)
+#include <immintrin.h>
+#define CUTILS_PACKED_ARRAY_AVX2
+#elif !defined(CUTILS_PACKED_ARRAY_SCALAR) && defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CUTILS_PACKED_ARRAY_NEON
+#endif
+
+#define PACKED_ARRAY_MAX_WIDTH 32
+// Widest values decoded by the vector instructions: 4 bytes hold a value and
+// the bits before it in its first byte
+#define PACKED_ARRAY_VECTOR_WIDTH 25
+
+typedef struct {
+    uint8_t* bytes;
+    size_t length;
+    // 0 while bytes is not owned (empty or a view of a serialized array)
+    size_t capacity;
+    unsigned width;
+} packed_array_t;
+
+#define EMPTY_PACKED_ARRAY(w) (packed_array_t) { .bytes = NULL, .length = 0, .capacity = 0, .width = (w) }
+
+#define PACKED_ARRAY_HEADER_SIZE 16
+
+// Bits needed by values up to max
+UNUSED
+static unsigned packed_array_width(const uint32_t max) {
+    return max == 0 ? 1 : 64 - bits_leading_zeros(max);
+}
+
+// Bytes of the stream of length values, padding included
+UNUSED
+static size_t packed_array_size(const size_t length, const unsigned width) {
+    return ((length * width + 63) / 64) * 8 + 8;
+}
+
+UNUSED
+static uint64_t packed_array_load(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+UNUSED
+static void packed_array_store(uint8_t* p, uint64_t v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+}
+
+UNUSED
+static uint64_t packed_array_mask(const unsigned width) {
+    return UINT64_MAX >> (64 - width);
+}
+
+UNUSED
+static uint32_t packed_array_get(const packed_array_t* packed, const size_t index) {
+    assert(index < packed->length);
+    const uint64_t bit = (uint64_t)index * packed->width;
+    return (uint32_t)((packed_array_load(packed->bytes + (bit >> 3)) >> (bit & 7))
+        & packed_array_mask(packed->width));
+}
+
+// The bits of value above the width are dropped
+UNUSED
+static void packed_array_set(packed_array_t* packed, const size_t index, const uint32_t value) {
+    assert(index < packed->length && packed->capacity != 0);
+    const uint64_t bit = (uint64_t)index * packed->width;
+    const unsigned shift = bit & 7;
+    const uint64_t mask = packed_array_mask(packed->width);
+    uint8_t* p = packed->bytes + (bit >> 3);
+    const uint64_t word = packed_array_load(p) & ~(mask << shift);
+    packed_array_store(p, word | ((value & mask) << shift));
+}
+
+UNUSED
+static void packed_array_free(packed_array_t* packed) {
+    if (packed->capacity != 0)
+        CUTILS_dealloc(packed->bytes);
+    packed->bytes = NULL;
+    packed->length = 0;
+    packed->capacity = 0;
+}
+
+// Make room for capacity values, the stream of a view is copied in owned
+// memory. Bits past the length are kept at 0.
+NODISCARD UNUSED
+static bool packed_array_reserve(packed_array_t* packed, size_t capacity) {
+    if (capacity <= packed->capacity)
+        return true;
+    when_true_ret(packed->width == 0 || packed->width > PACKED_ARRAY_MAX_WIDTH, false);
+    when_true_ret(capacity > (SIZE_MAX - 64) / packed->width, false);
+    capacity = capacity < packed->capacity * 2 ? packed->capacity * 2 : capacity;
+    // A view may ask for less than its length
+    capacity = capacity < packed->length ? packed->length : capacity;
+    capacity = capacity < 64 ? 64 : capacity;
+    if (capacity > (SIZE_MAX - 64) / packed->width)
+        capacity = (SIZE_MAX - 64) / packed->width;
+    const size_t size = packed_array_size(capacity, packed->width);
+    const size_t used = packed->length == 0 || packed->bytes == NULL ? 0
+        : packed_array_size(packed->length, packed->width);
+    uint8_t* bytes;
+    if (packed->capacity != 0) {
+        bytes = CUTILS_realloc(packed->bytes, size);
+        when_null_ret(bytes, false);
+    } else {
+        bytes = CUTILS_alloc(size);
+        when_null_ret(bytes, false);
+        if (used != 0)
+            memcpy(bytes, packed->bytes, used);
+    }
+    memset(bytes + used, 0, size - used);
+    packed->bytes = bytes;
+    packed->capacity = capacity;
+    return true;
+}
+
+NODISCARD UNUSED
+static bool packed_array_append(packed_array_t* packed, const uint32_t value) {
+    if (packed->length >= packed->capacity)
+        when_false_ret(packed_array_reserve(packed, packed->length + 1), false);
+    packed->length += 1;
+    packed_array_set(packed, packed->length - 1, value);
+    return true;
+}
+
+// Append count values, accumulating them in a 64-bit word written once full
+NODISCARD UNUSED
+static bool packed_array_pack(packed_array_t* packed, const uint32_t* values, const size_t count) {
+    if (count == 0)
+        return true;
+    when_true_ret(count > SIZE_MAX - packed->length, false);
+    when_false_ret(packed_array_reserve(packed, packed->length + count), false);
+    const unsigned width = packed->width;
+    const uint64_t mask = packed_array_mask(width);
+    const uint64_t bit = (uint64_t)packed->length * width;
+    uint8_t* p = packed->bytes + (bit >> 3);
+    unsigned filled = bit & 7;
+    uint64_t word = *p & ((1u << filled) - 1);
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t value = values[i] & mask;
+        word |= value << filled;
+        filled += width;
+        if (filled >= 64) {
+            packed_array_store(p, word);
+            p += 8;
+            filled -= 64;
+            // Bits of the value which did not fit, value >> width is 0
+            word = value >> (width - filled);
+        }
+    }
+    // The bytes past the end are 0 and stay so
+    packed_array_store(p, word);
+    packed->length += count;
+    return true;
+}
+
+#if defined(CUTILS_PACKED_ARRAY_AVX2) || defined(CUTILS_PACKED_ARRAY_NEON)
+// Byte indices and shifts of 8 consecutive values starting on a byte, the
+// last 4 are relative to the byte of the bit 4 * width
+typedef struct {
+    uint8_t control[32];
+    int32_t shifts[8];
+    size_t high;
+} packed_array_lanes_t;
+
+UNUSED
+static void packed_array_lanes(packed_array_lanes_t* lanes, const unsigned width) {
+    lanes->high = (4 * width) >> 3;
+    for (unsigned j = 0; j < 8; j++) {
+        const unsigned bit = j * width - (j >= 4 ? (unsigned)lanes->high * 8 : 0);
+        for (unsigned b = 0; b < 4; b++)
+            lanes->control[j * 4 + b] = (uint8_t)((bit >> 3) + b);
+        lanes->shifts[j] = (int32_t)(bit & 7);
+    }
+}
+#endif
+
+#ifdef CUTILS_PACKED_ARRAY_AVX2
+// Decode the groups of 8 values of [index, end), index being a multiple of 8,
+// returns the index of the first value left to the scalar loop
+UNUSED
+static size_t packed_array_unpack_vector(
+    const packed_array_t* packed, size_t index, const size_t end, uint32_t* out
+) {
+    packed_array_lanes_t lanes;
+    packed_array_lanes(&lanes, packed->width);
+    const size_t size = packed_array_size(packed->length, packed->width);
+    const __m256i control = _mm256_loadu_si256((const __m256i*)lanes.control);
+    const __m256i shifts = _mm256_loadu_si256((const __m256i*)lanes.shifts);
+    const __m256i mask = _mm256_set1_epi32((int)packed_array_mask(packed->width));
+    for (; index + 8 <= end; index += 8, out += 8) {
+        const size_t p = index * packed->width / 8;
+        if (p + lanes.high + 16 > size)
+            break;
+        const __m128i low = _mm_loadu_si128((const __m128i*)(packed->bytes + p));
+        const __m128i high = _mm_loadu_si128((const __m128i*)(packed->bytes + p + lanes.high));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        v = _mm256_shuffle_epi8(v, control);
+        v = _mm256_and_si256(_mm256_srlv_epi32(v, shifts), mask);
+        _mm256_storeu_si256((__m256i*)out, v);
+    }
+    return index;
+}
+#elif defined(CUTILS_PACKED_ARRAY_NEON)
+UNUSED
+static size_t packed_array_unpack_vector(
+    const packed_array_t* packed, size_t index, const size_t end, uint32_t* out
+) {
+    packed_array_lanes_t lanes;
+    packed_array_lanes(&lanes, packed->width);
+    for (unsigned j = 0; j < 8; j++)
+        lanes.shifts[j] = -lanes.shifts[j];
+    const size_t size = packed_array_size(packed->length, packed->width);
+    const uint8x16_t control_low = vld1q_u8(lanes.control);
+    const uint8x16_t control_high = vld1q_u8(lanes.control + 16);
+    const int32x4_t shifts_low = vld1q_s32(lanes.shifts);
+    const int32x4_t shifts_high = vld1q_s32(lanes.shifts + 4);
+    const uint32x4_t mask = vdupq_n_u32((uint32_t)packed_array_mask(packed->width));
+    for (; index + 8 <= end; index += 8, out += 8) {
+        const size_t p = index * packed->width / 8;
+        if (p + lanes.high + 16 > size)
+            break;
+        const uint8x16_t low = vqtbl1q_u8(vld1q_u8(packed->bytes + p), control_low);
+        const uint8x16_t high = vqtbl1q_u8(vld1q_u8(packed->bytes + p + lanes.high), control_high);
+        vst1q_u32(out, vandq_u32(vshlq_u32(vreinterpretq_u32_u8(low), shifts_low), mask));
+        vst1q_u32(out + 4, vandq_u32(vshlq_u32(vreinterpretq_u32_u8(high), shifts_high), mask));
+    }
+    return index;
+}
+#endif
+
+// Decode the values [from, from + count) into out
+UNUSED
+static void packed_array_unpack(
+    const packed_array_t* packed, size_t from, const size_t count, uint32_t* out
+) {
+    assert(count <= packed->length && from <= packed->length - count);
+    const size_t end = from + count;
+    const unsigned width = packed->width;
+    const uint64_t mask = packed_array_mask(width);
+#if defined(CUTILS_PACKED_ARRAY_AVX2) || defined(CUTILS_PACKED_ARRAY_NEON)
+    if (width <= PACKED_ARRAY_VECTOR_WIDTH) {
+        // Groups of 8 values start on a byte
+        for (; from < end && from % 8 != 0; from++)
+            *out++ = packed_array_get(packed, from);
+        const size_t decoded = packed_array_unpack_vector(packed, from, end, out);
+        out += decoded - from;
+        from = decoded;
+    }
+#endif
+    uint64_t bit = (uint64_t)from * width;
+    for (; from < end; from++, bit += width)
+        *out++ = (uint32_t)((packed_array_load(packed->bytes + (bit >> 3)) >> (bit & 7)) & mask);
+}
+
+/*
+ * Conversions with a name ## _array_t of 32-bit unsigned integers, defined
+ * beforehand with DEFINE_ARRAY_TYPE or DEFINE_ARRAY_TYPE_WITH_ALLOCATOR.
+ */
+#define DEFINE_PACKED_ARRAY_CONVERSIONS(name)                                   \
+    /* Append the elements of the array to the packed array */                  \
+    NODISCARD UNUSED static bool packed_array_pack_ ## name(                    \
+        packed_array_t* packed, const name ## _array_t* array                   \
+    ) {                                                                         \
+        static_assert(sizeof(*array->data) == sizeof(uint32_t),                 \
+            "elements of the array are 32-bit integers");                       \
+        return packed_array_pack(packed, (const uint32_t*)array->data,          \
+            array->length);                                                     \
+    }                                                                           \
+                                                                                \
+    /* Append the values of the packed array to the array */                   \
+    NODISCARD UNUSED static bool packed_array_unpack_ ## name(                  \
+        const packed_array_t* packed, name ## _array_t* array                   \
+    ) {                                                                         \
+        when_true_ret(packed->length > UINT32_MAX - array->length, false);      \
+        if (packed->length == 0)                                                \
+            return true;                                                        \
+        void* data = array_append_ ## name(array, (unsigned)packed->length);    \
+        when_null_ret(data, false);                                             \
+        packed_array_unpack(packed, 0, packed->length, (uint32_t*)data);        \
+        return true;                                                            \
+    }
+
+UNUSED
+static size_t packed_array_serialized_size(const packed_array_t* packed) {
+    return PACKED_ARRAY_HEADER_SIZE + packed_array_size(packed->length, packed->width);
+}
+
+UNUSED
+static void packed_array_serialize(char* buffer, const packed_array_t* packed) {
+    uint8_t* p = (uint8_t*)buffer;
+    packed_array_store(p, packed->length);
+    packed_array_store(p + 8, packed->width);
+    const size_t size = packed_array_size(packed->length, packed->width);
+    if (packed->bytes != NULL)
+        memcpy(p + PACKED_ARRAY_HEADER_SIZE, packed->bytes, size);
+    else
+        memset(p + PACKED_ARRAY_HEADER_SIZE, 0, size);
+}
+
+// Read the array of a serialized buffer of size bytes in place, without a
+// copy: the buffer must outlive the view. Appending copies the stream to
+// owned memory, packed_array_reserve(packed, packed->length) does so before
+// a packed_array_set.
+NODISCARD UNUSED
+static bool packed_array_view(packed_array_t* packed, const char* buffer, const size_t size) {
+    when_true_ret(size < PACKED_ARRAY_HEADER_SIZE, false);
+    const uint8_t* p = (const uint8_t*)buffer;
+    const uint64_t length = packed_array_load(p);
+    const uint64_t width = packed_array_load(p + 8);
+    when_true_ret(width == 0 || width > PACKED_ARRAY_MAX_WIDTH, false);
+    when_true_ret(length > (SIZE_MAX - 64) / width, false);
+    when_true_ret(packed_array_size((size_t)length, (unsigned)width) > size - PACKED_ARRAY_HEADER_SIZE, false);
+    packed_array_free(packed);
+    packed->bytes = (uint8_t*)(uintptr_t)(p + PACKED_ARRAY_HEADER_SIZE);
+    packed->length = (size_t)length;
+    packed->width = (unsigned)width;
+    return true;
+}
+
+// Copy the array of a serialized buffer of size bytes
+NODISCARD UNUSED
+static bool packed_array_deserialize(packed_array_t* packed, const char* buffer, const size_t size) {
+    packed_array_t view = EMPTY_PACKED_ARRAY(0);
+    when_false_ret(packed_array_view(&view, buffer, size), false);
+    packed_array_free(packed);
+    // An empty array keeps no pointer in the buffer
+    if (view.length == 0)
+        view.bytes = NULL;
+    else
+        when_false_ret(packed_array_reserve(&view, view.length), false);
+    *packed = view;
+    return true;
+}
+
+#endif //CUTILS_PACKED_ARRAY_H
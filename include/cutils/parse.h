@@ -0,0 +1,335 @@
+#ifndef CUTILS_PARSE_H
+#define CUTILS_PARSE_H
+
+#include <cutils/allocator/alloc.h>
+#include <cutils/bits.h>
+#include <cutils/compatibility.h>
+#include <cutils/errors.h>
+#include <cutils/pow5.h>
+#include <cutils/string.h>
+#include <cutils/when_macros.h>
+#include <float.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Numbers read from the start of a string_view_t, which does not need a NUL
+ * terminator. Like strtol and strtod the parsing stops at the first
+ * character which cannot continue the number, but leading spaces are not
+ * skipped. Each function stores the number of bytes consumed and returns
+ * -ERROR_NO_ERROR, -ERROR_SYNTAX when the view does not start with a number
+ * (nothing is consumed) or -ERROR_OUT_OF_RANGE when the number does not fit
+ * (the value is then clamped like strtol and strtod do).
+ * parse_f64 may also return -ERROR_ALLOCATION_FAILED, see below.
+ *
+ * The digits are converted eight at a time with SWAR arithmetic. The doubles
+ * are correctly rounded: exact products when the significand and the power
+ * of ten are exact doubles, the Eisel-Lemire algorithm on 128-bit products
+ * otherwise, and strtod on a copy of the number in the rare cases that
+ * algorithm cannot decide (more than 19 significant digits close to a
+ * halfway point, subnormals), so the C locale is expected. Numbers longer
+ * than 127 characters are copied to the heap for strtod.
+ */
+
+UNUSED
+static bool parse_is_digit(const char c) {
+    return (unsigned char)(c - '0') < 10;
+}
+
+// Eight characters as a little-endian word
+UNUSED
+static uint64_t parse_load_8(const char* p) {
+    uint64_t chars;
+    memcpy(&chars, p, sizeof(chars));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    chars = __builtin_bswap64(chars);
+#endif
+    return chars;
+}
+
+UNUSED
+static bool parse_is_8_digits(const uint64_t chars) {
+    // Each byte is in 0x30-0x39 if its high nibble is 3 and adding 6 keeps it
+    return ((chars & UINT64_C(0xF0F0F0F0F0F0F0F0))
+            | (((chars + UINT64_C(0x0606060606060606)) & UINT64_C(0xF0F0F0F0F0F0F0F0)) >> 4))
+        == UINT64_C(0x3333333333333333);
+}
+
+// Value of eight digits, the first one being the least significant byte
+UNUSED
+static uint32_t parse_8_digits(uint64_t chars) {
+    const uint64_t mask = UINT64_C(0x000000FF000000FF);
+    chars -= UINT64_C(0x3030303030303030);
+    // Pairs of digits, then groups of four combined by two multiplications
+    chars = chars * 10 + (chars >> 8);
+    chars = ((chars & mask) * UINT64_C(0x000F424000000064)
+             + ((chars >> 16) & mask) * UINT64_C(0x0000271000000001)) >> 32;
+    return (uint32_t)chars;
+}
+
+UNUSED NODISCARD
+static int parse_u64(const string_view_t view, uint64_t* value, size_t* consumed) {
+    const char* p = view.str;
+    const char* end = view.str + view.len;
+    while (p < end && *p == '0')
+        p++;
+    const char* significant = p;
+    uint64_t result = 0;
+    // 16 digits at most, which cannot overflow
+    while (end - p >= 8 && p - significant <= 8 && parse_is_8_digits(parse_load_8(p))) {
+        result = result * 100000000 + parse_8_digits(parse_load_8(p));
+        p += 8;
+    }
+    bool overflow = false;
+    for (; p < end && parse_is_digit(*p); p++) {
+        const unsigned digit = (unsigned)(*p - '0');
+        overflow = overflow || (p - significant >= 19 && result > (UINT64_MAX - digit) / 10);
+        result = result * 10 + digit;
+    }
+    *consumed = (size_t)(p - view.str);
+    if (p == view.str) {
+        *value = 0;
+        return -ERROR_SYNTAX;
+    }
+    *value = overflow ? UINT64_MAX : result;
+    return overflow ? -ERROR_OUT_OF_RANGE : -ERROR_NO_ERROR;
+}
+
+// Optional sign followed by decimal digits
+UNUSED NODISCARD
+static int parse_i64(const string_view_t view, int64_t* value, size_t* consumed) {
+    const bool sign = view.len != 0 && (view.str[0] == '-' || view.str[0] == '+');
+    const bool negative = sign && view.str[0] == '-';
+    uint64_t magnitude;
+    int ret = parse_u64((string_view_t) { .str = view.str + sign, .len = view.len - sign }, &magnitude, consumed);
+    if (ret == -ERROR_SYNTAX) {
+        *value = 0;
+        *consumed = 0;
+        return ret;
+    }
+    *consumed += sign;
+    const uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    if (ret == -ERROR_OUT_OF_RANGE || magnitude > limit) {
+        *value = negative ? INT64_MIN : INT64_MAX;
+        return -ERROR_OUT_OF_RANGE;
+    }
+    // -2^63 is negated in two steps so that it does not overflow
+    *value = negative && magnitude != 0 ? -(int64_t)(magnitude - 1) - 1 : (int64_t)magnitude;
+    return -ERROR_NO_ERROR;
+}
+
+UNUSED
+static double parse_double_from_bits(const uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Bits of the double nearest to w * 10^q, w != 0, or false when the 128-bit
+// approximation of the power of five cannot decide the rounding (Lemire,
+// "Number Parsing at a Gigabyte per Second")
+UNUSED
+static bool parse_eisel_lemire(uint64_t w, const int64_t q, uint64_t* bits) {
+    if (q < POW5_MIN_EXPONENT) {
+        *bits = 0;
+        return true;
+    }
+    if (q > 308) {
+        *bits = UINT64_C(0x7FF) << 52;
+        return true;
+    }
+    const unsigned zeros = bits_leading_zeros(w);
+    w <<= zeros;
+    const uint64_t* pow5 = pow5_128[q - POW5_MIN_EXPONENT];
+    // 5^q rounded up when 5^-q fits on 64 bits, so that a product exactly
+    // halfway between two doubles is recognized
+    const bool round_up = q < 0 && q >= -27;
+    const uint64_t pow5_low = pow5[1] + round_up;
+    const uint64_t pow5_high = pow5[0] + (round_up && pow5_low == 0);
+    uint64_t high;
+    uint64_t low = bits_mul128(w, pow5_high, &high);
+    // The bits below the 55 kept ones are all set, the low word of the power
+    // may carry into them
+    if ((high & 0x1FF) == 0x1FF) {
+        uint64_t second_high;
+        (void)bits_mul128(w, pow5_low, &second_high);
+        low += second_high;
+        high += low < second_high;
+    }
+    // A carry may still come from the truncated part of the power, which is
+    // exact when 5^q fits on 128 bits and 5^-q on 64 bits
+    if (low == UINT64_MAX && (q < -27 || q > 55))
+        return false;
+    const unsigned upper = (unsigned)(high >> 63);
+    const unsigned shift = upper + 9;
+    uint64_t mantissa = high >> shift;
+    // floor(q * log2(10)) + 63, plus the bias of the exponent
+    int64_t power2 = (((152170 + 65536) * q) >> 16) + 63 + upper - zeros + 1023;
+    // Subnormal results are left to strtod
+    if (power2 <= 0)
+        return false;
+    // Exactly halfway between two doubles, rounded to even, only possible
+    // when 5^q is exact
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == high)
+        mantissa &= ~UINT64_C(1);
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= UINT64_C(2) << 52) {
+        mantissa = UINT64_C(1) << 52;
+        power2++;
+    }
+    mantissa &= ~(UINT64_C(1) << 52);
+    if (power2 >= 0x7FF) {
+        power2 = 0x7FF;
+        mantissa = 0;
+    }
+    *bits = mantissa | (uint64_t)power2 << 52;
+    return true;
+}
+
+// Correctly rounded value of the length first characters of str, false if
+// a long number cannot be copied
+UNUSED NODISCARD
+static bool parse_strtod(const char* str, const size_t length, double* value) {
+    char buffer[128];
+    char* copy = length < sizeof(buffer) ? buffer : CUTILS_alloc(length + 1);
+    when_null_ret(copy, false);
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    *value = strtod(copy, NULL);
+    if (copy != buffer)
+        CUTILS_dealloc(copy);
+    return true;
+}
+
+// Case-insensitive match of the lowercase word at the start of p
+UNUSED
+static bool parse_word(const char* p, const char* end, const char* word) {
+    for (; *word != '\0'; p++, word++) {
+        if (p == end || (*p | 0x20) != *word)
+            return false;
+    }
+    return true;
+}
+
+// Optional sign, decimal digits with an optional decimal point, optional
+// exponent, or "inf", "infinity", "nan" in any case like strtod
+UNUSED NODISCARD
+static int parse_f64(const string_view_t view, double* value, size_t* consumed) {
+    const char* p = view.str;
+    const char* end = view.str + view.len;
+    const bool negative = p < end && *p == '-';
+    const uint64_t sign = (uint64_t)negative << 63;
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+    const char* start = p;
+    uint64_t w = 0;
+    while (end - p >= 8 && parse_is_8_digits(parse_load_8(p))) {
+        w = w * 100000000 + parse_8_digits(parse_load_8(p));
+        p += 8;
+    }
+    for (; p < end && parse_is_digit(*p); p++)
+        w = w * 10 + (uint64_t)(*p - '0');
+    const char* integer_end = p;
+    int64_t exponent = 0;
+    if (p < end && *p == '.') {
+        const char* fraction = ++p;
+        while (end - p >= 8 && parse_is_8_digits(parse_load_8(p))) {
+            w = w * 100000000 + parse_8_digits(parse_load_8(p));
+            p += 8;
+        }
+        for (; p < end && parse_is_digit(*p); p++)
+            w = w * 10 + (uint64_t)(*p - '0');
+        exponent = -(int64_t)(p - fraction);
+    }
+    int64_t digits = (integer_end - start) - exponent;
+    if (digits == 0) {
+        *consumed = 0;
+        *value = 0;
+        if (parse_word(start, end, "inf")) {
+            *consumed = (size_t)(start - view.str) + (parse_word(start, end, "infinity") ? 8 : 3);
+            *value = parse_double_from_bits(sign | UINT64_C(0x7FF) << 52);
+        } else if (parse_word(start, end, "nan")) {
+            *consumed = (size_t)(start - view.str) + 3;
+            *value = parse_double_from_bits(sign | UINT64_C(0x7FF8) << 48);
+        }
+        return *consumed != 0 ? -ERROR_NO_ERROR : -ERROR_SYNTAX;
+    }
+    const char* number_end = p;
+    if (p < end && (*p | 0x20) == 'e') {
+        const char* q = p + 1;
+        const bool negative_exponent = q < end && *q == '-';
+        if (q < end && (*q == '-' || *q == '+'))
+            q++;
+        if (q < end && parse_is_digit(*q)) {
+            int64_t written = 0;
+            for (; q < end && parse_is_digit(*q); q++) {
+                // Large enough to make any number overflow or underflow
+                if (written < 0x100000)
+                    written = written * 10 + (*q - '0');
+            }
+            exponent += negative_exponent ? -written : written;
+            p = q;
+        }
+    }
+    *consumed = (size_t)(p - view.str);
+
+    // Only the first 19 significant digits fit in w
+    bool truncated = false;
+    if (digits > 19) {
+        const char* s = start;
+        for (; s < number_end && (*s == '0' || *s == '.'); s++)
+            digits -= *s == '0';
+        if (digits > 19) {
+            truncated = true;
+            w = 0;
+            unsigned taken = 0;
+            for (; taken < 19; s++) {
+                if (*s != '.') {
+                    w = w * 10 + (uint64_t)(*s - '0');
+                    taken++;
+                }
+            }
+            // Scaled by the integer digits left out, or by the fraction
+            // digits up to the last one taken instead of all of them
+            if (integer_end < number_end)
+                exponent += number_end - integer_end - 1;
+            exponent += s <= integer_end ? integer_end - s : -(s - integer_end - 1);
+        }
+    }
+    if (w == 0) {
+        *value = parse_double_from_bits(sign);
+        return -ERROR_NO_ERROR;
+    }
+
+    uint64_t bits;
+    bool exact = false;
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    // Both w and 10^|exponent| are exact doubles, one rounding only
+    if (!truncated && w <= UINT64_C(1) << 53 && exponent >= -22 && exponent <= 22) {
+        static const double powers[23] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+        };
+        const double result = exponent < 0 ? (double)w / powers[-exponent] : (double)w * powers[exponent];
+        memcpy(&bits, &result, sizeof(bits));
+        exact = true;
+    }
+#endif
+    if (!exact && parse_eisel_lemire(w, exponent, &bits)) {
+        // The digits after the 19th could round w up
+        uint64_t above;
+        exact = !truncated || (parse_eisel_lemire(w + 1, exponent, &above) && above == bits);
+    }
+    if (exact) {
+        *value = parse_double_from_bits(sign | bits);
+    } else {
+        when_false_ret(parse_strtod(view.str, *consumed, value), -ERROR_ALLOCATION_FAILED);
+        memcpy(&bits, value, sizeof(bits));
+        bits &= ~(UINT64_C(1) << 63);
+    }
+    // Overflow to infinity or underflow to zero
+    return bits == UINT64_C(0x7FF) << 52 || bits == 0 ? -ERROR_OUT_OF_RANGE : -ERROR_NO_ERROR;
+}
+
+#endif //CUTILS_PARSE_H
@@ -0,0 +1,231 @@
+#ifndef CUTILS_PERF_H
+#define CUTILS_PERF_H
+
+#include <cutils/compatibility.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Hardware performance counters around code regions, aggregated per scope
+ * name:
+ *
+ *     PERF_SCOPE("find") {
+ *         ... measured code, without break or return ...
+ *     }
+ *     perf_report(stdout);
+ *
+ * The counters come from perf_event_open on Linux and measure the calling
+ * thread in user space. Each counter is opened on its own so the ones the
+ * system refuses (virtual machines, perf_event_paranoid, other systems) are
+ * reported as unavailable while the others and the wall-clock time keep
+ * working. Setting the CUTILS_PERF_DISABLE environment variable disables the
+ * counters. Opening and reading the counters costs a few system calls per
+ * scope, so the measured regions should last at least some microseconds.
+ *
+ * The scopes are stored per thread and per translation unit, and keep a
+ * pointer to their name which must outlive them (a string literal).
+ */
+
+#ifndef CUTILS_PERF_MAX_SCOPES
+#define CUTILS_PERF_MAX_SCOPES 64
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/perf_event.h>)
+#define CUTILS_PERF_EVENTS
+#endif
+#endif
+
+#ifdef CUTILS_PERF_EVENTS
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+// Declared here as glibc hides it in the strict ISO modes
+long syscall(long number, ...);
+#endif
+
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,
+    // Time the thread was running in nanoseconds, a software counter
+    PERF_TASK_CLOCK,
+    PERF_COUNTER_COUNT
+};
+
+UNUSED static const char* const perf_counter_names[PERF_COUNTER_COUNT] = {
+    "cycles", "instructions", "L1d-misses", "LLC-misses", "branch-misses", "dTLB-misses", "task-clock"
+};
+
+typedef struct {
+    const char* name;
+    uint64_t calls;
+    double seconds;
+    uint64_t counters[PERF_COUNTER_COUNT];
+} perf_stats_t;
+
+typedef struct {
+    bool initialized;
+    int fds[PERF_COUNTER_COUNT];
+    unsigned scope_count;
+    perf_stats_t scopes[CUTILS_PERF_MAX_SCOPES];
+} perf_state_t;
+
+typedef struct {
+    perf_stats_t* stats;
+    double start;
+    uint64_t counters[PERF_COUNTER_COUNT];
+    bool done;
+} perf_scope_t;
+
+UNUSED static THREAD_LOCAL perf_state_t perf_state;
+
+UNUSED
+static double perf_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+#ifdef CUTILS_PERF_EVENTS
+UNUSED
+static int perf_open_counter(const uint32_t type, const uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // Scale the counts when the counters are multiplexed
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    const long fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    return fd < 0 ? -1 : (int)fd;
+}
+
+#define PERF_CACHE_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+#endif
+
+// Open the counters of the calling thread, called by the first scope
+UNUSED
+static void perf_init(void) {
+    perf_state.initialized = true;
+    for (unsigned i = 0; i < PERF_COUNTER_COUNT; i++)
+        perf_state.fds[i] = -1;
+#ifdef CUTILS_PERF_EVENTS
+    if (getenv("CUTILS_PERF_DISABLE") != NULL)
+        return;
+    perf_state.fds[PERF_CYCLES] = perf_open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    perf_state.fds[PERF_INSTRUCTIONS] = perf_open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    perf_state.fds[PERF_L1D_MISSES] = perf_open_counter(PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D));
+    perf_state.fds[PERF_LLC_MISSES] = perf_open_counter(PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_LL));
+    perf_state.fds[PERF_BRANCH_MISSES] = perf_open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    perf_state.fds[PERF_DTLB_MISSES] = perf_open_counter(PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB));
+    perf_state.fds[PERF_TASK_CLOCK] = perf_open_counter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+#endif
+}
+
+// Close the counters and forget the scopes of the calling thread
+UNUSED
+static void perf_close(void) {
+#ifdef CUTILS_PERF_EVENTS
+    for (unsigned i = 0; i < PERF_COUNTER_COUNT && perf_state.initialized; i++)
+        if (perf_state.fds[i] >= 0)
+            close(perf_state.fds[i]);
+#endif
+    memset(&perf_state, 0, sizeof(perf_state));
+}
+
+UNUSED
+static bool perf_available(const unsigned counter) {
+    if (!perf_state.initialized)
+        perf_init();
+    return counter < PERF_COUNTER_COUNT && perf_state.fds[counter] >= 0;
+}
+
+// Current values of the counters of the calling thread, 0 if unavailable
+UNUSED
+static void perf_read(uint64_t counters[PERF_COUNTER_COUNT]) {
+    if (!perf_state.initialized)
+        perf_init();
+    for (unsigned i = 0; i < PERF_COUNTER_COUNT; i++) {
+        counters[i] = 0;
+#ifdef CUTILS_PERF_EVENTS
+        uint64_t values[3];
+        if (perf_state.fds[i] < 0 || read(perf_state.fds[i], values, sizeof(values)) != sizeof(values))
+            continue;
+        // Value, time enabled and time running
+        counters[i] = values[2] == 0 || values[1] == values[2]
+            ? values[0] : (uint64_t)((double)values[0] * values[1] / values[2]);
+#endif
+    }
+}
+
+// Statistics of the scope name, NULL if it was never entered
+UNUSED
+static perf_stats_t* perf_stats(const char* name) {
+    for (unsigned i = 0; i < perf_state.scope_count; i++)
+        if (perf_state.scopes[i].name == name || strcmp(perf_state.scopes[i].name, name) == 0)
+            return &perf_state.scopes[i];
+    return NULL;
+}
+
+UNUSED
+static perf_scope_t perf_begin(const char* name) {
+    perf_scope_t scope = { .stats = perf_stats(name), .done = false };
+    if (scope.stats == NULL && perf_state.scope_count < CUTILS_PERF_MAX_SCOPES) {
+        scope.stats = &perf_state.scopes[perf_state.scope_count++];
+        *scope.stats = (perf_stats_t) { .name = name };
+    }
+    perf_read(scope.counters);
+    scope.start = perf_now();
+    return scope;
+}
+
+UNUSED
+static void perf_end(perf_scope_t* scope) {
+    const double end = perf_now();
+    uint64_t counters[PERF_COUNTER_COUNT];
+    perf_read(counters);
+    scope->done = true;
+    // Scopes beyond CUTILS_PERF_MAX_SCOPES are not recorded
+    if (scope->stats == NULL)
+        return;
+    scope->stats->calls += 1;
+    scope->stats->seconds += end - scope->start;
+    for (unsigned i = 0; i < PERF_COUNTER_COUNT; i++)
+        scope->stats->counters[i] += counters[i] - scope->counters[i];
+}
+
+#define PERF_SCOPE(name) \
+    for (perf_scope_t perf_scope = perf_begin(name); !perf_scope.done; perf_end(&perf_scope))
+
+// Print the totals of each scope, with the instructions per cycle when known
+UNUSED
+static void perf_report(FILE* out) {
+    for (unsigned i = 0; i < perf_state.scope_count; i++) {
+        const perf_stats_t* stats = &perf_state.scopes[i];
+        fprintf(out, "%s: %llu calls, %.3f ms", stats->name,
+                (unsigned long long)stats->calls, stats->seconds * 1e3);
+        for (unsigned c = 0; c < PERF_COUNTER_COUNT; c++) {
+            if (perf_state.fds[c] >= 0)
+                fprintf(out, ", %s %llu", perf_counter_names[c], (unsigned long long)stats->counters[c]);
+        }
+        if (perf_state.fds[PERF_CYCLES] >= 0 && perf_state.fds[PERF_INSTRUCTIONS] >= 0 && stats->counters[PERF_CYCLES] != 0)
+            fprintf(out, ", IPC %.2f", (double)stats->counters[PERF_INSTRUCTIONS] / stats->counters[PERF_CYCLES]);
+        fputc('\n', out);
+    }
+    for (unsigned c = 0; c < PERF_COUNTER_COUNT && perf_state.initialized; c++) {
+        if (perf_state.fds[c] < 0)
+            fprintf(out, "%s: unavailable\n", perf_counter_names[c]);
+    }
+}
+
+#endif //CUTILS_PERF_H
@@ -0,0 +1,255 @@
+#ifndef CUTILS_PIECE_TABLE_H
+#define CUTILS_PIECE_TABLE_H
+
+#include <cutils/allocator/arena.h>
+#include <cutils/compatibility.h>
+#include <cutils/string.h>
+#include <cutils/when_macros.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Editable text stored as a sequence of pieces, each one a slice of an
+ * immutable buffer: the original text, which is referenced and never copied
+ * nor modified, or the copies of the inserted texts. The pieces are the
+ * nodes of a treap ordered by position, each node storing the length of its
+ * subtree, so inserting, erasing and indexing take O(log n) expected time
+ * for n pieces whatever the length of the text.
+ *
+ * The nodes and the inserted texts come from an arena which must outlive
+ * the table, the erased nodes are reused by the next edits. Freeing (or
+ * resetting) the arena frees the table.
+ */
+
+typedef struct piece_node piece_node_t;
+
+struct piece_node {
+    piece_node_t* left;
+    piece_node_t* right;
+    const char* text;
+    size_t length;
+    // Length of the text of the subtree
+    size_t total;
+    uint64_t priority;
+};
+
+typedef struct {
+    arena_allocator_t* arena;
+    piece_node_t* root;
+    // Erased nodes, linked by their right child
+    piece_node_t* free;
+    uint64_t state;
+} piece_table_t;
+
+#define piece_table_length(table) ((table)->root != NULL ? (table)->root->total : 0)
+
+UNUSED
+static size_t piece_node_total(const piece_node_t* node) {
+    return node != NULL ? node->total : 0;
+}
+
+UNUSED
+static void piece_node_update(piece_node_t* node) {
+    node->total = piece_node_total(node->left) + node->length + piece_node_total(node->right);
+}
+
+UNUSED NODISCARD
+static piece_node_t* piece_node_new(piece_table_t* table, const char* text, const size_t length) {
+    piece_node_t* node = table->free;
+    if (node != NULL) {
+        table->free = node->right;
+    } else {
+        node = arena_allocate(table->arena, sizeof(piece_node_t));
+        when_null_ret(node, NULL);
+    }
+    // xorshift64*, the priorities only need to look random
+    table->state ^= table->state >> 12;
+    table->state ^= table->state << 25;
+    table->state ^= table->state >> 27;
+    *node = (piece_node_t) {
+        .left = NULL, .right = NULL, .text = text, .length = length, .total = length,
+        .priority = table->state * UINT64_C(2685821657736338717),
+    };
+    return node;
+}
+
+// Table whose text is original, which is referenced by the table
+UNUSED NODISCARD
+static bool piece_table_init(piece_table_t* table, arena_allocator_t* arena, const string_view_t original) {
+    *table = (piece_table_t) { .arena = arena, .root = NULL, .free = NULL, .state = UINT64_C(0x9E3779B97F4A7C15) };
+    if (original.len == 0)
+        return true;
+    table->root = piece_node_new(table, original.str, original.len);
+    return table->root != NULL;
+}
+
+// Concatenate the pieces of a and then of b
+UNUSED
+static piece_node_t* piece_node_merge(piece_node_t* a, piece_node_t* b) {
+    if (a == NULL)
+        return b;
+    if (b == NULL)
+        return a;
+    if (a->priority >= b->priority) {
+        a->right = piece_node_merge(a->right, b);
+        piece_node_update(a);
+        return a;
+    }
+    b->left = piece_node_merge(a, b->left);
+    piece_node_update(b);
+    return b;
+}
+
+// Split node at position in the pieces before and after it. A piece crossing
+// position is cut in two, the second half takes the node spare which is left
+// out of both trees: the caller merges it in front of after at the top, where
+// its random priority cannot break the heap order of an ancestor.
+UNUSED
+static void piece_node_split(
+    piece_node_t* node, const size_t position, piece_node_t* spare, piece_node_t** before, piece_node_t** after
+) {
+    if (node == NULL) {
+        *before = NULL;
+        *after = NULL;
+        return;
+    }
+    const size_t left = piece_node_total(node->left);
+    if (position <= left) {
+        piece_node_split(node->left, position, spare, before, &node->left);
+        piece_node_update(node);
+        *after = node;
+    } else if (position >= left + node->length) {
+        piece_node_split(node->right, position - left - node->length, spare, &node->right, after);
+        piece_node_update(node);
+        *before = node;
+    } else {
+        const size_t cut = position - left;
+        spare->text = node->text + cut;
+        spare->length = node->length - cut;
+        piece_node_update(spare);
+        *after = node->right;
+        node->length = cut;
+        node->right = NULL;
+        piece_node_update(node);
+        *before = node;
+    }
+}
+
+UNUSED
+static void piece_node_release(piece_table_t* table, piece_node_t* node) {
+    if (node == NULL)
+        return;
+    piece_node_release(table, node->left);
+    piece_node_release(table, node->right);
+    node->right = table->free;
+    table->free = node;
+}
+
+// Insert a copy of text at position (at most the length of the table)
+UNUSED NODISCARD
+static bool piece_table_insert(piece_table_t* table, const size_t position, const string_view_t text) {
+    when_false_ret(position <= piece_table_length(table), false);
+    if (text.len == 0)
+        return true;
+    char* copy = arena_allocate_aligned(table->arena, text.len, 1);
+    when_null_ret(copy, false);
+    memcpy(copy, text.str, text.len);
+    // Both nodes are allocated before the tree is modified
+    piece_node_t* piece = piece_node_new(table, copy, text.len);
+    when_null_ret(piece, false);
+    piece_node_t* spare = piece_node_new(table, NULL, 0);
+    if (spare == NULL) {
+        piece_node_release(table, piece);
+        return false;
+    }
+    piece_node_t *before, *after;
+    piece_node_split(table->root, position, spare, &before, &after);
+    if (spare->text == NULL)
+        piece_node_release(table, spare);
+    else
+        after = piece_node_merge(spare, after);
+    table->root = piece_node_merge(piece_node_merge(before, piece), after);
+    return true;
+}
+
+// Erase count characters from position, both clamped to the length
+UNUSED NODISCARD
+static bool piece_table_erase(piece_table_t* table, size_t position, size_t count) {
+    const size_t length = piece_table_length(table);
+    position = position < length ? position : length;
+    count = count < length - position ? count : length - position;
+    if (count == 0)
+        return true;
+    piece_node_t* spares[2] = { piece_node_new(table, NULL, 0), piece_node_new(table, NULL, 0) };
+    if (spares[0] == NULL || spares[1] == NULL) {
+        if (spares[0] != NULL)
+            piece_node_release(table, spares[0]);
+        return false;
+    }
+    piece_node_t *before, *middle, *after;
+    piece_node_split(table->root, position, spares[0], &before, &middle);
+    if (spares[0]->text != NULL)
+        middle = piece_node_merge(spares[0], middle);
+    piece_node_split(middle, count, spares[1], &middle, &after);
+    if (spares[1]->text != NULL)
+        after = piece_node_merge(spares[1], after);
+    piece_node_release(table, middle);
+    for (unsigned i = 0; i < 2; i++) {
+        if (spares[i]->text == NULL)
+            piece_node_release(table, spares[i]);
+    }
+    table->root = piece_node_merge(before, after);
+    return true;
+}
+
+// Rest of the piece containing position (a view ending at the end of the
+// piece), an empty view when position is at or after the end
+UNUSED
+static string_view_t piece_table_chunk(const piece_table_t* table, size_t position) {
+    const piece_node_t* node = table->root;
+    while (node != NULL) {
+        const size_t left = piece_node_total(node->left);
+        if (position < left) {
+            node = node->left;
+        } else if (position < left + node->length) {
+            position -= left;
+            return (string_view_t) { .str = (char*)node->text + position, .len = node->length - position };
+        } else {
+            position -= left + node->length;
+            node = node->right;
+        }
+    }
+    return EMPTY_STRING_VIEW;
+}
+
+UNUSED
+static char piece_table_at(const piece_table_t* table, const size_t position) {
+    const string_view_t chunk = piece_table_chunk(table, position);
+    return chunk.len != 0 ? chunk.str[0] : '\0';
+}
+
+// Zero-copy iteration over the pieces from *position, which is advanced
+// past the returned chunk: for (size_t p = 0; piece_table_next(t, &p, &v);)
+UNUSED
+static bool piece_table_next(const piece_table_t* table, size_t* position, string_view_t* chunk) {
+    *chunk = piece_table_chunk(table, *position);
+    *position += chunk->len;
+    return chunk->len != 0;
+}
+
+// Copy of the text, NUL terminated like string_from
+UNUSED NODISCARD
+static string_t piece_table_to_string(const piece_table_t* table) {
+    string_t str = EMPTY_STRING;
+    const size_t length = piece_table_length(table);
+    char* data = array_append_char(&str, length + 1);
+    if (data == NULL)
+        return str;
+    string_view_t chunk;
+    for (size_t position = 0; piece_table_next(table, &position, &chunk);)
+        memcpy(data + position - chunk.len, chunk.str, chunk.len);
+    data[length] = '\0';
+    return str;
+}
+
+#endif //CUTILS_PIECE_TABLE_H
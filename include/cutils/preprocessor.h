@@ -0,0 +1,31 @@
+#ifndef CUTILS_PREPROCESSOR_H
+#define CUTILS_PREPROCESSOR_H
+
+#define CUTILS_CONCAT(a, b) CUTILS_CONCAT_(a, b)
+#define CUTILS_CONCAT_(a, b) a ## b
+
+// Number of arguments (from 1 to 16)
+#define CUTILS_NARGS(...) CUTILS_NARGS_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define CUTILS_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+
+// Expand macro(context, argument) for each argument (at most 16)
+#define CUTILS_FOREACH(macro, context, ...) \
+    CUTILS_CONCAT(CUTILS_FOREACH_, CUTILS_NARGS(__VA_ARGS__))(macro, context, __VA_ARGS__)
+#define CUTILS_FOREACH_1(m, c, x) m(c, x)
+#define CUTILS_FOREACH_2(m, c, x, ...) m(c, x) CUTILS_FOREACH_1(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_3(m, c, x, ...) m(c, x) CUTILS_FOREACH_2(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_4(m, c, x, ...) m(c, x) CUTILS_FOREACH_3(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_5(m, c, x, ...) m(c, x) CUTILS_FOREACH_4(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_6(m, c, x, ...) m(c, x) CUTILS_FOREACH_5(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_7(m, c, x, ...) m(c, x) CUTILS_FOREACH_6(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_8(m, c, x, ...) m(c, x) CUTILS_FOREACH_7(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_9(m, c, x, ...) m(c, x) CUTILS_FOREACH_8(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_10(m, c, x, ...) m(c, x) CUTILS_FOREACH_9(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_11(m, c, x, ...) m(c, x) CUTILS_FOREACH_10(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_12(m, c, x, ...) m(c, x) CUTILS_FOREACH_11(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_13(m, c, x, ...) m(c, x) CUTILS_FOREACH_12(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_14(m, c, x, ...) m(c, x) CUTILS_FOREACH_13(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_15(m, c, x, ...) m(c, x) CUTILS_FOREACH_14(m, c, __VA_ARGS__)
+#define CUTILS_FOREACH_16(m, c, x, ...) m(c, x) CUTILS_FOREACH_15(m, c, __VA_ARGS__)
+
+#endif //CUTILS_PREPROCESSOR_H
@@ -1,7 +1,8 @@
 #ifndef CUTILS_RING_H
 #define CUTILS_RING_H
 
-#include <cutils/allocator/alloc.h>
+#include <cutils/allocator/allocator.h>
+#include <cutils/instrument.h>
 #include <cutils/when_macros.h>
 #include <cutils/minmax.h>
 #include <cutils/compatibility.h>
@@ -21,11 +22,31 @@
     for(type* e = ring_get(ring, 0); e != NULL; e = NULL)                               \
         for(unsigned index = 0; index != (ring).length && (e = ring_get_unsafe(ring, index)); index++)
 
-#define DEFINE_RING_TYPE(type)              \
-    DEFINE_INTERFACE_RING_TYPE(type)        \
-    DEFINE_IMPLEMENTATION_RING_TYPE(type)   \
+#define DEFINE_RING_TYPE(type)                                          \
+    DEFINE_INTERFACE_RING_TYPE(type)                                    \
+    DEFINE_IMPLEMENTATION_RING_TYPE(type)
 
-#define DEFINE_INTERFACE_RING_TYPE(type)                                        \
+#define DEFINE_INTERFACE_RING_TYPE(type)                                \
+    DEFINE_INTERFACE_RING_TYPE_WITH_ALLOCATOR(type, type, heap)
+
+// ring_create_ ## type needs no allocator state, it only exists for the heap
+// binding, the other ones go through ring_create_allocator_ ## name
+#define DEFINE_IMPLEMENTATION_RING_TYPE(type)                           \
+    DEFINE_IMPLEMENTATION_RING_TYPE_WITH_ALLOCATOR(type, type, heap)    \
+                                                                        \
+    UNUSED static type ## _ring_t ring_create_ ## type(                 \
+        unsigned capacity, void (*free_element)(type*)                  \
+    ) {                                                                 \
+        return ring_create_allocator_ ## type(NULL, capacity, free_element); \
+    }
+
+// Define name ## _ring_t, a ring of type allocated with the allocator binding
+// (see allocator.h)
+#define DEFINE_RING_TYPE_WITH_ALLOCATOR(name, type, binding)            \
+    DEFINE_INTERFACE_RING_TYPE_WITH_ALLOCATOR(name, type, binding)      \
+    DEFINE_IMPLEMENTATION_RING_TYPE_WITH_ALLOCATOR(name, type, binding) \
+
+#define DEFINE_INTERFACE_RING_TYPE_WITH_ALLOCATOR(name, type, binding)          \
     typedef struct {                                                            \
         type* data;                                                             \
         void (*free)(type*);                                                    \
@@ -33,28 +54,37 @@
         unsigned begin;                                                         \
         unsigned next;                                                          \
         unsigned length;                                                        \
-    } type ## _ring_t;                                                          \
+        binding ## _binding_member                                              \
+    } name ## _ring_t;                                                          \
 
-#define DEFINE_IMPLEMENTATION_RING_TYPE(type)                                   \
-    UNUSED static type ## _ring_t ring_create_ ## type(                         \
-        unsigned capacity, void (*free_element)(type*)                          \
+#define DEFINE_IMPLEMENTATION_RING_TYPE_WITH_ALLOCATOR(name, type, binding)     \
+    INSTRUMENT_DEFINE(ring, name)                                               \
+                                                                                \
+    UNUSED static name ## _ring_t ring_create_allocator_ ## name(               \
+        binding ## _binding_t* allocator, unsigned capacity,                    \
+        void (*free_element)(type*)                                             \
     ) {                                                                         \
-        when_false_ret(capacity > 0, (type ## _ring_t) { .capacity = 0 });      \
-        return (type ## _ring_t) {                                              \
-            .data = CUTILS_alloc(capacity * sizeof(type)),                      \
+        (void)allocator;                                                        \
+        when_false_ret(capacity > 0, (name ## _ring_t) { .capacity = 0 });      \
+        INSTRUMENT(ring, name, INSTRUMENT_CAPACITY, capacity);                  \
+        return (name ## _ring_t) {                                              \
+            .data = binding ## _binding_alloc(allocator, capacity * sizeof(type)), \
             .capacity = capacity,                                               \
-            .free = free_element                                                \
+            .free = free_element,                                               \
+            binding ## _binding_init(allocator)                                 \
         };                                                                      \
     }                                                                           \
                                                                                 \
-    UNUSED static void ring_free_ ## type(type ## _ring_t* ring) {              \
+    UNUSED static void ring_free_ ## name(name ## _ring_t* ring) {              \
         if(ring->free) {                                                        \
             ring_foreach(*ring, e, type) {                                      \
                 ring->free(e);                                                  \
             }                                                                   \
         }                                                                       \
-        CUTILS_dealloc(ring->data);                                             \
-        *ring = (type ## _ring_t) {                                             \
+        binding ## _binding_dealloc(binding ## _binding_state(ring),            \
+            ring->data, ring->capacity * sizeof(type));                         \
+        *ring = (name ## _ring_t) {                                             \
+            binding ## _binding_init(binding ## _binding_state(ring))           \
             .data = NULL,                                                       \
             .capacity = 0,                                                      \
             .begin = 0,                                                         \
@@ -63,21 +93,21 @@
         };                                                                      \
     }                                                                           \
                                                                                 \
-    UNUSED static type* ring_front_ ## type(type ## _ring_t* ring) {            \
+    UNUSED static type* ring_front_ ## name(name ## _ring_t* ring) {            \
         if(ring_empty(*ring))                                                   \
             return NULL;                                                        \
         return &ring->data[ring->begin];                                        \
     }                                                                           \
                                                                                 \
-    UNUSED static type* ring_back_ ## type(type ## _ring_t* ring) {             \
+    UNUSED static type* ring_back_ ## name(name ## _ring_t* ring) {             \
         if(ring_empty(*ring))                                                   \
             return NULL;                                                        \
         unsigned last = ring_prev(*ring, ring->next);                           \
         return &ring->data[last];                                               \
     }                                                                           \
                                                                                 \
-    UNUSED static unsigned ring_head_ ## type(                                  \
-        type ## _ring_t* ring, unsigned count                                   \
+    UNUSED static unsigned ring_head_ ## name(                                  \
+        name ## _ring_t* ring, unsigned count                                   \
     ) {                                                                         \
         if(ring_empty(*ring) || count >= ring->length) return ring->length;     \
         if (ring->free) {                                                       \
@@ -89,8 +119,8 @@
         return count;                                                           \
     }                                                                           \
                                                                                 \
-    UNUSED static unsigned ring_tail_ ## type(                                  \
-        type ## _ring_t* ring, unsigned count                                   \
+    UNUSED static unsigned ring_tail_ ## name(                                  \
+        name ## _ring_t* ring, unsigned count                                   \
     ) {                                                                         \
         if(ring_empty(*ring) || count >= ring->length) return ring->length;     \
         if (ring->free && !ring_empty(*ring)) {                                 \
@@ -102,8 +132,8 @@
         return count;                                                           \
     }                                                                           \
                                                                                 \
-    UNUSED static bool ring_pop_back_ ## type(                                  \
-        type ## _ring_t* ring                                                   \
+    UNUSED static bool ring_pop_back_ ## name(                                  \
+        name ## _ring_t* ring                                                   \
     ) {                                                                         \
         if(ring_empty(*ring))                                                   \
             return false;                                                       \
@@ -115,8 +145,8 @@
         return true;                                                            \
     }                                                                           \
                                                                                 \
-    UNUSED static bool ring_pop_front_ ## type(                                 \
-        type ## _ring_t* ring                                                   \
+    UNUSED static bool ring_pop_front_ ## name(                                 \
+        name ## _ring_t* ring                                                   \
     ) {                                                                         \
         if(ring_empty(*ring))                                                   \
             return false;                                                       \
@@ -127,13 +157,16 @@
         return true;                                                            \
     }                                                                           \
                                                                                 \
-    UNUSED static type* ring_push_back_ ## type(                                \
-        type ## _ring_t* ring, bool force                                       \
+    UNUSED static type* ring_push_back_ ## name(                                \
+        name ## _ring_t* ring, bool force                                       \
     ) {                                                                         \
         const unsigned next = ring_next(*ring, ring->next);                     \
         if(ring_full(*ring)) {                                                  \
-            if (!force)                                                         \
+            if (!force) {                                                       \
+                INSTRUMENT(ring, name, INSTRUMENT_DROP, 1);                     \
                 return NULL;                                                    \
+            }                                                                   \
+            INSTRUMENT(ring, name, INSTRUMENT_OVERWRITE, 1);                    \
             if (ring->free)                                                     \
                 ring->free(&ring->data[ring->begin]);                           \
             ring->begin = ring_next(*ring, ring->begin);                        \
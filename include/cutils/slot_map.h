@@ -0,0 +1,171 @@
+#ifndef CUTILS_SLOT_MAP_H
+#define CUTILS_SLOT_MAP_H
+
+#include <cutils/allocator/alloc.h>
+#include <cutils/compatibility.h>
+#include <cutils/instrument.h>
+#include <cutils/minmax.h>
+#include <cutils/when_macros.h>
+#include <stdint.h>
+
+// Stable handle of an element: generation in the high 32 bits, slot index in
+// the low 32 bits. Generations start at 1 so SLOT_HANDLE_NULL is never valid.
+typedef uint64_t slot_handle_t;
+
+#define SLOT_HANDLE_NULL ((slot_handle_t)0)
+#define SLOT_MAP_NONE ((unsigned)-1)
+
+#define slot_handle(index, generation) (((slot_handle_t)(generation) << 32) | (uint32_t)(index))
+#define slot_handle_index(handle) ((unsigned)((handle) & 0xffffffffu))
+#define slot_handle_generation(handle) ((unsigned)((handle) >> 32))
+
+#define EMPTY_SLOT_MAP(name) (name ## _slot_map_t) { \
+    .values = { .length = 0, .capacity = 0, .data = NULL }, .free_head = SLOT_MAP_NONE }
+
+typedef struct {
+    // Index in the dense array when used, next free slot otherwise
+    unsigned index;
+    unsigned generation;
+} slot_map_slot_t;
+
+/*
+ * Slot map storing its elements densely in a name ## _array_t (defined
+ * beforehand with DEFINE_ARRAY_TYPE or DEFINE_ARRAY_TYPE_WITH_ALLOCATOR).
+ * Elements are addressed by generational handles which stay valid until the
+ * element is erased, erasing moves the last element in the hole so iterating
+ * over map.values is contiguous.
+ */
+#define DEFINE_SLOT_MAP_TYPE(type)                                              \
+    DEFINE_SLOT_MAP_TYPE_WITH_NAME(type, type)
+
+#define DEFINE_SLOT_MAP_TYPE_WITH_NAME(name, type)                              \
+    INSTRUMENT_DEFINE(slot_map, name)                                           \
+                                                                                \
+    typedef struct {                                                            \
+        name ## _array_t values;                                                \
+        /* Slot of each element of values */                                    \
+        unsigned* owner;                                                        \
+        unsigned owner_capacity;                                                \
+        slot_map_slot_t* slots;                                                 \
+        unsigned slot_count;                                                    \
+        unsigned slot_capacity;                                                 \
+        unsigned free_head;                                                     \
+    } name ## _slot_map_t;                                                      \
+                                                                                \
+    UNUSED static type* slot_map_get_ ## name(                                  \
+        const name ## _slot_map_t* map, slot_handle_t handle                    \
+    ) {                                                                         \
+        const unsigned slot = slot_handle_index(handle);                        \
+        if (slot >= map->slot_count                                             \
+            || map->slots[slot].generation != slot_handle_generation(handle))   \
+            return NULL;                                                        \
+        return &map->values.data[map->slots[slot].index];                       \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool slot_map_contains_ ## name(                              \
+        const name ## _slot_map_t* map, slot_handle_t handle                    \
+    ) {                                                                         \
+        return slot_map_get_ ## name(map, handle) != NULL;                      \
+    }                                                                           \
+                                                                                \
+    /* Handle of the element at index in map->values */                         \
+    UNUSED static slot_handle_t slot_map_handle_of_ ## name(                    \
+        const name ## _slot_map_t* map, unsigned index                          \
+    ) {                                                                         \
+        const unsigned slot = map->owner[index];                                \
+        return slot_handle(slot, map->slots[slot].generation);                  \
+    }                                                                           \
+                                                                                \
+    UNUSED NODISCARD static slot_handle_t slot_map_insert_ ## name(             \
+        name ## _slot_map_t* map, const type* value                             \
+    ) {                                                                         \
+        unsigned slot = map->free_head;                                         \
+        if (slot == SLOT_MAP_NONE && map->slot_count == map->slot_capacity) {   \
+            const unsigned capacity = MAX(map->slot_capacity * 2, 16);          \
+            slot_map_slot_t* slots = CUTILS_realloc(map->slots,                 \
+                capacity * sizeof(slot_map_slot_t));                            \
+            when_null_ret(slots, SLOT_HANDLE_NULL);                             \
+            INSTRUMENT(slot_map, name, INSTRUMENT_REALLOCATION,                 \
+                map->slot_capacity != 0);                                       \
+            INSTRUMENT(slot_map, name, INSTRUMENT_CAPACITY, capacity);          \
+            map->slots = slots;                                                 \
+            map->slot_capacity = capacity;                                      \
+        }                                                                       \
+        const unsigned index = map->values.length;                              \
+        type* data = array_append_ ## name(&map->values, 1);                    \
+        when_null_ret(data, SLOT_HANDLE_NULL);                                  \
+        if (map->values.capacity > map->owner_capacity) {                       \
+            unsigned* owner = CUTILS_realloc(map->owner,                        \
+                map->values.capacity * sizeof(unsigned));                       \
+            if (owner == NULL) {                                                \
+                map->values.length -= 1;                                        \
+                return SLOT_HANDLE_NULL;                                        \
+            }                                                                   \
+            INSTRUMENT(slot_map, name, INSTRUMENT_REALLOCATION,                 \
+                map->owner_capacity != 0);                                      \
+            map->owner = owner;                                                 \
+            map->owner_capacity = map->values.capacity;                         \
+        }                                                                       \
+        if (slot == SLOT_MAP_NONE) {                                            \
+            slot = map->slot_count++;                                           \
+            map->slots[slot].generation = 1;                                    \
+        } else {                                                                \
+            map->free_head = map->slots[slot].index;                            \
+        }                                                                       \
+        *data = *value;                                                         \
+        map->slots[slot].index = index;                                         \
+        map->owner[index] = slot;                                               \
+        return slot_handle(slot, map->slots[slot].generation);                  \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool slot_map_erase_ ## name(                                 \
+        name ## _slot_map_t* map, slot_handle_t handle, type* value             \
+    ) {                                                                         \
+        type* data = slot_map_get_ ## name(map, handle);                        \
+        if (data == NULL)                                                       \
+            return false;                                                       \
+        if (value != NULL)                                                      \
+            *value = *data;                                                     \
+        const unsigned slot = slot_handle_index(handle);                        \
+        const unsigned index = map->slots[slot].index;                          \
+        const unsigned last = map->values.length - 1;                           \
+        if (index != last) {                                                    \
+            map->owner[index] = map->owner[last];                               \
+            map->slots[map->owner[index]].index = index;                        \
+        }                                                                       \
+        array_swap_and_pop_back_ ## name(&map->values, index);                  \
+        /* Invalidate the handles of the slot, skipping the 0 generation */     \
+        map->slots[slot].generation += 1;                                       \
+        if (map->slots[slot].generation == 0)                                   \
+            map->slots[slot].generation = 1;                                    \
+        map->slots[slot].index = map->free_head;                                \
+        map->free_head = slot;                                                  \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static void slot_map_clear_ ## name(name ## _slot_map_t* map) {      \
+        for (unsigned i = 0; i < map->values.length; i++) {                     \
+            const slot_handle_t handle = slot_map_handle_of_ ## name(map, i);   \
+            const unsigned slot = slot_handle_index(handle);                    \
+            map->slots[slot].generation += 1;                                   \
+            if (map->slots[slot].generation == 0)                               \
+                map->slots[slot].generation = 1;                                \
+            map->slots[slot].index = map->free_head;                            \
+            map->free_head = slot;                                              \
+        }                                                                       \
+        map->values.length = 0;                                                 \
+    }                                                                           \
+                                                                                \
+    UNUSED static void slot_map_free_ ## name(name ## _slot_map_t* map) {       \
+        array_free_ ## name(&map->values);                                      \
+        CUTILS_dealloc(map->owner);                                             \
+        CUTILS_dealloc(map->slots);                                             \
+        map->owner = NULL;                                                      \
+        map->owner_capacity = 0;                                                \
+        map->slots = NULL;                                                      \
+        map->slot_count = 0;                                                    \
+        map->slot_capacity = 0;                                                 \
+        map->free_head = SLOT_MAP_NONE;                                         \
+    }
+
+#endif //CUTILS_SLOT_MAP_H
@@ -0,0 +1,263 @@
+#ifndef CUTILS_SMALL_ARRAY_H
+#define CUTILS_SMALL_ARRAY_H
+
+#include <cutils/array.h>
+
+/*
+ * Arrays storing up to N elements inside the structure, which only allocate
+ * when they grow past N. They have the functions of the arrays of array.h,
+ * with the same names and serialized form, so DEFINE_SMALL_ARRAY_TYPE(int, 8)
+ * can replace DEFINE_ARRAY_TYPE(int) in a translation unit, and
+ * array_data_int(&array) gives the elements wherever they are.
+ *
+ * The elements are not behind a data member: the inline ones would move with
+ * a copy of the structure, which stays valid as long as only one of the
+ * copies is used afterwards. capacity is at most N while the elements are
+ * inline, 0 meaning nothing was appended yet.
+ */
+
+#define EMPTY_SMALL_ARRAY(name) (name ## _array_t) { .length = 0, .capacity = 0 }
+#define EMPTY_SMALL_ARRAY_WITH_ALLOCATOR(name, state) \
+    (name ## _array_t) { .length = 0, .capacity = 0, .allocator = (state) }
+
+#define DEFINE_SMALL_ARRAY_TYPE(type, N)                                        \
+    DEFINE_SMALL_ARRAY_TYPE_WITH_ALLOCATOR(type, type, N, heap)
+
+#define DEFINE_INTERFACE_SMALL_ARRAY_TYPE(type, N)                              \
+    DEFINE_INTERFACE_SMALL_ARRAY_TYPE_WITH_ALLOCATOR(type, type, N, heap)
+
+#define DEFINE_IMPLEMENTATION_SMALL_ARRAY_TYPE(type, N)                         \
+    DEFINE_IMPLEMENTATION_SMALL_ARRAY_TYPE_WITH_ALLOCATOR(type, type, N, heap)
+
+// Define name ## _array_t, an array of type holding N elements inline, whose
+// growth past them calls the functions of the allocator binding (see
+// allocator.h)
+#define DEFINE_SMALL_ARRAY_TYPE_WITH_ALLOCATOR(name, type, N, binding)          \
+    DEFINE_INTERFACE_SMALL_ARRAY_TYPE_WITH_ALLOCATOR(name, type, N, binding)    \
+    DEFINE_IMPLEMENTATION_SMALL_ARRAY_TYPE_WITH_ALLOCATOR(name, type, N, binding)
+
+#define DEFINE_INTERFACE_SMALL_ARRAY_TYPE_WITH_ALLOCATOR(name, type, N, binding) \
+    typedef struct {                                                            \
+        unsigned length;                                                        \
+        unsigned capacity;                                                      \
+        union {                                                                 \
+            type* heap;                                                         \
+            type local[N];                                                      \
+        };                                                                      \
+        binding ## _binding_member                                              \
+    } name ## _array_t;
+
+#define DEFINE_IMPLEMENTATION_SMALL_ARRAY_TYPE_WITH_ALLOCATOR(name, type, N, binding) \
+    INSTRUMENT_DEFINE(small_array, name)                                        \
+                                                                                \
+    UNUSED static type* array_data_ ## name(const name ## _array_t* array) {    \
+        return array->capacity <= (N) ? (type*)array->local : array->heap;      \
+    }                                                                           \
+                                                                                \
+    UNUSED NODISCARD static type *array_append_ ## name(                        \
+        name ## _array_t *array, unsigned count                                 \
+    ) {                                                                         \
+        if(count == 0)                                                          \
+            return NULL;                                                        \
+        const bool local = array->capacity <= (N);                              \
+        const unsigned current = local ? (N) : array->capacity;                 \
+        if (current < array->length + count) {                                  \
+            const unsigned capacity = MAX(current * 2, array->length + count);  \
+            void* memory;                                                       \
+            if (local) {                                                        \
+                memory = binding ## _binding_alloc(                             \
+                    binding ## _binding_state(array), capacity * sizeof(type)); \
+                when_null_ret(memory, NULL);                                    \
+                memcpy(memory, array->local, array->length * sizeof(type));     \
+                INSTRUMENT(small_array, name, INSTRUMENT_BYTES_MOVED,           \
+                    array->length * sizeof(type));                              \
+            } else {                                                            \
+                memory = binding ## _binding_realloc(                           \
+                    binding ## _binding_state(array), array->heap,              \
+                    array->capacity * sizeof(type), capacity * sizeof(type));   \
+                when_null_ret(memory, NULL);                                    \
+                INSTRUMENT(small_array, name, INSTRUMENT_REALLOCATION, 1);      \
+                if (memory != array->heap)                                      \
+                    INSTRUMENT(small_array, name, INSTRUMENT_BYTES_MOVED,       \
+                        array->length * sizeof(type));                          \
+            }                                                                   \
+            INSTRUMENT(small_array, name, INSTRUMENT_CAPACITY, capacity);       \
+            array->heap = memory;                                               \
+            array->capacity = capacity;                                         \
+        } else if (local) {                                                     \
+            array->capacity = (N);                                              \
+        }                                                                       \
+        type* ret = array_data_ ## name(array) + array->length;                 \
+        array->length += count;                                                 \
+        return ret;                                                             \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool array_pop_ ## name(                                      \
+        name ## _array_t *array, type* value                                    \
+    ) {                                                                         \
+        if(array->length == 0)                                                  \
+            return false;                                                       \
+        array->length -= 1;                                                     \
+        if (value != NULL)                                                      \
+            memcpy(value, array_data_ ## name(array) + array->length,           \
+                   sizeof(type));                                               \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static type* array_insert_ ## name(                                  \
+        name##_array_t *array, const type *item, unsigned index                 \
+    ) {                                                                         \
+        assert(index <= array->length);                                         \
+        if(NULL == array_append_ ## name(array, 1))                             \
+            return NULL;                                                        \
+        type* data = array_data_ ## name(array);                                \
+        size_t tailSize = (array->length - 1 - index) * sizeof(type);           \
+        if(tailSize != 0) {                                                     \
+            memmove(&data[index + 1], &data[index], tailSize);                  \
+            INSTRUMENT(small_array, name, INSTRUMENT_BYTES_MOVED, tailSize);    \
+        }                                                                       \
+        if(item != NULL)                                                        \
+            memcpy(&data[index], item, sizeof(type));                           \
+        return &data[index];                                                    \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool array_remove_ ## name(                                   \
+        name##_array_t *array, type *item, unsigned index                       \
+    ) {                                                                         \
+        assert(index < array->length);                                          \
+        type* data = array_data_ ## name(array);                                \
+        size_t tailSize = (array->length - 1 - index) * sizeof(type);           \
+        if(item != NULL)                                                        \
+            memcpy(item, &data[index], sizeof(type));                           \
+        if(tailSize != 0) {                                                     \
+            memmove(&data[index], &data[index + 1], tailSize);                  \
+            INSTRUMENT(small_array, name, INSTRUMENT_BYTES_MOVED, tailSize);    \
+        }                                                                       \
+        array->length -= 1;                                                     \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static void array_filter_ ## name(                                   \
+        name##_array_t *array, const bool* remove                               \
+    ) {                                                                         \
+        type* data = array_data_ ## name(array);                                \
+        unsigned kept = 0;                                                      \
+        for(unsigned i = 0; i < array->length; i++) {                           \
+            if(remove[i])                                                       \
+                continue;                                                       \
+            if(kept != i)                                                       \
+                memcpy(&data[kept], &data[i], sizeof(type));                    \
+            kept++;                                                             \
+        }                                                                       \
+        array->length = kept;                                                   \
+    }                                                                           \
+                                                                                \
+    UNUSED static void array_swap_and_pop_back_ ## name(                        \
+        name ## _array_t *array, unsigned index                                 \
+    ) {                                                                         \
+        assert(index < array->length);                                          \
+        array->length--;                                                        \
+        if (index != array->length) {                                           \
+            type* data = array_data_ ## name(array);                            \
+            memcpy(data + index, data + array->length, sizeof(type));           \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    UNUSED static void array_free_##name(name##_array_t *array) {               \
+        if (array->capacity > (N))                                              \
+            binding ## _binding_dealloc(binding ## _binding_state(array),       \
+                array->heap, array->capacity * sizeof(type));                   \
+        array->length = 0;                                                      \
+        array->capacity = 0;                                                    \
+    }                                                                           \
+                                                                                \
+    UNUSED static name ## _array_t array_shallow_clone_ ## name(                \
+        const name##_array_t *array                                             \
+    ) {                                                                         \
+        name ## _array_t clone = *array;                                        \
+        if (array->capacity <= (N))                                             \
+            return clone;                                                       \
+        clone.heap = binding ## _binding_alloc(binding ## _binding_state(array), \
+            array->capacity * sizeof(type));                                    \
+        if (clone.heap == NULL)                                                 \
+            return (name ## _array_t) {                                         \
+                .length = 0,                                                    \
+                .capacity = 0,                                                  \
+                binding ## _binding_init(binding ## _binding_state(array))      \
+            };                                                                  \
+        memcpy(clone.heap, array->heap, array->length * sizeof(type));          \
+        INSTRUMENT(small_array, name, INSTRUMENT_BYTES_MOVED,                   \
+            array->length * sizeof(type));                                      \
+        return clone;                                                           \
+    }                                                                           \
+                                                                                \
+    typedef int (*compare_ ## type ##_fn)(const type *a, const type *b);        \
+                                                                                \
+    /* Index of the first element not less than x */                            \
+    UNUSED static unsigned array_lower_bound_ ## name(                          \
+        const name ## _array_t* array, compare_ ## type ## _fn fn,              \
+        const type* x                                                           \
+    ) {                                                                         \
+        const type* data = array_data_ ## name(array);                          \
+        unsigned a = 0, b = array->length;                                      \
+        while (a < b) {                                                         \
+            const unsigned mid = a + (b - a) / 2;                               \
+            if (fn(&data[mid], x) < 0)                                          \
+                a = mid + 1;                                                    \
+            else                                                                \
+                b = mid;                                                        \
+        }                                                                       \
+        return a;                                                               \
+    }                                                                           \
+                                                                                \
+    UNUSED static type* array_insert_sorted_ ## name(                           \
+        name ## _array_t* array, compare_ ## type ## _fn fn, type* x            \
+    ) {                                                                         \
+        return array_insert_ ## name(array, x,                                  \
+            array_lower_bound_ ## name(array, fn, x));                          \
+    }                                                                           \
+                                                                                \
+    UNUSED static type* array_find_sorted_ ## name(                             \
+        const name ## _array_t* array, compare_ ## type ## _fn fn, type* x      \
+    ) {                                                                         \
+        const unsigned index = array_lower_bound_ ## name(array, fn, x);        \
+        type* data = array_data_ ## name(array);                                \
+        if (index == array->length || fn(x, &data[index]) != 0)                 \
+            return NULL;                                                        \
+        return &data[index];                                                    \
+    }                                                                           \
+                                                                                \
+    UNUSED static size_t array_serialized_size_ ## name(                        \
+        const name ## _array_t* array                                           \
+    ) {                                                                         \
+        DEFINE_SERIALIZED_ARRAY_ALIGNER(type)                                   \
+        return sizeof(struct aligner) + array->length * sizeof(type);           \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool array_serialize_ ## name(                                \
+        char* buffer, const name ## _array_t* array                             \
+    ) {                                                                         \
+        DEFINE_SERIALIZED_ARRAY_ALIGNER(type)                                   \
+        if((intptr_t)buffer & (ALIGNOF(unsigned) - 1)) return false;            \
+        *(unsigned*)buffer = array->length;                                     \
+        buffer += sizeof(struct aligner);                                       \
+        memcpy(buffer, array_data_ ## name(array),                              \
+               array->length * sizeof(type));                                   \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    NODISCARD UNUSED static bool array_deserialize_ ## name(                    \
+        name ## _array_t* array, const char* buffer                             \
+    ) {                                                                         \
+        DEFINE_SERIALIZED_ARRAY_ALIGNER(type)                                   \
+        if((intptr_t)buffer & (ALIGNOF(unsigned) - 1)) return false;            \
+        unsigned length = *(unsigned*)buffer;                                   \
+        array_free_ ## name(array);                                             \
+        if (length == 0) return true;                                           \
+        type* data = array_append_ ## name(array, length);                      \
+        if (data == NULL) return false;                                         \
+        memcpy(data, buffer + sizeof(struct aligner), length * sizeof(type));   \
+        return true;                                                            \
+    }
+
+#endif //CUTILS_SMALL_ARRAY_H
@@ -0,0 +1,221 @@
+#ifndef CUTILS_SOA_H
+#define CUTILS_SOA_H
+
+#include <cutils/allocator/allocator.h>
+#include <cutils/compatibility.h>
+#include <cutils/instrument.h>
+#include <cutils/minmax.h>
+#include <cutils/preprocessor.h>
+#include <cutils/when_macros.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#ifndef CUTILS_NO_STD
+#include <string.h>
+#endif
+
+// Alignment of every column
+#ifndef CUTILS_SOA_ALIGN
+#define CUTILS_SOA_ALIGN 64
+#endif
+
+#ifndef SOA_MIN_CAPACITY
+#define SOA_MIN_CAPACITY 64
+#endif
+
+#define EMPTY_SOA(name) (name ## _soa_t) { .length = 0, .capacity = 0, .block = NULL }
+#define EMPTY_SOA_WITH_ALLOCATOR(name, state) \
+    (name ## _soa_t) { .length = 0, .capacity = 0, .block = NULL, .allocator = (state) }
+
+// Column pointer the compiler knows to be aligned on CUTILS_SOA_ALIGN
+#ifdef __GNUC__
+#define soa_column(soa, field) \
+    ((__typeof__((soa).field))__builtin_assume_aligned((soa).field, CUTILS_SOA_ALIGN))
+#else
+#define soa_column(soa, field) ((soa).field)
+#endif
+
+// Append the elements of an AoS array (name ## _array_t) and the other way around
+#define soa_from_array(name, soa, array) \
+    soa_append_aos_ ## name(soa, (array)->data, (array)->length)
+#define soa_to_array(name, soa, array) \
+    soa_copy_aos_ ## name(soa, array_append_ ## name(array, (soa)->length), 0, (soa)->length)
+
+// Expansions of a (type, field) column description
+#define SOA_MEMBER(c, column) SOA_MEMBER_ column
+#define SOA_MEMBER_(type, field) type* field;
+#define SOA_COLUMN_SIZE(c, column) SOA_COLUMN_SIZE_ column
+#define SOA_COLUMN_SIZE_(type, field) \
+    + CUTILS_NEXT_ALLOC_ALIGNED((size_t)capacity * sizeof(type), (size_t)CUTILS_SOA_ALIGN)
+#define SOA_COLUMN_MOVE(c, column) SOA_COLUMN_MOVE_ column
+#define SOA_COLUMN_MOVE_(type, field) \
+    next.field = (type*)cursor; \
+    cursor += CUTILS_NEXT_ALLOC_ALIGNED((size_t)capacity * sizeof(type), (size_t)CUTILS_SOA_ALIGN); \
+    if (soa->length != 0) memcpy(next.field, soa->field, soa->length * sizeof(type));
+#define SOA_COLUMN_SCATTER(c, column) SOA_COLUMN_SCATTER_ column
+#define SOA_COLUMN_SCATTER_(type, field) soa->field[index] = item->field;
+#define SOA_COLUMN_GATHER(c, column) SOA_COLUMN_GATHER_ column
+#define SOA_COLUMN_GATHER_(type, field) item->field = soa->field[index];
+#define SOA_COLUMN_REMOVE(c, column) SOA_COLUMN_REMOVE_ column
+#define SOA_COLUMN_REMOVE_(type, field) \
+    memmove(&soa->field[index], &soa->field[index + 1], tail * sizeof(type));
+#define SOA_COLUMN_SWAP_AND_POP(c, column) SOA_COLUMN_SWAP_AND_POP_ column
+#define SOA_COLUMN_SWAP_AND_POP_(type, field) soa->field[index] = soa->field[soa->length];
+
+// Define name ## _soa_t storing the fields of type in one aligned column per
+// field, each column being described as (field type, field name)
+#define DEFINE_SOA_TYPE(type, ...) \
+    DEFINE_SOA_TYPE_WITH_ALLOCATOR(type, type, heap, __VA_ARGS__)
+
+#define DEFINE_SOA_TYPE_WITH_ALLOCATOR(name, type, binding, ...) \
+    DEFINE_INTERFACE_SOA_TYPE_WITH_ALLOCATOR(name, type, binding, __VA_ARGS__) \
+    DEFINE_IMPLEMENTATION_SOA_TYPE_WITH_ALLOCATOR(name, type, binding, __VA_ARGS__) \
+
+#define DEFINE_INTERFACE_SOA_TYPE_WITH_ALLOCATOR(name, type, binding, ...)      \
+    typedef struct {                                                            \
+        unsigned length;                                                        \
+        unsigned capacity;                                                      \
+        CUTILS_FOREACH(SOA_MEMBER, ~, __VA_ARGS__)                              \
+        void* block;                                                            \
+        binding ## _binding_member                                              \
+    } name ## _soa_t;
+
+#define DEFINE_IMPLEMENTATION_SOA_TYPE_WITH_ALLOCATOR(name, type, binding, ...) \
+    INSTRUMENT_DEFINE(soa, name)                                                \
+                                                                                \
+    UNUSED static size_t soa_block_size_ ## name(unsigned capacity) {           \
+        return CUTILS_SOA_ALIGN - 1 CUTILS_FOREACH(SOA_COLUMN_SIZE, ~, __VA_ARGS__); \
+    }                                                                           \
+                                                                                \
+    UNUSED NODISCARD static bool soa_reserve_ ## name(                          \
+        name ## _soa_t *soa, unsigned capacity                                  \
+    ) {                                                                         \
+        if (capacity <= soa->capacity)                                          \
+            return true;                                                        \
+        name ## _soa_t next = *soa;                                             \
+        next.capacity = capacity;                                               \
+        next.block = binding ## _binding_alloc(binding ## _binding_state(soa),  \
+            soa_block_size_ ## name(capacity));                                 \
+        when_null_ret(next.block, false);                                       \
+        char* cursor = (char*)CUTILS_NEXT_ALLOC_ALIGNED((uintptr_t)next.block,  \
+            (uintptr_t)CUTILS_SOA_ALIGN);                                       \
+        CUTILS_FOREACH(SOA_COLUMN_MOVE, ~, __VA_ARGS__)                         \
+        if (soa->block != NULL) {                                               \
+            INSTRUMENT(soa, name, INSTRUMENT_REALLOCATION, 1);                  \
+            INSTRUMENT(soa, name, INSTRUMENT_BYTES_MOVED,                       \
+                soa->length * sizeof(type));                                    \
+            binding ## _binding_dealloc(binding ## _binding_state(soa),         \
+                soa->block, soa_block_size_ ## name(soa->capacity));            \
+        }                                                                       \
+        INSTRUMENT(soa, name, INSTRUMENT_CAPACITY, capacity);                   \
+        *soa = next;                                                            \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED NODISCARD static bool soa_append_ ## name(                           \
+        name ## _soa_t *soa, unsigned count                                     \
+    ) {                                                                         \
+        if (soa->capacity < soa->length + count) {                              \
+            unsigned capacity = MAX(soa->capacity * 2, soa->length + count);    \
+            if (!soa_reserve_ ## name(soa, MAX(capacity, SOA_MIN_CAPACITY)))    \
+                return false;                                                   \
+        }                                                                       \
+        soa->length += count;                                                   \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static void soa_set_ ## name(                                        \
+        name ## _soa_t *soa, unsigned index, const type* item                   \
+    ) {                                                                         \
+        assert(index < soa->length);                                            \
+        CUTILS_FOREACH(SOA_COLUMN_SCATTER, ~, __VA_ARGS__)                      \
+    }                                                                           \
+                                                                                \
+    UNUSED static type soa_get_ ## name(                                        \
+        const name ## _soa_t *soa, unsigned index                               \
+    ) {                                                                         \
+        assert(index < soa->length);                                            \
+        type value;                                                             \
+        memset(&value, 0, sizeof(value));                                       \
+        type* item = &value;                                                    \
+        CUTILS_FOREACH(SOA_COLUMN_GATHER, ~, __VA_ARGS__)                       \
+        return value;                                                           \
+    }                                                                           \
+                                                                                \
+    UNUSED NODISCARD static bool soa_push_ ## name(                             \
+        name ## _soa_t *soa, const type* item                                   \
+    ) {                                                                         \
+        if (!soa_append_ ## name(soa, 1))                                       \
+            return false;                                                       \
+        soa_set_ ## name(soa, soa->length - 1, item);                           \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool soa_pop_ ## name(                                        \
+        name ## _soa_t *soa, type* value                                        \
+    ) {                                                                         \
+        if (soa->length == 0)                                                   \
+            return false;                                                       \
+        if (value != NULL)                                                      \
+            *value = soa_get_ ## name(soa, soa->length - 1);                    \
+        soa->length -= 1;                                                       \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static void soa_remove_ ## name(                                     \
+        name ## _soa_t *soa, unsigned index                                     \
+    ) {                                                                         \
+        assert(index < soa->length);                                            \
+        const size_t tail = soa->length - 1 - index;                            \
+        if (tail != 0) {                                                        \
+            CUTILS_FOREACH(SOA_COLUMN_REMOVE, ~, __VA_ARGS__)                   \
+            INSTRUMENT(soa, name, INSTRUMENT_BYTES_MOVED, tail * sizeof(type)); \
+        }                                                                       \
+        soa->length -= 1;                                                       \
+    }                                                                           \
+                                                                                \
+    UNUSED static void soa_swap_and_pop_back_ ## name(                          \
+        name ## _soa_t *soa, unsigned index                                     \
+    ) {                                                                         \
+        assert(index < soa->length);                                            \
+        soa->length -= 1;                                                       \
+        if (index != soa->length) {                                             \
+            CUTILS_FOREACH(SOA_COLUMN_SWAP_AND_POP, ~, __VA_ARGS__)             \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    UNUSED NODISCARD static bool soa_append_aos_ ## name(                       \
+        name ## _soa_t *soa, const type* items, unsigned count                  \
+    ) {                                                                         \
+        unsigned index = soa->length;                                           \
+        if (!soa_append_ ## name(soa, count))                                   \
+            return false;                                                       \
+        for (const type* item = items; item != items + count; item++, index++) { \
+            CUTILS_FOREACH(SOA_COLUMN_SCATTER, ~, __VA_ARGS__)                  \
+        }                                                                       \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static bool soa_copy_aos_ ## name(                                   \
+        const name ## _soa_t *soa, type* items, unsigned from, unsigned count   \
+    ) {                                                                         \
+        when_true_ret(items == NULL && count != 0, false);                      \
+        assert(from + count <= soa->length);                                    \
+        unsigned index = from;                                                  \
+        for (type* item = items; item != items + count; item++, index++) {      \
+            CUTILS_FOREACH(SOA_COLUMN_GATHER, ~, __VA_ARGS__)                   \
+        }                                                                       \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    UNUSED static void soa_free_ ## name(name ## _soa_t *soa) {                 \
+        if (soa->block != NULL)                                                 \
+            binding ## _binding_dealloc(binding ## _binding_state(soa),         \
+                soa->block, soa_block_size_ ## name(soa->capacity));            \
+        soa->length = 0;                                                        \
+        soa->capacity = 0;                                                      \
+        soa->block = NULL;                                                      \
+    }
+
+#endif //CUTILS_SOA_H
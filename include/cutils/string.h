@@ -41,4 +41,72 @@ static string_view_t string_slice(const string_t str, int start, int end) {
     };
 }
 
+// Zero-copy iteration over the records of a view separated by delimiter.
+// A delimiter at the end of the view terminates the last record and does not
+// start an empty one.
+typedef struct {
+    string_view_t rest;
+    char delimiter;
+} string_split_t;
+
+UNUSED
+static string_split_t string_split(const string_view_t view, const char delimiter) {
+    return (string_split_t) { .rest = view, .delimiter = delimiter };
+}
+
+UNUSED
+static string_split_t string_lines(const string_view_t view) {
+    return string_split(view, '\n');
+}
+
+UNUSED
+static bool string_split_next(string_split_t* split, string_view_t* record) {
+    if (split->rest.len == 0)
+        return false;
+    char* end = memchr(split->rest.str, split->delimiter, split->rest.len);
+    if (end == NULL) {
+        *record = split->rest;
+        split->rest = (string_view_t) { .str = split->rest.str + split->rest.len, .len = 0 };
+        return true;
+    }
+    *record = (string_view_t) { .str = split->rest.str, .len = (size_t)(end - split->rest.str) };
+    split->rest.len -= record->len + 1;
+    split->rest.str = end + 1;
+    return true;
+}
+
+// Same as string_split_next, a trailing '\r' is removed from the lines
+UNUSED
+static bool string_lines_next(string_split_t* split, string_view_t* line) {
+    if (!string_split_next(split, line))
+        return false;
+    if (line->len != 0 && line->str[line->len - 1] == '\r')
+        line->len -= 1;
+    return true;
+}
+
+// Split view in at most count chunks of similar sizes which end right after
+// a delimiter (or at the end of the view), so each one can be processed by
+// a different thread. Returns the number of chunks written.
+UNUSED
+static unsigned string_chunks(
+    const string_view_t view, const char delimiter, const unsigned count, string_view_t* chunks
+) {
+    unsigned written = 0;
+    size_t begin = 0;
+    for (unsigned i = 0; i < count && begin < view.len; i++) {
+        size_t end = view.len;
+        if (i + 1 < count) {
+            // Nominal boundary of the chunk, moved after the next delimiter
+            const size_t nominal = MAX(begin, view.len / count * (i + 1));
+            const char* found = nominal < view.len
+                ? memchr(view.str + nominal, delimiter, view.len - nominal) : NULL;
+            end = found != NULL ? (size_t)(found - view.str) + 1 : view.len;
+        }
+        chunks[written++] = (string_view_t) { .str = view.str + begin, .len = end - begin };
+        begin = end;
+    }
+    return written;
+}
+
 #endif //CUTILS_STRING_H
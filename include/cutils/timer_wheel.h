@@ -0,0 +1,423 @@
+#ifndef CUTILS_TIMER_WHEEL_H
+#define CUTILS_TIMER_WHEEL_H
+
+#include <cutils/allocator/allocator.h>
+#include <cutils/bits.h>
+#include <cutils/compatibility.h>
+#include <cutils/instrument.h>
+#include <cutils/minmax.h>
+#include <cutils/slot_map.h>
+#include <cutils/when_macros.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef CUTILS_NO_STD
+#include <string.h>
+#endif
+
+/*
+ * Hierarchical timer wheel: level l has TIMER_WHEEL_SLOTS slots of
+ * TIMER_WHEEL_SLOTS^l ticks each, a timer is put in the lowest level whose
+ * span covers its delay and moves down a level each time the slot it is in
+ * comes around. Scheduling, rescheduling and cancelling a timer are O(1),
+ * advancing the time costs one step per tick where an occupied slot of some
+ * level comes around, idle ticks are skipped with the occupancy masks of the
+ * levels.
+ *
+ * Timers are kept in a pool of nodes grown with the allocator of the wheel
+ * and recycled through a free list, they are addressed by generational
+ * handles (see slot_map.h): cancelling a timer which already fired is
+ * harmless. A slot is a bucket of node indices, a node knows its position in
+ * its bucket and leaves it by swapping with the last one. Cascading or firing
+ * a slot reads its bucket in order instead of chasing a list through the
+ * pool, and buckets keep their capacity so a wheel in steady state does not
+ * allocate.
+ *
+ * Time is an unsigned integer in any unit, tick of them make a tick. A timer
+ * fires during the first call to timer_wheel_advance reaching its expiry
+ * rounded up to a tick, never earlier. Delays beyond the span of the highest
+ * level are parked in its farthest slot until they come into range.
+ */
+
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1u << TIMER_WHEEL_SLOT_BITS)
+// Levels cover up to 2^60 ticks
+#define TIMER_WHEEL_MAX_LEVELS 10
+#define TIMER_WHEEL_NONE ((unsigned)-1)
+
+// Nodes read ahead when a bucket is cascaded
+#ifndef CUTILS_TIMER_WHEEL_PREFETCH_DISTANCE
+#define CUTILS_TIMER_WHEEL_PREFETCH_DISTANCE 8
+#endif
+
+#ifdef __GNUC__
+#define timer_wheel_prefetch(address) __builtin_prefetch(address, 1)
+#else
+#define timer_wheel_prefetch(address) ((void)(address))
+#endif
+
+typedef struct timer_wheel timer_wheel_t;
+
+INSTRUMENT_DEFINE(timer_wheel, pool)
+INSTRUMENT_DEFINE(timer_wheel, bucket)
+
+// Called when a timer fires, it may schedule and cancel timers of the wheel
+typedef void (*timer_wheel_callback_t)(timer_wheel_t* wheel, void* data);
+
+typedef struct {
+    // Expiry in ticks
+    uint64_t expires;
+    timer_wheel_callback_t callback;
+    void* data;
+    // level * TIMER_WHEEL_SLOTS + index, TIMER_WHEEL_NONE when not scheduled
+    unsigned slot;
+    // Index in the bucket of the slot, next free node when not scheduled
+    unsigned position;
+    unsigned generation;
+} timer_wheel_node_t;
+
+typedef struct {
+    unsigned* data;
+    unsigned length;
+    unsigned capacity;
+} timer_wheel_bucket_t;
+
+struct timer_wheel {
+    timer_wheel_bucket_t buckets[TIMER_WHEEL_MAX_LEVELS * TIMER_WHEEL_SLOTS];
+    // Bit i of occupied[l] is set when slot i of level l is not empty
+    uint64_t occupied[TIMER_WHEEL_MAX_LEVELS];
+    timer_wheel_node_t* nodes;
+    unsigned node_count;
+    unsigned node_capacity;
+    unsigned free_head;
+    unsigned levels;
+    // Number of scheduled timers
+    size_t count;
+    // Last tick processed by timer_wheel_advance
+    uint64_t now;
+    uint64_t tick;
+    allocator_t allocator;
+};
+
+// Returns false when tick is 0 or levels is not in [1, TIMER_WHEEL_MAX_LEVELS]
+NODISCARD UNUSED
+static bool timer_wheel_init_allocator(
+    timer_wheel_t* wheel, const allocator_t allocator,
+    const uint64_t tick, const unsigned levels, const uint64_t start
+) {
+    when_true_ret(tick == 0 || levels == 0 || levels > TIMER_WHEEL_MAX_LEVELS, false);
+    for (unsigned i = 0; i < TIMER_WHEEL_MAX_LEVELS * TIMER_WHEEL_SLOTS; i++)
+        wheel->buckets[i] = (timer_wheel_bucket_t) { .data = NULL, .length = 0, .capacity = 0 };
+    for (unsigned l = 0; l < TIMER_WHEEL_MAX_LEVELS; l++)
+        wheel->occupied[l] = 0;
+    wheel->nodes = NULL;
+    wheel->node_count = 0;
+    wheel->node_capacity = 0;
+    wheel->free_head = TIMER_WHEEL_NONE;
+    wheel->levels = levels;
+    wheel->count = 0;
+    wheel->now = start / tick;
+    wheel->tick = tick;
+    wheel->allocator = allocator;
+    return true;
+}
+
+#ifndef CUTILS_NO_STD
+NODISCARD UNUSED
+static bool timer_wheel_init(
+    timer_wheel_t* wheel, const uint64_t tick, const unsigned levels, const uint64_t start
+) {
+    return timer_wheel_init_allocator(wheel, ALLOCATOR_DEFAULT, tick, levels, start);
+}
+#endif
+
+UNUSED
+static void timer_wheel_free(timer_wheel_t* wheel) {
+    for (unsigned i = 0; i < TIMER_WHEEL_MAX_LEVELS * TIMER_WHEEL_SLOTS; i++) {
+        allocator_dealloc(&wheel->allocator, wheel->buckets[i].data);
+        wheel->buckets[i] = (timer_wheel_bucket_t) { .data = NULL, .length = 0, .capacity = 0 };
+    }
+    for (unsigned l = 0; l < TIMER_WHEEL_MAX_LEVELS; l++)
+        wheel->occupied[l] = 0;
+    allocator_dealloc(&wheel->allocator, wheel->nodes);
+    wheel->nodes = NULL;
+    wheel->node_count = 0;
+    wheel->node_capacity = 0;
+    wheel->free_head = TIMER_WHEEL_NONE;
+    wheel->count = 0;
+}
+
+// Grow the node pool to hold at least capacity timers
+NODISCARD UNUSED
+static bool timer_wheel_reserve(timer_wheel_t* wheel, const unsigned capacity) {
+    if (capacity <= wheel->node_capacity)
+        return true;
+    when_true_ret(capacity >= TIMER_WHEEL_NONE, false);
+    timer_wheel_node_t* nodes = allocator_realloc_sized(&wheel->allocator, wheel->nodes,
+        wheel->node_capacity * sizeof(timer_wheel_node_t), capacity * sizeof(timer_wheel_node_t));
+    when_null_ret(nodes, false);
+    if (wheel->node_capacity != 0) {
+        INSTRUMENT(timer_wheel, pool, INSTRUMENT_REALLOCATION, 1);
+        if (nodes != wheel->nodes)
+            INSTRUMENT(timer_wheel, pool, INSTRUMENT_BYTES_MOVED, wheel->node_count * sizeof(timer_wheel_node_t));
+    }
+    INSTRUMENT(timer_wheel, pool, INSTRUMENT_CAPACITY, capacity);
+    wheel->nodes = nodes;
+    wheel->node_capacity = capacity;
+    return true;
+}
+
+// Node of a handle, NULL when the timer fired or was cancelled
+UNUSED
+static timer_wheel_node_t* timer_wheel_get(const timer_wheel_t* wheel, const slot_handle_t handle) {
+    const unsigned index = slot_handle_index(handle);
+    if (index >= wheel->node_count)
+        return NULL;
+    timer_wheel_node_t* node = &wheel->nodes[index];
+    if (node->generation != slot_handle_generation(handle) || node->slot == TIMER_WHEEL_NONE)
+        return NULL;
+    return node;
+}
+
+UNUSED
+static bool timer_wheel_pending(const timer_wheel_t* wheel, const slot_handle_t handle) {
+    return timer_wheel_get(wheel, handle) != NULL;
+}
+
+// Slot covering an expiry, which must not be before now
+UNUSED
+static unsigned timer_wheel_slot(const timer_wheel_t* wheel, uint64_t expires) {
+    const uint64_t delay = expires - wheel->now;
+    unsigned level = delay < TIMER_WHEEL_SLOTS ? 0
+        : (63 - bits_leading_zeros(delay)) / TIMER_WHEEL_SLOT_BITS;
+    if (level >= wheel->levels) {
+        level = wheel->levels - 1;
+        expires = wheel->now + ((uint64_t)1 << (wheel->levels * TIMER_WHEEL_SLOT_BITS)) - 1;
+    }
+    return level * TIMER_WHEEL_SLOTS
+        + (unsigned)((expires >> (level * TIMER_WHEEL_SLOT_BITS)) & (TIMER_WHEEL_SLOTS - 1));
+}
+
+// Append a node to the bucket of a slot, false when the bucket cannot grow
+NODISCARD UNUSED
+static bool timer_wheel_link(timer_wheel_t* wheel, const unsigned index, const unsigned slot) {
+    timer_wheel_bucket_t* bucket = &wheel->buckets[slot];
+    if (bucket->length == bucket->capacity) {
+        const unsigned capacity = MAX(bucket->capacity * 2, 8);
+        unsigned* data = allocator_realloc_sized(&wheel->allocator, bucket->data,
+            bucket->capacity * sizeof(unsigned), capacity * sizeof(unsigned));
+        when_null_ret(data, false);
+        if (bucket->capacity != 0) {
+            INSTRUMENT(timer_wheel, bucket, INSTRUMENT_REALLOCATION, 1);
+            if (data != bucket->data)
+                INSTRUMENT(timer_wheel, bucket, INSTRUMENT_BYTES_MOVED, bucket->length * sizeof(unsigned));
+        }
+        INSTRUMENT(timer_wheel, bucket, INSTRUMENT_CAPACITY, capacity);
+        bucket->data = data;
+        bucket->capacity = capacity;
+    }
+    wheel->nodes[index].slot = slot;
+    wheel->nodes[index].position = bucket->length;
+    bucket->data[bucket->length++] = index;
+    wheel->occupied[slot / TIMER_WHEEL_SLOTS] |= (uint64_t)1 << (slot % TIMER_WHEEL_SLOTS);
+    return true;
+}
+
+UNUSED
+static void timer_wheel_unlink(timer_wheel_t* wheel, const unsigned index) {
+    const timer_wheel_node_t* node = &wheel->nodes[index];
+    timer_wheel_bucket_t* bucket = &wheel->buckets[node->slot];
+    const unsigned last = bucket->data[--bucket->length];
+    bucket->data[node->position] = last;
+    wheel->nodes[last].position = node->position;
+    if (bucket->length == 0)
+        wheel->occupied[node->slot / TIMER_WHEEL_SLOTS] &=
+            ~((uint64_t)1 << (node->slot % TIMER_WHEEL_SLOTS));
+}
+
+// Give the node back to the pool, invalidating its handles
+UNUSED
+static void timer_wheel_release(timer_wheel_t* wheel, const unsigned index) {
+    timer_wheel_node_t* node = &wheel->nodes[index];
+    node->slot = TIMER_WHEEL_NONE;
+    node->generation += 1;
+    if (node->generation == 0)
+        node->generation = 1;
+    node->position = wheel->free_head;
+    wheel->free_head = index;
+    wheel->count -= 1;
+}
+
+// First tick not before time, a timer never fires early
+UNUSED
+static uint64_t timer_wheel_ticks(const timer_wheel_t* wheel, const uint64_t time) {
+    return time / wheel->tick + (time % wheel->tick != 0);
+}
+
+// Schedule callback(wheel, data) at time expires, a time already reached
+// fires on the next tick. Returns SLOT_HANDLE_NULL when the wheel cannot grow.
+NODISCARD UNUSED
+static slot_handle_t timer_wheel_schedule(
+    timer_wheel_t* wheel, const uint64_t expires, const timer_wheel_callback_t callback, void* data
+) {
+    unsigned index = wheel->free_head;
+    if (index == TIMER_WHEEL_NONE) {
+        if (wheel->node_count == wheel->node_capacity
+            && !timer_wheel_reserve(wheel, MAX(wheel->node_capacity * 2, 64)))
+            return SLOT_HANDLE_NULL;
+        index = wheel->node_count;
+        wheel->nodes[index].generation = 1;
+    }
+    timer_wheel_node_t* node = &wheel->nodes[index];
+    const unsigned next_free = node->position;
+    node->expires = MAX(timer_wheel_ticks(wheel, expires), wheel->now + 1);
+    node->callback = callback;
+    node->data = data;
+    when_false_ret(timer_wheel_link(wheel, index, timer_wheel_slot(wheel, node->expires)), SLOT_HANDLE_NULL);
+    if (index == wheel->node_count)
+        wheel->node_count += 1;
+    else
+        wheel->free_head = next_free;
+    wheel->count += 1;
+    return slot_handle(index, node->generation);
+}
+
+// Move a pending timer to a new expiry without going through the pool,
+// returns false when the timer is not pending or the wheel cannot grow
+NODISCARD UNUSED
+static bool timer_wheel_reschedule(timer_wheel_t* wheel, const slot_handle_t handle, const uint64_t expires) {
+    timer_wheel_node_t* node = timer_wheel_get(wheel, handle);
+    when_null_ret(node, false);
+    const unsigned index = slot_handle_index(handle);
+    const uint64_t ticks = MAX(timer_wheel_ticks(wheel, expires), wheel->now + 1);
+    const unsigned slot = timer_wheel_slot(wheel, ticks);
+    // Timers pushed back by a little often stay in the same slot of a level
+    // above, where they are sorted out by the cascade
+    if (slot != node->slot) {
+        const unsigned old_slot = node->slot;
+        timer_wheel_unlink(wheel, index);
+        if (!timer_wheel_link(wheel, index, slot)) {
+            // The old bucket just shrank, there is room to put it back
+            (void)timer_wheel_link(wheel, index, old_slot);
+            return false;
+        }
+    }
+    node->expires = ticks;
+    return true;
+}
+
+// Returns false when the timer already fired or was cancelled
+UNUSED
+static bool timer_wheel_cancel(timer_wheel_t* wheel, const slot_handle_t handle) {
+    when_null_ret(timer_wheel_get(wheel, handle), false);
+    const unsigned index = slot_handle_index(handle);
+    timer_wheel_unlink(wheel, index);
+    timer_wheel_release(wheel, index);
+    return true;
+}
+
+// Move the timers of the current slot of a level to the levels below. When a
+// bucket cannot grow the timers not moved yet stay and false is returned.
+NODISCARD UNUSED
+static bool timer_wheel_cascade(timer_wheel_t* wheel, const unsigned level) {
+    const unsigned index_in_level = (wheel->now >> (level * TIMER_WHEEL_SLOT_BITS)) & (TIMER_WHEEL_SLOTS - 1);
+    timer_wheel_bucket_t* bucket = &wheel->buckets[level * TIMER_WHEEL_SLOTS + index_in_level];
+    // Nodes never land back in the bucket being cascaded, it is only read
+    for (unsigned i = 0; i < bucket->length; i++) {
+        if (i + CUTILS_TIMER_WHEEL_PREFETCH_DISTANCE < bucket->length)
+            timer_wheel_prefetch(&wheel->nodes[bucket->data[i + CUTILS_TIMER_WHEEL_PREFETCH_DISTANCE]]);
+        const unsigned index = bucket->data[i];
+        if (!timer_wheel_link(wheel, index, timer_wheel_slot(wheel, wheel->nodes[index].expires))) {
+            const unsigned left = bucket->length - i;
+            memmove(bucket->data, bucket->data + i, left * sizeof(unsigned));
+            bucket->length = left;
+            for (unsigned k = 0; k < left; k++)
+                wheel->nodes[bucket->data[k]].position = k;
+            return false;
+        }
+    }
+    bucket->length = 0;
+    wheel->occupied[level] &= ~((uint64_t)1 << index_in_level);
+    return true;
+}
+
+// First tick after now where an occupied slot of level comes around, or
+// UINT64_MAX when the level is empty
+UNUSED
+static uint64_t timer_wheel_next_occupied(const timer_wheel_t* wheel, const unsigned level) {
+    const uint64_t occupied = wheel->occupied[level];
+    if (occupied == 0)
+        return UINT64_MAX;
+    const unsigned shift = level * TIMER_WHEEL_SLOT_BITS;
+    // Next boundary of the level and the slot coming around there
+    const uint64_t boundary = ((wheel->now >> shift) + 1) << shift;
+    const unsigned start = (unsigned)(boundary >> shift) & (TIMER_WHEEL_SLOTS - 1);
+    const uint64_t rotated = (occupied >> start) | (occupied << ((TIMER_WHEEL_SLOTS - start) & (TIMER_WHEEL_SLOTS - 1)));
+    return boundary + ((uint64_t)bits_trailing_zeros(rotated) << shift);
+}
+
+/*
+ * Advance the wheel to time and fire every timer expiring until then, in
+ * order of their tick. Timers scheduled by the callbacks fire during the same
+ * call when they expire before time. Returns the number of fired timers.
+ * When a bucket cannot grow to take the timers of a level above, the wheel
+ * stops before the tick of the failure: wheel->now stays below time / tick
+ * and a later call resumes from there.
+ */
+UNUSED
+static size_t timer_wheel_advance(timer_wheel_t* wheel, const uint64_t time) {
+    const uint64_t target = time / wheel->tick;
+    size_t fired = 0;
+    while (wheel->now < target) {
+        if (wheel->count == 0) {
+            wheel->now = target;
+            break;
+        }
+        // Next tick with something to do: an occupied slot of any level
+        // coming around, the empty slots in between are skipped
+        uint64_t next = UINT64_MAX;
+        for (unsigned l = 0; l < wheel->levels; l++)
+            next = MIN(next, timer_wheel_next_occupied(wheel, l));
+        if (next > target) {
+            wheel->now = target;
+            break;
+        }
+        wheel->now = next;
+        // Higher levels first, their timers can land in the slots below.
+        // Cascading a slot again after a failure moves nothing twice.
+        for (unsigned l = wheel->levels; l-- > 1;) {
+            const uint64_t span = (uint64_t)1 << (l * TIMER_WHEEL_SLOT_BITS);
+            if ((next & (span - 1)) == 0 && wheel->occupied[l] != 0 && !timer_wheel_cascade(wheel, l)) {
+                wheel->now = next - 1;
+                return fired;
+            }
+        }
+        // Callbacks can grow the pool or schedule timers, never in the slot
+        // of this tick: take the last node again after each of them
+        timer_wheel_bucket_t* bucket = &wheel->buckets[next & (TIMER_WHEEL_SLOTS - 1)];
+        while (bucket->length != 0) {
+            const unsigned index = bucket->data[bucket->length - 1];
+            const unsigned slot = wheel->nodes[index].slot;
+            timer_wheel_unlink(wheel, index);
+            // A wheel of a single level parks the timers beyond its span in
+            // its farthest slot, they go back there until they come in range
+            if (wheel->nodes[index].expires > next) {
+                if (!timer_wheel_link(wheel, index, timer_wheel_slot(wheel, wheel->nodes[index].expires))) {
+                    // The bucket just shrank, there is room to put it back
+                    (void)timer_wheel_link(wheel, index, slot);
+                    wheel->now = next - 1;
+                    return fired;
+                }
+                continue;
+            }
+            const timer_wheel_callback_t callback = wheel->nodes[index].callback;
+            void* data = wheel->nodes[index].data;
+            timer_wheel_release(wheel, index);
+            fired += 1;
+            callback(wheel, data);
+        }
+    }
+    return fired;
+}
+
+#endif // CUTILS_TIMER_WHEEL_H
@@ -2,9 +2,19 @@
 #include <tap.h>
 
 #include <cutils/allocator/arena.h>
+#include <pthread.h>
 
 CONSTEXPR arena_size_t BUFFER_SIZE = 4321;
 
+// Caches the regions of an arena and exits without releasing them
+static void* cache_and_exit(void* cached) {
+    arena_allocator_t arena = ARENA_INIT;
+    (void)arena_allocate(&arena, 100000);
+    arena_free(&arena);
+    *(bool*)cached = arena_region_cache.head != NULL;
+    return NULL;
+}
+
 int main(void) {
     arena_allocator_t arena = ARENA_INIT;
 
@@ -30,11 +40,47 @@ int main(void) {
     cmp_mem(b, b_exp, b_size, "527 bytes zone check");
     cmp_mem(c, c_exp, c_size, "97 bytes zone check");
 
+    const arena_region_t* region = arena.current;
     const void* d = arena_allocate(&arena, 6000);
     ok(d != NULL, "Realloc on overflow");
+    ok(arena.large != NULL, "Large allocation gets a dedicated region");
+    ok(arena.current == region, "Large allocation does not abandon the current region");
+
+    const void* e = arena_allocate_aligned(&arena, 3, 64);
+    ok(((uintptr_t)e & 63) == 0, "64 bytes aligned allocation");
+    const void* f = arena_allocate(&arena, 1);
+    ok((const char*)f == (const char*)e + 3, "1 byte allocation is not padded");
+
+    const arena_frame_t frame = arena_push_frame(&arena);
+    ok(arena_allocate(&arena, 1 << 20) != NULL, "1MiB allocation");
+    arena_pop_frame(&arena, frame);
+    ok(arena.large == frame.large, "Pop frame releases the large allocations");
+
+    unsigned regions = 0;
+    for (unsigned i = 0; i < 64 * 1024; i++)
+        (void)arena_allocate(&arena, 1000);
+    for (const arena_region_t* r = arena.head; r != NULL; r = r->next)
+        regions++;
+    cmp_ok(regions, "<=", 16, "Regions grow geometrically");
 
     arena_free(&arena);
     ok(arena.head == NULL, "Set head = NULL on free");
     ok(arena.current == NULL, "Set current = NULL on free");
-    return 0;
+    ok(arena_region_cache.head != NULL, "Free regions are cached");
+
+    arena_allocator_t other = ARENA_INIT;
+    const arena_size_t cached = arena_region_cache.size;
+    (void)arena_allocate(&other, 16);
+    cmp_ok(arena_region_cache.size, "<", cached, "Cached region is reused");
+    arena_free(&other);
+    arena_cache_release();
+    ok(arena_region_cache.head == NULL, "Release the region cache");
+
+    // The leak checker of the sanitizer builds sees a cache left at exit
+    pthread_t thread;
+    bool thread_cached = false;
+    ok(pthread_create(&thread, NULL, cache_and_exit, &thread_cached) == 0 && pthread_join(thread, NULL) == 0
+       && thread_cached,
+       "The cache of a thread is freed at its exit");
+    done_testing();
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include <tap.h>
+
+#define CUTILS_ARRAY_LIST_IMPL
+#include <cutils/array_list.h>
+
+typedef struct {
+    int id;
+    char payload[100];
+} record_t;
+
+int main(void) {
+    array_list_t list = ARRAY_LIST_INIT(int);
+    ok(array_list_empty(&list), "Initial list is empty");
+
+    // Interleave both ends so the buffer wraps around while growing
+    for (int i = 0; i < 100; i++) {
+        array_list_push_back(&list, &i);
+        int front = -i - 1;
+        array_list_push_front(&list, &front);
+    }
+    cmp_ok(list.size, "==", 200, "Push at both ends");
+    bool ordered = true;
+    for (int i = 0; i < 200; i++)
+        ordered &= *get_array_list_ref(list, i, int) == i - 100;
+    ok(ordered, "Indexed access follows the queue order");
+    ok(array_list_get(&list, 200) == NULL, "Out of bounds access returns NULL");
+
+    int value;
+    ok(array_list_pop_front(&list, &value) && value == -100, "Pop front");
+    ok(array_list_pop_back(&list, &value) && value == 99, "Pop back");
+    ok(array_list_swap(&list, 0, 197) == -ERROR_NO_ERROR, "Swap");
+    ok(*(int*)array_list_get(&list, 0) == 98 && *(int*)array_list_get(&list, 197) == -99, "Swapped values");
+    ok(array_list_swap_and_pop_back(&list, 1, &value) && value == -98, "Swap and pop back");
+    cmp_ok(*(int*)array_list_get(&list, 1), "==", -99, "Last element moved");
+    array_list_deinit(&list);
+    ok(list.data == NULL && list.size == 0, "Deinit");
+
+    // FIFO of records larger than the swap buffer
+    array_list_t *fifo = array_list_create(sizeof(record_t));
+    record_t r = { 0 };
+    bool fifo_ok = true;
+    for (int i = 0; i < 1000; i++) {
+        r.id = i;
+        memset(r.payload, i & 0xff, sizeof(r.payload));
+        array_list_push_back(fifo, &r);
+        if (i % 3 == 2) {
+            array_list_pop_front(fifo, &r);
+            fifo_ok &= r.id == i / 3 && (unsigned char)r.payload[99] == ((i / 3) & 0xff);
+        }
+    }
+    ok(fifo_ok, "FIFO order is kept");
+    cmp_ok(fifo->capacity, "<=", 1024, "FIFO capacity follows its size");
+    ok(array_list_swap(fifo, 0, 1) == -ERROR_NO_ERROR
+       && ((record_t*)array_list_get(fifo, 0))->id == 334
+       && ((record_t*)array_list_get(fifo, 1))->payload[99] == (char)(333 & 0xff), "Swap large elements");
+    array_list_free(fifo);
+    done_testing();
+}
@@ -0,0 +1,56 @@
+#include <tap.h>
+#include <cutils/allocator/arena.h>
+#include <cutils/allocator/bump.h>
+#include <cutils/array.h>
+#include <cutils/ring.h>
+
+DEFINE_ARRAY_TYPE_WITH_ALLOCATOR(arena_int, int, arena)
+DEFINE_ARRAY_TYPE_WITH_ALLOCATOR(bump_int, int, bump)
+DEFINE_ARRAY_TYPE_WITH_ALLOCATOR(dynamic_int, int, allocator)
+DEFINE_RING_TYPE_WITH_ALLOCATOR(arena_int, int, arena)
+
+char buf[4096];
+
+int main(void) {
+    arena_allocator_t arena = ARENA_INIT;
+    arena_int_array_t a = EMPTY_ARRAY_WITH_ALLOCATOR(arena_int, &arena);
+    for (int i = 0; i < 1000; i++)
+        *array_append_arena_int(&a, 1) = i;
+    cmp_ok(a.length, "==", 1000, "Arena array length");
+    ok(a.data[0] == 0 && a.data[999] == 999, "Arena array content");
+    ok(a.allocator == &arena, "Arena array keeps its allocator");
+    arena_int_array_t clone = array_shallow_clone_arena_int(&a);
+    ok(clone.allocator == &arena && clone.data[500] == 500, "Clone uses the same allocator");
+    array_free_arena_int(&a);
+    ok(a.data == NULL && a.allocator == &arena, "Free keeps the allocator");
+
+    arena_int_ring_t ring = ring_create_allocator_arena_int(&arena, 10, NULL);
+    ok(ring.data != NULL && ring.allocator == &arena, "Arena ring");
+    for (int i = 0; i < 20; i++)
+        *ring_push_back_arena_int(&ring, true) = i;
+    cmp_ok(*ring_front_arena_int(&ring), "==", 10, "Arena ring content");
+    ring_free_arena_int(&ring);
+    ok(ring.data == NULL && ring.allocator == &arena, "Ring free keeps the allocator");
+    arena_free(&arena);
+
+    bump_allocator_t bump = bump_init(buf, sizeof(buf));
+    bump_int_array_t b = EMPTY_ARRAY_WITH_ALLOCATOR(bump_int, &bump);
+    int* first = array_append_bump_int(&b, 1);
+    for (int i = 1; i < 500; i++)
+        *array_append_bump_int(&b, 1) = i;
+    ok(b.data == first, "Last bump allocation grows in place");
+    ok(array_append_bump_int(&b, 1000) == NULL, "Return NULL when the bump allocator is full");
+    array_free_bump_int(&b);
+    cmp_ok(bump.size, "==", 0, "Free the last bump allocation");
+
+    arena_allocator_t other = ARENA_INIT;
+    const allocator_t allocator = arena_get_allocator(&other);
+    dynamic_int_array_t d = EMPTY_ARRAY_WITH_ALLOCATOR(dynamic_int, &allocator);
+    for (int i = 0; i < 1000; i++)
+        *array_append_dynamic_int(&d, 1) = i;
+    ok(d.length == 1000 && d.data[999] == 999, "Dispatch through allocator_t without realloc");
+    array_free_dynamic_int(&d);
+    arena_free(&other);
+    arena_cache_release();
+    done_testing();
+}
@@ -14,5 +14,18 @@ int main(void) {
     }
     ok(bits_any(bitset, 15, 20) == false, "Only multiples of seven are set");
     ok(bits_any(bitset, 15, 21) == true, "Multiples of seven are set");
+    ok(bits_next_pow2(0) == 1 && bits_next_pow2(1) == 1, "Next power of 2 of 0 and 1");
+    ok(bits_next_pow2(64) == 64 && bits_next_pow2(65) == 128, "Next power of 2");
+    ok(bits_next_pow2((UINT64_C(1) << 40) - 3) == UINT64_C(1) << 40, "Next power of 2 above 32 bits");
+    ok(bits_popcount(0) == 0 && bits_popcount(UINT64_MAX) == 64, "Population count of 0 and ~0");
+    ok(bits_popcount(UINT64_C(0x8000000100000011)) == 4, "Population count");
+    ok(bits_leading_zeros(1) == 63 && bits_leading_zeros(UINT64_MAX) == 0, "Leading zeros of 1 and ~0");
+    ok(bits_leading_zeros(UINT64_C(0x00000F0000000000)) == 20, "Leading zeros");
+    ok(bits_trailing_zeros(1) == 0 && bits_trailing_zeros(UINT64_C(1) << 63) == 63, "Trailing zeros of 1 and 2^63");
+    ok(bits_trailing_zeros(UINT64_C(0x00000F0000000000)) == 40, "Trailing zeros");
+    uint64_t high;
+    ok(bits_mul128(UINT64_MAX, UINT64_MAX, &high) == 1 && high == UINT64_MAX - 1, "Product of ~0 by itself");
+    ok(bits_mul128(UINT64_C(0x123456789ABCDEF0), 16, &high) == UINT64_C(0x23456789ABCDEF00) && high == 1,
+       "Product carrying into the high word");
     return 0;
 }
\ No newline at end of file
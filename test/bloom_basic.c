@@ -0,0 +1,78 @@
+#include <tap.h>
+#include <stdlib.h>
+#include <cutils/bloom.h>
+
+#define COUNT 100000
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+int main(void) {
+    static uint64_t keys[COUNT], others[COUNT];
+    static bool results[COUNT];
+    uint64_t state = 1;
+    for (unsigned i = 0; i < COUNT; i++) {
+        keys[i] = splitmix64(&state);
+        others[i] = splitmix64(&state);
+    }
+
+    bloom_filter_t filter = BLOOM_INIT;
+    ok(!bloom_init(&filter, 0), "Filter without blocks");
+    ok(bloom_init_for(&filter, COUNT, 0.01), "Size the filter for a 1%% false positive rate");
+    ok(((uintptr_t)filter.blocks & (BLOOM_BLOCK_SIZE - 1)) == 0, "Blocks are aligned on cache lines");
+    ok(bloom_false_positive_rate(filter.block_count, COUNT) <= 0.01, "Expected false positive rate");
+    ok(bloom_fill_ratio(&filter) == 0, "New filter is empty");
+
+    for (unsigned i = 0; i < COUNT / 2; i++)
+        bloom_insert(&filter, keys[i]);
+    bloom_insert_batch(&filter, &keys[COUNT / 2], COUNT - COUNT / 2);
+    bool found = true;
+    for (unsigned i = 0; i < COUNT; i++)
+        found &= bloom_contains(&filter, keys[i]);
+    ok(found, "No false negative");
+    cmp_ok(bloom_contains_batch(&filter, keys, COUNT, results), "==", COUNT, "No false negative in batch");
+
+    const size_t positives = bloom_contains_batch(&filter, others, COUNT, results);
+    const double rate = (double)positives / COUNT;
+    ok(rate < 0.015, "Measured false positive rate %f", rate);
+    found = true;
+    for (unsigned i = 0; i < COUNT; i++)
+        found &= results[i] == bloom_contains(&filter, others[i]);
+    ok(found, "Batch and single probes agree");
+    const double fill = bloom_fill_ratio(&filter);
+    ok(fill > 0.5 && fill < 0.8, "Fill ratio %f", fill);
+
+    bloom_filter_t other = BLOOM_INIT;
+    ok(bloom_init(&other, filter.block_count), "Filter with the same size");
+    bloom_insert_batch(&other, others, COUNT);
+    ok(bloom_union(&other, &filter), "Union");
+    found = true;
+    for (unsigned i = 0; i < COUNT; i++)
+        found &= bloom_contains(&other, keys[i]) && bloom_contains(&other, others[i]);
+    ok(found, "Union contains the keys of both filters");
+    bloom_free(&other);
+    ok(bloom_init(&other, filter.block_count + 1), "Filter with another size");
+    ok(!bloom_union(&other, &filter), "Union of filters with different sizes");
+    bloom_free(&other);
+
+    char* buffer = malloc(bloom_serialized_size(&filter));
+    ok(bloom_serialize(buffer, &filter), "Serialize");
+    bloom_filter_t copy = BLOOM_INIT;
+    ok(bloom_deserialize(&copy, buffer), "Deserialize");
+    ok(copy.block_count == filter.block_count && memcmp(copy.blocks, filter.blocks, filter.block_count * BLOOM_BLOCK_SIZE) == 0,
+       "Deserialized filter is identical");
+    ((bloom_header_t*)buffer)->lanes = 8;
+    ok(!bloom_deserialize(&copy, buffer), "Reject another block layout");
+    free(buffer);
+    bloom_free(&copy);
+
+    bloom_clear(&filter);
+    ok(!bloom_contains(&filter, keys[0]), "Clear");
+    bloom_free(&filter);
+    ok(filter.blocks == NULL, "Free");
+    done_testing();
+}
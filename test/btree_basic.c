@@ -0,0 +1,157 @@
+#include <tap.h>
+#include <stdlib.h>
+#include <cutils/allocator/arena.h>
+#include <cutils/btree.h>
+
+#define int_cmp(a, b) ((*(a) > *(b)) - (*(a) < *(b)))
+
+DEFINE_BTREE_TYPE(int, int, int, int_cmp)
+DEFINE_BTREE_TYPE_WITH_ALLOCATOR(arena_int, int, int, int_cmp, arena)
+DEFINE_BTREE_TYPE_WITH_ALLOCATOR(counted_int, int, int, int_cmp, allocator)
+
+#define COUNT 20000
+
+// Allocator refusing to allocate more than limit live nodes
+typedef struct {
+    unsigned live;
+    unsigned limit;
+} counter_t;
+
+static void* counted_alloc(void* metadata, const size_t size) {
+    counter_t* counter = metadata;
+    if (counter->live == counter->limit)
+        return NULL;
+    counter->live += 1;
+    return malloc(size);
+}
+
+static void counted_dealloc(void* metadata, void* buffer) {
+    counter_t* counter = metadata;
+    counter->live -= buffer != NULL;
+    free(buffer);
+}
+
+static bool check_order(const int_btree_t* tree, unsigned* count) {
+    *count = 0;
+    int previous = -1;
+    for (int_btree_iterator_t it = btree_begin_int(tree); btree_iterator_valid(it); btree_next_int(&it)) {
+        if (*btree_iterator_key(it) <= previous || *btree_iterator_value(it) != 2 * *btree_iterator_key(it))
+            return false;
+        previous = *btree_iterator_key(it);
+        *count += 1;
+    }
+    return true;
+}
+
+int main(void) {
+    static bool present[COUNT];
+    int_btree_t tree = EMPTY_BTREE(int);
+    ok(btree_find_int(&tree, &(int) { 0 }) == NULL, "Find in an empty tree");
+
+    srand(1);
+    unsigned inserted = 0;
+    bool stored = true;
+    for (unsigned i = 0; i < 2 * COUNT; i++) {
+        const int key = rand() % COUNT;
+        const int value = 2 * key;
+        inserted += !present[key];
+        present[key] = true;
+        const int* v = btree_insert_int(&tree, &key, &value);
+        stored &= v != NULL && *v == value;
+    }
+    ok(stored, "Insert random keys");
+    cmp_ok(tree.length, "==", inserted, "Duplicated keys are assigned");
+    ok(tree.height > 2, "Nodes were split");
+
+    unsigned count;
+    ok(check_order(&tree, &count) && count == inserted, "Leaves are iterated in order");
+
+    bool found = true;
+    for (int key = 0; key < COUNT; key++) {
+        const int* v = btree_find_int(&tree, &key);
+        found &= present[key] ? v != NULL && *v == 2 * key : v == NULL;
+    }
+    ok(found, "Find every key");
+
+    bool bounds = true;
+    for (int key = 0; key < COUNT; key += 7) {
+        int expected = key;
+        while (expected < COUNT && !present[expected])
+            expected++;
+        const int_btree_iterator_t it = btree_lower_bound_int(&tree, &key);
+        bounds &= expected == COUNT ? !btree_iterator_valid(it) : *btree_iterator_key(it) == expected;
+    }
+    ok(bounds, "Lower bound");
+
+    const int low = 1000, high = 2000;
+    unsigned scanned = 0, expected = 0;
+    for (int key = low; key < high; key++)
+        expected += present[key];
+    for (int_btree_iterator_t it = btree_lower_bound_int(&tree, &low);
+         btree_iterator_valid(it) && *btree_iterator_key(it) < high; btree_next_int(&it))
+        scanned++;
+    cmp_ok(scanned, "==", expected, "Range scan");
+
+    bool erased = true;
+    for (int key = 0; key < COUNT; key += 2) {
+        int value = -1;
+        erased &= btree_erase_int(&tree, &key, &value) == present[key];
+        erased &= !present[key] || value == 2 * key;
+        inserted -= present[key];
+        present[key] = false;
+    }
+    ok(erased, "Erase the even keys");
+    ok(!btree_erase_int(&tree, &(int) { 0 }, NULL), "Erase a missing key");
+    ok(check_order(&tree, &count) && count == inserted && tree.length == inserted, "Order is kept after erase");
+
+    for (int key = 0; key < COUNT; key++)
+        (void)btree_erase_int(&tree, &key, NULL);
+    ok(tree.root == NULL && tree.first == NULL && tree.length == 0 && tree.height == 0, "Erase every key");
+
+    static int keys[COUNT], values[COUNT];
+    for (int i = 0; i < COUNT; i++) {
+        keys[i] = 3 * i;
+        values[i] = 6 * i;
+    }
+    ok(btree_bulk_load_int(&tree, keys, values, COUNT), "Bulk load");
+    ok(check_order(&tree, &count) && count == COUNT, "Bulk loaded leaves are in order");
+    found = true;
+    for (int i = 0; i < COUNT; i++) {
+        const int* v = btree_find_int(&tree, &keys[i]);
+        found &= v != NULL && *v == values[i];
+        found &= btree_find_int(&tree, &(int) { keys[i] + 1 }) == NULL;
+    }
+    ok(found, "Find in a bulk loaded tree");
+    const int* v = btree_insert_int(&tree, &(int) { 4 }, &(int) { 8 });
+    ok(v != NULL && btree_find_int(&tree, &(int) { 4 }) == v && check_order(&tree, &count) && count == COUNT + 1,
+       "Insert in a bulk loaded tree");
+    btree_free_int(&tree);
+    ok(tree.root == NULL && tree.length == 0, "Free");
+
+    // Bulk loads failing at each allocation free every node already built
+    counter_t counter = { 0, 0 };
+    const allocator_t counted = ALLOCATOR_INIT_METADATA(&counter, counted_alloc, NULL, counted_dealloc);
+    counted_int_btree_t countedTree = EMPTY_BTREE_WITH_ALLOCATOR(counted_int, &counted);
+    counter.limit = UINT32_MAX;
+    ok(btree_bulk_load_counted_int(&countedTree, keys, values, COUNT), "Bulk load with an allocator");
+    const unsigned nodes = counter.live;
+    btree_free_counted_int(&countedTree);
+    bool released = counter.live == 0;
+    for (counter.limit = 0; counter.limit < nodes; counter.limit += 1 + counter.limit / 64)
+        released &= !btree_bulk_load_counted_int(&countedTree, keys, values, COUNT) && counter.live == 0
+            && countedTree.root == NULL;
+    ok(released, "A failed bulk load releases its nodes");
+
+    arena_allocator_t arena = ARENA_INIT;
+    arena_int_btree_t arenaTree = EMPTY_BTREE_WITH_ALLOCATOR(arena_int, &arena);
+    stored = true;
+    for (int i = 0; i < COUNT; i++)
+        stored &= btree_insert_arena_int(&arenaTree, &(int) { COUNT - i }, &i) != NULL;
+    ok(stored && arenaTree.length == COUNT && arena.head != NULL, "Nodes are allocated from an arena");
+    const arena_int_btree_iterator_t first = btree_begin_arena_int(&arenaTree);
+    ok(*btree_iterator_key(first) == 1, "Arena tree is ordered");
+    btree_free_arena_int(&arenaTree);
+    arena_free(&arena);
+    arena_cache_release();
+    done_testing();
+}
@@ -1,7 +1,7 @@
 #include <string.h>
 #include <tap.h>
 #include <time.h>
-#include <../include/cutils/allocator/bump.h>
+#include <cutils/allocator/bump.h>
 
 #define BUFFER_SIZE 4321
 char buf[BUFFER_SIZE];
@@ -33,10 +33,37 @@ int main(void) {
 
     const void* d = bump_allocate(&bump, 6000);
     ok(d == NULL, "Return NULL on overflow");
+    ok((char*)b - (char*)a < 64, "Small allocations are not 64 bytes aligned");
+
+    bump_reset(&bump);
+    char* x = bump_allocate(&bump, 1);
+    char* y = bump_allocate(&bump, 1);
+    ok(y == x + 1, "1 byte allocations are packed");
+    double* e = bump_new(&bump, double, 3);
+    ok(((uintptr_t)e % ALIGNOF(double)) == 0, "Natural alignment of the type");
+    void* f = bump_allocate_aligned(&bump, 10, 256);
+    ok(((uintptr_t)f & 255) == 0, "Caller-specified alignment");
+
+    const bump_size_t front = bump_push_frame(&bump);
+    const bump_size_t back = bump_push_back_frame(&bump);
+    int* g = bump_new_back(&bump, int, 100);
+    ok((char*)g + 100 * sizeof(int) <= buf + BUFFER_SIZE && (char*)g > (char*)f, "Back allocation at the end of the buffer");
+    ok(((uintptr_t)g % ALIGNOF(int)) == 0, "Back allocation is aligned");
+    int* h = bump_new_back(&bump, int, 1);
+    ok(h + 1 <= g, "Back allocations grow downwards");
+    ok(bump_allocate(&bump, BUFFER_SIZE - bump.size - bump.back + 1) == NULL, "Front does not overlap back");
+    ok(bump_allocate_back(&bump, BUFFER_SIZE - bump.size - bump.back + 1) == NULL, "Back does not overlap front");
+    ok(bump_allocate(&bump, 100) != NULL, "Front allocation after back allocation");
+    bump_pop_back_frame(&bump, back);
+    cmp_ok(bump.back, "==", 0, "Pop back frame");
+    ok(bump.size != front, "Pop back frame keeps the front");
+    bump_pop_frame(&bump, front);
+    ok(bump_new_back(&bump, int, 100) == g, "Back frame reuses memory");
 
     bump_free(&bump);
     ok(bump.memory == NULL, "Set memory = nullptr on free");
     cmp_ok(bump.capacity, "==", 0, "Set capacity = 0 on free");
     cmp_ok(bump.size, "==", 0, "Set size = 0 on free");
-    return 0;
+    cmp_ok(bump.back, "==", 0, "Set back = 0 on free");
+    done_testing();
 }
\ No newline at end of file
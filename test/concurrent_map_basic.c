@@ -0,0 +1,121 @@
+#define _DEFAULT_SOURCE
+#include <tap.h>
+#include <cutils/concurrent_map.h>
+#include <stdio.h>
+
+DEFINE_CONCURRENT_MAP_TYPE(int, int)
+
+#define KEYS 20000
+#define THREADS 8
+#define PER_THREAD 5000
+#define SHARED 100
+
+static string_view_t key_of(char* buffer, const char* prefix, int i) {
+    const int len = snprintf(buffer, 32, "%s%d", prefix, i);
+    return (string_view_t) { .str = buffer, .len = (size_t)len };
+}
+
+static void increment(int* value, bool inserted, void* data) {
+    (void)data;
+    *value = inserted ? 1 : *value + 1;
+}
+
+typedef struct {
+    int_concurrent_map_t* map;
+    int id;
+    int failures;
+} worker_t;
+
+static void* worker(void* arg) {
+    worker_t* w = arg;
+    char buffer[32];
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "t%d-", w->id);
+    for (int i = 0; i < PER_THREAD; i++) {
+        const int value = w->id * PER_THREAD + i;
+        w->failures += concurrent_map_insert_int(w->map, key_of(buffer, prefix, i), &value) != -ERROR_NO_ERROR;
+        w->failures += concurrent_map_update_int(w->map, key_of(buffer, "shared", i % SHARED), increment, NULL) != -ERROR_NO_ERROR;
+        // Erase half of the own keys again while the others insert
+        if (i % 2 == 1)
+            w->failures += !concurrent_map_erase_int(w->map, key_of(buffer, prefix, i - 1), NULL);
+    }
+    return NULL;
+}
+
+int main(void) {
+    char buffer[32];
+    int_concurrent_map_t map;
+    ok(concurrent_map_init_int(&map, 5, 42), "Init");
+    cmp_ok(map.shard_count, "==", 8, "Shard count is rounded up to a power of two");
+    ok(!concurrent_map_find_int(&map, string_view("absent"), NULL), "Empty map has no key");
+    ok(!concurrent_map_erase_int(&map, string_view("absent"), NULL), "Erase in an empty map");
+
+    bool inserted = true;
+    for (int i = 0; i < KEYS; i++)
+        inserted &= concurrent_map_insert_int(&map, key_of(buffer, "key", i), &i) == -ERROR_NO_ERROR;
+    ok(inserted, "Insert %d keys", KEYS);
+    cmp_ok(concurrent_map_length_int(&map), "==", KEYS, "Length");
+    const int other = -1;
+    cmp_ok(concurrent_map_insert_int(&map, key_of(buffer, "key", 7), &other), "==", -ERROR_KEY_ALREADY_EXISTS,
+           "Insert keeps an existing key");
+
+    bool found = true;
+    for (int i = 0; i < KEYS; i++) {
+        int value = -1;
+        found &= concurrent_map_find_int(&map, key_of(buffer, "key", i), &value) && value == i;
+    }
+    ok(found, "Every key is found with its value");
+
+    const int replaced = 1234;
+    ok(concurrent_map_upsert_int(&map, key_of(buffer, "key", 7), &replaced) == -ERROR_NO_ERROR, "Upsert existing key");
+    int value = 0;
+    ok(concurrent_map_find_int(&map, key_of(buffer, "key", 7), &value) && value == 1234, "Upsert replaces the value");
+    ok(concurrent_map_upsert_int(&map, string_view("new"), &replaced) == -ERROR_NO_ERROR
+       && concurrent_map_find_int(&map, string_view("new"), NULL), "Upsert inserts a new key");
+    ok(concurrent_map_insert_int(&map, EMPTY_STRING_VIEW, &replaced) == -ERROR_NO_ERROR
+       && concurrent_map_find_int(&map, EMPTY_STRING_VIEW, NULL), "Empty key");
+
+    // Erasing every third key shifts the probe sequences back
+    bool erased = true;
+    for (int i = 0; i < KEYS; i += 3)
+        erased &= concurrent_map_erase_int(&map, key_of(buffer, "key", i), &value) && value == (i == 7 ? 1234 : i);
+    ok(erased, "Erase returns the values");
+    bool consistent = true;
+    for (int i = 0; i < KEYS; i++)
+        consistent &= concurrent_map_find_int(&map, key_of(buffer, "key", i), NULL) == (i % 3 != 0);
+    ok(consistent, "Only the erased keys are missing");
+    concurrent_map_free_int(&map);
+
+    // Threads insert their own keys, erase half of them and count shared keys
+    ok(concurrent_map_init_int(&map, 0, 0), "Init with the default shard count");
+    cmp_ok(map.shard_count, "==", CONCURRENT_MAP_DEFAULT_SHARDS, "Default shard count");
+    pthread_t threads[THREADS];
+    worker_t workers[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        workers[t] = (worker_t) { .map = &map, .id = t, .failures = 0 };
+        pthread_create(&threads[t], NULL, worker, &workers[t]);
+    }
+    int failures = 0;
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        failures += workers[t].failures;
+    }
+    cmp_ok(failures, "==", 0, "Concurrent operations succeed");
+    cmp_ok(concurrent_map_length_int(&map), "==", THREADS * PER_THREAD / 2 + SHARED, "Length after the threads");
+    bool counted = true;
+    for (int i = 0; i < SHARED; i++)
+        counted &= concurrent_map_find_int(&map, key_of(buffer, "shared", i), &value)
+            && value == THREADS * PER_THREAD / SHARED;
+    ok(counted, "Updates of the shared keys are not lost");
+    bool kept = true;
+    for (int t = 0; t < THREADS; t++) {
+        char prefix[16];
+        snprintf(prefix, sizeof(prefix), "t%d-", t);
+        for (int i = 1; i < PER_THREAD; i += 2)
+            kept &= concurrent_map_find_int(&map, key_of(buffer, prefix, i), &value) && value == t * PER_THREAD + i;
+    }
+    ok(kept, "Keys of every thread keep their values");
+    concurrent_map_free_int(&map);
+
+    done_testing();
+}
@@ -0,0 +1,183 @@
+#include <tap.h>
+#include <cutils/csv.h>
+
+#define RANDOM_DOCUMENTS 300
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Append a record to out, its fields separated by '|' and ended by '$'
+static void append_record(string_t* out, const csv_field_array_t* record) {
+    for (unsigned i = 0; i < record->length; i++) {
+        const string_view_t field = record->data[i];
+        char* dst = array_append_char(out, (unsigned)field.len + 1);
+        memcpy(dst, field.str, field.len);
+        dst[field.len] = i + 1 == record->length ? '$' : '|';
+    }
+}
+
+// Parse text cut in chunks of the given sizes, cycling through them
+static bool read_chunked(const char* text, const size_t length, const size_t* sizes, const unsigned count,
+                         string_t* out) {
+    csv_reader_t reader = csv_reader_init(',');
+    csv_field_array_t* record;
+    out->length = 0;
+    bool success = true;
+    for (size_t start = 0, n = 0; start < length && success; n++) {
+        const size_t size = MIN(sizes[n % count], length - start);
+        success = csv_reader_feed(&reader, (string_view_t) { .str = (char*)text + start, .len = size });
+        while (success && csv_reader_next(&reader, &record) == -ERROR_NO_ERROR)
+            append_record(out, record);
+        start += size;
+    }
+    csv_reader_finish(&reader);
+    while (success && csv_reader_next(&reader, &record) == -ERROR_NO_ERROR)
+        append_record(out, record);
+    csv_reader_free(&reader);
+    return success;
+}
+
+// Byte by byte state machine giving the same output
+static void read_reference(const char* text, const size_t length, string_t* out) {
+    out->length = 0;
+    string_t field = EMPTY_STRING;
+    bool quoted = false, started = false;
+    for (size_t i = 0; i < length; i++) {
+        const char c = text[i];
+        if (quoted) {
+            if (c != '"')
+                *array_append_char(&field, 1) = c;
+            else if (i + 1 < length && text[i + 1] == '"')
+                *array_append_char(&field, 1) = text[i++];
+            else
+                quoted = false;
+        } else if (c == '"' && !started) {
+            quoted = started = true;
+        } else if (c == ',' || c == '\n') {
+            if (c == '\n' && field.length != 0 && field.data[field.length - 1] == '\r')
+                field.length -= 1;
+            *array_append_char(&field, 1) = c == ',' ? '|' : '$';
+            memcpy(array_append_char(out, field.length), field.data, field.length);
+            field.length = 0;
+            started = false;
+        } else {
+            *array_append_char(&field, 1) = c;
+            started = true;
+        }
+    }
+    if (length != 0 && text[length - 1] != '\n') {
+        if (field.length != 0 && field.data[field.length - 1] == '\r')
+            field.length -= 1;
+        *array_append_char(&field, 1) = '$';
+        memcpy(array_append_char(out, field.length), field.data, field.length);
+    }
+    string_free(&field);
+}
+
+static bool equals(const string_t* str, const char* expected) {
+    return str->length == strlen(expected) && memcmp(str->data, expected, str->length) == 0;
+}
+
+int main(void) {
+    string_t out = EMPTY_STRING, expected = EMPTY_STRING;
+    const size_t whole = SIZE_MAX;
+
+    ok(read_chunked("a,b,c\n1,2,3\n", 12, &whole, 1, &out) && equals(&out, "a|b|c$1|2|3$"), "Simple records");
+    ok(read_chunked("a,,\n,\n\n", 7, &whole, 1, &out) && equals(&out, "a||$|$$"), "Empty fields and records");
+    ok(read_chunked("a,b\r\nc,d\r\n", 10, &whole, 1, &out) && equals(&out, "a|b$c|d$"), "CRLF line endings");
+    ok(read_chunked("a,b\nc,d", 7, &whole, 1, &out) && equals(&out, "a|b$c|d$"), "Last record without newline");
+    ok(read_chunked("\"a,b\",\"c\nd\"\n", 12, &whole, 1, &out) && equals(&out, "a,b|c\nd$"),
+       "Delimiters and newlines inside quotes");
+    ok(read_chunked("\"say \"\"hi\"\"\",\"\"\"\"\n", 18, &whole, 1, &out) && equals(&out, "say \"hi\"|\"$"),
+       "Doubled quotes are unescaped");
+    ok(read_chunked("\"\",x\n", 5, &whole, 1, &out) && equals(&out, "|x$"), "Empty quoted field");
+    ok(read_chunked("", 0, &whole, 1, &out) && out.length == 0, "Empty input");
+
+    csv_reader_t reader = csv_reader_init('\t');
+    csv_field_array_t* record;
+    ok(csv_reader_feed(&reader, string_view("a\tb,c\n")), "Feed a TSV chunk");
+    ok(csv_reader_next(&reader, &record) == -ERROR_NO_ERROR && record->length == 2
+           && record->data[1].len == 3 && memcmp(record->data[1].str, "b,c", 3) == 0,
+       "Other delimiter");
+    cmp_ok(csv_reader_next(&reader, &record), "==", -ERROR_IS_EMPTY, "No more records");
+    csv_reader_free(&reader);
+
+    // Fields longer than a block, quotes spanning blocks and chunks
+    static const char text[] =
+        "id,name,comment\r\n"
+        "1,\"a long, quoted field which crosses the boundary between two blocks of 64 bytes\",x\r\n"
+        "2,\"multi\nline \"\"quoted\"\"\nfield\",\r\n"
+        "3,,\"\"\"\"\r\n"
+        "4,plain field without any quote whatsoever and still longer than sixty-four bytes,end";
+    const size_t length = sizeof(text) - 1;
+    read_reference(text, length, &expected);
+    bool same = true;
+    for (size_t size = 1; size <= length && same; size++) {
+        same = read_chunked(text, length, &size, 1, &out) && out.length == expected.length
+            && memcmp(out.data, expected.data, out.length) == 0;
+        if (!same)
+            diag("chunks of %zu bytes", size);
+    }
+    ok(same, "Chunks of every size");
+    same = true;
+    for (size_t split = 0; split <= length && same; split++) {
+        const size_t sizes[] = { split == 0 ? length : split, length };
+        same = read_chunked(text, length, sizes, 2, &out) && out.length == expected.length
+            && memcmp(out.data, expected.data, out.length) == 0;
+    }
+    ok(same, "Two chunks split anywhere");
+
+    // Random documents of plain and quoted fields
+    static const char plain[] = "ab \r";
+    static const char quoted[] = "ab,\n\"";
+    uint64_t state = 88172645463325252U;
+    char document[4096];
+    same = true;
+    for (unsigned n = 0; n < RANDOM_DOCUMENTS && same; n++) {
+        size_t size = 0;
+        while (size < sizeof(document) - 256) {
+            const uint64_t random = next_random(&state);
+            const unsigned field = (unsigned)(random >> 8) % 100;
+            if (random & 1)
+                document[size++] = '"';
+            for (unsigned i = 0; i < field; i++) {
+                const uint64_t c = next_random(&state);
+                if (random & 1) {
+                    document[size++] = quoted[c % (sizeof(quoted) - 1)];
+                    if (document[size - 1] == '"')
+                        document[size++] = '"';
+                } else {
+                    document[size++] = plain[c % (sizeof(plain) - 1)];
+                }
+            }
+            if (random & 1)
+                document[size++] = '"';
+            if (random & 6)
+                document[size++] = ',';
+            else if (random & 8)
+                document[size++] = '\n';
+            else {
+                document[size++] = '\r';
+                document[size++] = '\n';
+            }
+        }
+        size -= (next_random(&state) & 1);
+        size_t sizes[4];
+        for (unsigned k = 0; k < 4; k++)
+            sizes[k] = 1 + next_random(&state) % (k == 0 ? 8 : 300);
+        read_reference(document, size, &expected);
+        same = read_chunked(document, size, sizes, 4, &out) && out.length == expected.length
+            && memcmp(out.data, expected.data, out.length) == 0;
+        if (!same)
+            diag("document %u", n);
+    }
+    ok(same, "Random documents in random chunks");
+
+    string_free(&out);
+    string_free(&expected);
+    done_testing();
+}
@@ -0,0 +1,83 @@
+#include <tap.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cutils/file_reader.h>
+
+// The ring of the reader has a private name
+DEFINE_RING_TYPE(file_chunk_t)
+
+#define PATH "file_reader_basic.tmp"
+#define SIZE (1024 * 1024 + 123)
+
+static bool read_all(const char* content, const unsigned depth, const size_t buffer_size, const unsigned flags) {
+    file_reader_t reader;
+    if (file_reader_open(&reader, PATH, depth, buffer_size, flags) != -ERROR_NO_ERROR)
+        return false;
+    bool same = true;
+    uint64_t offset = 0;
+    unsigned chunks = 0;
+    file_chunk_t chunk;
+    int status;
+    while ((status = file_reader_next(&reader, &chunk)) == -ERROR_NO_ERROR) {
+        same &= chunk.offset == offset && chunk.size <= buffer_size;
+        same &= memcmp(chunk.data, content + offset, chunk.size) == 0;
+        offset += chunk.size;
+        chunks++;
+        file_reader_release(&reader, &chunk);
+    }
+    same &= status == -ERROR_IS_EMPTY && reader.error == 0 && offset == SIZE && chunks == (SIZE + buffer_size - 1) / buffer_size;
+    file_reader_close(&reader);
+    return same;
+}
+
+int main(void) {
+    char* content = malloc(SIZE);
+    for (unsigned i = 0; i < SIZE; i++)
+        content[i] = (char)(i * 7 + i / 4096);
+    FILE* f = fopen(PATH, "wb");
+    ok(f != NULL && fwrite(content, 1, SIZE, f) == SIZE && fclose(f) == 0, "Write the test file");
+
+    file_reader_t reader;
+    ok(file_reader_open(&reader, PATH, 4, 65536, 0) == -ERROR_NO_ERROR, "Open");
+    diag("io_uring %s", file_reader_async(&reader) ? "available" : "unavailable");
+    file_reader_close(&reader);
+    ok(reader.fd == -1 && reader.buffers == NULL, "Close");
+
+    ok(read_all(content, 4, 65536, 0), "Read in order");
+    ok(read_all(content, 1, 4096, 0), "Read with a single buffer");
+    ok(read_all(content, 8, 100000, 0), "Read with unaligned chunks");
+    ok(read_all(content, 8, 65536, FILE_READER_REGISTER_BUFFERS), "Read with registered buffers");
+    ok(read_all(content, 4, 65536, FILE_READER_SYNC), "Synchronous fallback");
+
+    // Keep two chunks while reading the next ones
+    ok(file_reader_open(&reader, PATH, 4, 65536, 0) == -ERROR_NO_ERROR, "Open again");
+    file_chunk_t first, second, third;
+    ok(file_reader_next(&reader, &first) == -ERROR_NO_ERROR && file_reader_next(&reader, &second) == -ERROR_NO_ERROR,
+       "Hold two chunks");
+    file_reader_release(&reader, &first);
+    ok(file_reader_next(&reader, &third) == -ERROR_NO_ERROR && third.offset == 2 * 65536, "Chunks stay in file order");
+    ok(memcmp(second.data, content + 65536, second.size) == 0, "Held chunk is untouched");
+    file_reader_close(&reader);
+
+    // Every buffer held by the caller is told apart from the end of the file
+    ok(file_reader_open(&reader, PATH, 2, 65536, 0) == -ERROR_NO_ERROR, "Open with two buffers");
+    ok(file_reader_next(&reader, &first) == -ERROR_NO_ERROR && file_reader_next(&reader, &second) == -ERROR_NO_ERROR,
+       "Hold both buffers");
+    cmp_ok(file_reader_next(&reader, &third), "==", -ERROR_CAPACITY_EXCEEDED, "No chunk while every buffer is held");
+    file_reader_release(&reader, &second);
+    ok(file_reader_next(&reader, &third) == -ERROR_NO_ERROR && third.offset == 2 * 65536,
+       "Reading goes on once a buffer is released");
+    file_reader_close(&reader);
+
+    f = fopen(PATH, "wb");
+    ok(f != NULL && fclose(f) == 0, "Write an empty file");
+    ok(file_reader_open(&reader, PATH, 4, 4096, 0) == -ERROR_NO_ERROR, "Open an empty file");
+    ok(file_reader_next(&reader, &first) == -ERROR_IS_EMPTY && reader.error == 0, "Empty file has no chunk");
+    file_reader_close(&reader);
+    remove(PATH);
+
+    ok(file_reader_open(&reader, PATH, 4, 4096, 0) == -ERROR_IO, "Missing file");
+    ok(file_reader_open(&reader, PATH, 0, 4096, 0) == -ERROR_INVALID_PARAM3, "No buffer");
+    free(content);
+    done_testing();
+}
@@ -0,0 +1,221 @@
+#include <tap.h>
+#include <cutils/format.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+#define RANDOM_DOUBLES 200000
+
+static double from_bits(const uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Content of str, which is then cleared
+static const char* take(string_t* str) {
+    static char buffer[512];
+    const unsigned length = str->length < sizeof(buffer) ? str->length : sizeof(buffer) - 1;
+    memcpy(buffer, str->data, length);
+    buffer[length] = '\0';
+    str->length = 0;
+    return buffer;
+}
+
+// Significant digits and decimal exponent of a number written in plain or
+// scientific notation, so that representations can be compared
+static void decimal_digits(const char* s, char* digits, int* exponent) {
+    int point = 0, count = 0;
+    bool seen_point = false;
+    for (; *s != '\0' && *s != 'e'; s++) {
+        if (*s == '.') {
+            seen_point = true;
+        } else if (*s >= '0' && *s <= '9') {
+            if (count == 0 && *s == '0') {
+                point -= seen_point;
+                continue;
+            }
+            digits[count++] = *s;
+            point += !seen_point;
+        }
+    }
+    while (count > 1 && digits[count - 1] == '0') {
+        count--;
+    }
+    digits[count] = '\0';
+    *exponent = point + (*s == 'e' ? atoi(s + 1) : 0);
+}
+
+// Whether the decimal significand * 10^exponent reads back as value
+static bool reads_back(const uint64_t significand, const int exponent, const double value) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%llue%d", (unsigned long long)significand, exponent);
+    return strtod(buffer, NULL) == value;
+}
+
+// Nearest decimal to value with precision significant digits, as
+// significand * 10^exponent
+static uint64_t nearest(const double value, const int precision, int* exponent) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, value);
+    char digits[64];
+    decimal_digits(buffer, digits, exponent);
+    const int count = (int)strlen(digits);
+    *exponent -= count;
+    return strtoull(digits, NULL, 10);
+}
+
+// The shortest representation reads back as value, no decimal with one digit
+// less does, and it is the nearest decimal with that many digits unless that
+// one does not read back (the interval is narrower below the powers of two)
+static bool shortest_matches(string_t* str, const double value) {
+    if (!string_append_f64(str, value))
+        return false;
+    const char* written = take(str);
+    if (strtod(written, NULL) != value)
+        return false;
+    if (value == 0)
+        return strcmp(written, "0") == 0;
+    char digits[64];
+    int exponent;
+    decimal_digits(written, digits, &exponent);
+    const int count = (int)strlen(digits);
+    if (count > 1) {
+        // The decimals around value with one digit less
+        int shorter_exponent;
+        const uint64_t shorter = nearest(value, count - 1, &shorter_exponent);
+        for (uint64_t candidate = shorter - 1; candidate <= shorter + 1; candidate++) {
+            if (reads_back(candidate, shorter_exponent, value))
+                return false;
+        }
+    }
+    int expected_exponent;
+    const uint64_t expected = nearest(value, count, &expected_exponent);
+    return !reads_back(expected, expected_exponent, value)
+        || (strtoull(digits, NULL, 10) == expected && exponent - count == expected_exponent);
+}
+
+int main(void) {
+    string_t str = EMPTY_STRING;
+
+    ok(string_append_u64(&str, 0), "Append 0");
+    is(take(&str), "0");
+    ok(string_append_u64(&str, 7) && string_append_u64(&str, 42) && string_append_u64(&str, 100), "Append in a row");
+    is(take(&str), "742100");
+    ok(string_append_u64(&str, UINT64_MAX), "Append UINT64_MAX");
+    is(take(&str), "18446744073709551615");
+    ok(string_append_i64(&str, INT64_MIN) && string_append_i64(&str, -5) && string_append_i64(&str, 12),
+       "Append signed values");
+    is(take(&str), "-9223372036854775808-512");
+
+    bool same = true;
+    uint64_t state = 88172645463325252U;
+    char expected[64];
+    for (unsigned i = 0; i < 100000 && same; i++) {
+        const uint64_t value = next_random(&state) >> (i % 64);
+        same = string_append_u64(&str, value) && string_append_i64(&str, -(int64_t)(value >> 1));
+        snprintf(expected, sizeof(expected), "%llu%lld", (unsigned long long)value, -(long long)(value >> 1));
+        same = same && strcmp(take(&str), expected) == 0;
+    }
+    ok(same, "Integers match printf");
+    for (uint64_t power = 1, i = 0; i < 20 && same; i++, power *= 10) {
+        same = string_append_u64(&str, power - 1) && string_append_u64(&str, power);
+        snprintf(expected, sizeof(expected), "%llu%llu", (unsigned long long)(power - 1), (unsigned long long)power);
+        same = same && strcmp(take(&str), expected) == 0;
+    }
+    ok(same, "Powers of ten and their predecessors");
+
+    ok(string_append_u64_padded(&str, 42, 6) && string_append_u64_padded(&str, 123456, 3), "Padded integers");
+    is(take(&str), "000042123456");
+    ok(string_append_hex(&str, 0, 0) && string_append_hex(&str, 0xBEEF, 8) && string_append_hex(&str, UINT64_MAX, 4),
+       "Hexadecimal integers");
+    is(take(&str), "00000beefffffffffffffffff");
+
+    ok(string_append_f64(&str, 0.0) && string_append_f64(&str, -0.0), "Append zeros");
+    is(take(&str), "0-0");
+    ok(string_append_f64(&str, 0.1), "Append 0.1");
+    is(take(&str), "0.1");
+    ok(string_append_f64(&str, 1.0 / 3.0), "Append 1/3");
+    is(take(&str), "0.3333333333333333");
+    ok(string_append_f64(&str, -123.25), "Append -123.25");
+    is(take(&str), "-123.25");
+    ok(string_append_f64(&str, 1e20) && string_append_f64(&str, 1e21), "Plain and scientific large values");
+    is(take(&str), "1000000000000000000001e+21");
+    ok(string_append_f64(&str, 1e-6) && string_append_f64(&str, 2.5e-7), "Plain and scientific small values");
+    is(take(&str), "0.0000012.5e-7");
+    ok(string_append_f64(&str, DBL_MAX), "Append DBL_MAX");
+    is(take(&str), "1.7976931348623157e+308");
+    ok(string_append_f64(&str, 5e-324), "Append the smallest subnormal");
+    is(take(&str), "5e-324");
+    ok(string_append_f64(&str, DBL_MIN), "Append DBL_MIN");
+    is(take(&str), "2.2250738585072014e-308");
+    ok(string_append_f64(&str, 9007199254740993.0), "Append 2^53 + 1 rounded");
+    is(take(&str), "9007199254740992");
+    ok(string_append_f64(&str, INFINITY) && string_append_f64(&str, -INFINITY) && string_append_f64(&str, NAN),
+       "Append infinities and NaN");
+    is(take(&str), "inf-infnan");
+
+    same = true;
+    for (unsigned i = 0; i < RANDOM_DOUBLES && same; i++) {
+        const uint64_t bits = next_random(&state) & ~(UINT64_C(1) << 63);
+        if ((bits >> 52) == 0x7FF)
+            continue;
+        const double value = from_bits(bits);
+        same = shortest_matches(&str, value);
+        if (!same)
+            diag("%.17g", value);
+    }
+    ok(same, "Random doubles are shortest, closest and read back");
+    same = true;
+    for (unsigned i = 0; i < RANDOM_DOUBLES && same; i++) {
+        // Short decimals, the usual content of a CSV file
+        const double value = (double)(next_random(&state) % 2000000) / 1000.0 - 1000.0;
+        same = shortest_matches(&str, value);
+    }
+    ok(same, "Short decimals are shortest, closest and read back");
+    same = true;
+    for (int e = -1074; e <= 1023 && same; e++) {
+        const uint64_t bits = e < -1022 ? UINT64_C(1) << (e + 1074) : (uint64_t)(e + 1023) << 52;
+        // The predecessor of the smallest subnormal is 0
+        same = shortest_matches(&str, from_bits(bits)) && (bits == 1 || shortest_matches(&str, from_bits(bits - 1)));
+        if (!same)
+            diag("2^%d", e);
+    }
+    ok(same, "Powers of two and their predecessors");
+
+    ok(string_append_f64_fixed(&str, 3.14159, 2), "Fixed notation");
+    is(take(&str), "3.14");
+    ok(string_append_f64_fixed(&str, 0.125, 2) && string_append_f64_fixed(&str, 0.375, 2), "Ties to even");
+    is(take(&str), "0.120.38");
+    ok(string_append_f64_fixed(&str, 9.999, 2) && string_append_f64_fixed(&str, -0.5, 0), "Carry and sign");
+    is(take(&str), "10.00-0");
+    char buffer[512];
+    ok(string_append_f64_fixed(&str, 1e300, 1), "Huge fixed value");
+    snprintf(buffer, sizeof(buffer), "%.1f", 1e300);
+    is(take(&str), buffer);
+
+    same = true;
+    for (unsigned i = 0; i < RANDOM_DOUBLES && same; i++) {
+        const uint64_t random = next_random(&state);
+        const unsigned precision = (unsigned)(random % 20);
+        // Magnitudes between 2^-40 and 2^23 with a random sign
+        const uint64_t exponent = 1023 - 40 + (random >> 58);
+        const double value = from_bits((random & 32) << 58 | exponent << 52 | next_random(&state) >> 12);
+        same = string_append_f64_fixed(&str, value, precision);
+        snprintf(buffer, sizeof(buffer), "%.*f", (int)precision, value);
+        same = same && strcmp(take(&str), buffer) == 0;
+        if (!same)
+            diag("%.17g %u", value, precision);
+    }
+    ok(same, "Fixed notation matches printf");
+
+    string_free(&str);
+    done_testing();
+}
@@ -0,0 +1,84 @@
+#include <tap.h>
+#include <cutils/bits.h>
+#include <cutils/hash.h>
+
+#define COUNT 100000
+
+typedef struct {
+    int32_t x, y;
+} point;
+
+int main(void) {
+    static char buffer[1024];
+    for (unsigned i = 0; i < sizeof(buffer); i++)
+        buffer[i] = (char)(i * 31 + 7);
+
+    ok(hash_bytes(buffer, 100, 1) == hash_bytes(buffer, 100, 1), "Hash is deterministic");
+    ok(hash_bytes(buffer, 100, 1) != hash_bytes(buffer, 100, 2), "Hash depends on the seed");
+    ok(hash_bytes(NULL, 0, 0) != hash_bytes(NULL, 0, 1), "Empty input depends on the seed");
+
+    // Every length goes through a different path of the short and long keys
+    bool distinct = true;
+    for (unsigned a = 0; a <= 200; a++)
+        for (unsigned b = 0; b < a; b++)
+            distinct &= hash_bytes(buffer, a, 0) != hash_bytes(buffer, b, 0);
+    ok(distinct, "Prefixes of every length have distinct hashes");
+
+    bool unaligned = true;
+    static char copy[1024 + 8];
+    for (unsigned offset = 1; offset < 8; offset++) {
+        memcpy(copy + offset, buffer, 300);
+        for (unsigned size = 0; size <= 300; size += 7)
+            unaligned &= hash_bytes(copy + offset, size, 3) == hash_bytes(buffer, size, 3);
+    }
+    ok(unaligned, "Hash does not depend on the alignment");
+
+    // Flipping one input bit flips about half of the output bits
+    unsigned flipped = 0, tests = 0;
+    for (unsigned size = 1; size <= 128; size *= 2) {
+        const uint64_t reference = hash_bytes(buffer, size, 0);
+        for (unsigned bit = 0; bit < size * 8; bit++) {
+            buffer[bit / 8] ^= (char)(1 << (bit % 8));
+            flipped += bits_popcount(reference ^ hash_bytes(buffer, size, 0));
+            buffer[bit / 8] ^= (char)(1 << (bit % 8));
+            tests++;
+        }
+    }
+    const double average = (double)flipped / tests;
+    ok(average > 31 && average < 33, "Avalanche: %f output bits flip on average", average);
+
+    bool same = true;
+    for (uint64_t key = 0; key < 1000; key++) {
+        const uint64_t value = key * UINT64_C(0x9E3779B97F4A7C15);
+        same &= hash_u64(value, 5) == hash_bytes(&value, sizeof(value), 5);
+    }
+    ok(same, "hash_u64 matches hash_bytes");
+
+    static uint64_t hashes[COUNT];
+    unsigned collisions = 0;
+    for (uint64_t key = 0; key < COUNT; key++)
+        hashes[key] = hash_u64(key, 0) >> 40;
+    // 24-bit buckets: about COUNT^2 / 2^25 collisions are expected
+    static uint8_t seen[1 << 21];
+    for (unsigned i = 0; i < COUNT; i++) {
+        collisions += bits_isset(seen, (unsigned)hashes[i]);
+        bits_set(seen, (unsigned)hashes[i]);
+    }
+    ok(collisions < 600, "Sequential keys spread on the high bits (%u collisions)", collisions);
+
+    const point p = { 1, 2 }, q = { 2, 1 };
+    ok(hash_value(&p, 0) == hash_bytes(&p, sizeof(p), 0) && hash_value(&p, 0) != hash_value(&q, 0),
+       "Hash a plain old data value");
+
+    string_view_t views[64];
+    uint64_t bulk[64];
+    for (unsigned i = 0; i < 64; i++)
+        views[i] = (string_view_t) { buffer + i, i * 5 };
+    hash_string_views(views, 64, 9, bulk);
+    same = true;
+    for (unsigned i = 0; i < 64; i++)
+        same &= bulk[i] == hash_string_view(views[i], 9);
+    ok(same, "Bulk hashing matches hash_string_view");
+    ok(hash_string_view(string_view("cutils"), 0) == hash_bytes("cutils", 6, 0), "Hash a string view");
+    done_testing();
+}
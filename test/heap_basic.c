@@ -0,0 +1,95 @@
+#include <tap.h>
+#include <stdlib.h>
+#include <cutils/array.h>
+#include <cutils/heap.h>
+
+#define int_cmp(a, b) ((*(a) > *(b)) - (*(a) < *(b)))
+
+DEFINE_ARRAY_TYPE(int)
+DEFINE_HEAP_TYPE(int, int_cmp)
+
+static int int_cmp_fn(const int* a, const int* b) { return int_cmp(a, b); }
+
+typedef struct {
+    unsigned vertex;
+    unsigned distance;
+} node;
+
+#define node_cmp(a, b) ((int)((a)->distance > (b)->distance) - (int)((a)->distance < (b)->distance))
+#define node_index(n) ((n)->vertex)
+
+DEFINE_ARRAY_TYPE(node)
+DEFINE_INDEXED_HEAP_TYPE(node, node, node_cmp, node_index, 2)
+
+int main(void) {
+    srand(42);
+    int_heap_t heap = EMPTY_HEAP(int);
+    for (int i = 0; i < 1000; i++) {
+        const int value = rand() % 500;
+        ok(heap_push_int(&heap, &value), "Push %d", value);
+    }
+    cmp_ok(heap_length(heap), "==", 1000, "Heap length");
+    int previous = -1, value;
+    bool sorted = true;
+    while (heap_pop_int(&heap, &value)) {
+        sorted &= previous <= value;
+        previous = value;
+    }
+    ok(sorted, "Pop in ascending order");
+    ok(heap_empty(heap), "Heap is empty");
+
+    for (int i = 100; i > 0; i--)
+        *array_append_int(&heap.array, 1) = i;
+    heap_heapify_int(&heap);
+    cmp_ok(*heap_top_int(&heap), "==", 1, "Heapify puts the minimum on top");
+    heap_free_int(&heap);
+
+    // Keep the 10 greatest values of a stream
+    for (int i = 0; i < 10000; i++) {
+        const int v = (i * 7919) % 10007;
+        heap_push_bounded_int(&heap, &v, 10);
+    }
+    cmp_ok(heap_length(heap), "==", 10, "Bounded heap length");
+    heap_pop_int(&heap, &value);
+    int top = 0;
+    while (heap_pop_int(&heap, &top)) {}
+    ok(value == 9997 && top == 10006, "Top-K values");
+    heap_free_int(&heap);
+
+    node_heap_t queue = EMPTY_HEAP(node);
+    for (unsigned v = 0; v < 100; v++)
+        ok(heap_update_node(&queue, &(node) { v, 1000 + v }), "Push vertex %u", v);
+    ok(heap_update_node(&queue, &(node) { 50, 3 }), "Decrease key");
+    ok(heap_update_node(&queue, &(node) { 0, 5000 }), "Increase key");
+    node n;
+    ok(heap_pop_node(&queue, &n) && n.vertex == 50, "Decreased key is popped first");
+    ok(!heap_contains_node(&queue, 50), "Popped vertex is not in the heap");
+    ok(heap_remove_node(&queue, 1, &n) && n.distance == 1001, "Remove by index");
+    ok(heap_find_node(&queue, 99)->distance == 1099, "Find by index");
+    ok(heap_push_node(&queue, &(node) { 300, 2 }) && heap_find_node(&queue, 300)->distance == 2,
+       "Push grows the positions of an indexed heap");
+    ok(heap_push_node(&queue, &(node) { 300, 1200 }) && heap_find_node(&queue, 300)->distance == 1200,
+       "Push replaces the element with the same index");
+    ok(heap_remove_node(&queue, 300, NULL), "Remove the pushed element");
+    unsigned last = 0, count = 0;
+    bool valid = true;
+    while (heap_pop_node(&queue, &n)) {
+        valid &= last <= n.distance && queue.position[n.vertex] == HEAP_NO_POSITION;
+        last = n.distance;
+        count++;
+    }
+    ok(valid && count == 98 && n.vertex == 0, "Indexed heap order");
+    heap_free_node(&queue);
+
+    int_array_t sorted_array = EMPTY_ARRAY(int);
+    for (int i = 0; i < 200; i++) {
+        int v = (i * 37) % 101;
+        array_insert_sorted_int(&sorted_array, int_cmp_fn, &v);
+    }
+    sorted = true;
+    for (unsigned i = 1; i < sorted_array.length; i++)
+        sorted &= sorted_array.data[i - 1] <= sorted_array.data[i];
+    ok(sorted, "Sorted insert keeps the order");
+    array_free_int(&sorted_array);
+    done_testing();
+}
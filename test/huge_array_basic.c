@@ -0,0 +1,68 @@
+#define _GNU_SOURCE
+#define CUTILS_INSTRUMENT
+#define CUTILS_HUGE_ARRAY_MAP_THRESHOLD ((size_t)1 << 20)
+#include <tap.h>
+#include <cutils/huge_array.h>
+
+typedef struct {
+    char bytes[1 << 20];
+} block_t;
+
+DEFINE_HUGE_ARRAY_TYPE(uint64_t)
+DEFINE_HUGE_ARRAY_TYPE(block_t)
+
+int main(void) {
+    uint64_t_huge_array_t array = HUGE_ARRAY_INIT(uint64_t, HUGE_ARRAY_HUGE_PAGES);
+    cmp_ok(array.capacity, "==", 0, "Initial capacity is 0");
+    ok(huge_array_append_uint64_t(&array, 0) == NULL, "Appending nothing gives NULL");
+
+    // Grow one element at a time across the mapping threshold
+    const size_t count = ((size_t)8 << 20) / sizeof(uint64_t);
+    bool appended = true;
+    for (size_t i = 0; i < count && appended; i++) {
+        uint64_t* p = huge_array_append_uint64_t(&array, 1);
+        appended = p != NULL;
+        if (appended)
+            *p = i * 7;
+    }
+    ok(appended && array.length == count, "Append past the mapping threshold");
+    bool same = true;
+    for (size_t i = 0; i < count; i++)
+        same = same && array.data[i] == i * 7;
+    ok(same, "Elements are kept across the growth");
+    ok(array.capacity >= array.length, "Capacity covers the length");
+
+#if defined(CUTILS_HUGE_ARRAY_MAP) && defined(MREMAP_MAYMOVE)
+    // Only the switch from the heap to the first mapping copies
+    const uint64_t moved = INSTRUMENT_STATS(huge_array, uint64_t)->bytes_moved;
+    ok(moved < CUTILS_HUGE_ARRAY_MAP_THRESHOLD, "Mappings grow without copying");
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    ok(array.capacity * sizeof(uint64_t) % page == 0, "Mapped capacity fills whole pages");
+#else
+    skip(true, 2, "mremap is not available");
+    end_skip;
+#endif
+
+    uint64_t last;
+    ok(huge_array_pop_uint64_t(&array, &last) && last == (count - 1) * 7, "Pop the last element");
+    huge_array_swap_and_pop_back_uint64_t(&array, 0);
+    ok(array.data[0] == (count - 2) * 7 && array.length == count - 2, "Swap and pop back");
+
+    ok(huge_array_append_uint64_t(&array, SIZE_MAX) == NULL, "Length overflow is refused");
+    ok(array.length == count - 2 && array.data[1] == 7, "The array is unchanged by a refused append");
+    ok(!huge_array_reserve_uint64_t(&array, SIZE_MAX / 4), "Size overflow is refused");
+    huge_array_free_uint64_t(&array);
+    cmp_ok(array.capacity, "==", 0, "Set capacity = 0 on free");
+    ok(array.data == NULL, "Set data = NULL on free");
+
+    block_t_huge_array_t blocks = EMPTY_HUGE_ARRAY(block_t);
+    ok(huge_array_append_block_t(&blocks, SIZE_MAX / sizeof(block_t) + 1) == NULL,
+       "Element count whose size overflows is refused");
+    block_t* block = huge_array_append_block_t(&blocks, 3);
+    ok(block != NULL && blocks.length == 3, "Large elements");
+    if (block != NULL)
+        memset(block, 0xAB, 3 * sizeof(block_t));
+    huge_array_free_block_t(&blocks);
+
+    done_testing();
+}
@@ -0,0 +1,158 @@
+#define _DEFAULT_SOURCE
+#define CUTILS_INSTRUMENT
+#include <tap.h>
+#include <cutils/array.h>
+#include <cutils/concurrent_map.h>
+#include <cutils/lockfree.h>
+#include <cutils/ring.h>
+#include <cutils/soa.h>
+#include <cutils/slot_map.h>
+#include <cutils/timer_wheel.h>
+#include <stdio.h>
+
+#define CUTILS_ARRAY_LIST_IMPL
+#include <cutils/array_list.h>
+
+typedef struct {
+    float x, y;
+} point;
+
+DEFINE_ARRAY_TYPE(int)
+DEFINE_RING_TYPE(int)
+DEFINE_ARRAY_TYPE(point)
+DEFINE_SOA_TYPE(point, (float, x), (float, y))
+DEFINE_SLOT_MAP_TYPE(point)
+DEFINE_CONCURRENT_MAP_TYPE(int, int)
+DEFINE_LOCKFREE_STACK_TYPE(int)
+DEFINE_LOCKFREE_QUEUE_TYPE(int)
+
+typedef struct {
+    unsigned events[INSTRUMENT_PROBE + 1];
+    const instrument_stats_t* last;
+} hook_data;
+
+static void hook(const instrument_stats_t* stats, instrument_event_t event, uint64_t value, void* data) {
+    hook_data* d = data;
+    (void)value;
+    d->events[event]++;
+    d->last = stats;
+}
+
+int main(void) {
+    ok(instrument_first() == NULL, "Nothing is listed before the first event");
+
+    int_array_t array = EMPTY_ARRAY(int);
+    for (int i = 0; i < 1000; i++)
+        *array_append_int(&array, 1) = i;
+    const instrument_stats_t* stats = INSTRUMENT_STATS(array, int);
+    // 64, 128, 256, 512 then 1024: one allocation and four reallocations
+    cmp_ok(stats->reallocations, "==", 4, "Reallocations of the growth");
+    cmp_ok(stats->peak_capacity, "==", 1024, "Peak capacity");
+    ok(stats->bytes_moved <= (64 + 128 + 256 + 512) * sizeof(int), "Moves of the reallocations are bounded");
+
+    const uint64_t moved = stats->bytes_moved;
+    array_insert_int(&array, &(int) { -1 }, 0);
+    cmp_ok(stats->bytes_moved - moved, "==", 1000 * sizeof(int), "Insert at the front moves the whole array");
+    array_remove_int(&array, NULL, 990);
+    cmp_ok(stats->bytes_moved - moved, "==", 1010 * sizeof(int), "Remove moves the tail");
+    ok(strcmp(stats->container, "array") == 0 && strcmp(stats->name, "int") == 0, "Statistics are named");
+    array_free_int(&array);
+
+    hook_data data = { { 0 }, NULL };
+    instrument_set_hook(hook, &data);
+    int_ring_t ring = ring_create_int(8, NULL);
+    for (int i = 0; i < 20; i++)
+        ring_push_back_int(&ring, i < 12);
+    stats = INSTRUMENT_STATS(ring, int);
+    cmp_ok(stats->peak_capacity, "==", 8, "Ring capacity");
+    cmp_ok(stats->overwrites, "==", 4, "Forced pushes overwrite");
+    cmp_ok(stats->drops, "==", 8, "Pushes on a full ring are dropped");
+    cmp_ok(data.events[INSTRUMENT_OVERWRITE], "==", 4, "Hook sees the overwrites");
+    cmp_ok(data.events[INSTRUMENT_DROP], "==", 8, "Hook sees the drops");
+    ok(data.last == stats, "Hook gets the statistics of the container");
+    instrument_set_hook(NULL, NULL);
+    ring_free_int(&ring);
+
+    point_soa_t soa = EMPTY_SOA(point);
+    for (int i = 0; i < 100; i++) {
+        if (!soa_push_point(&soa, &(point) { (float)i, (float)i }))
+            fail("Push %d", i);
+    }
+    stats = INSTRUMENT_STATS(soa, point);
+    cmp_ok(stats->reallocations, "==", 1, "Soa grows once past its minimum capacity");
+    cmp_ok(stats->bytes_moved, "==", 64 * sizeof(point), "Soa growth copies the columns");
+    soa_free_point(&soa);
+
+    point_slot_map_t map = EMPTY_SLOT_MAP(point);
+    for (int i = 0; i < 100; i++)
+        (void)slot_map_insert_point(&map, &(point) { 0, 0 });
+    stats = INSTRUMENT_STATS(slot_map, point);
+    cmp_ok(stats->peak_capacity, "==", 128, "Slot capacity");
+    cmp_ok(stats->reallocations, "==", 4, "Slot and owner arrays grow");
+    slot_map_free_point(&map);
+
+    array_list_t list = ARRAY_LIST_INIT(int);
+    for (int i = 0; i < 100; i++)
+        array_list_push_back(&list, &i);
+    stats = INSTRUMENT_STATS(array_list, untyped);
+    ok(stats->reallocations == 4 && stats->peak_capacity == 128, "Array list grows from 8 to 128");
+    array_list_deinit(&list);
+
+    // A single shard of 1000 keys grows from 16 to 2048 slots
+    int_concurrent_map_t concurrent;
+    ok(concurrent_map_init_int(&concurrent, 1, 0), "Initialize a concurrent map");
+    char key[16];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        if (concurrent_map_insert_int(&concurrent, string_view(key), &i) != -ERROR_NO_ERROR)
+            fail("Insert %d", i);
+    }
+    stats = INSTRUMENT_STATS(concurrent_map, int);
+    ok(stats->reallocations == 7 && stats->peak_capacity == 2048, "Concurrent map shard growth");
+    cmp_ok(stats->probes, ">", 0, "Collisions are counted as probes");
+    concurrent_map_free_int(&concurrent);
+
+    ebr_domain_t domain;
+    ebr_init(&domain);
+    ebr_thread_t* thread = ebr_register(&domain);
+    int_lockfree_stack_t stack = EMPTY_LOCKFREE_STACK(int);
+    int_lockfree_queue_t queue;
+    bool pushed = lockfree_queue_init_int(&queue, &domain);
+    for (int i = 0; i < 10; i++)
+        pushed = pushed && lockfree_stack_push_int(&stack, thread, &i) && lockfree_queue_push_int(&queue, thread, &i);
+    ok(pushed && INSTRUMENT_STATS(lockfree_stack, int)->allocations == 10
+       && INSTRUMENT_STATS(lockfree_queue, int)->allocations == 11, "Lock-free nodes, and the dummy of the queue");
+    lockfree_stack_free_int(&stack, &domain);
+    lockfree_queue_free_int(&queue, &domain);
+    ebr_unregister(thread);
+    ebr_free(&domain);
+
+    // 100 timers in the same slot of the second level
+    timer_wheel_t wheel;
+    ok(timer_wheel_init(&wheel, 1, 2, 0), "Initialize a timer wheel");
+    for (int i = 0; i < 100; i++)
+        (void)timer_wheel_schedule(&wheel, 1000, NULL, NULL);
+    ok(INSTRUMENT_STATS(timer_wheel, pool)->reallocations == 1 && INSTRUMENT_STATS(timer_wheel, pool)->peak_capacity == 128,
+       "Timer wheel pool growth");
+    ok(INSTRUMENT_STATS(timer_wheel, bucket)->reallocations == 4
+       && INSTRUMENT_STATS(timer_wheel, bucket)->peak_capacity == 128, "Timer wheel bucket growth");
+    timer_wheel_free(&wheel);
+
+    FILE* out = tmpfile();
+    static char dump[4096];
+    if (out != NULL) {
+        instrument_dump(out);
+        rewind(out);
+        dump[fread(dump, 1, sizeof(dump) - 1, out)] = '\0';
+        fclose(out);
+    }
+    ok(strstr(dump, "array int: 4 reallocations") != NULL, "Dump lists the arrays");
+    ok(strstr(dump, "ring int:") != NULL && strstr(dump, "4 overwrites, 8 drops") != NULL, "Dump lists the rings");
+    ok(strstr(dump, "10 allocations") != NULL && strstr(dump, "probes") != NULL,
+       "Dump lists the allocations and the probes");
+
+    instrument_reset();
+    ok(INSTRUMENT_STATS(array, int)->reallocations == 0 && instrument_first() != NULL, "Reset keeps the list");
+
+    done_testing();
+}
@@ -0,0 +1,220 @@
+#include <tap.h>
+#include <cutils/lockfree.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+DEFINE_LOCKFREE_STACK_TYPE(int)
+DEFINE_LOCKFREE_QUEUE_TYPE(int)
+
+#define THREADS 16
+#define PER_THREAD 20000
+
+// Allocator counting the live allocations, called from every thread
+static atomic_long live;
+
+static void* counting_alloc(void* metadata, size_t size) {
+    (void)metadata;
+    atomic_fetch_add(&live, 1);
+    return malloc(size);
+}
+
+static void* counting_realloc(void* metadata, void* buffer, size_t size) {
+    (void)metadata;
+    if (buffer == NULL)
+        atomic_fetch_add(&live, 1);
+    return realloc(buffer, size);
+}
+
+static void counting_dealloc(void* metadata, void* buffer) {
+    (void)metadata;
+    if (buffer != NULL)
+        atomic_fetch_sub(&live, 1);
+    free(buffer);
+}
+
+static int metadata;
+static ebr_domain_t domain;
+static int_lockfree_stack_t stack;
+static int_lockfree_queue_t queue;
+
+typedef struct {
+    int id;
+    long long popped_sum;
+    long popped;
+    bool ordered;
+    bool failed;
+} worker_t;
+
+// Every thread pushes its values and pops as many values, in any order
+static void* stack_worker(void* arg) {
+    worker_t* w = arg;
+    ebr_thread_t* thread = ebr_register(&domain);
+    if (thread == NULL) {
+        w->failed = true;
+        return NULL;
+    }
+    for (int i = 0; i < PER_THREAD; i++) {
+        const int value = w->id * PER_THREAD + i;
+        w->failed |= !lockfree_stack_push_int(&stack, thread, &value);
+        int popped;
+        if (i % 2 == 1) {
+            for (int k = 0; k < 2; k++) {
+                while (!lockfree_stack_pop_int(&stack, thread, &popped)) {}
+                w->popped_sum += popped;
+                w->popped += 1;
+            }
+        }
+    }
+    ebr_unregister(thread);
+    return NULL;
+}
+
+// Producers push increasing values, consumers check that the values of each
+// producer come out in order
+static void* queue_producer(void* arg) {
+    worker_t* w = arg;
+    ebr_thread_t* thread = ebr_register(&domain);
+    if (thread == NULL) {
+        w->failed = true;
+        return NULL;
+    }
+    for (int i = 0; i < PER_THREAD; i++) {
+        const int value = w->id * PER_THREAD + i;
+        w->failed |= !lockfree_queue_push_int(&queue, thread, &value);
+    }
+    ebr_unregister(thread);
+    return NULL;
+}
+
+static void* queue_consumer(void* arg) {
+    worker_t* w = arg;
+    ebr_thread_t* thread = ebr_register(&domain);
+    if (thread == NULL) {
+        w->failed = true;
+        return NULL;
+    }
+    int last[THREADS];
+    for (int p = 0; p < THREADS; p++)
+        last[p] = -1;
+    w->ordered = true;
+    for (int i = 0; i < PER_THREAD; i++) {
+        int value;
+        while (!lockfree_queue_pop_int(&queue, thread, &value)) {}
+        const int producer = value / PER_THREAD;
+        w->ordered &= value % PER_THREAD > last[producer];
+        last[producer] = value % PER_THREAD;
+        w->popped_sum += value;
+        w->popped += 1;
+    }
+    ebr_unregister(thread);
+    return NULL;
+}
+
+int main(void) {
+    ebr_init_allocator(&domain, ALLOCATOR_INIT_METADATA(&metadata, counting_alloc, counting_realloc, counting_dealloc));
+    ebr_thread_t* main_thread = ebr_register(&domain);
+    ok(main_thread != NULL, "Register the main thread");
+
+    // Sequential behaviour
+    stack = EMPTY_LOCKFREE_STACK(int);
+    ok(!lockfree_stack_pop_int(&stack, main_thread, NULL), "Empty stack");
+    bool pushed = true;
+    for (int i = 0; i < 100; i++)
+        pushed &= lockfree_stack_push_int(&stack, main_thread, &i);
+    ok(pushed, "Push on the stack");
+    bool lifo = true;
+    for (int i = 99; i >= 0; i--) {
+        int value = -1;
+        lifo &= lockfree_stack_pop_int(&stack, main_thread, &value) && value == i;
+    }
+    ok(lifo, "Stack pops in reverse order");
+    ok(!lockfree_stack_pop_int(&stack, main_thread, NULL), "Stack is empty again");
+
+    ok(lockfree_queue_init_int(&queue, &domain), "Init the queue");
+    ok(!lockfree_queue_pop_int(&queue, main_thread, NULL), "Empty queue");
+    pushed = true;
+    for (int i = 0; i < 100; i++)
+        pushed &= lockfree_queue_push_int(&queue, main_thread, &i);
+    ok(pushed, "Push in the queue");
+    bool fifo = true;
+    for (int i = 0; i < 100; i++) {
+        int value = -1;
+        fifo &= lockfree_queue_pop_int(&queue, main_thread, &value) && value == i;
+    }
+    ok(fifo, "Queue pops in order");
+    ok(!lockfree_queue_pop_int(&queue, main_thread, NULL), "Queue is empty again");
+
+    // Nothing pinned: the retired nodes are freed after two epochs
+    for (int i = 0; i < 3; i++)
+        ebr_collect(main_thread);
+    cmp_ok(main_thread->retired_count, "==", 0, "Retired nodes are freed once unpinned");
+
+    // A pinned thread keeps the epoch from advancing twice
+    ebr_thread_t* reader = ebr_register(&domain);
+    ebr_pin(reader);
+    for (int i = 0; i < 10; i++)
+        pushed &= lockfree_stack_push_int(&stack, main_thread, &i);
+    for (int i = 0; i < 10; i++)
+        lockfree_stack_pop_int(&stack, main_thread, NULL);
+    for (int i = 0; i < 3; i++)
+        ebr_collect(main_thread);
+    cmp_ok(main_thread->retired_count, "==", 10, "Pinned thread delays the frees");
+    ebr_unpin(reader);
+    for (int i = 0; i < 3; i++)
+        ebr_collect(main_thread);
+    cmp_ok(main_thread->retired_count, "==", 0, "Frees resume after unpin");
+    ebr_unregister(reader);
+    ok(ebr_register(&domain) == reader, "Released records are reused");
+    ebr_unregister(reader);
+
+    // Stress the stack
+    pthread_t threads[2 * THREADS];
+    worker_t workers[2 * THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        workers[t] = (worker_t) { .id = t };
+        pthread_create(&threads[t], NULL, stack_worker, &workers[t]);
+    }
+    long long sum = 0;
+    long popped = 0;
+    bool failed = false;
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        sum += workers[t].popped_sum;
+        popped += workers[t].popped;
+        failed |= workers[t].failed;
+    }
+    const long long expected = (long long)THREADS * PER_THREAD * (THREADS * PER_THREAD - 1) / 2;
+    ok(!failed, "Concurrent stack operations succeed");
+    ok(popped == (long)THREADS * PER_THREAD && sum == expected, "Every value is popped once from the stack");
+    ok(!lockfree_stack_pop_int(&stack, main_thread, NULL), "Stack is empty after the threads");
+
+    // Stress the queue with as many producers as consumers
+    for (int t = 0; t < 2 * THREADS; t++) {
+        workers[t] = (worker_t) { .id = t % THREADS };
+        pthread_create(&threads[t], NULL, t < THREADS ? queue_producer : queue_consumer, &workers[t]);
+    }
+    sum = 0;
+    popped = 0;
+    bool ordered = true;
+    for (int t = 0; t < 2 * THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        failed |= workers[t].failed;
+        if (t >= THREADS) {
+            sum += workers[t].popped_sum;
+            popped += workers[t].popped;
+            ordered &= workers[t].ordered;
+        }
+    }
+    ok(!failed, "Concurrent queue operations succeed");
+    ok(popped == (long)THREADS * PER_THREAD && sum == expected, "Every value is popped once from the queue");
+    ok(ordered, "Values of a producer keep their order");
+    ok(!lockfree_queue_pop_int(&queue, main_thread, NULL), "Queue is empty after the threads");
+
+    ebr_unregister(main_thread);
+    lockfree_stack_free_int(&stack, &domain);
+    lockfree_queue_free_int(&queue, &domain);
+    ebr_free(&domain);
+    cmp_ok(atomic_load(&live), "==", 0, "Every allocation is freed");
+
+    done_testing();
+}
@@ -0,0 +1,93 @@
+#define _DEFAULT_SOURCE
+#include <tap.h>
+#include <stdio.h>
+#include <cutils/mapped_file.h>
+
+#define PATH "mapped_file_basic.tmp"
+
+static bool write_file(const char* content, const size_t size) {
+    FILE* f = fopen(PATH, "wb");
+    if (f == NULL)
+        return false;
+    const bool written = fwrite(content, 1, size, f) == size;
+    return fclose(f) == 0 && written;
+}
+
+static bool view_equals(const string_view_t view, const char* expected) {
+    return view.len == strlen(expected) && memcmp(view.str, expected, view.len) == 0;
+}
+
+int main(void) {
+    const char* text = "first line\r\nsecond;line\n\nlast;line";
+    ok(write_file(text, strlen(text)), "Write the test file");
+
+    mapped_file_t file = MAPPED_FILE_INIT;
+    cmp_ok(mapped_file_open(&file, PATH), "==", -ERROR_NO_ERROR, "Map the file");
+    ok(view_equals(file.content, text), "Content of the mapping");
+
+    const char* lines[] = { "first line", "second;line", "", "last;line" };
+    string_split_t split = string_lines(file.content);
+    string_view_t record;
+    unsigned count = 0;
+    bool same = true;
+    while (string_lines_next(&split, &record))
+        same &= count < 4 && view_equals(record, lines[count++]);
+    ok(same && count == 4, "Iterate over the lines");
+
+    const char* records[] = { "first line\r\nsecond", "line\n\nlast", "line" };
+    split = string_split(file.content, ';');
+    count = 0;
+    same = true;
+    while (string_split_next(&split, &record))
+        same &= count < 3 && view_equals(record, records[count++]);
+    ok(same && count == 3, "Iterate over delimited records");
+    ok(record.str >= file.content.str && record.str < file.content.str + file.content.len,
+       "Records point in the mapping");
+    mapped_file_close(&file);
+    ok(file.content.len == 0, "Close");
+
+    split = string_lines(string_view("a\nb\n"));
+    count = 0;
+    while (string_split_next(&split, &record))
+        count++;
+    ok(count == 2, "A trailing delimiter does not start a record");
+    split = string_lines(EMPTY_STRING_VIEW);
+    ok(!string_split_next(&split, &record), "Empty view has no record");
+
+    // Lines of various lengths split for 1 to 16 threads
+    static char big[64 * 1024];
+    size_t size = 0;
+    for (unsigned i = 0; size + 100 < sizeof(big); i++) {
+        memset(big + size, 'a' + i % 26, i % 97);
+        size += i % 97;
+        big[size++] = '\n';
+    }
+    ok(write_file(big, size), "Write a larger file");
+    cmp_ok(mapped_file_open(&file, PATH), "==", -ERROR_NO_ERROR, "Map the larger file");
+    bool chunked = true;
+    for (unsigned threads = 1; threads <= 16; threads++) {
+        string_view_t chunks[16];
+        const unsigned n = string_chunks(file.content, '\n', threads, chunks);
+        chunked &= n >= 1 && n <= threads;
+        const char* next = file.content.str;
+        for (unsigned i = 0; i < n; i++) {
+            chunked &= chunks[i].str == next && chunks[i].len != 0 && chunks[i].str[chunks[i].len - 1] == '\n';
+            next = chunks[i].str + chunks[i].len;
+        }
+        chunked &= next == file.content.str + file.content.len;
+    }
+    ok(chunked, "Chunks cover the file and end on record boundaries");
+    string_view_t chunks[4];
+    cmp_ok(string_chunks(string_view("a\nb"), '\n', 4, chunks), "==", 2, "Fewer chunks than records");
+    ok(view_equals(chunks[0], "a\n") && view_equals(chunks[1], "b"), "Last chunk ends at the end of the view");
+    mapped_file_close(&file);
+
+    ok(write_file("", 0), "Write an empty file");
+    cmp_ok(mapped_file_open(&file, PATH), "==", -ERROR_NO_ERROR, "Map an empty file");
+    ok(file.content.len == 0, "Empty file gives an empty view");
+    mapped_file_close(&file);
+    remove(PATH);
+
+    cmp_ok(mapped_file_open(&file, PATH), "==", -ERROR_IO, "Missing file");
+    done_testing();
+}
@@ -0,0 +1,128 @@
+#include <tap.h>
+#include <cutils/array.h>
+#include <cutils/packed_array.h>
+#include <stdlib.h>
+
+#define COUNT 5000
+
+DEFINE_ARRAY_TYPE(uint32_t)
+DEFINE_PACKED_ARRAY_CONVERSIONS(uint32_t)
+
+static uint32_t values[COUNT];
+static uint32_t decoded[COUNT];
+
+static uint32_t random_value(const unsigned width) {
+    const uint32_t r = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+    return width == 32 ? r : r & ((1u << width) - 1);
+}
+
+int main(void) {
+    ok(packed_array_width(0) == 1 && packed_array_width(1) == 1 && packed_array_width(7) == 3
+       && packed_array_width(8) == 4 && packed_array_width(UINT32_MAX) == 32, "Width of a maximum value");
+
+    packed_array_t packed = EMPTY_PACKED_ARRAY(5);
+    ok(packed_array_append(&packed, 17) && packed_array_append(&packed, 31) && packed_array_append(&packed, 3),
+       "Append values");
+    ok(packed.length == 3 && packed_array_get(&packed, 0) == 17 && packed_array_get(&packed, 1) == 31
+       && packed_array_get(&packed, 2) == 3, "Get the appended values");
+    ok(packed.bytes[0] == (17 | (31 << 5)) % 256, "Values are stored from the low bits");
+    packed_array_set(&packed, 1, 0xFFE);
+    ok(packed_array_get(&packed, 0) == 17 && packed_array_get(&packed, 1) == 30 && packed_array_get(&packed, 2) == 3,
+       "Set drops the bits above the width and keeps the neighbours");
+    packed_array_free(&packed);
+    ok(packed.bytes == NULL && packed.length == 0, "Free the array");
+
+    srand(3);
+    bool appended = true, packed_same = true, unpacked_same = true, set_same = true;
+    for (unsigned width = 1; width <= PACKED_ARRAY_MAX_WIDTH; width++) {
+        for (unsigned i = 0; i < COUNT; i++)
+            values[i] = random_value(width);
+        packed_array_t one = EMPTY_PACKED_ARRAY(width);
+        for (unsigned i = 0; i < COUNT && appended; i++)
+            appended = packed_array_append(&one, values[i]);
+        // Packed in uneven batches which do not start on a byte
+        packed_array_t bulk = EMPTY_PACKED_ARRAY(width);
+        for (unsigned i = 0; i < COUNT; i += 37)
+            appended = appended && packed_array_pack(&bulk, values + i, COUNT - i < 37 ? COUNT - i : 37);
+        packed_same = packed_same && bulk.length == COUNT
+            && memcmp(one.bytes, bulk.bytes, packed_array_size(COUNT, width)) == 0;
+        // Unpacked from offsets and lengths around the groups of 8 values
+        for (unsigned from = 0; from < 20; from++) {
+            const unsigned count = COUNT - from - from * 3;
+            packed_array_unpack(&bulk, from, count, decoded);
+            unpacked_same = unpacked_same && memcmp(decoded, values + from, count * sizeof(uint32_t)) == 0;
+        }
+        for (unsigned i = 0; i < COUNT; i += 7) {
+            values[i] = random_value(width);
+            packed_array_set(&bulk, i, values[i]);
+        }
+        for (unsigned i = 0; i < COUNT; i++)
+            set_same = set_same && packed_array_get(&bulk, i) == values[i];
+        packed_array_free(&one);
+        packed_array_free(&bulk);
+    }
+    ok(appended, "Append and pack every width");
+    ok(packed_same, "Bulk packing gives the stream of single appends");
+    ok(unpacked_same, "Bulk unpacking from any offset");
+    ok(set_same, "Set values in the middle of the stream");
+
+    // Conversions with arrays
+    uint32_t_array_t array = EMPTY_ARRAY(uint32_t);
+    for (uint32_t i = 0; i < 1000; i++)
+        *array_append_uint32_t(&array, 1) = i * 13 % 1000;
+    packed = EMPTY_PACKED_ARRAY(packed_array_width(999));
+    ok(packed_array_pack_uint32_t(&packed, &array), "Pack an array");
+    cmp_ok(packed_array_size(packed.length, packed.width), "<", array.length * sizeof(uint32_t) / 3,
+           "10-bit values take less than a third of the array");
+    uint32_t_array_t copy = EMPTY_ARRAY(uint32_t);
+    ok(packed_array_unpack_uint32_t(&packed, &copy) && copy.length == array.length
+       && memcmp(copy.data, array.data, array.length * sizeof(uint32_t)) == 0, "Unpack into an array");
+
+    // Serialized form read in place and copied
+    const size_t size = packed_array_serialized_size(&packed);
+    char* buffer = malloc(size + 1);
+    packed_array_serialize(buffer + 1, &packed);
+    ok(buffer[1] == (char)1000 && buffer[9] == 10, "Little-endian header");
+    packed_array_t view = EMPTY_PACKED_ARRAY(0);
+    ok(packed_array_view(&view, buffer + 1, size), "View an unaligned serialized array");
+    ok(view.length == 1000 && view.width == 10 && view.capacity == 0 && view.bytes == (uint8_t*)buffer + 1 + 16,
+       "A view reads the buffer in place");
+    bool same = true;
+    for (unsigned i = 0; i < 1000; i++)
+        same = same && packed_array_get(&view, i) == array.data[i];
+    ok(same, "Get from a view");
+    ok(!packed_array_view(&view, buffer + 1, size - 1), "A truncated buffer is refused");
+    ok(packed_array_append(&view, 5) && view.capacity != 0 && view.bytes != (uint8_t*)buffer + 17
+       && packed_array_get(&view, 1000) == 5 && packed_array_get(&view, 999) == array.data[999],
+       "Appending to a view copies it");
+    packed_array_t copied = EMPTY_PACKED_ARRAY(0);
+    ok(packed_array_deserialize(&copied, buffer + 1, size) && copied.capacity >= 1000
+       && packed_array_get(&copied, 500) == array.data[500], "Deserialize a copy");
+    packed_array_t shrunk = EMPTY_PACKED_ARRAY(0);
+    ok(packed_array_view(&shrunk, buffer + 1, size) && packed_array_reserve(&shrunk, 1)
+       && shrunk.capacity >= 1000 && packed_array_get(&shrunk, 999) == array.data[999],
+       "Reserving less than the length of a view copies all of it");
+    packed_array_free(&shrunk);
+    buffer[9] = 33;
+    ok(!packed_array_deserialize(&copied, buffer + 1, size), "A width above 32 bits is refused");
+
+    // An empty array round trip does not point in the freed buffer
+    packed_array_t empty = EMPTY_PACKED_ARRAY(7);
+    const size_t empty_size = packed_array_serialized_size(&empty);
+    char* empty_buffer = malloc(empty_size);
+    packed_array_serialize(empty_buffer, &empty);
+    packed_array_t restored = EMPTY_PACKED_ARRAY(0);
+    ok(packed_array_deserialize(&restored, empty_buffer, empty_size) && restored.length == 0
+       && restored.width == 7 && restored.bytes == NULL, "Deserialize an empty array");
+    free(empty_buffer);
+    ok(packed_array_append(&restored, 100) && packed_array_get(&restored, 0) == 100, "Append after the buffer is freed");
+    packed_array_free(&restored);
+
+    free(buffer);
+    packed_array_free(&view);
+    packed_array_free(&copied);
+    packed_array_free(&packed);
+    array_free_uint32_t(&copy);
+    array_free_uint32_t(&array);
+    done_testing();
+}
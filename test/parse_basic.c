@@ -0,0 +1,158 @@
+#include <tap.h>
+#include <cutils/format.h>
+#include <cutils/parse.h>
+#include <math.h>
+#include <stdlib.h>
+
+#define RANDOM_NUMBERS 200000
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static bool same_double(const double a, const double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// parse_f64 agrees with strtod on the value and the consumed bytes, the
+// text being followed by a character which must not be read
+static bool matches_strtod(const char* text) {
+    char buffer[512];
+    const size_t length = strlen(text);
+    memcpy(buffer, text, length);
+    buffer[length] = '\0';
+    char* end;
+    const double expected = strtod(buffer, &end);
+    buffer[length] = '7';
+    double value;
+    size_t consumed;
+    const int ret = parse_f64((string_view_t) { .str = buffer, .len = length }, &value, &consumed);
+    if (end == buffer)
+        return ret == -ERROR_SYNTAX && consumed == 0;
+    return ret != -ERROR_SYNTAX && consumed == (size_t)(end - buffer) && same_double(value, expected);
+}
+
+int main(void) {
+    uint64_t u;
+    int64_t i;
+    double d;
+    size_t consumed;
+
+    cmp_ok(parse_u64(string_view("12345"), &u, &consumed), "==", -ERROR_NO_ERROR, "Parse an integer");
+    ok(u == 12345 && consumed == 5, "Value and length of an integer");
+    cmp_ok(parse_u64(string_view("000000000000000000000042x"), &u, &consumed), "==", -ERROR_NO_ERROR,
+           "Parse an integer with leading zeros");
+    ok(u == 42 && consumed == 24, "Leading zeros are consumed, the suffix is not");
+    cmp_ok(parse_u64(string_view("18446744073709551615"), &u, &consumed), "==", -ERROR_NO_ERROR, "Parse UINT64_MAX");
+    ok(u == UINT64_MAX && consumed == 20, "Value of UINT64_MAX");
+    cmp_ok(parse_u64(string_view("18446744073709551616"), &u, &consumed), "==", -ERROR_OUT_OF_RANGE,
+           "UINT64_MAX + 1 is out of range");
+    ok(u == UINT64_MAX && consumed == 20, "Out of range value is clamped and consumed");
+    cmp_ok(parse_u64(string_view("x1"), &u, &consumed), "==", -ERROR_SYNTAX, "No digit");
+    ok(consumed == 0, "Nothing consumed without digits");
+    cmp_ok(parse_u64((string_view_t) { .str = "123", .len = 2 }, &u, &consumed), "==", -ERROR_NO_ERROR,
+           "Parse the start of a string");
+    ok(u == 12 && consumed == 2, "The view ends the number");
+
+    cmp_ok(parse_i64(string_view("-9223372036854775808"), &i, &consumed), "==", -ERROR_NO_ERROR, "Parse INT64_MIN");
+    ok(i == INT64_MIN && consumed == 20, "Value of INT64_MIN");
+    cmp_ok(parse_i64(string_view("9223372036854775808"), &i, &consumed), "==", -ERROR_OUT_OF_RANGE,
+           "INT64_MAX + 1 is out of range");
+    ok(i == INT64_MAX, "Out of range value is clamped");
+    cmp_ok(parse_i64(string_view("+17,"), &i, &consumed), "==", -ERROR_NO_ERROR, "Parse a positive sign");
+    ok(i == 17 && consumed == 3, "Value with a positive sign");
+    cmp_ok(parse_i64(string_view("-"), &i, &consumed), "==", -ERROR_SYNTAX, "A sign alone");
+    ok(consumed == 0, "Nothing consumed for a sign alone");
+
+    bool same = true;
+    uint64_t state = 88172645463325252U;
+    char text[64];
+    for (unsigned n = 0; n < RANDOM_NUMBERS && same; n++) {
+        const uint64_t value = next_random(&state) >> (n % 64);
+        const int length = snprintf(text, sizeof(text), "%lld;", -(long long)(value >> 1));
+        same = parse_i64((string_view_t) { .str = text, .len = (size_t)length }, &i, &consumed) == -ERROR_NO_ERROR
+            && i == -(int64_t)(value >> 1) && consumed == (size_t)length - 1;
+        snprintf(text, sizeof(text), "%llu", (unsigned long long)value);
+        same = same && parse_u64(string_view(text), &u, &consumed) == -ERROR_NO_ERROR && u == value;
+    }
+    ok(same, "Random integers");
+
+    cmp_ok(parse_f64(string_view("3.25"), &d, &consumed), "==", -ERROR_NO_ERROR, "Parse a decimal");
+    ok(d == 3.25 && consumed == 4, "Value of a decimal");
+    cmp_ok(parse_f64(string_view("-0"), &d, &consumed), "==", -ERROR_NO_ERROR, "Parse a negative zero");
+    ok(same_double(d, -0.0), "Negative zero keeps its sign");
+    cmp_ok(parse_f64(string_view("1e400"), &d, &consumed), "==", -ERROR_OUT_OF_RANGE, "Overflow");
+    ok(d == HUGE_VAL && consumed == 5, "Overflow to infinity");
+    cmp_ok(parse_f64(string_view("-1e-400"), &d, &consumed), "==", -ERROR_OUT_OF_RANGE, "Underflow");
+    ok(same_double(d, -0.0), "Underflow to zero");
+    cmp_ok(parse_f64(string_view("."), &d, &consumed), "==", -ERROR_SYNTAX, "A point alone");
+    cmp_ok(parse_f64(string_view("-Infinity"), &d, &consumed), "==", -ERROR_NO_ERROR, "Parse an infinity");
+    ok(d == -HUGE_VAL && consumed == 9, "Value of an infinity");
+    cmp_ok(parse_f64(string_view("NaN"), &d, &consumed), "==", -ERROR_NO_ERROR, "Parse a NaN");
+    ok(d != d && consumed == 3, "Value of a NaN");
+
+    static const char* const cases[] = {
+        "0", "1", "1.", ".5", "-.5e1", "1e", "1e+", "1e-5", "2.5E+3", "123456789012345678901234567890",
+        "0.000000000000000000000000000000123456789012345678901234567890", "1.7976931348623157e308",
+        "1.7976931348623159e308", "2.2250738585072011e-308", "2.2250738585072014e-308", "4.9e-324", "2e-324",
+        "2.4703282292062328e-324", "9007199254740993", "9007199254740993.0000000000000000001",
+        "9007199254740992.9999999999999999999", "0.1", "0.30000000000000004", "1e22", "1e23", "5e-1",
+        "7.2057594037927933e+16", "179769313486231580793728971405303415079934132710037826936173778980444968292"
+        "764750946649017977587207096330286416692887910946555547851940402630657488671505820681908902000708383676"
+        "2737625895468434969520713138003574419086254453935099130613011466303456",
+        "0000000000000000000000000000000000000000000001e-10", "1e-99999999999", "1e99999999999", "+", "e5",
+    };
+    same = true;
+    for (unsigned n = 0; n < sizeof(cases) / sizeof(cases[0]); n++) {
+        const bool match = matches_strtod(cases[n]);
+        if (!match)
+            diag("%s", cases[n]);
+        same = same && match;
+    }
+    ok(same, "Edge cases match strtod");
+
+    string_t str = EMPTY_STRING;
+    same = true;
+    for (unsigned n = 0; n < RANDOM_NUMBERS && same; n++) {
+        // Random finite doubles, shortest and with a random number of digits
+        uint64_t bits;
+        do
+            bits = next_random(&state);
+        while ((bits >> 52 & 0x7FF) == 0x7FF);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        str.length = 0;
+        same = string_append_f64(&str, value);
+        snprintf(text, sizeof(text), "%.*s", (int)str.length, str.data);
+        same = same && matches_strtod(text);
+        snprintf(text, sizeof(text), "%.*e", (int)(bits % 25), value);
+        same = same && matches_strtod(text);
+        if (!same)
+            diag("%s", text);
+    }
+    ok(same, "Random doubles match strtod");
+    same = true;
+    char digits[128];
+    for (unsigned n = 0; n < RANDOM_NUMBERS && same; n++) {
+        // Long significands with a point anywhere, close to halfway cases
+        const uint64_t random = next_random(&state);
+        const unsigned length = 1 + (unsigned)(random % 40);
+        for (unsigned k = 0; k < length; k++)
+            digits[k] = (char)('0' + next_random(&state) % 10);
+        if (random & 0x100)
+            memset(digits + length / 2, random & 0x200 ? '0' : '9', length / 2);
+        const unsigned point = (unsigned)(random >> 8) % (length + 1);
+        snprintf(text, sizeof(text), "%.*s.%.*se%d", (int)point, digits, (int)(length - point), digits + point,
+                 (int)(random >> 32) % 700 - 350);
+        same = matches_strtod(text);
+        if (!same)
+            diag("%s", text);
+    }
+    ok(same, "Long significands match strtod");
+    string_free(&str);
+
+    done_testing();
+}
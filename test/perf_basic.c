@@ -0,0 +1,74 @@
+#include <tap.h>
+#include <cutils/perf.h>
+#include <stdint.h>
+
+static volatile uint64_t sink;
+
+static void work(const unsigned iterations) {
+    uint64_t x = 1;
+    for (unsigned i = 0; i < iterations; i++)
+        x = x * 6364136223846793005U + i;
+    sink = x;
+}
+
+int main(void) {
+    ok(perf_stats("loop") == NULL, "Scope is unknown before it is entered");
+
+    for (unsigned i = 0; i < 10; i++) {
+        PERF_SCOPE("loop") {
+            work(100000);
+        }
+    }
+    PERF_SCOPE("once") {
+        work(1000);
+    }
+
+    const perf_stats_t* loop = perf_stats("loop");
+    const perf_stats_t* once = perf_stats("once");
+    ok(loop != NULL && once != NULL && loop != once, "Every name has its own scope");
+    ok(loop->calls == 10, "Calls of a scope are aggregated");
+    ok(once->calls == 1, "Single call is recorded");
+    ok(loop->seconds > 0, "Wall-clock time is measured");
+
+    // Unavailable counters read as zero, the others count the loop
+    bool consistent = true;
+    for (unsigned c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (!perf_available(c))
+            consistent &= loop->counters[c] == 0;
+    }
+    ok(consistent, "Unavailable counters stay at zero");
+    skip(!perf_available(PERF_INSTRUCTIONS), 1, "Instructions counter unavailable");
+    ok(loop->counters[PERF_INSTRUCTIONS] > once->counters[PERF_INSTRUCTIONS],
+       "Longer scope retires more instructions");
+    end_skip;
+    skip(!perf_available(PERF_TASK_CLOCK), 1, "Task clock unavailable");
+    ok(loop->counters[PERF_TASK_CLOCK] > 0, "Task clock counts the running time");
+    end_skip;
+
+    ok(!perf_available(PERF_COUNTER_COUNT), "Out of range counter is unavailable");
+
+    static char report[4096];
+    FILE* out = tmpfile();
+    ok(out != NULL, "Report file is created");
+    if (out != NULL) {
+        perf_report(out);
+        rewind(out);
+        const size_t size = fread(report, 1, sizeof(report) - 1, out);
+        report[size] = '\0';
+        fclose(out);
+    }
+    ok(strstr(report, "loop: 10 calls") != NULL, "Report lists the scopes");
+    ok(strstr(report, "once: 1 calls") != NULL, "Report lists every scope");
+
+    perf_close();
+    ok(perf_stats("loop") == NULL, "Closing forgets the scopes");
+
+    // Scopes still work once the counters are closed
+    PERF_SCOPE("again") {
+        work(1000);
+    }
+    ok(perf_stats("again") != NULL && perf_stats("again")->calls == 1, "Counters are reopened after closing");
+    perf_close();
+
+    done_testing();
+}
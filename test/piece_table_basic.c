@@ -0,0 +1,146 @@
+#include <tap.h>
+#include <cutils/piece_table.h>
+#include <stdlib.h>
+
+#define EDITS 5000
+#define MODEL_CAPACITY (1 << 20)
+
+static uint64_t next_random(uint64_t* state) {
+    *state = *state * 6364136223846793005U + 1442695040888963407U;
+    return *state >> 33;
+}
+
+static bool matches(const piece_table_t* table, const char* model, size_t length) {
+    if (piece_table_length(table) != length)
+        return false;
+    string_t str = piece_table_to_string(table);
+    const bool equal = str.data != NULL && str.length == length + 1 && memcmp(str.data, model, length) == 0
+        && str.data[length] == '\0';
+    string_free(&str);
+    return equal;
+}
+
+static size_t depth(const piece_node_t* node) {
+    if (node == NULL)
+        return 0;
+    const size_t left = depth(node->left), right = depth(node->right);
+    return 1 + (left > right ? left : right);
+}
+
+// Nodes whose priority is above the one of their parent
+static size_t heap_violations(const piece_node_t* node) {
+    if (node == NULL)
+        return 0;
+    size_t violations = heap_violations(node->left) + heap_violations(node->right);
+    violations += node->left != NULL && node->left->priority > node->priority;
+    violations += node->right != NULL && node->right->priority > node->priority;
+    return violations;
+}
+
+int main(void) {
+    arena_allocator_t arena = ARENA_INIT;
+    piece_table_t table;
+    static char original[] = "The quick brown fox jumps over the lazy dog";
+    const size_t original_length = strlen(original);
+
+    ok(piece_table_init(&table, &arena, EMPTY_STRING_VIEW), "Init empty");
+    cmp_ok(piece_table_length(&table), "==", 0, "Empty table");
+    ok(piece_table_insert(&table, 0, string_view("abc")), "Insert in an empty table");
+    ok(!piece_table_insert(&table, 4, string_view("x")), "Insert after the end fails");
+    ok(matches(&table, "abc", 3), "Content after the first insert");
+
+    ok(piece_table_init(&table, &arena, string_view(original)), "Init with an original text");
+    ok(piece_table_insert(&table, 4, string_view("very ")), "Insert in the middle of a piece");
+    ok(piece_table_insert(&table, 0, string_view(">> ")), "Insert at the start");
+    ok(piece_table_insert(&table, piece_table_length(&table), string_view(" <<")), "Insert at the end");
+    ok(matches(&table, ">> The very quick brown fox jumps over the lazy dog <<", original_length + 11),
+       "Content after the inserts");
+    ok(piece_table_erase(&table, 3, 9), "Erase across pieces");
+    ok(matches(&table, ">> quick brown fox jumps over the lazy dog <<", original_length + 2), "Content after erase");
+    ok(piece_table_at(&table, 3) == 'q' && piece_table_at(&table, 1000) == '\0', "Index");
+    ok(piece_table_erase(&table, 40, 1000), "Erase past the end is clamped");
+    cmp_ok(piece_table_length(&table), "==", 40, "Length after a clamped erase");
+    ok(strcmp(original, "The quick brown fox jumps over the lazy dog") == 0, "Original text is not modified");
+
+    // Chunks are views of the pieces, some of them into the original text
+    size_t total = 0;
+    unsigned chunks = 0;
+    bool in_original = false;
+    string_view_t chunk;
+    for (size_t position = 0; piece_table_next(&table, &position, &chunk); chunks++) {
+        total += chunk.len;
+        in_original |= chunk.str >= original && chunk.str < original + original_length;
+    }
+    ok(total == 40 && chunks >= 2 && in_original, "Zero-copy iteration over the pieces");
+
+    // Random edits checked against a flat copy
+    char* model = malloc(MODEL_CAPACITY);
+    if (model == NULL)
+        return 1;
+    memcpy(model, original, original_length);
+    size_t length = original_length;
+    ok(piece_table_init(&table, &arena, string_view(original)), "Init for the random edits");
+    uint64_t state = 7;
+    bool edited = true, indexed = true;
+    for (unsigned i = 0; i < EDITS; i++) {
+        const size_t position = next_random(&state) % (length + 1);
+        if (next_random(&state) % 3 != 0 || length == 0) {
+            char text[16];
+            const size_t len = 1 + next_random(&state) % sizeof(text);
+            for (size_t k = 0; k < len; k++)
+                text[k] = (char)('a' + next_random(&state) % 26);
+            edited &= piece_table_insert(&table, position, (string_view_t) { text, len });
+            memmove(model + position + len, model + position, length - position);
+            memcpy(model + position, text, len);
+            length += len;
+        } else {
+            const size_t count = next_random(&state) % 32;
+            edited &= piece_table_erase(&table, position, count);
+            const size_t erased = count < length - position ? count : length - position;
+            memmove(model + position, model + position + erased, length - position - erased);
+            length -= erased;
+        }
+        if (length != 0) {
+            const size_t probe = next_random(&state) % length;
+            indexed &= piece_table_at(&table, probe) == model[probe];
+        }
+    }
+    ok(edited, "Random edits succeed");
+    ok(indexed, "Index matches after every edit");
+    ok(matches(&table, model, length), "Content matches after %d random edits", EDITS);
+
+    // Erasing everything recycles the nodes
+    ok(piece_table_erase(&table, 0, length), "Erase everything");
+    cmp_ok(piece_table_length(&table), "==", 0, "Table is empty");
+    ok(table.free != NULL, "Erased nodes are kept for reuse");
+    const piece_node_t* reused = table.free;
+    ok(piece_table_insert(&table, 0, string_view("x")) && table.root == reused, "Next insert reuses a node");
+
+    // Erases only cut pieces in two, the halves must stay balanced
+    static char long_original[3000];
+    memset(long_original, 'a', sizeof(long_original));
+    ok(piece_table_init(&table, &arena, (string_view_t) { .str = long_original, .len = sizeof(long_original) }),
+       "Init for the erases");
+    bool erased = true;
+    for (size_t i = 1; i <= 1000; i++)
+        erased = erased && piece_table_erase(&table, i, 1);
+    ok(erased && piece_table_length(&table) == 2000, "Erase a character out of two");
+    cmp_ok(depth(table.root), "<", 60, "The treap of 1001 pieces stays balanced");
+    cmp_ok(heap_violations(table.root), "==", 0, "Erases keep the heap order of the priorities");
+
+    // Inserts in the middle of pieces cut them, and so do erases inside them
+    uint64_t cuts = 11;
+    bool cut = true;
+    for (unsigned i = 0; i < 20000; i++) {
+        const size_t position = next_random(&cuts) % (piece_table_length(&table) + 1);
+        cut = cut && (i % 4 == 3 ? piece_table_erase(&table, position, 3)
+                                 : piece_table_insert(&table, position, string_view("xyz")));
+    }
+    ok(cut, "Insert and erase in the middle of pieces");
+    cmp_ok(heap_violations(table.root), "==", 0, "Inserts keep the heap order of the priorities");
+    cmp_ok(depth(table.root), "<", 100, "The treap stays balanced");
+
+    free(model);
+    arena_free(&arena);
+    done_testing();
+}
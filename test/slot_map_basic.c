@@ -0,0 +1,56 @@
+#include <tap.h>
+#include <cutils/array.h>
+#include <cutils/slot_map.h>
+
+typedef struct {
+    int id;
+    float x;
+} entity;
+
+DEFINE_ARRAY_TYPE(entity)
+DEFINE_SLOT_MAP_TYPE(entity)
+
+int main(void) {
+    entity_slot_map_t map = EMPTY_SLOT_MAP(entity);
+    slot_handle_t handles[1000];
+    for (int i = 0; i < 1000; i++) {
+        handles[i] = slot_map_insert_entity(&map, &(entity) { i, (float)i });
+        if (handles[i] == SLOT_HANDLE_NULL)
+            fail("Insert %d", i);
+    }
+    cmp_ok(map.values.length, "==", 1000, "Insert 1000 elements");
+    ok(slot_map_get_entity(&map, handles[500])->id == 500, "Lookup by handle");
+    ok(slot_map_get_entity(&map, SLOT_HANDLE_NULL) == NULL, "Null handle is never valid");
+
+    // Erase the even elements
+    entity removed;
+    bool erased = true;
+    for (int i = 0; i < 1000; i += 2)
+        erased &= slot_map_erase_entity(&map, handles[i], &removed) && removed.id == i;
+    ok(erased, "Erase by handle");
+    cmp_ok(map.values.length, "==", 500, "Values stay dense");
+    ok(!slot_map_contains_entity(&map, handles[0]), "Stale handle is detected");
+    ok(!slot_map_erase_entity(&map, handles[0], NULL), "Stale handle cannot be erased");
+
+    bool stable = true;
+    for (int i = 1; i < 1000; i += 2)
+        stable &= slot_map_get_entity(&map, handles[i])->id == i;
+    ok(stable, "Handles of the remaining elements are stable");
+
+    const slot_handle_t reused = slot_map_insert_entity(&map, &(entity) { 2000, 0 });
+    ok(slot_handle_index(reused) == slot_handle_index(handles[998]), "Free slot is reused");
+    ok(slot_handle_generation(reused) != slot_handle_generation(handles[998]), "Generation of a reused slot changes");
+    ok(slot_map_get_entity(&map, handles[998]) == NULL, "Old handle of a reused slot is stale");
+
+    bool owners = true;
+    foreach(map.values, e, entity) {
+        owners &= slot_map_get_entity(&map, slot_map_handle_of_entity(&map, index)) == e;
+    }
+    ok(owners, "Contiguous iteration maps back to handles");
+
+    slot_map_clear_entity(&map);
+    ok(map.values.length == 0 && slot_map_get_entity(&map, handles[1]) == NULL, "Clear invalidates the handles");
+    slot_map_free_entity(&map);
+    ok(map.slots == NULL && map.owner == NULL && map.values.data == NULL, "Free");
+    done_testing();
+}
@@ -0,0 +1,89 @@
+#include <tap.h>
+#include <cutils/small_array.h>
+
+DEFINE_SMALL_ARRAY_TYPE(int, 4)
+DEFINE_SMALL_ARRAY_TYPE_WITH_ALLOCATOR(byte_alloc, char, 8, allocator)
+
+static unsigned allocations = 0;
+
+static void* counting_alloc(size_t size) {
+    allocations++;
+    return malloc(size);
+}
+
+static int compare_int(const int* a, const int* b) {
+    return (*a > *b) - (*a < *b);
+}
+
+int main(void) {
+    int_array_t array = EMPTY_SMALL_ARRAY(int);
+    cmp_ok(array.capacity, "==", 0, "Initial capacity is 0");
+    ok(array_data_int(&array) == array.local, "Elements start inline");
+
+    for (int i = 0; i < 4; i++)
+        *array_append_int(&array, 1) = i;
+    cmp_ok(array.capacity, "==", 4, "Capacity is N while inline");
+    ok(array_data_int(&array) == array.local, "N elements stay inline");
+
+    int_array_t copy = array;
+    ok(array_data_int(&copy)[3] == 3, "A copy carries the inline elements");
+
+    *array_append_int(&array, 1) = 4;
+    ok(array.capacity > 4 && array_data_int(&array) == array.heap, "Spill to the heap past N");
+    bool same = array.length == 5;
+    for (int i = 0; i < 5; i++)
+        same = same && array_data_int(&array)[i] == i;
+    ok(same, "Elements are kept on spill");
+
+    int value;
+    ok(array_pop_int(&array, &value) && value == 4 && array.length == 4, "Pop the last element");
+    ok(array_remove_int(&array, &value, 0) && value == 0 && array_data_int(&array)[0] == 1, "Remove the first element");
+    value = 0;
+    ok(*array_insert_int(&array, &value, 0) == 0 && array.length == 4, "Insert at the front");
+    array_swap_and_pop_back_int(&array, 0);
+    ok(array.length == 3 && array_data_int(&array)[0] == 3, "Swap and pop back");
+
+    const bool remove[] = { true, false, true };
+    array_filter_int(&array, remove);
+    ok(array.length == 1 && array_data_int(&array)[0] == 1, "Filter elements out");
+
+    array_free_int(&array);
+    for (int i = 9; i >= 0; i--) {
+        int x = i * 2;
+        array_insert_sorted_int(&array, compare_int, &x);
+    }
+    same = array.length == 10;
+    for (int i = 0; i < 10; i++)
+        same = same && array_data_int(&array)[i] == i * 2;
+    ok(same, "Sorted insertion");
+    int needle = 8;
+    ok(array_find_sorted_int(&array, compare_int, &needle) == array_data_int(&array) + 4, "Find a sorted element");
+    needle = 7;
+    ok(array_find_sorted_int(&array, compare_int, &needle) == NULL, "Missing sorted element");
+
+    int_array_t clone = array_shallow_clone_int(&array);
+    ok(clone.heap != array.heap && memcmp(clone.heap, array.heap, 10 * sizeof(int)) == 0, "Clone a spilled array");
+    array_free_int(&clone);
+
+    _Alignas(unsigned) char buffer[128];
+    ok(array_serialized_size_int(&array) <= sizeof(buffer) && array_serialize_int(buffer, &array), "Serialize");
+    int_array_t restored = EMPTY_SMALL_ARRAY(int);
+    ok(array_deserialize_int(&restored, buffer) && restored.length == 10
+           && memcmp(array_data_int(&restored), array_data_int(&array), 10 * sizeof(int)) == 0,
+       "Deserialize");
+    array_free_int(&restored);
+    array_free_int(&array);
+    cmp_ok(array.capacity, "==", 0, "Set capacity = 0 on free");
+    cmp_ok(array.length, "==", 0, "Set length = 0 on free");
+
+    const allocator_t allocator = ALLOCATOR_INIT(counting_alloc, realloc, free);
+    byte_alloc_array_t bytes = EMPTY_SMALL_ARRAY_WITH_ALLOCATOR(byte_alloc, &allocator);
+    memcpy(array_append_byte_alloc(&bytes, 8), "01234567", 8);
+    cmp_ok(allocations, "==", 0, "No allocation up to N");
+    *array_append_byte_alloc(&bytes, 1) = '8';
+    cmp_ok(allocations, "==", 1, "Spill through the allocator");
+    ok(memcmp(array_data_byte_alloc(&bytes), "012345678", 9) == 0, "Content after the spill");
+    array_free_byte_alloc(&bytes);
+
+    done_testing();
+}
@@ -0,0 +1,49 @@
+#include <tap.h>
+#include <cutils/array.h>
+#include <cutils/soa.h>
+
+typedef struct {
+    float x, y;
+    int id;
+} point;
+
+DEFINE_ARRAY_TYPE(point)
+DEFINE_SOA_TYPE(point, (float, x), (float, y), (int, id))
+
+int main(void) {
+    point_soa_t soa = EMPTY_SOA(point);
+    for (int i = 0; i < 100; i++) {
+        const point p = { .x = (float)i, .y = (float)-i, .id = i };
+        ok(soa_push_point(&soa, &p), "Push %d", i);
+    }
+    cmp_ok(soa.length, "==", 100, "Length after push");
+    ok(((uintptr_t)soa.x % CUTILS_SOA_ALIGN) == 0 && ((uintptr_t)soa.y % CUTILS_SOA_ALIGN) == 0
+       && ((uintptr_t)soa.id % CUTILS_SOA_ALIGN) == 0, "Columns are aligned");
+    const float* x = soa_column(soa, x);
+    float sum = 0;
+    for (unsigned i = 0; i < soa.length; i++)
+        sum += x[i];
+    ok(sum == 4950.0f, "Sum of a column");
+
+    point p = soa_get_point(&soa, 42);
+    ok(p.x == 42.0f && p.y == -42.0f && p.id == 42, "Get gathers the fields");
+    soa_remove_point(&soa, 0);
+    ok(soa.length == 99 && soa.id[0] == 1 && soa.y[98] == -99.0f, "Remove shifts the columns");
+    soa_swap_and_pop_back_point(&soa, 0);
+    ok(soa.length == 98 && soa.id[0] == 99 && soa.x[0] == 99.0f, "Swap and pop back");
+    ok(soa_pop_point(&soa, &p) && p.id == 98, "Pop");
+
+    point_array_t array = EMPTY_ARRAY(point);
+    ok(soa_to_array(point, &soa, &array), "Convert to AoS");
+    ok(array.length == soa.length && array.data[1].id == soa.id[1] && array.data[1].y == soa.y[1], "AoS content");
+
+    point_soa_t copy = EMPTY_SOA(point);
+    ok(soa_from_array(point, &copy, &array), "Convert from AoS");
+    ok(copy.length == array.length && copy.id[96] == soa.id[96] && copy.x[96] == soa.x[96], "SoA content");
+
+    array_free_point(&array);
+    soa_free_point(&copy);
+    soa_free_point(&soa);
+    ok(soa.block == NULL && soa.length == 0 && soa.capacity == 0, "Free");
+    done_testing();
+}
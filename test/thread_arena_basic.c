@@ -0,0 +1,119 @@
+#include <tap.h>
+#include <cutils/allocator/thread_arena.h>
+#include <cutils/array.h>
+#include <pthread.h>
+
+#define THREADS 4
+#define BLOCKS 10000
+
+DEFINE_ARRAY_TYPE_WITH_ALLOCATOR(int_thread, int, thread_arena)
+
+typedef struct {
+    void* blocks[BLOCKS];
+    bool filled;
+} batch_t;
+
+// Allocate blocks which the main thread frees after the exit of the thread
+static void* allocate_and_exit(void* data) {
+    batch_t* batch = data;
+    batch->filled = true;
+    for (unsigned i = 0; i < BLOCKS; i++) {
+        batch->blocks[i] = thread_arena_alloc(16 + i % 200);
+        batch->filled = batch->filled && batch->blocks[i] != NULL;
+        if (batch->blocks[i] != NULL)
+            memset(batch->blocks[i], (int)i, 16 + i % 200);
+    }
+    return NULL;
+}
+
+// Free the blocks of another thread
+static void* free_batch(void* data) {
+    batch_t* batch = data;
+    for (unsigned i = 0; i < BLOCKS; i++)
+        thread_arena_free(batch->blocks[i]);
+    return NULL;
+}
+
+int main(void) {
+    const int node = thread_arena_current_node();
+    ok(node >= -1, "Current node is known or -1");
+    diag("node %d", node);
+
+    void* a = thread_arena_alloc(24);
+    thread_arena_t* arena = thread_arena_get();
+    ok(a != NULL && arena != NULL, "Allocate from the arena of the thread");
+    cmp_ok(thread_arena_count(), "==", 1, "One arena is created");
+    ok(((uintptr_t)a & (ALIGNOF(max_align_t) - 1)) == 0, "Blocks are aligned for any type");
+    ok(thread_arena_block_size(a) == 32, "Sizes are rounded to their class");
+    ok(arena->node == node, "The arena is placed on the current node");
+    diag("memory %s", arena->bound ? "bound by mbind" : "placed by first touch");
+
+    thread_arena_free(a);
+    ok(thread_arena_alloc(20) == a, "A freed block is reused by its class");
+    void* big = thread_arena_alloc(CUTILS_THREAD_ARENA_MAX_SMALL * 4);
+    ok(big != NULL && thread_arena_block_size(big) >= CUTILS_THREAD_ARENA_MAX_SMALL * 4, "Large block");
+    memset(big, 1, CUTILS_THREAD_ARENA_MAX_SMALL * 4);
+    void* grown = thread_arena_realloc(a, 200);
+    ok(grown != NULL && thread_arena_block_size(grown) == 256, "Reallocate to a larger class");
+    thread_arena_free(big);
+    thread_arena_free(grown);
+
+    // Blocks of a main thread allocation freed by another thread come back
+    static batch_t batch;
+    for (unsigned i = 0; i < BLOCKS; i++)
+        batch.blocks[i] = thread_arena_alloc(48);
+    pthread_t thread;
+    pthread_create(&thread, NULL, free_batch, &batch);
+    pthread_join(thread, NULL);
+    cmp_ok(atomic_load(&arena->references), "==", 1, "Remote frees release their references");
+    bool reused = true;
+    for (unsigned i = 0; i < 16; i++) {
+        void* p = thread_arena_alloc(48);
+        bool found = false;
+        for (unsigned k = 0; k < BLOCKS && !found; k++)
+            found = batch.blocks[k] == p;
+        reused = reused && found;
+        thread_arena_free(p);
+    }
+    ok(reused, "Blocks freed by another thread are handed back to the owner");
+
+    // Threads exit with live blocks, their arenas outlive them
+    static batch_t batches[THREADS];
+    pthread_t threads[THREADS];
+    for (unsigned t = 0; t < THREADS; t++)
+        pthread_create(&threads[t], NULL, allocate_and_exit, &batches[t]);
+    for (unsigned t = 0; t < THREADS; t++)
+        pthread_join(threads[t], NULL);
+    bool filled = true;
+    for (unsigned t = 0; t < THREADS; t++)
+        filled = filled && batches[t].filled;
+    ok(filled, "Allocations of several threads");
+    cmp_ok(thread_arena_count(), "==", 1 + THREADS, "Arenas of exited threads with live blocks are kept");
+    bool intact = true;
+    for (unsigned t = 0; t < THREADS; t++)
+        for (unsigned i = 0; i < BLOCKS; i++)
+            intact = intact && ((unsigned char*)batches[t].blocks[i])[15] == (unsigned char)i;
+    ok(intact, "Blocks survive the exit of their thread");
+    for (unsigned t = 0; t < THREADS; t++)
+        free_batch(&batches[t]);
+    cmp_ok(thread_arena_count(), "==", 1, "The last free releases the arena of an exited thread");
+
+    int_thread_array_t array = EMPTY_ARRAY(int_thread);
+    bool appended = true;
+    for (int i = 0; i < 5000 && appended; i++) {
+        int* p = array_append_int_thread(&array, 1);
+        appended = p != NULL;
+        if (appended)
+            *p = i;
+    }
+    ok(appended && array.data[4999] == 4999, "Containers bound to the thread arena");
+    array_free_int_thread(&array);
+
+    // Go back to the default node policy, set_mempolicy may be refused by a
+    // seccomp filter or a kernel without NUMA support
+    diag("set_mempolicy %s", thread_arena_prefer_node(-1) ? "accepted" : "refused");
+
+    thread_arena_thread_exit();
+    cmp_ok(thread_arena_count(), "==", 0, "Release the arena of the main thread");
+    done_testing();
+}
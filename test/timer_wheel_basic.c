@@ -0,0 +1,190 @@
+#include <tap.h>
+#include <cutils/timer_wheel.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define RANDOM_TIMERS 20000
+
+typedef struct {
+    uint64_t expires;
+    uint64_t fired_at;
+    unsigned fired;
+    bool cancelled;
+} probe_t;
+
+static uint64_t last_fired;
+static bool in_order = true;
+
+static void record(timer_wheel_t* wheel, void* data) {
+    probe_t* probe = data;
+    probe->fired += 1;
+    probe->fired_at = wheel->now;
+    in_order = in_order && wheel->now >= last_fired;
+    last_fired = wheel->now;
+}
+
+typedef struct {
+    unsigned count;
+    uint64_t period;
+} periodic_t;
+
+static void repeat(timer_wheel_t* wheel, void* data) {
+    periodic_t* periodic = data;
+    periodic->count += 1;
+    (void)timer_wheel_schedule(wheel, (wheel->now * wheel->tick) + periodic->period, repeat, periodic);
+}
+
+// Allocator failing while refuse is set
+static bool refuse;
+static void* refusing_alloc(const size_t size) { return refuse ? NULL : malloc(size); }
+static void* refusing_realloc(void* buffer, const size_t size) { return refuse ? NULL : realloc(buffer, size); }
+
+static uint64_t random_below(const uint64_t n) {
+    return (((uint64_t)rand() << 31) ^ (uint64_t)rand()) % n;
+}
+
+int main(void) {
+    timer_wheel_t wheel;
+    ok(!timer_wheel_init(&wheel, 0, 4, 0), "A tick of 0 is refused");
+    ok(!timer_wheel_init(&wheel, 1, 0, 0) && !timer_wheel_init(&wheel, 1, TIMER_WHEEL_MAX_LEVELS + 1, 0),
+       "Level counts out of range are refused");
+
+    // A single level parks the timers beyond its span of 64 ticks
+    ok(timer_wheel_init(&wheel, 1, 1, 0), "Initialize a wheel of a single level");
+    probe_t parked = {0}, soon = {0};
+    (void)timer_wheel_schedule(&wheel, 1000, record, &parked);
+    (void)timer_wheel_schedule(&wheel, 64, record, &soon);
+    cmp_ok(timer_wheel_advance(&wheel, 63), "==", 0, "No timer fires before its tick on a single level");
+    ok(timer_wheel_advance(&wheel, 999) == 1 && soon.fired_at == 64 && parked.fired == 0,
+       "A timer 64 ticks away fires on its tick");
+    ok(timer_wheel_advance(&wheel, 1000) == 1 && parked.fired_at == 1000,
+       "A timer beyond the span fires on its tick");
+    static probe_t single[1000];
+    srand(5);
+    for (unsigned i = 0; i < 1000; i++) {
+        single[i].expires = 1001 + random_below(5000);
+        (void)timer_wheel_schedule(&wheel, single[i].expires, record, &single[i]);
+    }
+    for (uint64_t time = 1000; wheel.count != 0;)
+        timer_wheel_advance(&wheel, time += random_below(200));
+    bool single_exact = true;
+    for (unsigned i = 0; i < 1000; i++)
+        single_exact = single_exact && single[i].fired == 1 && single[i].fired_at == single[i].expires;
+    ok(single_exact && in_order, "Random timers fire once, on their tick, on a single level");
+    timer_wheel_free(&wheel);
+    last_fired = 0;
+
+    // Two levels with a timer far beyond their span
+    ok(timer_wheel_init(&wheel, 1, 2, 0), "Initialize a wheel of 2 levels");
+    probe_t far = {0};
+    (void)timer_wheel_schedule(&wheel, 10000, record, &far);
+    cmp_ok(timer_wheel_advance(&wheel, 63), "==", 0, "A far timer does not fire in the first slots");
+    cmp_ok(timer_wheel_advance(&wheel, 9999), "==", 0, "A far timer does not fire at the end of the span");
+    ok(timer_wheel_advance(&wheel, 10000) == 1 && far.fired_at == 10000, "A far timer fires on its tick");
+    timer_wheel_free(&wheel);
+    last_fired = 0;
+
+    ok(timer_wheel_init(&wheel, 10, 3, 1000), "Initialize a wheel of 3 levels");
+    probe_t a = {0}, b = {0}, c = {0};
+    const slot_handle_t ha = timer_wheel_schedule(&wheel, 1500, record, &a);
+    const slot_handle_t hb = timer_wheel_schedule(&wheel, 1505, record, &b);
+    const slot_handle_t hc = timer_wheel_schedule(&wheel, 900, record, &c);
+    ok(ha != SLOT_HANDLE_NULL && hb != SLOT_HANDLE_NULL && hc != SLOT_HANDLE_NULL, "Schedule timers");
+    cmp_ok(wheel.count, "==", 3, "Count the scheduled timers");
+    cmp_ok(timer_wheel_advance(&wheel, 1010), "==", 1, "A timer in the past fires on the next tick");
+    ok(c.fired == 1 && c.fired_at == 101, "Fired on tick 101");
+    cmp_ok(timer_wheel_advance(&wheel, 1499), "==", 0, "No timer fires early");
+    cmp_ok(timer_wheel_advance(&wheel, 1500), "==", 1, "Fire on the expiry");
+    cmp_ok(timer_wheel_advance(&wheel, 1509), "==", 0, "Expiries are rounded up to a tick");
+    cmp_ok(timer_wheel_advance(&wheel, 1510), "==", 1, "Fire on the next tick");
+    ok(!timer_wheel_pending(&wheel, ha) && !timer_wheel_cancel(&wheel, hb), "Fired timers cannot be cancelled");
+
+    const slot_handle_t hd = timer_wheel_schedule(&wheel, 2000, record, &a);
+    ok(slot_handle_index(hd) == slot_handle_index(hb) && hd != hb, "Nodes are reused with a new generation");
+    ok(timer_wheel_pending(&wheel, hd) && !timer_wheel_pending(&wheel, hb), "Stale handles do not see the new timer");
+    ok(timer_wheel_cancel(&wheel, hd) && !timer_wheel_cancel(&wheel, hd), "Cancel a timer once");
+    ok(timer_wheel_advance(&wheel, 3000) == 0 && a.fired == 1, "A cancelled timer does not fire");
+    cmp_ok(wheel.count, "==", 0, "No timer is left");
+
+    const slot_handle_t he = timer_wheel_schedule(&wheel, 4000, record, &b);
+    ok(timer_wheel_reschedule(&wheel, he, 100000), "Reschedule a pending timer");
+    timer_wheel_advance(&wheel, 99990);
+    cmp_ok(b.fired, "==", 1, "A rescheduled timer does not fire at its old expiry");
+    timer_wheel_advance(&wheel, 100000);
+    ok(b.fired == 2 && b.fired_at == 10000, "A rescheduled timer fires at its new expiry");
+
+    // Periodic timer scheduling itself from its callback
+    periodic_t periodic = { .period = 70 };
+    (void)timer_wheel_schedule(&wheel, 100070, repeat, &periodic);
+    timer_wheel_advance(&wheel, 100700);
+    cmp_ok(periodic.count, "==", 10, "Timers scheduled by callbacks fire in the same advance");
+    timer_wheel_free(&wheel);
+    ok(wheel.count == 0 && wheel.nodes == NULL, "Free the wheel");
+
+    // Random expiries across the levels and beyond their span (64^3 ticks),
+    // advanced by random steps with random cancellations
+    ok(timer_wheel_init(&wheel, 1, 3, 0), "Initialize a wheel with a tick of 1");
+    static probe_t probes[RANDOM_TIMERS];
+    static slot_handle_t handles[RANDOM_TIMERS];
+    srand(7);
+    last_fired = 0;
+    bool scheduled = true;
+    for (unsigned i = 0; i < RANDOM_TIMERS; i++) {
+        probes[i].expires = 1 + random_below(i % 4 == 0 ? 1 << 20 : 1 << 12);
+        handles[i] = timer_wheel_schedule(&wheel, probes[i].expires, record, &probes[i]);
+        scheduled = scheduled && handles[i] != SLOT_HANDLE_NULL;
+    }
+    ok(scheduled, "Schedule random timers");
+    for (unsigned i = 0; i < RANDOM_TIMERS; i += 5)
+        probes[i].cancelled = timer_wheel_cancel(&wheel, handles[i]);
+    uint64_t time = 0;
+    while (wheel.count != 0)
+        timer_wheel_advance(&wheel, time += random_below(3000));
+    bool exact = true;
+    for (unsigned i = 0; i < RANDOM_TIMERS; i++) {
+        if (probes[i].cancelled)
+            exact = exact && probes[i].fired == 0;
+        else
+            exact = exact && probes[i].fired == 1 && probes[i].fired_at == probes[i].expires;
+    }
+    ok(exact, "Every timer fires once, on its tick");
+    ok(in_order, "Timers fire in order of expiry");
+    const unsigned capacity = wheel.node_capacity;
+    for (unsigned i = 0; i < RANDOM_TIMERS; i++)
+        handles[i] = timer_wheel_schedule(&wheel, time + 1 + i, record, &probes[i]);
+    cmp_ok(wheel.node_capacity, "==", capacity, "Nodes come back to the pool");
+    timer_wheel_free(&wheel);
+
+    // A far timer is reached by jumping from slot to slot of the levels, not
+    // by stepping over each boundary of the first level (2^30 of them)
+    ok(timer_wheel_init(&wheel, 1, TIMER_WHEEL_MAX_LEVELS, 0), "Initialize a wheel of every level");
+    probe_t distant = {0};
+    (void)timer_wheel_schedule(&wheel, (uint64_t)1 << 36, record, &distant);
+    const clock_t started = clock();
+    cmp_ok(timer_wheel_advance(&wheel, ((uint64_t)1 << 36) - 1), "==", 0, "A far timer does not fire early");
+    ok(timer_wheel_advance(&wheel, (uint64_t)1 << 36) == 1 && distant.fired_at == (uint64_t)1 << 36,
+       "A far timer fires on its tick");
+    cmp_ok((double)(clock() - started) / CLOCKS_PER_SEC, "<", 1.0, "Idle levels are skipped");
+    timer_wheel_free(&wheel);
+    last_fired = 0;
+
+    // Buckets of the first level cannot grow when a slot above cascades
+    ok(timer_wheel_init_allocator(&wheel, ALLOCATOR_INIT(refusing_alloc, refusing_realloc, free), 1, 2, 0),
+       "Initialize a wheel with an allocator");
+    for (unsigned i = 0; i < 100; i++)
+        handles[i] = timer_wheel_schedule(&wheel, 200 + i % 50, record, &probes[i]);
+    memset(probes, 0, 100 * sizeof(probe_t));
+    refuse = true;
+    ok(timer_wheel_schedule(&wheel, 10, record, &a) == SLOT_HANDLE_NULL, "Scheduling fails when the pool cannot grow");
+    timer_wheel_advance(&wheel, 300);
+    ok(wheel.now < 300 && wheel.count == 100, "Advancing stops when a bucket cannot grow");
+    refuse = false;
+    timer_wheel_advance(&wheel, 300);
+    exact = true;
+    for (unsigned i = 0; i < 100; i++)
+        exact = exact && probes[i].fired == 1 && probes[i].fired_at == 200 + i % 50;
+    ok(exact && wheel.count == 0, "Advancing resumes once the bucket can grow");
+    timer_wheel_free(&wheel);
+
+    done_testing();
+}